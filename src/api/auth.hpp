@@ -15,6 +15,7 @@
 #ifndef MENDER_API_AUTH_HPP
 #define MENDER_API_AUTH_HPP
 
+#include <chrono>
 #include <functional>
 #include <string>
 #include <vector>
@@ -69,6 +70,23 @@ using ExpectedAuthData = expected::expected<AuthData, error::Error>;
 
 using AuthenticatedAction = function<void(ExpectedAuthData)>;
 
+using ExpectedTimePoint = expected::expected<chrono::system_clock::time_point, error::Error>;
+
+// Returns the expiry time from the `exp` claim of a JWT token. The signature is not checked, we
+// only use this to know when to ask for a new token.
+ExpectedTimePoint GetTokenExpiry(const string &token);
+
+// How long to wait before refreshing a token which expires at `expiry`, so that the new token
+// arrives before the old one expires. Returns an error if the token has already expired according
+// to `now`, which usually means that our clock is off, and then there is no point in refreshing
+// ahead of time.
+using ExpectedSeconds = expected::expected<chrono::seconds, error::Error>;
+ExpectedSeconds TokenRefreshDelay(
+	chrono::system_clock::time_point expiry,
+	chrono::system_clock::time_point now = chrono::system_clock::now());
+// Same as above, for the expiry of the given token.
+ExpectedSeconds TokenRefreshDelay(const string &token);
+
 class Authenticator {
 public:
 	Authenticator(events::EventLoop &loop, chrono::seconds auth_timeout = chrono::minutes {1}) :
@@ -77,9 +95,9 @@ public:
 		auth_timeout_timer_ {loop} {
 	}
 
-	void ExpireToken();
+	virtual void ExpireToken();
 
-	error::Error WithToken(AuthenticatedAction action);
+	virtual error::Error WithToken(AuthenticatedAction action);
 
 protected:
 	enum class NoTokenAction {
@@ -14,12 +14,18 @@
 
 #include <api/auth.hpp>
 
+#include <algorithm>
+
+#include <common/crypto.hpp>
+#include <common/json.hpp>
 #include <common/log.hpp>
 
 namespace mender {
 namespace api {
 namespace auth {
 
+namespace crypto = mender::common::crypto;
+namespace json = mender::common::json;
 namespace mlog = mender::common::log;
 
 using namespace std;
@@ -49,6 +55,63 @@ error::Error MakeError(AuthenticatorErrorCode code, const string &msg) {
 	return error::Error(error_condition(code, AuthenticatorErrorCategory), msg);
 }
 
+ExpectedTimePoint GetTokenExpiry(const string &token) {
+	// header.payload.signature, each part base64url encoded without padding.
+	auto payload_start = token.find('.');
+	if (payload_start == string::npos) {
+		return expected::unexpected(MakeError(AuthenticationError, "Malformed JWT token"));
+	}
+	payload_start++;
+	auto payload_end = token.find('.', payload_start);
+	if (payload_end == string::npos) {
+		return expected::unexpected(MakeError(AuthenticationError, "Malformed JWT token"));
+	}
+
+	string payload = token.substr(payload_start, payload_end - payload_start);
+	replace(payload.begin(), payload.end(), '-', '+');
+	replace(payload.begin(), payload.end(), '_', '/');
+	payload.append((4 - payload.size() % 4) % 4, '=');
+
+	auto exp_decoded = crypto::DecodeBase64(payload);
+	if (!exp_decoded) {
+		return expected::unexpected(exp_decoded.error().WithContext("Malformed JWT token"));
+	}
+
+	auto exp_claims = json::Load(common::StringFromByteVector(exp_decoded.value()));
+	if (!exp_claims) {
+		return expected::unexpected(exp_claims.error().WithContext("Malformed JWT token"));
+	}
+
+	auto exp_expiry = exp_claims.value().Get("exp").and_then(json::ToInt64);
+	if (!exp_expiry) {
+		return expected::unexpected(exp_expiry.error().WithContext("JWT token without expiry"));
+	}
+
+	return chrono::system_clock::time_point {chrono::seconds {exp_expiry.value()}};
+}
+
+ExpectedSeconds TokenRefreshDelay(
+	chrono::system_clock::time_point expiry, chrono::system_clock::time_point now) {
+	if (expiry <= now) {
+		return expected::unexpected(
+			MakeError(AuthenticationError, "JWT token has already expired, is the clock right?"));
+	}
+
+	// Refresh when 90% of the remaining lifetime has passed, but don't leave it to the last
+	// ten minutes for long lived tokens, nor refresh more often than every ten seconds.
+	auto remaining = chrono::duration_cast<chrono::seconds>(expiry - now);
+	auto margin = min(remaining / 10, chrono::seconds {chrono::minutes {10}});
+	return max(remaining - margin, chrono::seconds {10});
+}
+
+ExpectedSeconds TokenRefreshDelay(const string &token) {
+	auto exp_expiry = GetTokenExpiry(token);
+	if (!exp_expiry) {
+		return expected::unexpected(exp_expiry.error());
+	}
+	return TokenRefreshDelay(exp_expiry.value());
+}
+
 void Authenticator::ExpireToken() {
 	if (!token_fetch_in_progress_) {
 		RequestNewToken();
@@ -31,6 +31,14 @@ ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig conf) {
 	return parser::Parse(reader, conf);
 }
 
+ExpectedArtifact Parse(
+	io::Reader &reader,
+	io::AsyncReader &async_reader,
+	events::EventLoop &event_loop,
+	config::ParserConfig conf) {
+	return parser::Parse(reader, async_reader, event_loop, conf);
+}
+
 ExpectedPayloadHeaderView View(parser::Artifact &artifact, size_t index) {
 	// Check if the index is available
 	if (index >= artifact.header.info.payloads.size()) {
@@ -19,6 +19,7 @@
 
 #include <common/json.hpp>
 #include <common/io.hpp>
+#include <common/events.hpp>
 
 #include <artifact/parser.hpp>
 #include <artifact/config.hpp>
@@ -32,6 +33,7 @@ namespace error = mender::common::error;
 namespace expected = mender::common::expected;
 namespace json = mender::common::json;
 namespace io = mender::common::io;
+namespace events = mender::common::events;
 
 using error::Error;
 
@@ -40,6 +42,11 @@ using artifact::parser::Artifact;
 using ExpectedArtifact = expected::expected<Artifact, error::Error>;
 
 ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig conf = {});
+ExpectedArtifact Parse(
+	io::Reader &reader,
+	io::AsyncReader &async_reader,
+	events::EventLoop &event_loop,
+	config::ParserConfig conf = {});
 
 using namespace mender::artifact::v3::payload;
 using HeaderInfo = v3::header::Info;
@@ -78,9 +78,8 @@ ExpectedArtifact VerifyEmptyPayloadArtifact(
 	return artifact;
 }
 
-ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig config) {
-	std::shared_ptr<tar::Reader> tar_reader {make_shared<tar::Reader>(reader)};
-
+static ExpectedArtifact ParseTar(
+	std::shared_ptr<tar::Reader> tar_reader, config::ParserConfig config) {
 	auto lexer = lexer::Lexer<token::Token, token::Type> {tar_reader};
 
 	token::Token tok = lexer.Next();
@@ -199,6 +198,20 @@ ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig config) {
 };
 
 
+ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig config) {
+	return ParseTar(make_shared<tar::Reader>(reader), config);
+}
+
+ExpectedArtifact Parse(
+	io::Reader &reader,
+	io::AsyncReader &async_reader,
+	events::EventLoop &event_loop,
+	config::ParserConfig config) {
+	auto tar_reader = make_shared<tar::Reader>(reader);
+	tar_reader->SetAsyncSource(async_reader, event_loop);
+	return ParseTar(tar_reader, config);
+}
+
 ExpectedPayload Artifact::Next() {
 	token::Token tok = lexer_.Next();
 	if (payload_index_ != 0) {
@@ -23,6 +23,7 @@
 #include <common/error.hpp>
 #include <common/log.hpp>
 #include <common/io.hpp>
+#include <common/events.hpp>
 #include <artifact/tar/tar.hpp>
 
 #include <artifact/sha/sha.hpp>
@@ -48,6 +49,7 @@ using namespace std;
 namespace expected = mender::common::expected;
 namespace error = mender::common::error;
 namespace io = mender::common::io;
+namespace events = mender::common::events;
 
 namespace payload = mender::artifact::v3::payload;
 
@@ -92,6 +94,15 @@ using ExpectedArtifact = expected::expected<Artifact, error::Error>;
 
 ExpectedArtifact Parse(io::Reader &reader, config::ParserConfig conf = {});
 
+// Same as above, but payload data is read directly from `async_reader` when possible, instead of
+// through `reader`. `reader` must be a synchronous view of `async_reader` which doesn't buffer
+// anything, such as `events::io::ReaderFromAsyncReader`.
+ExpectedArtifact Parse(
+	io::Reader &reader,
+	io::AsyncReader &async_reader,
+	events::EventLoop &event_loop,
+	config::ParserConfig conf = {});
+
 } // namespace parser
 } // namespace artifact
 
@@ -56,7 +56,11 @@ expected::ExpectedSize Reader::Read(
 			"The ShaReader was not properly initialized. Shasumming is not possible"));
 	}
 
-	auto bytes_read = wrapped_reader_.Read(start, end);
+	return HandleRead(start, wrapped_reader_.Read(start, end));
+}
+
+expected::ExpectedSize Reader::HandleRead(
+	vector<uint8_t>::iterator start, expected::ExpectedSize bytes_read) {
 	if (!bytes_read) {
 		return bytes_read;
 	}
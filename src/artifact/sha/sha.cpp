@@ -55,6 +55,44 @@ Reader::Reader(io::Reader &reader) :
 	Reader::Reader {reader, ""} {
 }
 
+Reader::Reader(io::Reader &reader, io::AsyncReader &async_reader, const std::string &expected_sha) :
+	Reader::Reader {reader, expected_sha} {
+	wrapped_async_reader_ = &async_reader;
+}
+
+Reader::~Reader() {
+	*destroying_ = true;
+}
+
+error::Error Reader::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	if (!initialized_) {
+		return MakeError(
+			InitializationError,
+			"The ShaReader was not properly initialized. Shasumming is not possible");
+	}
+	if (wrapped_async_reader_ == nullptr) {
+		return error::Error(
+			make_error_condition(errc::not_supported),
+			"The ShaReader has no asynchronous reader to read from");
+	}
+
+	auto destroying = destroying_;
+	return wrapped_async_reader_->AsyncRead(
+		start, end, [this, destroying, start, handler](io::ExpectedSize result) {
+			if (*destroying) {
+				return;
+			}
+			handler(HandleRead(start, result));
+		});
+}
+
+void Reader::Cancel() {
+	if (wrapped_async_reader_ != nullptr) {
+		wrapped_async_reader_->Cancel();
+	}
+}
+
 ExpectedSHA Shasum(const vector<uint8_t> &data) {
 	string in {data.begin(), data.end()};
 
@@ -106,24 +106,44 @@ private:
 
 using ExpectedSHA = expected::expected<SHA, error::Error>;
 
-class Reader : virtual public io::Reader {
+class Reader : virtual public io::Reader, virtual public io::AsyncReader {
 private:
 #ifdef MENDER_SHA_OPENSSL
 	std::unique_ptr<EVP_MD_CTX, void (*)(EVP_MD_CTX *)> sha_handle_;
 #endif
 	io::Reader &wrapped_reader_;
+	io::AsyncReader *wrapped_async_reader_ {nullptr};
 	std::string expected_sha_ {};
 	bool initialized_ {false};
 	bool done_ {false};
 	SHA shasum_ {};
+	shared_ptr<bool> destroying_ {make_shared<bool>(false)};
+
+	// Checksums the data which `Read()` or `AsyncRead()` got from the wrapped reader, and verifies
+	// it at EOF.
+	expected::ExpectedSize HandleRead(
+		vector<uint8_t>::iterator start, expected::ExpectedSize bytes_read);
 
 public:
 	Reader(io::Reader &reader);
 	Reader(io::Reader &reader, const std::string &expected_sha);
+	// `async_reader` must be the same stream as `reader`. Which one is used depends on whether the
+	// data is read with `Read()` or `AsyncRead()`.
+	Reader(io::Reader &reader, io::AsyncReader &async_reader, const std::string &expected_sha);
+	~Reader();
+
+	Reader(const Reader &) = delete;
+	Reader &operator=(const Reader &) = delete;
 
 	expected::ExpectedSize Read(
 		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
 
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start,
+		vector<uint8_t>::iterator end,
+		io::AsyncIoHandler handler) override;
+	void Cancel() override;
+
 	ExpectedSHA ShaSum();
 };
 
@@ -0,0 +1,500 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <artifact/tar/native.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <common/common.hpp>
+#include <common/config.h>
+
+#include <artifact/tar/tar_errors.hpp>
+
+namespace mender {
+namespace tar {
+
+namespace common = mender::common;
+
+// Header field offsets and sizes, from the POSIX ustar definition.
+const size_t kNameOffset = 0;
+const size_t kNameSize = 100;
+const size_t kSizeOffset = 124;
+const size_t kSizeSize = 12;
+const size_t kChecksumOffset = 148;
+const size_t kChecksumSize = 8;
+const size_t kTypeflagOffset = 156;
+const size_t kLinkNameOffset = 157;
+const size_t kLinkNameSize = 100;
+const size_t kMagicOffset = 257;
+const size_t kPrefixOffset = 345;
+const size_t kPrefixSize = 155;
+
+// Extended headers are a handful of key/value records. Anything bigger than this is not
+// something mender-artifact produced.
+const int64_t kMaxExtendedHeaderSize = 1024 * 1024;
+
+static int64_t Padding(int64_t size) {
+	return (kBlockSize - size % kBlockSize) % kBlockSize;
+}
+
+static string FieldString(const vector<uint8_t> &block, size_t offset, size_t size) {
+	auto start = block.cbegin() + offset;
+	auto end = find(start, start + size, '\0');
+	return string(start, end);
+}
+
+// Numeric fields are octal, optionally padded with spaces and NULs. GNU and pax writers switch
+// to base-256, marked by the high bit, for values which don't fit.
+static expected::ExpectedInt64 ParseNumber(
+	const vector<uint8_t> &block, size_t offset, size_t size) {
+	auto field = block.cbegin() + offset;
+
+	if ((field[0] & 0x80) != 0) {
+		if (field[0] != 0x80) {
+			// Negative, or too big to fit in 64 bits.
+			return expected::unexpected(
+				MakeError(TarReaderError, "Unsupported base-256 number in tar header"));
+		}
+		uint64_t value = 0;
+		for (size_t i = 1; i < size; i++) {
+			if (value >> 55 != 0) {
+				return expected::unexpected(
+					MakeError(TarReaderError, "Number in tar header is too large"));
+			}
+			value = (value << 8) | field[i];
+		}
+		return static_cast<int64_t>(value);
+	}
+
+	size_t i = 0;
+	while (i < size && (field[i] == ' ' || field[i] == '\0')) {
+		i++;
+	}
+	uint64_t value = 0;
+	bool found_digit = false;
+	for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) {
+		if (value >> 60 != 0) {
+			return expected::unexpected(
+				MakeError(TarReaderError, "Number in tar header is too large"));
+		}
+		value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+		found_digit = true;
+	}
+	for (; i < size; i++) {
+		if (field[i] != ' ' && field[i] != '\0') {
+			return expected::unexpected(MakeError(TarReaderError, "Invalid number in tar header"));
+		}
+	}
+	if (!found_digit) {
+		return expected::unexpected(MakeError(TarReaderError, "Empty number in tar header"));
+	}
+	return static_cast<int64_t>(value);
+}
+
+static bool ChecksumMatches(const vector<uint8_t> &block) {
+	auto stored = ParseNumber(block, kChecksumOffset, kChecksumSize);
+	if (!stored) {
+		return false;
+	}
+
+	// The checksum field itself counts as spaces.
+	int64_t sum = ' ' * static_cast<int64_t>(kChecksumSize);
+	for (size_t i = 0; i < kBlockSize; i++) {
+		if (i < kChecksumOffset || i >= kChecksumOffset + kChecksumSize) {
+			sum += block[i];
+		}
+	}
+	return sum == stored.value();
+}
+
+static bool IsZeroBlock(const vector<uint8_t> &block) {
+	return all_of(block.cbegin(), block.cend(), [](uint8_t byte) { return byte == 0; });
+}
+
+// Pax records look like "<length> <key>=<value>\n", where length covers the whole record.
+static error::Error ParsePaxRecords(
+	const string &data, string &path, string &link_path, int64_t &size) {
+	size_t pos = 0;
+	while (pos < data.size()) {
+		auto space = data.find(' ', pos);
+		if (space == string::npos) {
+			return MakeError(TarReaderError, "Invalid pax record");
+		}
+		auto length = common::StringToLongLong(data.substr(pos, space - pos));
+		if (!length || length.value() <= 0
+			|| static_cast<size_t>(length.value()) > data.size() - pos) {
+			return MakeError(TarReaderError, "Invalid pax record length");
+		}
+		auto record_end = pos + static_cast<size_t>(length.value());
+		if (data[record_end - 1] != '\n') {
+			return MakeError(TarReaderError, "Invalid pax record");
+		}
+
+		auto record = data.substr(space + 1, record_end - 1 - (space + 1));
+		auto equals = record.find('=');
+		if (equals == string::npos) {
+			return MakeError(TarReaderError, "Invalid pax record");
+		}
+		auto key = record.substr(0, equals);
+		auto value = record.substr(equals + 1);
+		if (key == "path") {
+			path = value;
+		} else if (key == "linkpath") {
+			link_path = value;
+		} else if (key == "size") {
+			auto num = common::StringToLongLong(value);
+			if (!num || num.value() < 0) {
+				return MakeError(TarReaderError, "Invalid size in pax header: " + value);
+			}
+			size = num.value();
+		}
+		// Everything else is metadata we don't use.
+
+		pos = record_end;
+	}
+	return error::NoError;
+}
+
+NativeReader::NativeReader(io::Reader &reader, const vector<uint8_t> &first_block) :
+	reader_ {reader},
+	zero_copy_reader_ {dynamic_cast<io::ZeroCopyReader *>(&reader)},
+	block_ {first_block} {
+}
+
+NativeReader::~NativeReader() {
+	*destroying_ = true;
+}
+
+bool NativeReader::IsHeaderBlock(const vector<uint8_t> &block) {
+	if (block.size() != kBlockSize) {
+		return false;
+	}
+	// Both "ustar\000" (POSIX) and "ustar  \0" (GNU).
+	const char magic[] = "ustar";
+	if (!equal(magic, magic + strlen(magic), block.cbegin() + kMagicOffset)) {
+		return false;
+	}
+	auto after_magic = block[kMagicOffset + strlen(magic)];
+	if (after_magic != '\0' && after_magic != ' ') {
+		return false;
+	}
+	return ChecksumMatches(block);
+}
+
+expected::ExpectedSize NativeReader::ReadBlock() {
+	block_.resize(kBlockSize);
+	size_t filled = 0;
+	while (filled < kBlockSize) {
+		auto result = reader_.Read(block_.begin() + filled, block_.end());
+		if (!result) {
+			return result;
+		} else if (result.value() == 0) {
+			break;
+		}
+		filled += result.value();
+	}
+	if (filled != 0 && filled != kBlockSize) {
+		return expected::unexpected(
+			MakeError(TarShortReadError, "Unexpected end of stream in the middle of a tar block"));
+	}
+	return filled;
+}
+
+error::Error NativeReader::Skip(int64_t size) {
+	while (size > 0) {
+		size_t chunk;
+		if (zero_copy_reader_ != nullptr) {
+			auto view = zero_copy_reader_->ReadView(static_cast<size_t>(size));
+			if (!view) {
+				return view.error();
+			}
+			chunk = view.value().size;
+		} else {
+			if (skip_buffer_.empty()) {
+				skip_buffer_.resize(MENDER_BUFSIZE);
+			}
+			auto to_read = min(static_cast<size_t>(size), skip_buffer_.size());
+			auto result = reader_.Read(skip_buffer_.begin(), skip_buffer_.begin() + to_read);
+			if (!result) {
+				return result.error();
+			}
+			chunk = result.value();
+		}
+		if (chunk == 0) {
+			return MakeError(TarShortReadError, "Unexpected end of stream in tar entry");
+		}
+		size -= chunk;
+	}
+	return error::NoError;
+}
+
+expected::ExpectedString NativeReader::ReadExtendedData(int64_t size) {
+	if (size > kMaxExtendedHeaderSize) {
+		return expected::unexpected(MakeError(TarReaderError, "Extended tar header too large"));
+	}
+
+	vector<uint8_t> data(static_cast<size_t>(size));
+	size_t filled = 0;
+	while (filled < data.size()) {
+		auto result = reader_.Read(data.begin() + filled, data.end());
+		if (!result) {
+			return expected::unexpected(result.error());
+		} else if (result.value() == 0) {
+			return expected::unexpected(
+				MakeError(TarShortReadError, "Unexpected end of stream in extended tar header"));
+		}
+		filled += result.value();
+	}
+
+	auto err = Skip(Padding(size));
+	if (err != error::NoError) {
+		return expected::unexpected(err);
+	}
+	return string(data.begin(), data.end());
+}
+
+error::Error NativeReader::EnsureEOF() {
+	// Same rule as for libarchive: After the end marker, only padding is allowed.
+	while (true) {
+		size_t n;
+		const uint8_t *data;
+		if (zero_copy_reader_ != nullptr) {
+			auto view = zero_copy_reader_->ReadView(MENDER_BUFSIZE);
+			if (!view) {
+				return view.error();
+			}
+			data = view.value().data;
+			n = view.value().size;
+		} else {
+			if (skip_buffer_.empty()) {
+				skip_buffer_.resize(MENDER_BUFSIZE);
+			}
+			auto result = reader_.Read(skip_buffer_.begin(), skip_buffer_.end());
+			if (!result) {
+				return result.error();
+			}
+			data = skip_buffer_.data();
+			n = result.value();
+		}
+		if (n == 0) {
+			return error::NoError;
+		}
+		if (any_of(data, data + n, [](uint8_t byte) { return byte != 0; })) {
+			return MakeError(TarExtraDataError, "Only zero bytes allowed after an end of archive");
+		}
+	}
+}
+
+NativeReader::ExpectedHeader NativeReader::Next() {
+	auto err = Skip(entry_remaining_ + entry_padding_);
+	entry_remaining_ = 0;
+	entry_padding_ = 0;
+	if (err != error::NoError) {
+		return expected::unexpected(err);
+	}
+
+	string long_name;
+	string long_link_name;
+	string pax_path;
+	string pax_link_path;
+	// Negative means not set.
+	int64_t pax_size = -1;
+
+	while (true) {
+		if (first_block_pending_) {
+			first_block_pending_ = false;
+		} else {
+			auto result = ReadBlock();
+			if (!result) {
+				return expected::unexpected(result.error());
+			} else if (result.value() == 0) {
+				// Missing end marker. Accept it, like libarchive does.
+				return expected::unexpected(
+					MakeError(TarEOFError, "Reached the end of the archive"));
+			}
+		}
+
+		if (IsZeroBlock(block_)) {
+			err = EnsureEOF();
+			if (err != error::NoError) {
+				return expected::unexpected(err.WithContext("Reached the end of the archive"));
+			}
+			return expected::unexpected(MakeError(TarEOFError, "Reached the end of the archive"));
+		}
+
+		if (!ChecksumMatches(block_)) {
+			return expected::unexpected(MakeError(TarReaderError, "Invalid tar header checksum"));
+		}
+
+		auto size = ParseNumber(block_, kSizeOffset, kSizeSize);
+		if (!size) {
+			return expected::unexpected(size.error());
+		}
+
+		switch (block_[kTypeflagOffset]) {
+		case 'x': {
+			// Pax header for the next entry.
+			auto data = ReadExtendedData(size.value());
+			if (!data) {
+				return expected::unexpected(data.error());
+			}
+			err = ParsePaxRecords(data.value(), pax_path, pax_link_path, pax_size);
+			if (err != error::NoError) {
+				return expected::unexpected(err);
+			}
+			continue;
+		}
+		case 'g':
+			// Global pax header. Nothing in there that we need.
+			err = Skip(size.value() + Padding(size.value()));
+			if (err != error::NoError) {
+				return expected::unexpected(err);
+			}
+			continue;
+		case 'L': {
+			// GNU long name for the next entry.
+			auto data = ReadExtendedData(size.value());
+			if (!data) {
+				return expected::unexpected(data.error());
+			}
+			long_name = data.value().substr(0, data.value().find('\0'));
+			continue;
+		}
+		case 'K': {
+			// GNU long link name for the next entry.
+			auto data = ReadExtendedData(size.value());
+			if (!data) {
+				return expected::unexpected(data.error());
+			}
+			long_link_name = data.value().substr(0, data.value().find('\0'));
+			continue;
+		}
+		case '\0':
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+			break;
+		default:
+			// Most notably GNU sparse files ('S'), whose data is not stored the way the size
+			// says. Returning them as normal entries would hand out the wrong content.
+			return expected::unexpected(MakeError(
+				TarReaderError,
+				string("Unsupported tar entry type '") + static_cast<char>(block_[kTypeflagOffset])
+					+ "'"));
+		}
+
+		Header header;
+		if (!pax_path.empty()) {
+			header.name = pax_path;
+		} else if (!long_name.empty()) {
+			header.name = long_name;
+		} else {
+			header.name = FieldString(block_, kNameOffset, kNameSize);
+			auto prefix = FieldString(block_, kPrefixOffset, kPrefixSize);
+			if (!prefix.empty()) {
+				header.name = prefix + "/" + header.name;
+			}
+		}
+		if (!pax_link_path.empty()) {
+			header.link_name = pax_link_path;
+		} else if (!long_link_name.empty()) {
+			header.link_name = long_link_name;
+		} else {
+			header.link_name = FieldString(block_, kLinkNameOffset, kLinkNameSize);
+		}
+		header.size = pax_size >= 0 ? pax_size : size.value();
+
+		entry_remaining_ = header.size;
+		entry_padding_ = Padding(header.size);
+		return header;
+	}
+}
+
+expected::ExpectedSize NativeReader::Read(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
+	if (entry_remaining_ == 0) {
+		return 0;
+	}
+	if (end - start > entry_remaining_) {
+		end = start + static_cast<size_t>(entry_remaining_);
+	}
+
+	auto result = reader_.Read(start, end);
+	if (!result) {
+		return result;
+	} else if (result.value() == 0) {
+		return expected::unexpected(
+			MakeError(TarShortReadError, "Unexpected end of stream in tar entry"));
+	}
+	entry_remaining_ -= result.value();
+	return result;
+}
+
+void NativeReader::SetAsyncSource(io::AsyncReader &source, events::EventLoop &event_loop) {
+	async_source_ = &source;
+	event_loop_ = &event_loop;
+}
+
+error::Error NativeReader::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	if (async_source_ == nullptr) {
+		return MakeError(TarReaderError, "No asynchronous source to read the tar entry from");
+	}
+
+	auto destroying = destroying_;
+
+	if (entry_remaining_ == 0) {
+		event_loop_->Post([destroying, handler]() {
+			if (!*destroying) {
+				handler(0);
+			}
+		});
+		return error::NoError;
+	}
+	if (end - start > entry_remaining_) {
+		end = start + static_cast<size_t>(entry_remaining_);
+	}
+
+	return async_source_->AsyncRead(
+		start, end, [this, destroying, handler](io::ExpectedSize result) {
+			if (*destroying) {
+				return;
+			}
+			if (!result) {
+				handler(result);
+				return;
+			} else if (result.value() == 0) {
+				handler(expected::unexpected(
+					MakeError(TarShortReadError, "Unexpected end of stream in tar entry")));
+				return;
+			}
+			entry_remaining_ -= result.value();
+			handler(result);
+		});
+}
+
+void NativeReader::CancelAsync() {
+	if (async_source_ != nullptr) {
+		async_source_->Cancel();
+	}
+}
+
+} // namespace tar
+} // namespace mender
@@ -0,0 +1,110 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef MENDER_COMMON_TAR_NATIVE_HPP
+#define MENDER_COMMON_TAR_NATIVE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <common/error.hpp>
+#include <common/events.hpp>
+#include <common/expected.hpp>
+#include <common/io.hpp>
+
+namespace mender {
+namespace tar {
+
+using namespace std;
+
+namespace expected = mender::common::expected;
+namespace error = mender::common::error;
+namespace io = mender::common::io;
+namespace events = mender::common::events;
+
+const size_t kBlockSize = 512;
+
+/**
+ * Parser for uncompressed tar streams in ustar, pax or GNU format, which covers everything
+ * mender-artifact produces. GNU sparse files and other special entry types are rejected. Entry
+ * data is read straight from the underlying reader into the caller's buffer, and skipped data is
+ * not copied at all if the reader supports it.
+ */
+class NativeReader {
+public:
+	struct Header {
+		string name;
+		// Only set for hard and symbolic links.
+		string link_name;
+		int64_t size;
+	};
+	using ExpectedHeader = expected::expected<Header, error::Error>;
+
+	// `first_block` is the first header block, which the caller has already read from `reader`
+	// in order to decide which parser to use.
+	NativeReader(io::Reader &reader, const vector<uint8_t> &first_block);
+	~NativeReader();
+
+	// Whether `block` is a header this parser understands. Compressed streams, or archives in
+	// older formats, are not, and need to go through libarchive.
+	static bool IsHeaderBlock(const vector<uint8_t> &block);
+
+	// Skips whatever is left of the current entry, and returns the header of the next one.
+	ExpectedHeader Next();
+
+	// Reads from the current entry. Returns 0 at the end of it.
+	expected::ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end);
+
+	// Makes it possible to read entry data with `AsyncRead()`. `source` must deliver the same
+	// bytes as the reader given to the constructor, without buffering anything in between, since
+	// headers are still read synchronously, and data from whichever of the two is used.
+	void SetAsyncSource(io::AsyncReader &source, events::EventLoop &event_loop);
+
+	bool HasAsyncSource() const {
+		return async_source_ != nullptr;
+	}
+
+	// Same as `Read()`, but straight from the asynchronous source, without running the event
+	// loop recursively. The handler is never called before this function has returned.
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler);
+
+	void CancelAsync();
+
+private:
+	expected::ExpectedSize ReadBlock();
+	expected::ExpectedString ReadExtendedData(int64_t size);
+	error::Error Skip(int64_t size);
+	error::Error EnsureEOF();
+
+	io::Reader &reader_;
+	io::ZeroCopyReader *zero_copy_reader_;
+
+	vector<uint8_t> block_;
+	bool first_block_pending_ {true};
+	vector<uint8_t> skip_buffer_;
+
+	int64_t entry_remaining_ {0};
+	int64_t entry_padding_ {0};
+
+	io::AsyncReader *async_source_ {nullptr};
+	events::EventLoop *event_loop_ {nullptr};
+	shared_ptr<bool> destroying_ {make_shared<bool>(false)};
+};
+
+} // namespace tar
+} // namespace mender
+
+#endif // MENDER_COMMON_TAR_NATIVE_HPP
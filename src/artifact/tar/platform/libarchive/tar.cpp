@@ -33,28 +33,78 @@ namespace expected = mender::common::expected;
 namespace error = mender::common::error;
 
 
-ExpectedSize Reader::Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
-	return this->archive_handle_.Read(start, end);
-}
+// Hands out the bytes which were read to detect the format first, and then continues with the
+// underlying reader.
+class PrefixedReader : virtual public io::Reader {
+public:
+	PrefixedReader(const vector<uint8_t> &prefix, io::Reader &reader) :
+		prefix_ {prefix},
+		reader_ {reader} {
+	}
+
+	ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override {
+		if (prefix_offset_ < prefix_.size()) {
+			auto n = min(static_cast<size_t>(end - start), prefix_.size() - prefix_offset_);
+			copy_n(prefix_.cbegin() + prefix_offset_, n, start);
+			prefix_offset_ += n;
+			return n;
+		}
+		return reader_.Read(start, end);
+	}
 
+protected:
+	vector<uint8_t> prefix_;
+	size_t prefix_offset_ {0};
+	io::Reader &reader_;
+};
+
+// Same as above, for an underlying reader which can hand out views of its data, so that the
+// libarchive wrapper can still make use of that.
+class PrefixedZeroCopyReader : public PrefixedReader, virtual public io::ZeroCopyReader {
+public:
+	PrefixedZeroCopyReader(const vector<uint8_t> &prefix, io::ZeroCopyReader &reader) :
+		PrefixedReader {prefix, reader},
+		zero_copy_reader_ {reader} {
+	}
 
-Reader::Reader(mender::common::io::Reader &reader) :
-	archive_handle_ {reader} {
+	ExpectedView ReadView(size_t max_size) override {
+		if (prefix_offset_ < prefix_.size()) {
+			auto n = min(max_size, prefix_.size() - prefix_offset_);
+			View view {prefix_.data() + prefix_offset_, n};
+			prefix_offset_ += n;
+			return view;
+		}
+		return zero_copy_reader_.ReadView(max_size);
+	}
+
+private:
+	io::ZeroCopyReader &zero_copy_reader_;
+};
+
+error::Error Reader::InitLibarchive(const vector<uint8_t> &first_block) {
+	auto zero_copy_reader = dynamic_cast<io::ZeroCopyReader *>(&reader_);
+	if (zero_copy_reader != nullptr) {
+		archive_input_.reset(new PrefixedZeroCopyReader(first_block, *zero_copy_reader));
+	} else {
+		archive_input_.reset(new PrefixedReader(first_block, reader_));
+	}
+	archive_handle_.reset(new mender::libarchive::wrapper::Handle(*archive_input_));
+	return error::NoError;
 }
 
 // Read the next Tar header, and populate the meta-data:
 // * name
 // * Archive size
-ExpectedEntry Reader::Next() {
+ExpectedEntry Reader::LibarchiveNext() {
 	struct archive_entry *current_entry;
 
-	if (archive_handle_.Get() == nullptr) {
+	if (archive_handle_->Get() == nullptr) {
 		return expected::unexpected(MakeError(TarEntryError, "No underlying stream to read from"));
 	}
 
-	int r = archive_read_next_header(archive_handle_.Get(), &current_entry);
+	int r = archive_read_next_header(archive_handle_->Get(), &current_entry);
 	if (r == ARCHIVE_EOF) {
-		auto err = archive_handle_.EnsureEOF();
+		auto err = archive_handle_->EnsureEOF();
 		if (err != error::NoError) {
 			return expected::unexpected(err.WithContext("Reached the end of the archive"));
 		}
@@ -64,7 +114,7 @@ ExpectedEntry Reader::Next() {
 		return expected::unexpected(MakeError(
 			TarReaderError,
 			"archive_read_next failed in LibArchive. Error code: " + to_string(r)
-				+ " Error message: " + archive_error_string(archive_handle_.Get())));
+				+ " Error message: " + archive_error_string(archive_handle_->Get())));
 	}
 
 	const char *archive_name = archive_entry_pathname(current_entry);
@@ -25,6 +25,8 @@ namespace libarchive {
 namespace wrapper {
 
 size_t libarchive_read_buffer_size {MENDER_BUFSIZE};
+// When the data is already in memory there is no buffer to fill, so hand out bigger blocks.
+size_t libarchive_zero_copy_block_size {1024 * 1024};
 
 namespace expected = mender::common::expected;
 
@@ -42,6 +44,20 @@ using ExpectedSize = expected::ExpectedSize;
 ssize_t reader_callback(archive *archive, void *in_reader_container, const void **buff) {
 	ReaderContainer *p_reader_container = static_cast<ReaderContainer *>(in_reader_container);
 
+	if (p_reader_container->zero_copy_reader_ != nullptr) {
+		// Point libarchive straight at the reader's memory. It stays valid until the next call
+		// to the reader, which is the next time we are called.
+		auto view = p_reader_container->zero_copy_reader_->ReadView(
+			libarchive_zero_copy_block_size);
+		if (!view) {
+			archive_set_error(
+				archive, view.error().code.value(), "%s", view.error().message.c_str());
+			return -1;
+		}
+		*buff = view.value().data;
+		return view.value().size;
+	}
+
 	auto ret = p_reader_container->reader_.Read(
 		p_reader_container->buff_.begin(), p_reader_container->buff_.end());
 	if (!ret) {
@@ -43,10 +43,14 @@ namespace log = mender::common::log;
 
 struct ReaderContainer {
 	mender::common::io::Reader &reader_;
+	// Set if `reader_` can hand out its data in place, in which case `buff_` is not used by the
+	// callback.
+	mender::common::io::ZeroCopyReader *zero_copy_reader_;
 	std::vector<uint8_t> buff_;
 
 	ReaderContainer(mender::common::io::Reader &reader, size_t block_size) :
 		reader_ {reader},
+		zero_copy_reader_ {dynamic_cast<mender::common::io::ZeroCopyReader *>(&reader)},
 		buff_(block_size) {
 	}
 };
@@ -37,5 +37,127 @@ ExpectedSize Entry::Read(vector<uint8_t>::iterator start, vector<uint8_t>::itera
 	return read_bytes;
 }
 
+bool Entry::CanReadAsync() const {
+	return archive_ != nullptr && archive_->CanReadAsync();
+}
+
+error::Error Entry::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	if (!CanReadAsync()) {
+		return error::Error(
+			make_error_condition(errc::not_supported),
+			"Tar entry \"" + name_ + "\" can not be read asynchronously");
+	}
+	return archive_->AsyncRead(start, end, handler);
+}
+
+void Entry::Cancel() {
+	if (CanReadAsync()) {
+		archive_->CancelAsync();
+	}
+}
+
+Reader::Reader(io::Reader &reader) :
+	reader_ {reader} {
+}
+
+error::Error Reader::Init() {
+	vector<uint8_t> first_block(kBlockSize);
+	size_t filled = 0;
+	while (filled < first_block.size()) {
+		auto result = reader_.Read(first_block.begin() + filled, first_block.end());
+		if (!result) {
+			return result.error();
+		} else if (result.value() == 0) {
+			break;
+		}
+		filled += result.value();
+	}
+	first_block.resize(filled);
+
+	if (NativeReader::IsHeaderBlock(first_block)) {
+		native_reader_.reset(new NativeReader(reader_, first_block));
+		if (async_source_ != nullptr) {
+			native_reader_->SetAsyncSource(*async_source_, *event_loop_);
+		}
+		return error::NoError;
+	}
+
+#ifdef MENDER_TAR_LIBARCHIVE
+	return InitLibarchive(first_block);
+#else
+	return MakeError(
+		TarReaderError, "Unsupported archive format, only uncompressed tar archives can be read");
+#endif
+}
+
+ExpectedEntry Reader::Next() {
+	if (!initialized_) {
+		initialized_ = true;
+		auto err = Init();
+		if (err != error::NoError) {
+			return expected::unexpected(err);
+		}
+	}
+
+	if (native_reader_) {
+		auto header = native_reader_->Next();
+		if (!header) {
+			return expected::unexpected(header.error());
+		}
+		return Entry(header.value().name, header.value().size, *this, this);
+	}
+#ifdef MENDER_TAR_LIBARCHIVE
+	if (archive_handle_) {
+		return LibarchiveNext();
+	}
+#endif
+
+	return expected::unexpected(MakeError(TarEntryError, "No underlying stream to read from"));
+}
+
+ExpectedSize Reader::Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
+	if (native_reader_) {
+		return native_reader_->Read(start, end);
+	}
+#ifdef MENDER_TAR_LIBARCHIVE
+	if (archive_handle_) {
+		return archive_handle_->Read(start, end);
+	}
+#endif
+
+	return expected::unexpected(
+		MakeError(TarReaderError, "Unable to read from a tar reader without an entry"));
+}
+
+void Reader::SetAsyncSource(io::AsyncReader &source, events::EventLoop &event_loop) {
+	async_source_ = &source;
+	event_loop_ = &event_loop;
+}
+
+void Reader::SetAsyncSource(Entry &entry) {
+	if (entry.CanReadAsync()) {
+		SetAsyncSource(entry, *entry.archive_->event_loop_);
+	}
+}
+
+bool Reader::CanReadAsync() const {
+	return native_reader_ && native_reader_->HasAsyncSource();
+}
+
+error::Error Reader::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	if (!CanReadAsync()) {
+		return MakeError(TarReaderError, "Tar archive can not be read asynchronously");
+	}
+	return native_reader_->AsyncRead(start, end, handler);
+}
+
+void Reader::CancelAsync() {
+	if (native_reader_) {
+		native_reader_->CancelAsync();
+	}
+}
+
 } // namespace tar
 } // namespace mender
@@ -21,9 +21,11 @@
 #include <vector>
 
 #include <common/io.hpp>
+#include <common/events.hpp>
 #include <common/expected.hpp>
 #include <common/error.hpp>
 
+#include <artifact/tar/native.hpp>
 #include <artifact/tar/tar_errors.hpp>
 
 #ifdef MENDER_TAR_LIBARCHIVE
@@ -38,25 +40,34 @@ using namespace std;
 namespace expected = mender::common::expected;
 namespace error = mender::common::error;
 namespace io = mender::common::io;
+namespace events = mender::common::events;
 
 using Error = error::Error;
 using ExpectedSize = expected::ExpectedSize;
 
-class Entry : public io::Reader {
+class Reader;
+
+class Entry : public io::Reader, virtual public io::AsyncReader {
 private:
 	string name_;
 	int64_t total_size_;
 
 	Reader &reader_;
+	mender::tar::Reader *archive_;
 
 	// Reader data
 	int64_t nr_bytes_read_ {0};
 
 public:
-	Entry(const string &name, int64_t archive_size, Reader &reader) :
+	Entry(
+		const string &name,
+		int64_t archive_size,
+		Reader &reader,
+		mender::tar::Reader *archive = nullptr) :
 		name_ {name},
 		total_size_ {archive_size},
-		reader_ {reader} {
+		reader_ {reader},
+		archive_ {archive} {
 	}
 
 	string Name() {
@@ -68,22 +79,67 @@ public:
 	}
 
 	ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
+
+	// Only entries of plain tar archives with an asynchronous source can be read with
+	// `AsyncRead()`. See `Reader::SetAsyncSource()`.
+	bool CanReadAsync() const;
+
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start,
+		vector<uint8_t>::iterator end,
+		io::AsyncIoHandler handler) override;
+	void Cancel() override;
+
+	friend class mender::tar::Reader;
 };
 
 using ExpectedEntry = expected::expected<Entry, error::Error>;
 
 class Reader : io::Reader {
 private:
+	io::Reader &reader_;
+
+	// Which parser to use is only known once the first block has been seen, so the backend is
+	// set up by the first call to `Next()`. Plain tar streams are parsed natively, anything
+	// else, such as compressed streams, goes through libarchive.
+	bool initialized_ {false};
+	unique_ptr<NativeReader> native_reader_;
 #ifdef MENDER_TAR_LIBARCHIVE
-	mender::libarchive::wrapper::Handle archive_handle_;
+	unique_ptr<io::Reader> archive_input_;
+	unique_ptr<mender::libarchive::wrapper::Handle> archive_handle_;
+
+	error::Error InitLibarchive(const vector<uint8_t> &first_block);
+	ExpectedEntry LibarchiveNext();
 #endif
 
+	io::AsyncReader *async_source_ {nullptr};
+	events::EventLoop *event_loop_ {nullptr};
+
+	error::Error Init();
+
 	ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
 
+	bool CanReadAsync() const;
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler);
+	void CancelAsync();
+
 public:
 	Reader(io::Reader &reader);
 
+	// Lets entry data be read with `Entry::AsyncRead()`, straight from `source`, instead of
+	// through `reader`, which then typically has to run the event loop recursively for every
+	// read. `source` must be the stream `reader` reads from, and `reader` must not buffer
+	// anything. Only has an effect on plain tar streams. Call it before the first `Next()`.
+	void SetAsyncSource(io::AsyncReader &source, events::EventLoop &event_loop);
+
+	// For an archive which is stored in `entry` of another archive. Does nothing if `entry` can
+	// not be read asynchronously.
+	void SetAsyncSource(Entry &entry);
+
 	ExpectedEntry Next();
+
+	friend class Entry;
 };
 
 } // namespace tar
@@ -36,6 +36,15 @@ ExpectedSize Reader::Read(vector<uint8_t>::iterator start, vector<uint8_t>::iter
 	return reader_->Read(start, end);
 }
 
+error::Error Reader::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	return reader_->AsyncRead(start, end, handler);
+}
+
+void Reader::Cancel() {
+	reader_->Cancel();
+}
+
 ExpectedPayloadReader Payload::Next() {
 	auto expected_tar_entry = tar_reader_->Next();
 	if (!expected_tar_entry) {
@@ -42,24 +42,44 @@ namespace manifest = mender::artifact::v3::manifest;
 
 using mender::common::expected::ExpectedSize;
 
-class Reader : virtual public io::Reader {
+class Reader : virtual public io::Reader, virtual public io::AsyncReader {
 public:
 	Reader(tar::Entry &&entry, const string &checksum) :
 		entry_ {make_shared<tar::Entry>(entry)},
-		reader_ {make_shared<sha::Reader>(sha::Reader {*entry_, checksum})} {};
+		checksum_ {checksum},
+		reader_ {
+			entry_->CanReadAsync() ? make_shared<sha::Reader>(*entry_, *entry_, checksum)
+								   : make_shared<sha::Reader>(*entry_, checksum)} {};
 
 
 	ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
 
+	// Whether `AsyncRead()` can be used. This is the case when the Artifact was parsed with an
+	// asynchronous source, and it is not compressed.
+	bool CanReadAsync() {
+		return this->entry_->CanReadAsync();
+	}
+
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start,
+		vector<uint8_t>::iterator end,
+		io::AsyncIoHandler handler) override;
+	void Cancel() override;
+
 	string Name() {
 		return this->entry_->Name();
 	}
 	int64_t Size() {
 		return this->entry_->Size();
 	}
+	// The checksum from the manifest, which the data is verified against.
+	string Checksum() {
+		return this->checksum_;
+	}
 
 private:
 	shared_ptr<tar::Entry> entry_;
+	string checksum_;
 	shared_ptr<sha::Reader> reader_;
 };
 
@@ -70,6 +90,11 @@ public:
 	Payload(io::Reader &reader, manifest::Manifest &manifest) :
 		tar_reader_ {make_shared<tar::Reader>(reader)},
 		manifest_ {manifest} {};
+	Payload(tar::Entry &entry, manifest::Manifest &manifest) :
+		tar_reader_ {make_shared<tar::Reader>(entry)},
+		manifest_ {manifest} {
+		tar_reader_->SetAsyncSource(entry);
+	};
 
 	ExpectedPayloadReader Next();
 
@@ -171,6 +171,7 @@ private:
 	string fallback_conf_file = path::Join(data_store, "mender.conf");
 
 	string key_file = path::Join(data_store, "mender-agent.pem");
+	string auth_token_cache_file = path::Join(data_store, "auth-token-cache.json");
 
 public:
 	string GetPathConfDir() const {
@@ -203,6 +204,7 @@ public:
 		this->modules_work_path = path::Join(data_store, "modules/v3");
 		this->bootstrap_artifact_file = path::Join(data_store, "bootstrap.mender");
 		this->key_file = path::Join(data_store, "mender-agent.pem");
+		this->auth_token_cache_file = path::Join(data_store, "auth-token-cache.json");
 		return;
 	}
 
@@ -220,6 +222,13 @@ public:
 		this->key_file = key_file;
 	}
 
+	string GetAuthTokenCacheFile() const {
+		return auth_token_cache_file;
+	}
+	void SetAuthTokenCacheFile(const string &auth_token_cache_file) {
+		this->auth_token_cache_file = auth_token_cache_file;
+	}
+
 
 	string GetConfFile() const {
 		return conf_file;
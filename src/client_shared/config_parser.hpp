@@ -53,6 +53,9 @@ struct ClientSecurity {
 //        // int idle_conn_timeout_seconds = 0;
 // };
 
+// Anything longer defeats the point of authenticating in parallel.
+const int kMaxParallelAuthenticationStaggerMilliseconds = 60000;
+
 enum ConfigParserErrorCode {
 	NoError = 0,
 	ValidationError,
@@ -137,6 +140,25 @@ public:
 	/** Global max retry poll count */
 	int retry_poll_count = 0;
 
+	/** Authenticate with several of the `servers` at the same time, and use the first one
+		which accepts the device */
+	bool parallel_authentication = false;
+
+	/** Delay before trying the next server when authenticating in parallel, at most
+		`kMaxParallelAuthenticationStaggerMilliseconds` */
+	int parallel_authentication_stagger_milliseconds = 500;
+
+	/** How long the device identity data may be reused before running the identity script
+		again (0 disables reuse) */
+	int identity_data_cache_seconds = 3600; // 1 hour
+
+	/** Where mender-auth's local HTTP proxy for add-ons listens, for example
+		`unix:///run/mender/auth.sock`. Empty means a random port on 127.0.0.1 */
+	string forwarder_listen_url;
+	/** Users who may connect to the proxy, besides root and the user running mender-auth, when
+		`forwarder_listen_url` is a Unix domain socket */
+	vector<int> forwarder_allowed_uids;
+
 	/* State script parameters */
 	int state_script_timeout_seconds = 3600;       // 1 hour
 	int state_script_retry_timeout_seconds = 1800; // 30 min
@@ -149,6 +171,32 @@ public:
 		be killed. */
 	int module_timeout_seconds = 14400; // 4 hours
 
+	/** Minimum time between progress events for payload downloads and installs, which the daemon
+		emits as DBus signals (0 disables progress tracking) */
+	int progress_interval_milliseconds = 1000;
+
+	/** Minimum time between progress updates sent to the server as deployment substates (0, the
+		default, disables them) */
+	int progress_substate_interval_seconds = 0;
+
+	/** Write payloads directly to the target which the update module names in the
+		`ProvidePayloadWriteTarget` query, instead of streaming them through the module */
+	bool native_payload_writer = false;
+
+	/** Bypass the page cache (`O_DIRECT`) when writing natively to a block device */
+	bool native_payload_writer_direct_io = false;
+
+	/** Compare with the existing content of the target when writing natively, and only write the
+	 * blocks that differ */
+	bool native_payload_writer_skip_unchanged = false;
+
+	/** Read back what has been written natively while writing continues, and verify it against
+	 * the checksum in the Artifact */
+	bool native_payload_writer_verify = false;
+
+	/** Use the built-in installers instead of the `directory` and `single-file` Update Modules */
+	bool native_installers = false;
+
 	/** Path to server SSL certificate */
 	string server_certificate;
 
@@ -169,6 +217,11 @@ public:
 	/** Log level which takes effect right before daemon startup */
 	string daemon_log_level;
 
+	/** How often the state database is flushed to disk: `full` (every commit, the default),
+		`no-meta-sync` or `no-sync`. With the latter two, the client still flushes explicitly
+		before rebooting and before committing an update */
+	string state_database_durability;
+
 	/**
 	 * Loads values from the given file and overrides the current values of the
 	 * respective above fields with them.
@@ -114,6 +114,16 @@ ExpectedBool MenderConfigFromFile::LoadFile(const string &path) {
 		}
 	}
 
+	e_cfg_value = cfg_json.Get("StateDatabaseDurability");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedString e_cfg_string = value_json.GetString();
+		if (e_cfg_string) {
+			this->state_database_durability = e_cfg_string.value();
+			applied = true;
+		}
+	}
+
 	/* Boolean values now */
 	e_cfg_value = cfg_json.Get("SkipVerify");
 	if (e_cfg_value) {
@@ -165,6 +175,79 @@ ExpectedBool MenderConfigFromFile::LoadFile(const string &path) {
 		}
 	}
 
+	e_cfg_value = cfg_json.Get("ParallelAuthentication");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->parallel_authentication = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("ParallelAuthenticationStaggerMilliseconds");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const auto e_cfg_int = value_json.Get<int>();
+		if (e_cfg_int) {
+			if (e_cfg_int.value() < 0
+				|| e_cfg_int.value() > kMaxParallelAuthenticationStaggerMilliseconds) {
+				auto err = MakeError(
+					ConfigParserErrorCode::ValidationError,
+					"'ParallelAuthenticationStaggerMilliseconds' must be between 0 and "
+						+ to_string(kMaxParallelAuthenticationStaggerMilliseconds));
+				return expected::unexpected(err);
+			}
+			this->parallel_authentication_stagger_milliseconds = e_cfg_int.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("IdentityDataCacheSeconds");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const auto e_cfg_int = value_json.Get<int>();
+		if (e_cfg_int) {
+			this->identity_data_cache_seconds = e_cfg_int.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("ForwarderListenURL");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedString e_cfg_string = value_json.GetString();
+		if (e_cfg_string) {
+			this->forwarder_listen_url = e_cfg_string.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("ForwarderAllowedUIDs");
+	if (e_cfg_value) {
+		this->forwarder_allowed_uids.clear();
+		const json::Json value_array = e_cfg_value.value();
+		const json::ExpectedSize e_n_items = value_array.GetArraySize();
+		if (e_n_items) {
+			for (size_t i = 0; i < e_n_items.value(); i++) {
+				const json::ExpectedJson e_array_item = value_array.Get(i);
+				if (e_array_item) {
+					const auto e_item_int = e_array_item.value().Get<int>();
+					if (e_item_int) {
+						if (e_item_int.value() < 0) {
+							auto err = MakeError(
+								ConfigParserErrorCode::ValidationError,
+								"'ForwarderAllowedUIDs' must not contain negative user IDs");
+							return expected::unexpected(err);
+						}
+						this->forwarder_allowed_uids.push_back(e_item_int.value());
+						applied = true;
+					}
+				}
+			}
+		}
+	}
+
 	e_cfg_value = cfg_json.Get("StateScriptTimeoutSeconds");
 	if (e_cfg_value) {
 		const json::Json value_json = e_cfg_value.value();
@@ -205,6 +288,76 @@ ExpectedBool MenderConfigFromFile::LoadFile(const string &path) {
 		}
 	}
 
+	e_cfg_value = cfg_json.Get("ProgressIntervalMilliseconds");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const auto e_cfg_int = value_json.Get<int>();
+		if (e_cfg_int) {
+			this->progress_interval_milliseconds = e_cfg_int.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("ProgressSubstateIntervalSeconds");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const auto e_cfg_int = value_json.Get<int>();
+		if (e_cfg_int) {
+			this->progress_substate_interval_seconds = e_cfg_int.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("NativePayloadWriter");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->native_payload_writer = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("NativePayloadWriterDirectIO");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->native_payload_writer_direct_io = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("NativePayloadWriterSkipUnchanged");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->native_payload_writer_skip_unchanged = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("NativePayloadWriterVerify");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->native_payload_writer_verify = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
+	e_cfg_value = cfg_json.Get("NativeInstallers");
+	if (e_cfg_value) {
+		const json::Json value_json = e_cfg_value.value();
+		const json::ExpectedBool e_cfg_bool = value_json.GetBool();
+		if (e_cfg_bool) {
+			this->native_installers = e_cfg_bool.value();
+			applied = true;
+		}
+	}
+
 
 	e_cfg_value = cfg_json.Get("ArtifactVerifyKeys");
 	if (e_cfg_value) {
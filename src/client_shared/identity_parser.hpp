@@ -15,6 +15,9 @@
 #ifndef MENDER_COMMON_IDENTITY_PARSER_HPP
 #define MENDER_COMMON_IDENTITY_PARSER_HPP
 
+#include <chrono>
+#include <string>
+
 #include <common/key_value_parser.hpp>
 
 namespace mender {
@@ -26,6 +29,12 @@ namespace kvp = mender::common::key_value_parser;
 
 kvp::ExpectedKeyValuesMap GetIdentityData(const string &identity_data_generator);
 
+// Like `GetIdentityData()`, but reuses the data from an earlier call for the same generator if it
+// is at most `max_age` old and the generator hasn't been modified since. A zero `max_age` always
+// runs the generator.
+kvp::ExpectedKeyValuesMap GetCachedIdentityData(
+	const string &identity_data_generator, chrono::seconds max_age);
+
 string DumpIdentityData(const kvp::KeyValuesMap &identity_data);
 
 } // namespace identity_parser
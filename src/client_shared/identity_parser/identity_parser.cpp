@@ -14,6 +14,11 @@
 
 #include <client_shared/identity_parser.hpp>
 
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
 #include <common/common.hpp>
 #include <common/expected.hpp>
 #include <common/json.hpp>
@@ -42,6 +47,74 @@ kvp::ExpectedKeyValuesMap GetIdentityData(const string &identity_data_generator)
 	return ex_key_values;
 }
 
+// Identity data is effectively static, but the generator, usually a shell script, would be run for
+// every authentication request. So the data is kept for a while, unless the generator changes.
+class IdentityDataCache {
+public:
+	bool Get(const string &generator, chrono::seconds max_age, kvp::KeyValuesMap &data) {
+		struct timespec mtime;
+		if (!GetModificationTime(generator, mtime)) {
+			return false;
+		}
+
+		lock_guard<mutex> lock(mutex_);
+		auto found = entries_.find(generator);
+		if (found == entries_.end() || found->second.mtime.tv_sec != mtime.tv_sec
+			|| found->second.mtime.tv_nsec != mtime.tv_nsec
+			|| chrono::steady_clock::now() - found->second.fetched > max_age) {
+			return false;
+		}
+		data = found->second.data;
+		return true;
+	}
+
+	void Put(const string &generator, const kvp::KeyValuesMap &data) {
+		struct timespec mtime;
+		if (!GetModificationTime(generator, mtime)) {
+			return;
+		}
+
+		lock_guard<mutex> lock(mutex_);
+		entries_[generator] = Entry {mtime, chrono::steady_clock::now(), data};
+	}
+
+private:
+	static bool GetModificationTime(const string &path, struct timespec &mtime) {
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0) {
+			return false;
+		}
+		mtime = st.st_mtim;
+		return true;
+	}
+
+	struct Entry {
+		struct timespec mtime;
+		chrono::steady_clock::time_point fetched;
+		kvp::KeyValuesMap data;
+	};
+
+	mutex mutex_;
+	unordered_map<string, Entry> entries_;
+};
+
+static IdentityDataCache identity_data_cache;
+
+kvp::ExpectedKeyValuesMap GetCachedIdentityData(
+	const string &identity_data_generator, chrono::seconds max_age) {
+	kvp::KeyValuesMap data;
+	if (max_age > chrono::seconds::zero()
+		&& identity_data_cache.Get(identity_data_generator, max_age, data)) {
+		return data;
+	}
+
+	auto ex_data = GetIdentityData(identity_data_generator);
+	if (ex_data && max_age > chrono::seconds::zero()) {
+		identity_data_cache.Put(identity_data_generator, ex_data.value());
+	}
+	return ex_data;
+}
+
 string DumpIdentityData(const kvp::KeyValuesMap &identity_data) {
 	stringstream top_ss;
 	top_ss << "{";
@@ -18,14 +18,20 @@
 
 #include <cerrno>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
+#include <sys/stat.h>
+
 #include <openssl/bn.h>
 #include <openssl/ecdsa.h>
 #include <openssl/err.h>
 #include <openssl/engine.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <openssl/ui.h>
 #include <openssl/ssl.h>
 #ifndef MENDER_CRYPTO_OPENSSL_LEGACY
@@ -125,6 +131,128 @@ auto password_callback = [](char *buf, int size, int rwflag, void *u) {
 };
 
 
+// Parsing keys is expensive, and the same few keys are used over and over again: The private key
+// for every authentication request, and the verification keys for every Artifact. So parsed keys
+// are kept for the lifetime of the process, and only parsed again if the file they came from has
+// changed. Keys which don't come from a regular file, such as HSM keys, are not cached.
+class KeyCache {
+public:
+	// Returns a new reference to the key, or null if it is not cached, or the file has changed
+	// since.
+	PkeyPtr Get(const string &path, const string &passphrase) {
+		FileVersion version;
+		string passphrase_hash;
+		if (!GetFileVersion(path, version) || !HashPassphrase(passphrase, passphrase_hash)) {
+			return PkeyPtr(nullptr, pkey_free_func);
+		}
+
+		lock_guard<mutex> lock(mutex_);
+		auto found = entries_.find(path);
+		if (found == entries_.end() || !(found->second.version == version)
+			|| found->second.passphrase_hash != passphrase_hash) {
+			return PkeyPtr(nullptr, pkey_free_func);
+		}
+		EVP_PKEY_up_ref(found->second.key.get());
+		return PkeyPtr(found->second.key.get(), pkey_free_func);
+	}
+
+	void Put(const string &path, const string &passphrase, EVP_PKEY *key) {
+		FileVersion version;
+		string passphrase_hash;
+		if (!GetFileVersion(path, version) || !HashPassphrase(passphrase, passphrase_hash)) {
+			return;
+		}
+
+		EVP_PKEY_up_ref(key);
+		lock_guard<mutex> lock(mutex_);
+		entries_.erase(path);
+		entries_.emplace(path, Entry {version, passphrase_hash, PkeyPtr(key, pkey_free_func)});
+	}
+
+	void Forget(const string &path) {
+		lock_guard<mutex> lock(mutex_);
+		entries_.erase(path);
+	}
+
+private:
+	struct FileVersion {
+		dev_t device;
+		ino_t inode;
+		off_t size;
+		struct timespec mtime;
+
+		bool operator==(const FileVersion &other) const {
+			return device == other.device && inode == other.inode && size == other.size
+				   && mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec;
+		}
+	};
+
+	static bool GetFileVersion(const string &path, FileVersion &version) {
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+			return false;
+		}
+		version = FileVersion {st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+		return true;
+	}
+
+	// A cached private key must not be handed out to someone who doesn't know the passphrase,
+	// but the passphrase itself should not be kept in memory for the lifetime of the process
+	// either. So only a hash of it is kept, keyed with a secret which is random for every
+	// process, so that it can't be looked up in precomputed tables. Returns false if the hash
+	// can't be computed, in which case the key is not cached.
+	bool HashPassphrase(const string &passphrase, string &hash) {
+		call_once(hash_key_init_, [this]() {
+			hash_key_valid_ =
+				RAND_bytes(hash_key_, sizeof(hash_key_)) == static_cast<int>(OPENSSL_SUCCESS);
+		});
+		if (!hash_key_valid_) {
+			return false;
+		}
+
+		unsigned char digest[EVP_MAX_MD_SIZE];
+		unsigned int digest_len = 0;
+		if (HMAC(
+				EVP_sha256(),
+				hash_key_,
+				sizeof(hash_key_),
+				reinterpret_cast<const unsigned char *>(passphrase.data()),
+				passphrase.size(),
+				digest,
+				&digest_len)
+			== nullptr) {
+			return false;
+		}
+		hash.assign(reinterpret_cast<const char *>(digest), digest_len);
+		return true;
+	}
+
+	struct Entry {
+		FileVersion version;
+		string passphrase_hash;
+		PkeyPtr key;
+	};
+
+	mutex mutex_;
+	unordered_map<string, Entry> entries_;
+
+	once_flag hash_key_init_;
+	bool hash_key_valid_ {false};
+	unsigned char hash_key_[32];
+};
+
+// Never destroyed, since OpenSSL may already have cleaned up after itself by the time static
+// destructors run.
+static KeyCache &PrivateKeyCache() {
+	static KeyCache *cache = new KeyCache;
+	return *cache;
+}
+
+static KeyCache &PublicKeyCache() {
+	static KeyCache *cache = new KeyCache;
+	return *cache;
+}
+
 // NOTE: GetOpenSSLErrorMessage should be called upon all OpenSSL errors, as
 // the errors are queued, and if not harvested, the FIFO structure of the
 // queue will mean that if you just get one, you might actually get the wrong
@@ -313,7 +441,19 @@ ExpectedPrivateKey PrivateKey::Load(const Args &args) {
 				+ "': " + err.String());
 		}
 	}
-	return LoadFrom(args);
+
+	auto cached_key = PrivateKeyCache().Get(args.private_key_path, args.private_key_passphrase);
+	if (cached_key) {
+		log::Trace("Using cached private key");
+		return PrivateKey(std::move(cached_key));
+	}
+
+	auto exp_key = LoadFrom(args);
+	if (exp_key) {
+		PrivateKeyCache().Put(
+			args.private_key_path, args.private_key_passphrase, exp_key.value().Get());
+	}
+	return exp_key;
 }
 
 ExpectedPrivateKey PrivateKey::Generate() {
@@ -682,6 +822,36 @@ static expected::ExpectedBytes TryASN1EncodeMenderCustomBinaryECFormat(
 }
 
 
+using ExpectedPkeyPtr = expected::expected<PkeyPtr, error::Error>;
+
+static ExpectedPkeyPtr LoadPublicKey(const string &public_key_path) {
+	auto cached_key = PublicKeyCache().Get(public_key_path, "");
+	if (cached_key) {
+		return cached_key;
+	}
+
+	auto bio_key =
+		unique_ptr<BIO, void (*)(BIO *)>(BIO_new_file(public_key_path.c_str(), "r"), bio_free_func);
+	if (bio_key == nullptr) {
+		return expected::unexpected(MakeError(
+			SetupError,
+			"Failed to open the public key file from (" + public_key_path
+				+ "):" + GetOpenSSLErrorMessage()));
+	}
+
+	auto pkey = PkeyPtr(
+		PEM_read_bio_PUBKEY(bio_key.get(), nullptr, nullptr, nullptr), pkey_free_func);
+	if (pkey == nullptr) {
+		return expected::unexpected(MakeError(
+			SetupError,
+			"Failed to load the public key from(" + public_key_path
+				+ "): " + GetOpenSSLErrorMessage()));
+	}
+
+	PublicKeyCache().Put(public_key_path, "", pkey.get());
+	return pkey;
+}
+
 expected::ExpectedBool VerifySignData(
 	const string &public_key_path,
 	const mender::sha::SHA &shasum,
@@ -724,23 +894,11 @@ expected::ExpectedBool VerifySignData(
 	const string &public_key_path,
 	const mender::sha::SHA &shasum,
 	const vector<uint8_t> &signature) {
-	auto bio_key =
-		unique_ptr<BIO, void (*)(BIO *)>(BIO_new_file(public_key_path.c_str(), "r"), bio_free_func);
-	if (bio_key == nullptr) {
-		return expected::unexpected(MakeError(
-			SetupError,
-			"Failed to open the public key file from (" + public_key_path
-				+ "):" + GetOpenSSLErrorMessage()));
-	}
-
-	auto pkey = unique_ptr<EVP_PKEY, void (*)(EVP_PKEY *)>(
-		PEM_read_bio_PUBKEY(bio_key.get(), nullptr, nullptr, nullptr), pkey_free_func);
-	if (pkey == nullptr) {
-		return expected::unexpected(MakeError(
-			SetupError,
-			"Failed to load the public key from(" + public_key_path
-				+ "): " + GetOpenSSLErrorMessage()));
+	auto exp_pkey = LoadPublicKey(public_key_path);
+	if (!exp_pkey) {
+		return expected::unexpected(exp_pkey.error());
 	}
+	auto &pkey = exp_pkey.value();
 
 	auto pkey_signer_ctx = unique_ptr<EVP_PKEY_CTX, void (*)(EVP_PKEY_CTX *)>(
 		EVP_PKEY_CTX_new(pkey.get(), nullptr), pkey_ctx_free_func);
@@ -786,6 +944,8 @@ expected::ExpectedBool VerifySign(
 }
 
 error::Error PrivateKey::SaveToPEM(const string &private_key_path) {
+	PrivateKeyCache().Forget(private_key_path);
+
 	if (path::FileExists(private_key_path)) {
 		auto err = path::FileDelete(private_key_path);
 		if (err != error::NoError) {
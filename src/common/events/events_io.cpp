@@ -82,6 +82,22 @@ error::Error AsyncWriterFromWriter::AsyncWrite(
 	return error::NoError;
 }
 
+error::Error AsyncWriterFromWriter::AsyncWriteV(
+	const mio::ConstBufferChain &buffers, mio::AsyncIoHandler handler) {
+	cancelled_ = make_shared<bool>(false);
+	auto &cancelled = cancelled_;
+	loop_.Post([this, cancelled, buffers, handler]() {
+		if (!*cancelled) {
+			in_progress_ = true;
+			auto result = writer_->WriteV(buffers);
+			in_progress_ = false;
+			handler(result);
+		}
+	});
+
+	return error::NoError;
+}
+
 void AsyncWriterFromWriter::Cancel() {
 	// Cancel() is not allowed on normal Writers.
 	assert(!in_progress_);
@@ -14,21 +14,61 @@
 
 #include <common/events_io.hpp>
 
+#include <algorithm>
 #include <vector>
 
+#ifdef MENDER_USE_IO_URING
+#include <common/events/platform/liburing/io_uring.hpp>
+#endif // MENDER_USE_IO_URING
+
 namespace mender {
 namespace common {
 namespace events {
 namespace io {
 
+#ifdef MENDER_USE_IO_URING
+static uring::Ring *RingIfAvailable(asio::io_context &ctx) {
+	auto &ring = uring::Ring::Get(ctx);
+	return ring.Available() ? &ring : nullptr;
+}
+#endif // MENDER_USE_IO_URING
+
+static function<void(error_code, size_t)> AsioWriteHandler(
+	shared_ptr<bool> destroying, mender::common::io::AsyncIoHandler handler) {
+	return [destroying, handler](error_code ec, size_t n) {
+		if (*destroying) {
+			return;
+		} else if (ec == make_error_code(asio::error::operation_aborted)) {
+			handler(expected::unexpected(error::Error(
+				make_error_condition(errc::operation_canceled), "AsyncWrite cancelled")));
+		} else if (ec == make_error_code(asio::error::broken_pipe)) {
+			// Let's translate broken_pipe. It's a common error, and we don't want to
+			// require the caller to match with Boost ASIO errors.
+			handler(expected::unexpected(
+				error::Error(make_error_condition(errc::broken_pipe), "AsyncWrite failed")));
+		} else if (ec) {
+			handler(expected::unexpected(
+				error::Error(ec.default_error_condition(), "AsyncWrite failed")));
+		} else {
+			handler(n);
+		}
+	};
+}
+
 AsyncFileDescriptorReader::AsyncFileDescriptorReader(events::EventLoop &loop, int fd) :
 	pipe_(GetAsioIoContext(loop), fd),
 	destroying_ {make_shared<bool>(false)} {
+#ifdef MENDER_USE_IO_URING
+	ring_ = RingIfAvailable(GetAsioIoContext(loop));
+#endif // MENDER_USE_IO_URING
 }
 
 AsyncFileDescriptorReader::AsyncFileDescriptorReader(events::EventLoop &loop) :
 	pipe_(GetAsioIoContext(loop)),
 	destroying_ {make_shared<bool>(false)} {
+#ifdef MENDER_USE_IO_URING
+	ring_ = RingIfAvailable(GetAsioIoContext(loop));
+#endif // MENDER_USE_IO_URING
 }
 
 AsyncFileDescriptorReader::~AsyncFileDescriptorReader() {
@@ -62,6 +102,45 @@ error::Error AsyncFileDescriptorReader::AsyncRead(
 
 	auto destroying {destroying_};
 
+#ifdef MENDER_USE_IO_URING
+	if (ring_ != nullptr) {
+		// The ring reads into its own buffer, and only copies into ours if we are still
+		// interested, so the caller's buffer may be gone after `Cancel()`.
+		auto cancelled = make_shared<bool>(false);
+		auto exp_op = ring_->AsyncRead(
+			pipe_.native_handle(),
+			&start[0],
+			size_t(end - start),
+			[this, destroying, cancelled, handler](int res) {
+				if (*destroying) {
+					return;
+				}
+				if (*cancelled || res == -ECANCELED) {
+					if (!*cancelled) {
+						pending_op_ = 0;
+					}
+					handler(expected::unexpected(error::Error(
+						make_error_condition(errc::operation_canceled), "AsyncRead cancelled")));
+					return;
+				}
+				pending_op_ = 0;
+				if (res < 0) {
+					handler(expected::unexpected(error::Error(
+						generic_category().default_error_condition(-res), "AsyncRead failed")));
+				} else {
+					// Zero means EOF, same as with asio.
+					handler(static_cast<size_t>(res));
+				}
+			});
+		if (!exp_op) {
+			return exp_op.error();
+		}
+		pending_op_ = exp_op.value();
+		pending_cancelled_ = cancelled;
+		return error::NoError;
+	}
+#endif // MENDER_USE_IO_URING
+
 	asio::mutable_buffer buf {&start[0], size_t(end - start)};
 	pipe_.async_read_some(buf, [destroying, handler](error_code ec, size_t n) {
 		if (*destroying) {
@@ -86,19 +165,41 @@ error::Error AsyncFileDescriptorReader::AsyncRead(
 }
 
 void AsyncFileDescriptorReader::Cancel() {
+#ifdef MENDER_USE_IO_URING
+	if (ring_ != nullptr && pending_op_ != 0) {
+		auto op = pending_op_;
+		pending_op_ = 0;
+		*pending_cancelled_ = true;
+		ring_->Cancel(op);
+	}
+#endif // MENDER_USE_IO_URING
 	if (pipe_.is_open()) {
 		pipe_.cancel();
 	}
 }
 
+bool AsyncFileDescriptorReader::UsesIoUring() const {
+#ifdef MENDER_USE_IO_URING
+	return ring_ != nullptr;
+#else
+	return false;
+#endif // MENDER_USE_IO_URING
+}
+
 AsyncFileDescriptorWriter::AsyncFileDescriptorWriter(events::EventLoop &loop, int fd) :
 	pipe_(GetAsioIoContext(loop), fd),
 	destroying_ {make_shared<bool>(false)} {
+#ifdef MENDER_USE_IO_URING
+	ring_ = RingIfAvailable(GetAsioIoContext(loop));
+#endif // MENDER_USE_IO_URING
 }
 
 AsyncFileDescriptorWriter::AsyncFileDescriptorWriter(events::EventLoop &loop) :
 	pipe_(GetAsioIoContext(loop)),
 	destroying_ {make_shared<bool>(false)} {
+#ifdef MENDER_USE_IO_URING
+	ring_ = RingIfAvailable(GetAsioIoContext(loop));
+#endif // MENDER_USE_IO_URING
 }
 
 AsyncFileDescriptorWriter::~AsyncFileDescriptorWriter() {
@@ -141,35 +242,102 @@ error::Error AsyncFileDescriptorWriter::AsyncWrite(
 
 	auto destroying {destroying_};
 
+#ifdef MENDER_USE_IO_URING
+	if (ring_ != nullptr) {
+		// The ring copies the data before this returns, so the caller's buffer is free to go
+		// as soon as we do, even if the kernel is still writing after `Cancel()`.
+		auto cancelled = make_shared<bool>(false);
+		auto exp_op = ring_->AsyncWrite(
+			pipe_.native_handle(),
+			&start[0],
+			size_t(end - start),
+			[this, destroying, cancelled, handler](int res) {
+				if (*destroying) {
+					return;
+				}
+				if (*cancelled || res == -ECANCELED) {
+					if (!*cancelled) {
+						pending_op_ = 0;
+					}
+					handler(expected::unexpected(error::Error(
+						make_error_condition(errc::operation_canceled), "AsyncWrite cancelled")));
+					return;
+				}
+				pending_op_ = 0;
+				if (res < 0) {
+					// EPIPE maps to `errc::broken_pipe`, same as the asio path below.
+					handler(expected::unexpected(error::Error(
+						generic_category().default_error_condition(-res), "AsyncWrite failed")));
+				} else {
+					handler(static_cast<size_t>(res));
+				}
+			});
+		if (!exp_op) {
+			return exp_op.error();
+		}
+		pending_op_ = exp_op.value();
+		pending_cancelled_ = cancelled;
+		return error::NoError;
+	}
+#endif // MENDER_USE_IO_URING
+
 	asio::const_buffer buf {&start[0], size_t(end - start)};
-	pipe_.async_write_some(buf, [destroying, handler](error_code ec, size_t n) {
-		if (*destroying) {
-			return;
-		} else if (ec == make_error_code(asio::error::operation_aborted)) {
-			handler(expected::unexpected(error::Error(
-				make_error_condition(errc::operation_canceled), "AsyncWrite cancelled")));
-		} else if (ec == make_error_code(asio::error::broken_pipe)) {
-			// Let's translate broken_pipe. It's a common error, and we don't want to
-			// require the caller to match with Boost ASIO errors.
-			handler(expected::unexpected(
-				error::Error(make_error_condition(errc::broken_pipe), "AsyncWrite failed")));
-		} else if (ec) {
-			handler(expected::unexpected(
-				error::Error(ec.default_error_condition(), "AsyncWrite failed")));
-		} else {
-			handler(n);
+	pipe_.async_write_some(buf, AsioWriteHandler(destroying, handler));
+
+	return error::NoError;
+}
+
+error::Error AsyncFileDescriptorWriter::AsyncWriteV(
+	const mender::common::io::ConstBufferChain &buffers,
+	mender::common::io::AsyncIoHandler handler) {
+	if (!handler) {
+		return error::Error(
+			make_error_condition(errc::invalid_argument), "AsyncWriteV: handler cannot be nullptr");
+	}
+
+	// The io_uring path is not used here. Both paths use the file position, so mixing them is
+	// fine, as long as there is only one write at a time, which is required anyway.
+	vector<asio::const_buffer> bufs;
+	bufs.reserve(buffers.size());
+	for (const auto &buf : buffers) {
+		if (buf.end < buf.start) {
+			return error::Error(
+				make_error_condition(errc::invalid_argument),
+				"AsyncWriteV: end cannot precede start");
 		}
-	});
+		if (buf.size() > 0) {
+			bufs.push_back(asio::const_buffer {&buf.start[0], buf.size()});
+		}
+	}
+
+	// Asio copies the buffer sequence into the operation, so `bufs` may go out of scope.
+	pipe_.async_write_some(bufs, AsioWriteHandler(destroying_, handler));
 
 	return error::NoError;
 }
 
 void AsyncFileDescriptorWriter::Cancel() {
+#ifdef MENDER_USE_IO_URING
+	if (ring_ != nullptr && pending_op_ != 0) {
+		auto op = pending_op_;
+		pending_op_ = 0;
+		*pending_cancelled_ = true;
+		ring_->Cancel(op);
+	}
+#endif // MENDER_USE_IO_URING
 	if (pipe_.is_open()) {
 		pipe_.cancel();
 	}
 }
 
+bool AsyncFileDescriptorWriter::UsesIoUring() const {
+#ifdef MENDER_USE_IO_URING
+	return ring_ != nullptr;
+#else
+	return false;
+#endif // MENDER_USE_IO_URING
+}
+
 } // namespace io
 } // namespace events
 } // namespace common
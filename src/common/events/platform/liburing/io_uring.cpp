@@ -0,0 +1,398 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <common/events/platform/liburing/io_uring.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <common/log.hpp>
+
+namespace mender {
+namespace common {
+namespace events {
+namespace io {
+namespace uring {
+
+namespace log = mender::common::log;
+
+// Large enough for all the descriptors a deployment has open at the same time. If it fills up
+// anyway, we just submit early.
+const unsigned kQueueDepth = 64;
+
+// Enough for the descriptors a deployment has busy at the same time, without asking for more
+// locked memory than older kernels allow by default.
+const size_t kRegisteredBufferCount = 4;
+
+const size_t Ring::kBounceBufferSize = MENDER_BUFSIZE;
+
+asio::execution_context::id Ring::id;
+
+static string ErrnoString(int err) {
+	return string(strerror(err));
+}
+
+Ring::Ring(asio::io_context &ctx) :
+	asio::execution_context::service(ctx),
+	ctx_ {ctx},
+	event_fd_(ctx) {
+	io_uring_params params {};
+	int ret = io_uring_queue_init_params(kQueueDepth, &ring_, &params);
+	if (ret < 0) {
+		log::Debug("io_uring not available, using readiness based I/O: " + ErrnoString(-ret));
+		return;
+	}
+
+	// Pipes don't have offsets, and we don't track them for files either, so we need the
+	// kernel to use the current file position for us.
+	if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+		log::Debug("io_uring does not support the current file position, not using it");
+		io_uring_queue_exit(&ring_);
+		return;
+	}
+
+	int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (efd < 0) {
+		int err = errno;
+		log::Debug("Could not create eventfd for io_uring: " + ErrnoString(err));
+		io_uring_queue_exit(&ring_);
+		return;
+	}
+	ret = io_uring_register_eventfd(&ring_, efd);
+	if (ret < 0) {
+		log::Debug("Could not register eventfd with io_uring: " + ErrnoString(-ret));
+		close(efd);
+		io_uring_queue_exit(&ring_);
+		return;
+	}
+	event_fd_.assign(efd);
+
+	SetUpBuffers();
+
+	available_ = true;
+}
+
+Ring::~Ring() {
+	shutdown();
+	if (available_) {
+		io_uring_queue_exit(&ring_);
+	}
+}
+
+void Ring::shutdown() {
+	if (shut_down_) {
+		return;
+	}
+	shut_down_ = true;
+
+	boost::system::error_code ec;
+	event_fd_.close(ec);
+
+	// Same semantics as asio: Handlers which have not run by now are destroyed, never called.
+	// The buffers stay until the ring itself is gone, the kernel may still be using them.
+	ops_.clear();
+}
+
+io_uring_sqe *Ring::GetSqe() {
+	auto sqe = io_uring_get_sqe(&ring_);
+	if (sqe == nullptr) {
+		// Submission queue is full. Flush it early and try again.
+		io_uring_submit(&ring_);
+		sqe = io_uring_get_sqe(&ring_);
+	}
+	return sqe;
+}
+
+void Ring::PrepareOp(io_uring_sqe *sqe, OpId id, const Op &op) {
+	if (op.polling) {
+		io_uring_prep_poll_add(sqe, op.fd, op.write ? POLLOUT : POLLIN);
+	} else if (op.write) {
+		if (op.fixed) {
+			io_uring_prep_write_fixed(sqe, op.fd, op.buf, op.len, 0, 0);
+		} else {
+			io_uring_prep_write(sqe, op.fd, op.buf, op.len, 0);
+		}
+		// -1 means current file position.
+		sqe->off = numeric_limits<uint64_t>::max();
+	} else {
+		if (op.fixed) {
+			io_uring_prep_read_fixed(sqe, op.fd, op.buf, op.len, 0, 0);
+		} else {
+			io_uring_prep_read(sqe, op.fd, op.buf, op.len, 0);
+		}
+		sqe->off = numeric_limits<uint64_t>::max();
+	}
+	sqe->user_data = id;
+}
+
+ExpectedOpId Ring::Queue(
+	bool write, int fd, uint8_t *dest, size_t len, CompletionHandler handler) {
+	AssertOrReturnUnexpected(available_ && !shut_down_);
+
+	auto sqe = GetSqe();
+	if (sqe == nullptr) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::resource_unavailable_try_again),
+			"io_uring submission queue is full"));
+	}
+
+	auto buf = AcquireBuffer();
+	auto nbytes = static_cast<unsigned>(min(len, kBounceBufferSize));
+	if (write) {
+		copy_n(dest, nbytes, buf);
+	}
+
+	OpId id = next_op_id_++;
+	Op op {handler, fd, buf, nbytes, write, IsRegistered(buf), dest, false, false};
+	PrepareOp(sqe, id, op);
+	ops_[id] = std::move(op);
+
+	ScheduleSubmit();
+	ArmEventFd();
+
+	return id;
+}
+
+void Ring::QueueInternal(function<void(io_uring_sqe *)> prepare) {
+	if (shut_down_) {
+		return;
+	}
+
+	auto sqe = GetSqe();
+	if (sqe == nullptr) {
+		// Still full, most likely because the completion queue is overflowing. Completions
+		// are reaped before the next attempt, which makes room.
+		asio::post(ctx_, [this, prepare]() {
+			Reap();
+			QueueInternal(prepare);
+		});
+		return;
+	}
+	prepare(sqe);
+
+	ScheduleSubmit();
+	ArmEventFd();
+}
+
+ExpectedOpId Ring::AsyncRead(int fd, uint8_t *buf, size_t len, CompletionHandler handler) {
+	return Queue(false, fd, buf, len, handler);
+}
+
+ExpectedOpId Ring::AsyncWrite(int fd, const uint8_t *buf, size_t len, CompletionHandler handler) {
+	// The buffer is only read from, the cast is just so that reads and writes can share `Op`.
+	return Queue(true, fd, const_cast<uint8_t *>(buf), len, handler);
+}
+
+void Ring::ScheduleSubmit() {
+	if (submit_scheduled_) {
+		return;
+	}
+	submit_scheduled_ = true;
+
+	asio::post(ctx_, [this]() {
+		submit_scheduled_ = false;
+		int ret = io_uring_submit(&ring_);
+		if (ret == -EAGAIN || ret == -EBUSY) {
+			// The kernel is short on resources or the completion queue is overflowing. Make
+			// room and try again on the next iteration.
+			Reap();
+			ScheduleSubmit();
+		} else if (ret < 0) {
+			log::Error("io_uring_submit failed: " + ErrnoString(-ret));
+			// Some of these may have reached the kernel in an earlier submission, so their
+			// buffers are not handed out again. They go away with the ring.
+			auto ops = std::move(ops_);
+			ops_.clear();
+			for (auto &op : ops) {
+				op.second.handler(ret);
+			}
+		}
+	});
+}
+
+void Ring::ArmEventFd() {
+	// Only keep the event loop busy while there is something to wait for, otherwise
+	// `EventLoop::Run()` would never run out of work.
+	if (event_fd_armed_ || ops_.empty() || shut_down_) {
+		return;
+	}
+	event_fd_armed_ = true;
+
+	event_fd_.async_wait(
+		asio::posix::stream_descriptor::wait_read, [this](const boost::system::error_code &ec) {
+			if (ec == asio::error::operation_aborted || shut_down_) {
+				return;
+			}
+			event_fd_armed_ = false;
+			if (ec) {
+				log::Error("Error while waiting for io_uring completions: " + ec.message());
+			}
+
+			uint64_t count;
+			// Only resets the counter, the completion queue is the source of truth.
+			auto n = read(event_fd_.native_handle(), &count, sizeof(count));
+			(void)n;
+
+			Reap();
+			ArmEventFd();
+		});
+}
+
+void Ring::Reap() {
+	io_uring_cqe *cqe;
+	while (io_uring_peek_cqe(&ring_, &cqe) == 0) {
+		HandleCqe(cqe);
+	}
+}
+
+void Ring::HandleCqe(io_uring_cqe *cqe) {
+	OpId id = cqe->user_data;
+	int res = cqe->res;
+	// Mark it seen before calling anything, the handler is likely to queue more operations.
+	io_uring_cqe_seen(&ring_, cqe);
+
+	auto found = ops_.find(id);
+	if (found == ops_.end()) {
+		// Cancellation requests and other internal bookkeeping.
+		return;
+	}
+	auto &op = found->second;
+
+	if (op.polling && res >= 0) {
+		// The descriptor is ready now, so try the operation again.
+		if (!op.cancelling) {
+			op.polling = false;
+			Requeue(id);
+			return;
+		}
+		res = -ECANCELED;
+	} else if (!op.polling && res == -EAGAIN && !op.cancelling) {
+		// A non-blocking descriptor which wasn't ready. Wait until it is, the same way asio
+		// does it, instead of failing.
+		op.polling = true;
+		Requeue(id);
+		return;
+	}
+
+	Complete(id, res);
+}
+
+void Ring::Requeue(OpId id) {
+	QueueInternal([this, id](io_uring_sqe *sqe) {
+		auto found = ops_.find(id);
+		if (found != ops_.end() && !found->second.cancelling) {
+			PrepareOp(sqe, id, found->second);
+			return;
+		}
+
+		// Cancelled while waiting for room in the submission queue, so there is nothing for
+		// the cancellation request to find. Fill the slot with a no-op instead.
+		io_uring_prep_nop(sqe);
+		sqe->user_data = 0;
+		if (found != ops_.end()) {
+			asio::post(ctx_, [this, id]() { Complete(id, -ECANCELED); });
+		}
+	});
+}
+
+void Ring::Complete(OpId id, int res) {
+	auto found = ops_.find(id);
+	if (found == ops_.end()) {
+		return;
+	}
+	auto &op = found->second;
+	if (!op.write && res > 0) {
+		if (op.cancelling) {
+			// The destination may be gone by now.
+			res = -ECANCELED;
+		} else {
+			copy_n(op.buf, res, op.dest);
+		}
+	}
+	auto handler = std::move(op.handler);
+	ReleaseBuffer(op.buf);
+	ops_.erase(found);
+
+	handler(res);
+}
+
+void Ring::Cancel(OpId id) {
+	auto found = ops_.find(id);
+	if (found == ops_.end() || found->second.cancelling) {
+		return;
+	}
+	found->second.cancelling = true;
+
+	// Submitted along with everything else, so this never blocks the event loop. If the
+	// operation is waiting for the descriptor to become ready, the poll request is cancelled
+	// instead, since it has the same `user_data`.
+	QueueInternal([id](io_uring_sqe *sqe) {
+		io_uring_prep_rw(IORING_OP_ASYNC_CANCEL, sqe, -1, nullptr, 0, 0);
+		sqe->addr = id;
+		sqe->user_data = 0;
+	});
+}
+
+void Ring::SetUpBuffers() {
+	registered_pool_.resize(kRegisteredBufferCount * kBounceBufferSize);
+	for (size_t i = 0; i < kRegisteredBufferCount; i++) {
+		free_buffers_.push_back(registered_pool_.data() + i * kBounceBufferSize);
+	}
+
+	// The whole pool is one registered buffer, so every operation uses index zero.
+	iovec vec {registered_pool_.data(), registered_pool_.size()};
+	int ret = io_uring_register_buffers(&ring_, &vec, 1);
+	if (ret < 0) {
+		// Most likely RLIMIT_MEMLOCK. The buffers still work, just without the head start.
+		log::Debug("Not using registered io_uring buffers: " + ErrnoString(-ret));
+		return;
+	}
+	pool_registered_ = true;
+}
+
+uint8_t *Ring::AcquireBuffer() {
+	if (free_buffers_.empty()) {
+		overflow_buffers_.emplace_back(kBounceBufferSize);
+		return overflow_buffers_.back().data();
+	}
+	auto buf = free_buffers_.back();
+	free_buffers_.pop_back();
+	return buf;
+}
+
+void Ring::ReleaseBuffer(uint8_t *buf) {
+	// Hand out the registered ones first.
+	if (IsRegistered(buf)) {
+		free_buffers_.push_back(buf);
+	} else {
+		free_buffers_.insert(free_buffers_.begin(), buf);
+	}
+}
+
+bool Ring::IsRegistered(const uint8_t *buf) const {
+	return pool_registered_ && buf >= registered_pool_.data()
+		   && buf < registered_pool_.data() + registered_pool_.size();
+}
+
+} // namespace uring
+} // namespace io
+} // namespace events
+} // namespace common
+} // namespace mender
@@ -0,0 +1,161 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef MENDER_COMMON_EVENTS_IO_URING_HPP
+#define MENDER_COMMON_EVENTS_IO_URING_HPP
+
+#include <common/config.h>
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include <boost/asio.hpp>
+
+#include <liburing.h>
+
+#include <common/error.hpp>
+#include <common/expected.hpp>
+
+namespace mender {
+namespace common {
+namespace events {
+namespace io {
+namespace uring {
+
+using namespace std;
+
+namespace asio = boost::asio;
+namespace error = mender::common::error;
+namespace expected = mender::common::expected;
+
+// Called with the raw completion result: The number of bytes transferred, or a negative errno.
+using CompletionHandler = function<void(int result)>;
+
+using OpId = uint64_t;
+using ExpectedOpId = expected::expected<OpId, error::Error>;
+
+// One io_uring instance per asio::io_context, created lazily the first time an object on the
+// event loop asks for it. Completions are delivered through an eventfd which is watched by the
+// io_context, so handlers run on the event loop just like the asio based ones.
+class Ring : public asio::execution_context::service {
+public:
+	static asio::execution_context::id id;
+
+	explicit Ring(asio::io_context &ctx);
+	~Ring();
+
+	static Ring &Get(asio::io_context &ctx) {
+		return asio::use_service<Ring>(ctx);
+	}
+
+	// False if the kernel lacks io_uring support, or it is blocked (by seccomp for example). In
+	// that case callers need to fall back to the readiness based implementation.
+	bool Available() const {
+		return available_;
+	}
+
+	// Operations are only queued here. They are submitted once the currently running handler
+	// returns, so that all operations started in the same event loop iteration share one
+	// `io_uring_enter` call. The file position is used as offset, so the descriptor can be
+	// either a pipe or a regular file.
+	//
+	// The kernel only ever sees buffers owned by the ring: Data to write is copied in before
+	// this returns, and data which was read is copied out right before the handler is called.
+	// So `buf` only needs to stay valid until then, or until `Cancel()`. At most
+	// `kBounceBufferSize` bytes are transferred per operation.
+	ExpectedOpId AsyncRead(int fd, uint8_t *buf, size_t len, CompletionHandler handler);
+	ExpectedOpId AsyncWrite(int fd, const uint8_t *buf, size_t len, CompletionHandler handler);
+
+	// Requests cancellation of the operation, without waiting for it. The handler is called
+	// later with `-ECANCELED`, or, for writes, with the real result if the operation managed to
+	// complete in the meantime. Data read after cancellation is dropped.
+	void Cancel(OpId op);
+
+	static const size_t kBounceBufferSize;
+
+private:
+	struct Op {
+		CompletionHandler handler;
+		int fd;
+		// Our own buffer, which the kernel reads from or writes to.
+		uint8_t *buf;
+		unsigned len;
+		bool write;
+		// Whether `buf` is in the registered part of the pool.
+		bool fixed;
+		// Where the data goes after a read.
+		uint8_t *dest;
+		// Waiting for the descriptor to become ready, after the operation returned `-EAGAIN`.
+		bool polling;
+		bool cancelling;
+	};
+
+	void shutdown() override;
+
+	io_uring_sqe *GetSqe();
+	ExpectedOpId Queue(bool write, int fd, uint8_t *dest, size_t len, CompletionHandler handler);
+	void PrepareOp(io_uring_sqe *sqe, OpId id, const Op &op);
+	// For requests which are not started by the user. If the submission queue is full, this
+	// tries again on the next event loop iteration, instead of failing.
+	void QueueInternal(function<void(io_uring_sqe *)> prepare);
+	void Requeue(OpId id);
+	void Complete(OpId id, int res);
+
+	void ScheduleSubmit();
+	void ArmEventFd();
+	void Reap();
+
+	void HandleCqe(io_uring_cqe *cqe);
+
+	void SetUpBuffers();
+	uint8_t *AcquireBuffer();
+	void ReleaseBuffer(uint8_t *buf);
+	bool IsRegistered(const uint8_t *buf) const;
+
+	asio::io_context &ctx_;
+	io_uring ring_;
+	bool available_ {false};
+	bool shut_down_ {false};
+
+	asio::posix::stream_descriptor event_fd_;
+	bool event_fd_armed_ {false};
+	bool submit_scheduled_ {false};
+
+	unordered_map<OpId, Op> ops_;
+	// Zero is reserved for internal requests whose completions we do not care about.
+	OpId next_op_id_ {1};
+
+	// Registered with the kernel once, and kept until the ring goes away, so registration never
+	// races with operations in flight. A buffer goes back to the free list only when the kernel
+	// is done with it, which may be some time after cancellation.
+	vector<uint8_t> registered_pool_;
+	bool pool_registered_ {false};
+	// Used when all registered buffers are busy. Never freed before the ring, for the same
+	// reason.
+	list<vector<uint8_t>> overflow_buffers_;
+	vector<uint8_t *> free_buffers_;
+};
+
+} // namespace uring
+} // namespace io
+} // namespace events
+} // namespace common
+} // namespace mender
+
+#endif // MENDER_COMMON_EVENTS_IO_URING_HPP
@@ -34,6 +34,13 @@ using namespace std;
 namespace asio = boost::asio;
 namespace mio = mender::common::io;
 
+#ifdef MENDER_USE_IO_URING
+namespace uring {
+class Ring;
+using OpId = uint64_t;
+} // namespace uring
+#endif // MENDER_USE_IO_URING
+
 enum class Append {
 	Disabled,
 	Enabled,
@@ -54,11 +61,23 @@ public:
 		mio::AsyncIoHandler handler) override;
 	void Cancel() override;
 
+	// Whether operations go through io_uring rather than asio. False if built without it, or
+	// if the kernel doesn't support it.
+	bool UsesIoUring() const;
+
 private:
 #ifdef MENDER_USE_BOOST_ASIO
 	asio::posix::stream_descriptor pipe_;
 	shared_ptr<bool> destroying_;
 #endif // MENDER_USE_BOOST_ASIO
+#ifdef MENDER_USE_IO_URING
+	// Null if the kernel doesn't support io_uring, in which case we use `pipe_` directly.
+	uring::Ring *ring_;
+	uring::OpId pending_op_ {0};
+	// Cancellation doesn't wait for the kernel, so the operation may still complete later. This
+	// tells its handler not to touch anything anymore.
+	shared_ptr<bool> pending_cancelled_;
+#endif // MENDER_USE_IO_URING
 };
 using AsyncFileDescriptorReaderPtr = shared_ptr<AsyncFileDescriptorReader>;
 
@@ -75,13 +94,25 @@ public:
 		vector<uint8_t>::const_iterator start,
 		vector<uint8_t>::const_iterator end,
 		mio::AsyncIoHandler handler) override;
+	// Uses a single `writev()`.
+	error::Error AsyncWriteV(
+		const mio::ConstBufferChain &buffers, mio::AsyncIoHandler handler) override;
 	void Cancel() override;
 
+	// See `AsyncFileDescriptorReader::UsesIoUring()`.
+	bool UsesIoUring() const;
+
 private:
 #ifdef MENDER_USE_BOOST_ASIO
 	asio::posix::stream_descriptor pipe_;
 	shared_ptr<bool> destroying_;
 #endif // MENDER_USE_BOOST_ASIO
+#ifdef MENDER_USE_IO_URING
+	// Null if the kernel doesn't support io_uring, in which case we use `pipe_` directly.
+	uring::Ring *ring_;
+	uring::OpId pending_op_ {0};
+	shared_ptr<bool> pending_cancelled_;
+#endif // MENDER_USE_IO_URING
 };
 using AsyncFileDescriptorWriterPtr = shared_ptr<AsyncFileDescriptorWriter>;
 
@@ -114,6 +145,8 @@ public:
 		vector<uint8_t>::const_iterator start,
 		vector<uint8_t>::const_iterator end,
 		mio::AsyncIoHandler handler) override;
+	error::Error AsyncWriteV(
+		const mio::ConstBufferChain &buffers, mio::AsyncIoHandler handler) override;
 	// Important: There is no way to cancel a Write operation on a normal Writer, so `Cancel()`
 	// will assert if a Write is in progress.
 	void Cancel() override;
@@ -15,6 +15,7 @@
 #ifndef MENDER_COMMON_HTTP_HPP
 #define MENDER_COMMON_HTTP_HPP
 
+#include <chrono>
 #include <functional>
 #include <string>
 #include <memory>
@@ -22,6 +23,8 @@
 #include <unordered_set>
 #include <vector>
 
+#include <sys/types.h>
+
 #include <common/config.h>
 
 #ifdef MENDER_USE_BOOST_BEAST
@@ -410,6 +413,10 @@ struct ClientConfig {
 	string https_proxy;
 	string no_proxy;
 	string ssl_engine;
+
+	// Keep the connection open after a complete response, and reuse it for the next request to
+	// the same host, instead of connecting anew. Not used for connections through a proxy.
+	common::def_bool keep_alive;
 };
 
 enum class TransactionStatus {
@@ -459,6 +466,9 @@ public:
 
 	Client(Client &&) = default;
 
+	// Besides `http` and `https` URLs, this accepts `unix://<socket path><request path>`, for
+	// example the URL of a `Server` listening on a Unix domain socket with a request path
+	// appended. The socket is the shortest prefix of the path which is a socket file.
 	error::Error AsyncCall(
 		OutgoingRequestPtr req,
 		ResponseHandler header_handler,
@@ -520,11 +530,19 @@ private:
 	};
 
 	boost::asio::ip::tcp::resolver resolver_;
-	shared_ptr<ssl::stream<ssl::stream<tcp::socket>>> stream_;
+	// Either TCP or a Unix domain socket, depending on the URL.
+	shared_ptr<ssl::stream<ssl::stream<asio::generic::stream_protocol::socket>>> stream_;
 
 	vector<uint8_t> body_buffer_;
 
-	asio::ip::tcp::resolver::results_type resolver_results_;
+	vector<asio::generic::stream_protocol::endpoint> resolver_results_;
+
+	// Only used with `ClientConfig::keep_alive`: Where `stream_` is connected to, when it
+	// became idle, and whether the current request is being sent over a reused connection.
+	BrokenDownUrl connection_address_;
+	chrono::steady_clock::time_point idle_since_;
+	bool reusing_connection_ {false};
+	bool via_proxy_ {false};
 
 	// The reason that these are inside a struct is a bit complicated. We need to deal with what
 	// may be a bug in Boost Beast: Parsers and serializers can access the corresponding request
@@ -564,6 +582,11 @@ private:
 
 	error::Error Initialize();
 	void DoCancel();
+	void CloseConnection();
+	void FinishTransaction();
+	bool KeepConnectionAlive() const;
+	bool CanReuseConnection(const BrokenDownUrl &address);
+	bool ReconnectIfStale();
 
 	void CallHandler(ResponseHandler handler);
 	void CallErrorHandler(
@@ -571,11 +594,14 @@ private:
 	void CallErrorHandler(
 		const error::Error &err, const OutgoingRequestPtr &req, ResponseHandler handler);
 	error::Error HandleProxySetup();
+	void Resolve();
 	void ResolveHandler(const error_code &ec, const asio::ip::tcp::resolver::results_type &results);
-	void ConnectHandler(const error_code &ec, const asio::ip::tcp::endpoint &endpoint);
+	void ConnectUnixSocket();
+	void PrepareStream();
+	void ConnectHandler(const error_code &ec, const string &peer);
+	void WriteRequestHeader();
 	template <typename StreamType>
-	void HandshakeHandler(
-		StreamType &stream, const error_code &ec, const asio::ip::tcp::endpoint &endpoint);
+	void HandshakeHandler(StreamType &stream, const error_code &ec, const string &peer);
 	void WriteHeaderHandler(const error_code &ec, size_t num_written);
 	void WriteBodyHandler(const error_code &ec, size_t num_written);
 	void PrepareAndWriteNewBodyBuffer();
@@ -596,7 +622,17 @@ using ClientPtr = shared_ptr<Client>;
 
 // Master object that servers are made from.
 struct ServerConfig {
-	// Empty for now, but will probably contain configuration options later.
+	// Keep serving requests on the same connection after a reply, if the client asks for it.
+	common::def_bool keep_alive;
+
+	// How long a kept-alive connection may sit idle waiting for the next request before the
+	// server closes it.
+	chrono::seconds keep_alive_idle_timeout {30};
+
+	// Only used when listening on a Unix domain socket (`unix:///path/to/socket`): Users who
+	// may connect in addition to root and the user running the server. This is checked using
+	// the peer credentials of each connection.
+	vector<uid_t> unix_socket_allowed_uids;
 };
 
 class Server;
@@ -648,7 +684,8 @@ private:
 	shared_ptr<bool> cancelled_;
 
 #ifdef MENDER_USE_BOOST_BEAST
-	asio::ip::tcp::socket socket_;
+	// Either TCP or a Unix domain socket, depending on what the server listens on.
+	asio::generic::stream_protocol::socket socket_;
 
 	// See `Client::request_data_` for why this is a struct.
 	struct {
@@ -659,6 +696,12 @@ private:
 	vector<uint8_t> body_buffer_;
 	TransactionStatus status_ {TransactionStatus::None};
 
+	// Whether the connection stays open for another request after the current reply, and
+	// whether we are waiting for such a request.
+	bool keep_alive_ {false};
+	bool idle_ {false};
+	asio::steady_timer idle_timer_;
+
 	// See `Client::request_data_` for why this is a struct.
 	struct {
 		shared_ptr<http::response<http::buffer_body>> http_response_;
@@ -683,6 +726,7 @@ private:
 		const error::Error &err, const RequestPtr &req, SwitchProtocolHandler handler);
 
 	void AcceptHandler(const error_code &ec);
+	error::Error CheckPeerCredentials();
 	void ReadHeader();
 	void ReadHeaderHandler(const error_code &ec, size_t num_read);
 	void AsyncReadNextBodyPart(
@@ -697,6 +741,7 @@ private:
 	void WriteBodyHandler(const error_code &ec, size_t num_written);
 	void CallBodyHandler();
 	void FinishReply();
+	void PrepareForNextRequest();
 	error::Error AsyncSwitchProtocol(SwitchProtocolHandler handler);
 	void SwitchingProtocolHandler(error_code ec, size_t num_written);
 #endif // MENDER_USE_BOOST_BEAST
@@ -709,6 +754,8 @@ public:
 
 	Server(Server &&) = default;
 
+	// `url` is either `http://<address>:<port>`, or `unix://<absolute path>` to listen on a
+	// Unix domain socket. An existing socket file at that path is replaced.
 	error::Error AsyncServeUrl(
 		const string &url, RequestHandler header_handler, RequestHandler body_handler);
 	// Same as the above, except that the body handler has the `IncomingRequestPtr` included
@@ -718,6 +765,7 @@ public:
 		const string &url, RequestHandler header_handler, IdentifiedRequestHandler body_handler);
 	void Cancel() override;
 
+	// Zero when listening on a Unix domain socket.
 	uint16_t GetPort() const;
 	// Can differ from the passed in URL if a 0 (random) port number was used.
 	string GetUrl() const;
@@ -740,8 +788,11 @@ public:
 
 private:
 	events::EventLoop &event_loop_;
+	ServerConfig server_config_;
 
 	BrokenDownUrl address_;
+	// Empty unless listening on a Unix domain socket.
+	string unix_socket_path_;
 
 	RequestHandler header_handler_;
 	IdentifiedRequestHandler body_handler_;
@@ -755,12 +806,16 @@ private:
 	friend class TestInspector;
 
 #ifdef MENDER_USE_BOOST_BEAST
-	asio::ip::tcp::acceptor acceptor_;
+	asio::basic_socket_acceptor<asio::generic::stream_protocol> acceptor_;
 
 	unordered_set<StreamPtr> streams_;
 
 	void DoCancel();
 
+	error::Error Listen(const asio::generic::stream_protocol::endpoint &endpoint);
+	error::Error ListenOnUnixSocket(const string &path);
+	bool PeerAllowed(uid_t uid) const;
+
 	void PrepareNewStream();
 	void AsyncAccept(StreamPtr stream);
 	void RemoveStream(StreamPtr stream);
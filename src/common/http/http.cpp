@@ -115,6 +115,18 @@ error::Error BreakDownUrl(const string &url, BrokenDownUrl &address, bool with_a
 		address.path = tmp.substr(split_index);
 	}
 
+	if (address.protocol == "unix") {
+		// The path holds both the socket path and the request path. Where one ends and the
+		// other begins can only be found by looking at the file system, which is left to
+		// whoever connects.
+		if (address.host != "") {
+			address = {};
+			return MakeError(InvalidUrlError, url + ": Unix socket URLs can not have a hostname");
+		}
+		address.port = 0;
+		return error::NoError;
+	}
+
 	auto auth_index = address.host.rfind("@");
 	if (auth_index != string::npos) {
 		if (!with_auth) {
@@ -15,6 +15,13 @@
 #include <common/http.hpp>
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -40,6 +47,19 @@ namespace http = boost::beast::http;
 
 const int HTTP_BEAST_BUFFER_SIZE = MENDER_BUFSIZE;
 
+// Don't reuse connections which have been idle for longer than this. Servers usually close them
+// after a while, and we would rather not find out in the middle of a request.
+const chrono::seconds KeepAliveIdleTimeout {30};
+
+// Generic sockets are used so that both TCP and Unix domain sockets can be used. This recovers
+// the TCP endpoint, with its address and port, from a generic one.
+static tcp::endpoint ToTcpEndpoint(const asio::generic::stream_protocol::endpoint &generic) {
+	tcp::endpoint endpoint;
+	memcpy(endpoint.data(), generic.data(), generic.size());
+	endpoint.resize(generic.size());
+	return endpoint;
+}
+
 static http::verb MethodToBeastVerb(Method method) {
 	switch (method) {
 	case Method::GET:
@@ -211,6 +231,36 @@ public:
 		return error::NoError;
 	}
 
+	error::Error AsyncWriteV(
+		const io::ConstBufferChain &buffers, io::AsyncIoHandler handler) override {
+		write_buffers_.clear();
+		for (const auto &buf : buffers) {
+			if (buf.size() > 0) {
+				write_buffers_.push_back(asio::buffer(&*buf.start, buf.size()));
+			}
+		}
+		auto &destroying = destroying_;
+		stream_->async_write_some(
+			write_buffers_,
+			[destroying, handler](const boost::system::error_code &ec, size_t num_written) {
+				if (*destroying) {
+					return;
+				}
+
+				if (ec == asio::error::operation_aborted) {
+					handler(expected::unexpected(error::Error(
+						make_error_condition(errc::operation_canceled),
+						"Could not write to socket")));
+				} else if (ec) {
+					handler(expected::unexpected(
+						error::Error(ec.default_error_condition(), "Could not write to socket")));
+				} else {
+					handler(num_written);
+				}
+			});
+		return error::NoError;
+	}
+
 	void Cancel() override {
 		if (stream_->lowest_layer().is_open()) {
 			stream_->lowest_layer().cancel();
@@ -244,6 +294,7 @@ private:
 	shared_ptr<beast::flat_buffer> buffered_;
 	asio::mutable_buffer read_buffer_;
 	asio::const_buffer write_buffer_;
+	vector<asio::const_buffer> write_buffers_;
 };
 
 template <typename PARSER>
@@ -370,12 +421,35 @@ error::Error Client::Initialize() {
 // https://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.23
 // In short: Add the port-number if it is non-standard HTTP
 static string CreateHOSTAddress(OutgoingRequestPtr req) {
+	if (req->GetProtocol() == "unix") {
+		// There is no host name, but HTTP/1.1 requires the header anyway.
+		return "localhost";
+	}
 	if (req->GetPort() == 80 || req->GetPort() == 443) {
 		return req->GetHost();
 	}
 	return req->GetHost() + ":" + to_string(req->GetPort());
 }
 
+// Moves the socket path of a `unix://` URL into `host`, leaving the request path in `path`.
+static error::Error FindUnixSocket(BrokenDownUrl &address) {
+	const string path = address.path;
+	for (auto end = path.find('/', 1);; end = path.find('/', end + 1)) {
+		const string socket_path = path.substr(0, end);
+		struct stat path_stat;
+		if (stat(socket_path.c_str(), &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+			address.host = socket_path;
+			address.path = end == string::npos ? "/" : path.substr(end);
+			return error::NoError;
+		}
+		if (end == string::npos) {
+			return error::Error(
+				make_error_condition(errc::no_such_file_or_directory),
+				"No Unix domain socket found in " + path);
+		}
+	}
+}
+
 error::Error Client::AsyncCall(
 	OutgoingRequestPtr req, ResponseHandler header_handler, ResponseHandler body_handler) {
 	auto err = Initialize();
@@ -388,7 +462,9 @@ error::Error Client::AsyncCall(
 			make_error_condition(errc::operation_in_progress), "HTTP call already ongoing");
 	}
 
-	if (req->address_.protocol == "" || req->address_.host == "" || req->address_.port < 0) {
+	if (req->address_.protocol == ""
+		|| (req->address_.host == "" && req->address_.protocol != "unix")
+		|| req->address_.port < 0) {
 		return error::MakeError(error::ProgrammingError, "Request is not ready");
 	}
 
@@ -397,13 +473,25 @@ error::Error Client::AsyncCall(
 			error::ProgrammingError, "header_handler and body_handler can not be nullptr");
 	}
 
-	if (req->address_.protocol != "http" && req->address_.protocol != "https") {
+	if (req->address_.protocol != "http" && req->address_.protocol != "https"
+		&& req->address_.protocol != "unix") {
 		return error::Error(
 			make_error_condition(errc::protocol_not_supported), req->address_.protocol);
 	}
 
+	// Only done once, since the request may be sent again, for example after a redirect.
+	if (req->address_.protocol == "unix" && req->address_.host == "") {
+		err = FindUnixSocket(req->address_);
+		if (err != error::NoError) {
+			return err.WithContext(MethodToString(req->method_) + " " + req->orig_address_);
+		}
+	}
+
 	logger_ = log::Logger(logger_name_).WithFields(log::LogField("url", req->orig_address_));
 
+	// Save it before the proxy setup rewrites it.
+	const auto address = req->address_;
+
 	request_ = req;
 
 	err = HandleProxySetup();
@@ -424,6 +512,53 @@ error::Error Client::AsyncCall(
 
 	cancelled_ = make_shared<bool>(false);
 
+	if (CanReuseConnection(address)) {
+		logger_.Debug("Reusing existing connection");
+		reusing_connection_ = true;
+		auto &cancelled = cancelled_;
+		event_loop_.Post([this, cancelled]() {
+			if (!*cancelled) {
+				WriteRequestHeader();
+			}
+		});
+		return error::NoError;
+	}
+
+	CloseConnection();
+	reusing_connection_ = false;
+	connection_address_ = address;
+
+	if (address.protocol == "unix") {
+		ConnectUnixSocket();
+	} else {
+		Resolve();
+	}
+
+	return error::NoError;
+}
+
+bool Client::CanReuseConnection(const BrokenDownUrl &address) {
+	if (!client_config_.keep_alive || via_proxy_ || !stream_) {
+		return false;
+	}
+
+	if (address.protocol != connection_address_.protocol || address.host != connection_address_.host
+		|| address.port != connection_address_.port) {
+		return false;
+	}
+
+	if (chrono::steady_clock::now() - idle_since_ > KeepAliveIdleTimeout) {
+		return false;
+	}
+
+	// The peer may have closed the connection while it was idle. Then the socket is readable,
+	// either with EOF or with a TLS alert, so only reuse it if there is nothing to read.
+	uint8_t byte;
+	auto ret = ::recv(stream_->lowest_layer().native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void Client::Resolve() {
 	auto &cancelled = cancelled_;
 
 	resolver_.async_resolve(
@@ -435,8 +570,26 @@ error::Error Client::AsyncCall(
 				ResolveHandler(ec, results);
 			}
 		});
+}
 
-	return error::NoError;
+bool Client::ReconnectIfStale() {
+	// The peer can close a reused connection right as we send the request on it. As long as
+	// nothing of the request body has been consumed, it is safe to try once more on a fresh
+	// connection.
+	if (!reusing_connection_) {
+		return false;
+	}
+	reusing_connection_ = false;
+
+	logger_.Debug("Reused connection was closed by the peer, reconnecting");
+
+	*cancelled_ = true;
+	cancelled_ = make_shared<bool>(false);
+	CloseConnection();
+	response_data_.response_buffer_->consume(response_data_.response_buffer_->size());
+
+	Resolve();
+	return true;
 }
 
 static inline error::Error AddProxyAuthHeader(OutgoingRequest &req, BrokenDownUrl &proxy_address) {
@@ -464,11 +617,14 @@ static inline error::Error AddProxyAuthHeader(OutgoingRequest &req, BrokenDownUr
 
 error::Error Client::HandleProxySetup() {
 	secondary_req_.reset();
+	via_proxy_ = false;
 
 	if (request_->address_.protocol == "http") {
 		socket_mode_ = SocketMode::Plain;
 
 		if (http_proxy_ != "" && !HostNameMatchesNoProxy(request_->address_.host, no_proxy_)) {
+			via_proxy_ = true;
+
 			// Make a modified proxy request.
 			BrokenDownUrl proxy_address;
 			auto err = BreakDownUrl(http_proxy_, proxy_address, true);
@@ -505,6 +661,8 @@ error::Error Client::HandleProxySetup() {
 		socket_mode_ = SocketMode::Tls;
 
 		if (https_proxy_ != "" && !HostNameMatchesNoProxy(request_->address_.host, no_proxy_)) {
+			via_proxy_ = true;
+
 			// Save the original request for later, so that we can make a new request
 			// over the channel established by CONNECT.
 			secondary_req_ = std::move(request_);
@@ -541,6 +699,9 @@ error::Error Client::HandleProxySetup() {
 				assert(false);
 			}
 		}
+	} else if (request_->address_.protocol == "unix") {
+		// Proxies are for reaching other hosts, so they never apply here.
+		socket_mode_ = SocketMode::Plain;
 	} else {
 		// Should never get here
 		assert(false);
@@ -582,17 +743,18 @@ io::ExpectedAsyncReadWriterPtr Client::SwitchProtocol(IncomingResponsePtr req) {
 	// This no longer belongs to us.
 	stream_.reset();
 
+	using Socket = asio::generic::stream_protocol::socket;
 	switch (socket_mode_) {
 	case SocketMode::TlsTls:
-		return make_shared<RawSocket<ssl::stream<ssl::stream<tcp::socket>>>>(
+		return make_shared<RawSocket<ssl::stream<ssl::stream<Socket>>>>(
 			stream, response_data_.response_buffer_);
 	case SocketMode::Tls:
-		return make_shared<RawSocket<ssl::stream<tcp::socket>>>(
-			make_shared<ssl::stream<tcp::socket>>(std::move(stream->next_layer())),
+		return make_shared<RawSocket<ssl::stream<Socket>>>(
+			make_shared<ssl::stream<Socket>>(std::move(stream->next_layer())),
 			response_data_.response_buffer_);
 	case SocketMode::Plain:
-		return make_shared<RawSocket<tcp::socket>>(
-			make_shared<tcp::socket>(std::move(stream->next_layer().next_layer())),
+		return make_shared<RawSocket<Socket>>(
+			make_shared<Socket>(std::move(stream->next_layer().next_layer())),
 			response_data_.response_buffer_);
 	}
 
@@ -640,29 +802,22 @@ void Client::ResolveHandler(
 		logger_.Debug("Hostname " + request_->address_.host + " resolved to " + ips);
 	}
 
-	resolver_results_ = results;
-
-	stream_ = make_shared<ssl::stream<ssl::stream<tcp::socket>>>(
-		ssl::stream<tcp::socket>(GetAsioIoContext(event_loop_), ssl_ctx_[0]), ssl_ctx_[1]);
-
-	if (!response_data_.response_buffer_) {
-		// We can reuse this if preexisting.
-		response_data_.response_buffer_ = make_shared<beast::flat_buffer>();
-
-		// This is equivalent to:
-		//   response_data_.response_buffer_.reserve(body_buffer_.size());
-		// but compatible with Boost 1.67.
-		response_data_.response_buffer_->prepare(
-			body_buffer_.size() - response_data_.response_buffer_->size());
+	resolver_results_.clear();
+	for (const auto &r : results) {
+		resolver_results_.push_back(r.endpoint());
 	}
 
+	PrepareStream();
+
 	auto &cancelled = cancelled_;
 
 	asio::async_connect(
 		stream_->lowest_layer(),
 		resolver_results_,
-		[this, cancelled](const error_code &ec, const asio::ip::tcp::endpoint &endpoint) {
+		[this, cancelled](
+			const error_code &ec, const asio::generic::stream_protocol::endpoint &endpoint) {
 			if (!*cancelled) {
+				const string peer = ToTcpEndpoint(endpoint).address().to_string();
 				switch (socket_mode_) {
 				case SocketMode::TlsTls:
 					// Should never happen because we always need to handshake
@@ -675,17 +830,49 @@ void Client::ResolveHandler(
 						request_,
 						header_handler_);
 				case SocketMode::Tls:
-					return HandshakeHandler(stream_->next_layer(), ec, endpoint);
+					return HandshakeHandler(stream_->next_layer(), ec, peer);
 				case SocketMode::Plain:
-					return ConnectHandler(ec, endpoint);
+					return ConnectHandler(ec, peer);
 				}
 			}
 		});
 }
 
+void Client::ConnectUnixSocket() {
+	PrepareStream();
+
+	auto &cancelled = cancelled_;
+	const string path = request_->address_.host;
+
+	stream_->lowest_layer().async_connect(
+		asio::local::stream_protocol::endpoint(path),
+		[this, cancelled, path](const error_code &ec) {
+			if (!*cancelled) {
+				ConnectHandler(ec, path);
+			}
+		});
+}
+
+void Client::PrepareStream() {
+	stream_ = make_shared<ssl::stream<ssl::stream<asio::generic::stream_protocol::socket>>>(
+		ssl::stream<asio::generic::stream_protocol::socket>(
+			GetAsioIoContext(event_loop_), ssl_ctx_[0]),
+		ssl_ctx_[1]);
+
+	if (!response_data_.response_buffer_) {
+		// We can reuse this if preexisting.
+		response_data_.response_buffer_ = make_shared<beast::flat_buffer>();
+
+		// This is equivalent to:
+		//   response_data_.response_buffer_.reserve(body_buffer_.size());
+		// but compatible with Boost 1.67.
+		response_data_.response_buffer_->prepare(
+			body_buffer_.size() - response_data_.response_buffer_->size());
+	}
+}
+
 template <typename StreamType>
-void Client::HandshakeHandler(
-	StreamType &stream, const error_code &ec, const asio::ip::tcp::endpoint &endpoint) {
+void Client::HandshakeHandler(StreamType &stream, const error_code &ec, const string &peer) {
 	if (ec) {
 		CallErrorHandler(ec, request_, header_handler_);
 		return;
@@ -732,7 +919,7 @@ void Client::HandshakeHandler(
 	auto &cancelled = cancelled_;
 
 	stream.async_handshake(
-		ssl::stream_base::client, [this, cancelled, endpoint](const error_code &ec) {
+		ssl::stream_base::client, [this, cancelled, peer](const error_code &ec) {
 			if (*cancelled) {
 				return;
 			}
@@ -742,23 +929,29 @@ void Client::HandshakeHandler(
 				return;
 			}
 			logger_.Debug("https: Successful SSL handshake");
-			ConnectHandler(ec, endpoint);
+			ConnectHandler(ec, peer);
 		});
 }
 
 
-void Client::ConnectHandler(const error_code &ec, const asio::ip::tcp::endpoint &endpoint) {
+void Client::ConnectHandler(const error_code &ec, const string &peer) {
 	if (ec) {
 		CallErrorHandler(ec, request_, header_handler_);
 		return;
 	}
 
-	// Enable TCP keepalive
-	boost::asio::socket_base::keep_alive option(true);
-	stream_->lowest_layer().set_option(option);
+	if (request_->address_.protocol != "unix") {
+		// Enable TCP keepalive
+		boost::asio::socket_base::keep_alive option(true);
+		stream_->lowest_layer().set_option(option);
+	}
+
+	logger_.Debug("Connected to " + peer);
 
-	logger_.Debug("Connected to " + endpoint.address().to_string());
+	WriteRequestHeader();
+}
 
+void Client::WriteRequestHeader() {
 	request_data_.http_request_ = make_shared<http::request<http::buffer_body>>(
 		MethodToBeastVerb(request_->method_), request_->address_.path, BeastHttpVersion);
 
@@ -810,7 +1003,9 @@ void Client::WriteHeaderHandler(const error_code &ec, size_t num_written) {
 	}
 
 	if (ec) {
-		CallErrorHandler(ec, request_, header_handler_);
+		if (!ReconnectIfStale()) {
+			CallErrorHandler(ec, request_, header_handler_);
+		}
 		return;
 	}
 
@@ -825,6 +1020,9 @@ void Client::WriteHeaderHandler(const error_code &ec, size_t num_written) {
 		return;
 	}
 
+	// The body can usually not be generated twice, so from here on we cannot retry.
+	reusing_connection_ = false;
+
 	if (!request_->body_gen_ && !request_->async_body_gen_) {
 		auto err = MakeError(BodyMissingError, "No body generator");
 		CallErrorHandler(err, request_, header_handler_);
@@ -982,9 +1180,12 @@ void Client::ReadHeaderHandler(const error_code &ec, size_t num_read) {
 	}
 
 	if (ec) {
-		CallErrorHandler(ec, request_, header_handler_);
+		if (num_read > 0 || !ReconnectIfStale()) {
+			CallErrorHandler(ec, request_, header_handler_);
+		}
 		return;
 	}
+	reusing_connection_ = false;
 
 	if (!response_data_.http_response_parser_->is_header_done()) {
 		ReadHeader();
@@ -1030,7 +1231,7 @@ void Client::ReadHeaderHandler(const error_code &ec, size_t num_read) {
 			if (response_->status_code_ != StatusCode::StatusSwitchingProtocols) {
 				// Make an exception for 101 Switching Protocols response, where the TCP connection
 				// is meant to be reused.
-				DoCancel();
+				FinishTransaction();
 			}
 			CallHandler(body_handler_);
 		}
@@ -1084,6 +1285,9 @@ void Client::HandleSecondaryRequest() {
 	// a different layer, this will get out of sync.
 	assert(response_data_.response_buffer_->size() == 0);
 
+	const string proxy =
+		ToTcpEndpoint(stream_->lowest_layer().remote_endpoint()).address().to_string();
+
 	switch (socket_mode_) {
 	case SocketMode::TlsTls:
 		// Should never get here, because this is the only place where TlsTls mode
@@ -1099,13 +1303,12 @@ void Client::HandleSecondaryRequest() {
 	case SocketMode::Tls:
 		// Upgrade to TLS inside TLS.
 		socket_mode_ = SocketMode::TlsTls;
-		HandshakeHandler(*stream_, error_code {}, stream_->lowest_layer().remote_endpoint());
+		HandshakeHandler(*stream_, error_code {}, proxy);
 		break;
 	case SocketMode::Plain:
 		// Upgrade to TLS.
 		socket_mode_ = SocketMode::Tls;
-		HandshakeHandler(
-			stream_->next_layer(), error_code {}, stream_->lowest_layer().remote_endpoint());
+		HandshakeHandler(stream_->next_layer(), error_code {}, proxy);
 		break;
 	}
 }
@@ -1123,7 +1326,7 @@ void Client::AsyncReadNextBodyPart(
 		handler(0);
 		if (!*cancelled && status_ == TransactionStatus::BodyReadingFinished) {
 			status_ = TransactionStatus::Done;
-			DoCancel();
+			FinishTransaction();
 			CallHandler(body_handler_);
 		}
 		return;
@@ -1221,6 +1424,12 @@ void Client::ReadBodyHandler(error_code ec, size_t num_read) {
 }
 
 void Client::Cancel() {
+	if (*cancelled_) {
+		// Nothing in progress, but don't keep an idle connection around either.
+		CloseConnection();
+		return;
+	}
+
 	auto cancelled = cancelled_;
 
 	if (!*cancelled) {
@@ -1254,27 +1463,55 @@ void Client::Cancel() {
 
 void Client::DoCancel() {
 	resolver_.cancel();
+	CloseConnection();
+
+	// Reset logger to no connection.
+	logger_ = log::Logger(logger_name_);
+
+	// Set cancel state and then make a new one. Those who are interested should have their own
+	// pointer to the old one.
+	*cancelled_ = true;
+	cancelled_ = make_shared<bool>(true);
+}
+
+void Client::CloseConnection() {
 	if (stream_) {
 		stream_->lowest_layer().cancel();
 		stream_->lowest_layer().close();
 		stream_.reset();
 	}
+}
 
-	// Reset logger to no connection.
-	logger_ = log::Logger(logger_name_);
+void Client::FinishTransaction() {
+	if (!KeepConnectionAlive()) {
+		DoCancel();
+		return;
+	}
 
-	// Set cancel state and then make a new one. Those who are interested should have their own
-	// pointer to the old one.
+	logger_.Debug("Keeping connection open for the next request");
+	idle_since_ = chrono::steady_clock::now();
+
+	// Like `DoCancel()`, except that the connection stays open.
+	logger_ = log::Logger(logger_name_);
 	*cancelled_ = true;
 	cancelled_ = make_shared<bool>(true);
 }
 
+bool Client::KeepConnectionAlive() const {
+	// Any leftover data in the buffer would be mistaken for the next response.
+	return client_config_.keep_alive && !via_proxy_ && stream_
+		   && request_data_.http_request_->keep_alive()
+		   && response_data_.http_response_parser_->keep_alive()
+		   && response_data_.response_buffer_->size() == 0;
+}
+
 Stream::Stream(Server &server) :
 	server_ {server},
 	logger_ {"http"},
 	cancelled_(make_shared<bool>(true)),
 	socket_(server_.GetAsioIoContext(server_.event_loop_)),
-	body_buffer_(HTTP_BEAST_BUFFER_SIZE) {
+	body_buffer_(HTTP_BEAST_BUFFER_SIZE),
+	idle_timer_(server_.GetAsioIoContext(server_.event_loop_)) {
 	request_data_.request_buffer_ = make_shared<beast::flat_buffer>();
 
 	// This is equivalent to:
@@ -1337,6 +1574,8 @@ void Stream::Cancel() {
 }
 
 void Stream::DoCancel() {
+	idle_timer_.cancel();
+
 	if (socket_.is_open()) {
 		socket_.cancel();
 		socket_.close();
@@ -1415,10 +1654,23 @@ void Stream::AcceptHandler(const error_code &ec) {
 		return;
 	}
 
-	auto ip = socket_.remote_endpoint().address().to_string();
+	string ip;
+	if (server_.unix_socket_path_ != "") {
+		auto err = CheckPeerCredentials();
+		if (err != error::NoError) {
+			log::Warning("Rejected HTTP connection: " + err.String());
+			server_.RemoveStream(shared_from_this());
+			return;
+		}
+		// Use socket path as context for logging.
+		ip = server_.unix_socket_path_;
+		logger_ = log::Logger("http_server").WithFields(log::LogField("socket", ip));
+	} else {
+		ip = ToTcpEndpoint(socket_.remote_endpoint()).address().to_string();
 
-	// Use IP as context for logging.
-	logger_ = log::Logger("http_server").WithFields(log::LogField("ip", ip));
+		// Use IP as context for logging.
+		logger_ = log::Logger("http_server").WithFields(log::LogField("ip", ip));
+	}
 
 	logger_.Debug("Accepted connection.");
 
@@ -1431,6 +1683,25 @@ void Stream::AcceptHandler(const error_code &ec) {
 	ReadHeader();
 }
 
+error::Error Stream::CheckPeerCredentials() {
+	struct ucred cred;
+	socklen_t cred_size = sizeof(cred);
+	if (getsockopt(socket_.native_handle(), SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) != 0) {
+		int err = errno;
+		return error::Error(
+			generic_category().default_error_condition(err), "Could not get peer credentials");
+	}
+
+	if (!server_.PeerAllowed(cred.uid)) {
+		return error::Error(
+			make_error_condition(errc::permission_denied),
+			"User ID " + to_string(cred.uid) + " (PID " + to_string(cred.pid)
+				+ ") is not allowed to connect");
+	}
+
+	return error::NoError;
+}
+
 void Stream::ReadHeader() {
 	auto &cancelled = cancelled_;
 	auto &request_data = request_data_;
@@ -1451,6 +1722,18 @@ void Stream::ReadHeaderHandler(const error_code &ec, size_t num_read) {
 		logger_.Trace("Read " + to_string(num_read) + " bytes of header data from stream.");
 	}
 
+	if (ec && idle_ && !request_data_.http_request_parser_->got_some()) {
+		// The client closed a kept-alive connection instead of sending another request.
+		logger_.Debug("Connection closed by client.");
+		DoCancel();
+		server_.RemoveStream(shared_from_this());
+		return;
+	}
+	if (idle_) {
+		idle_timer_.cancel();
+	}
+	idle_ = false;
+
 	if (ec) {
 		CallErrorHandler(ec, request_, server_.header_handler_);
 		return;
@@ -1608,6 +1891,15 @@ void Stream::ReadBodyHandler(error_code ec, size_t num_read) {
 void Stream::AsyncReply(ReplyFinishedHandler reply_finished_handler) {
 	SetupResponse();
 
+	if (server_.server_config_.keep_alive) {
+		// If the request body has not been read completely, we could not find the start of the
+		// next request, so close the connection in that case.
+		keep_alive_ = request_data_.http_request_parser_->is_done()
+					  && request_data_.http_request_parser_->keep_alive()
+					  && response_data_.http_response_->keep_alive();
+		response_data_.http_response_->keep_alive(keep_alive_);
+	}
+
 	reply_finished_handler_ = reply_finished_handler;
 
 	auto &cancelled = cancelled_;
@@ -1751,12 +2043,61 @@ void Stream::WriteBodyHandler(const error_code &ec, size_t num_written) {
 void Stream::FinishReply() {
 	// We are done.
 	status_ = TransactionStatus::Done;
-	DoCancel();
+	if (keep_alive_) {
+		// Detach the finished request, but leave the socket open.
+		*cancelled_ = true;
+		cancelled_ = make_shared<bool>(true);
+	} else {
+		DoCancel();
+	}
 	// Release ownership of Body reader.
 	response_->body_reader_.reset();
 	response_->async_body_reader_.reset();
+
+	auto stream_ref = shared_from_this();
 	reply_finished_handler_(error::NoError);
-	server_.RemoveStream(shared_from_this());
+
+	// The handler may have cancelled the server, which removes all streams.
+	if (keep_alive_ && socket_.is_open() && server_.streams_.count(stream_ref) > 0) {
+		PrepareForNextRequest();
+	} else {
+		server_.RemoveStream(stream_ref);
+	}
+}
+
+void Stream::PrepareForNextRequest() {
+	auto ip = request_->address_.host;
+	logger_.Debug("Waiting for next request on the same connection.");
+
+	response_.reset();
+	maybe_response_.reset();
+	reply_finished_handler_ = nullptr;
+	keep_alive_ = false;
+	idle_ = true;
+	status_ = TransactionStatus::None;
+
+	// Anything left in `request_buffer_` belongs to the next request, so keep it.
+	request_data_.http_request_parser_ = make_shared<http::request_parser<http::buffer_body>>();
+	// See the constructor.
+	request_data_.http_request_parser_->body_limit(numeric_limits<uint64_t>::max());
+
+	*cancelled_ = false;
+	request_.reset(new IncomingRequest(*this, cancelled_));
+	request_->address_.host = ip;
+
+	// Don't let an idle client hold on to the connection forever.
+	auto &cancelled = cancelled_;
+	idle_timer_.expires_after(server_.server_config_.keep_alive_idle_timeout);
+	idle_timer_.async_wait([this, cancelled](const error_code &ec) {
+		if (ec || *cancelled || !idle_ || request_data_.http_request_parser_->got_some()) {
+			return;
+		}
+		logger_.Debug("Closing idle connection.");
+		DoCancel();
+		server_.RemoveStream(shared_from_this());
+	});
+
+	ReadHeader();
 }
 
 error::Error Stream::AsyncSwitchProtocol(SwitchProtocolHandler handler) {
@@ -1790,8 +2131,9 @@ void Stream::SwitchingProtocolHandler(error_code ec, size_t num_written) {
 		return;
 	}
 
-	auto socket = make_shared<RawSocket<tcp::socket>>(
-		make_shared<tcp::socket>(std::move(socket_)), request_data_.request_buffer_);
+	auto socket = make_shared<RawSocket<asio::generic::stream_protocol::socket>>(
+		make_shared<asio::generic::stream_protocol::socket>(std::move(socket_)),
+		request_data_.request_buffer_);
 
 	auto switch_protocol_handler = switch_protocol_handler_;
 
@@ -1825,6 +2167,7 @@ void Stream::CallBodyHandler() {
 
 Server::Server(const ServerConfig &server, events::EventLoop &event_loop) :
 	event_loop_ {event_loop},
+	server_config_ {server},
 	acceptor_(GetAsioIoContext(event_loop_)) {
 }
 
@@ -1846,40 +2189,96 @@ error::Error Server::AsyncServeUrl(
 
 error::Error Server::AsyncServeUrl(
 	const string &url, RequestHandler header_handler, IdentifiedRequestHandler body_handler) {
-	auto err = BreakDownUrl(url, address_);
-	if (error::NoError != err) {
-		return MakeError(InvalidUrlError, "Could not parse URL " + url + ": " + err.String());
-	}
+	const string unix_prefix {"unix://"};
+	error::Error err;
+	if (url.substr(0, unix_prefix.size()) == unix_prefix) {
+		err = ListenOnUnixSocket(url.substr(unix_prefix.size()));
+	} else {
+		err = BreakDownUrl(url, address_);
+		if (error::NoError != err) {
+			return MakeError(InvalidUrlError, "Could not parse URL " + url + ": " + err.String());
+		}
+
+		if (address_.protocol != "http") {
+			return error::Error(
+				make_error_condition(errc::protocol_not_supported), address_.protocol);
+		}
+
+		if (address_.path.size() > 0 && address_.path != "/") {
+			return MakeError(InvalidUrlError, "URLs with paths are not supported when listening.");
+		}
+
+		boost::system::error_code ec;
+		auto address = asio::ip::make_address(address_.host, ec);
+		if (ec) {
+			return error::Error(
+				ec.default_error_condition(),
+				"Could not construct endpoint from address " + address_.host);
+		}
 
-	if (address_.protocol != "http") {
-		return error::Error(make_error_condition(errc::protocol_not_supported), address_.protocol);
+		err = Listen(asio::ip::tcp::endpoint(address, address_.port));
 	}
+	if (err != error::NoError) {
+		return err;
+	}
+
+	header_handler_ = header_handler;
+	body_handler_ = body_handler;
+
+	PrepareNewStream();
 
-	if (address_.path.size() > 0 && address_.path != "/") {
-		return MakeError(InvalidUrlError, "URLs with paths are not supported when listening.");
+	return error::NoError;
+}
+
+error::Error Server::ListenOnUnixSocket(const string &path) {
+	if (path.size() == 0 || path[0] != '/') {
+		return MakeError(InvalidUrlError, "Unix socket path must be absolute: " + path);
 	}
 
-	boost::system::error_code ec;
-	auto address = asio::ip::make_address(address_.host, ec);
-	if (ec) {
+	// A socket file left behind by a previous instance would make bind() fail. Anything else at
+	// the path is not ours to remove, so leave it for bind() to fail on.
+	struct stat path_stat;
+	if (lstat(path.c_str(), &path_stat) == 0) {
+		if (S_ISSOCK(path_stat.st_mode) && unlink(path.c_str()) != 0 && errno != ENOENT) {
+			int err = errno;
+			return error::Error(
+				generic_category().default_error_condition(err),
+				"Could not remove existing socket " + path);
+		}
+	} else if (errno != ENOENT) {
+		int err = errno;
 		return error::Error(
-			ec.default_error_condition(),
-			"Could not construct endpoint from address " + address_.host);
+			generic_category().default_error_condition(err), "Could not inspect " + path);
 	}
 
-	asio::ip::tcp::endpoint endpoint(address, address_.port);
+	address_ = {};
+	address_.protocol = "unix";
+	address_.path = "/";
 
-	ec.clear();
+	auto err = Listen(asio::local::stream_protocol::endpoint(path));
+	if (err != error::NoError) {
+		return err;
+	}
+
+	unix_socket_path_ = path;
+
+	return error::NoError;
+}
+
+error::Error Server::Listen(const asio::generic::stream_protocol::endpoint &endpoint) {
+	boost::system::error_code ec;
 	acceptor_.open(endpoint.protocol(), ec);
 	if (ec) {
 		return error::Error(ec.default_error_condition(), "Could not open acceptor");
 	}
 
-	// Allow address reuse, otherwise we can't re-bind later.
-	ec.clear();
-	acceptor_.set_option(asio::socket_base::reuse_address(true), ec);
-	if (ec) {
-		return error::Error(ec.default_error_condition(), "Could not set socket options");
+	if (endpoint.protocol().family() != AF_UNIX) {
+		// Allow address reuse, otherwise we can't re-bind later.
+		ec.clear();
+		acceptor_.set_option(asio::socket_base::reuse_address(true), ec);
+		if (ec) {
+			return error::Error(ec.default_error_condition(), "Could not set socket options");
+		}
 	}
 
 	ec.clear();
@@ -1888,33 +2287,62 @@ error::Error Server::AsyncServeUrl(
 		return error::Error(ec.default_error_condition(), "Could not bind socket");
 	}
 
+	if (endpoint.protocol().family() == AF_UNIX) {
+		// Only the owner can connect, unless more users were allowed. Those are then vetted
+		// by `Stream::CheckPeerCredentials()` instead. Nobody can connect before `listen()`,
+		// so setting the mode here leaves no window where the socket is more accessible.
+		string path = reinterpret_cast<const sockaddr_un *>(endpoint.data())->sun_path;
+		mode_t mode = server_config_.unix_socket_allowed_uids.empty() ? 0600 : 0666;
+		if (chmod(path.c_str(), mode) != 0) {
+			int err = errno;
+			return error::Error(
+				generic_category().default_error_condition(err),
+				"Could not set permissions of socket " + path);
+		}
+	}
+
 	ec.clear();
 	acceptor_.listen(asio::socket_base::max_listen_connections, ec);
 	if (ec) {
 		return error::Error(ec.default_error_condition(), "Could not start listening");
 	}
 
-	header_handler_ = header_handler;
-	body_handler_ = body_handler;
-
-	PrepareNewStream();
-
 	return error::NoError;
 }
 
+bool Server::PeerAllowed(uid_t uid) const {
+	if (uid == 0 || uid == geteuid()) {
+		return true;
+	}
+	const auto &allowed = server_config_.unix_socket_allowed_uids;
+	return find(allowed.begin(), allowed.end(), uid) != allowed.end();
+}
+
 void Server::Cancel() {
 	if (acceptor_.is_open()) {
 		acceptor_.cancel();
 		acceptor_.close();
 	}
 	streams_.clear();
+
+	if (unix_socket_path_ != "") {
+		unlink(unix_socket_path_.c_str());
+		unix_socket_path_.clear();
+	}
 }
 
 uint16_t Server::GetPort() const {
-	return acceptor_.local_endpoint().port();
+	if (unix_socket_path_ != "") {
+		return 0;
+	}
+
+	return ToTcpEndpoint(acceptor_.local_endpoint()).port();
 }
 
 string Server::GetUrl() const {
+	if (unix_socket_path_ != "") {
+		return "unix://" + unix_socket_path_;
+	}
 	return "http://127.0.0.1:" + to_string(GetPort());
 }
 
@@ -49,12 +49,63 @@ namespace paths {
 extern const string Stdin;
 }
 
+/**
+ * One element of a scatter/gather buffer chain, the equivalent of a `struct iovec`. The memory
+ * is owned by someone else, and needs to stay valid until the operation using it has finished.
+ */
+struct MutableBuffer {
+	MutableBuffer(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) :
+		start {start},
+		end {end} {
+	}
+	MutableBuffer(vector<uint8_t> &vec) :
+		start {vec.begin()},
+		end {vec.end()} {
+	}
+
+	size_t size() const {
+		return end - start;
+	}
+
+	vector<uint8_t>::iterator start;
+	vector<uint8_t>::iterator end;
+};
+using MutableBufferChain = vector<MutableBuffer>;
+
+struct ConstBuffer {
+	ConstBuffer(vector<uint8_t>::const_iterator start, vector<uint8_t>::const_iterator end) :
+		start {start},
+		end {end} {
+	}
+	ConstBuffer(const vector<uint8_t> &vec) :
+		start {vec.cbegin()},
+		end {vec.cend()} {
+	}
+
+	size_t size() const {
+		return end - start;
+	}
+
+	vector<uint8_t>::const_iterator start;
+	vector<uint8_t>::const_iterator end;
+};
+using ConstBufferChain = vector<ConstBuffer>;
+
+size_t BufferChainSize(const MutableBufferChain &chain);
+size_t BufferChainSize(const ConstBufferChain &chain);
+
 class Reader {
 public:
 	virtual ~Reader() {};
 
 	virtual ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) = 0;
 
+	// Scatter read. Fills the buffers in order, and just like `readv()` it may return less than
+	// the size of the whole chain. Zero means EOF. The default implementation calls `Read()` for
+	// each buffer, and stops at the first short read. An error is returned even if some buffers
+	// were filled already, since the caller can't continue reading anyway.
+	virtual ExpectedSize ReadV(const MutableBufferChain &buffers);
+
 	unique_ptr<istream> GetStream();
 };
 using ReaderPtr = shared_ptr<Reader>;
@@ -66,6 +117,12 @@ public:
 
 	virtual ExpectedSize Write(
 		vector<uint8_t>::const_iterator start, vector<uint8_t>::const_iterator end) = 0;
+
+	// Gather write. Writes the buffers in order, and just like `writev()` it may return less
+	// than the size of the whole chain. The default implementation calls `Write()` for each
+	// buffer, and stops at the first short write. An error is returned even if some buffers
+	// were written already.
+	virtual ExpectedSize WriteV(const ConstBufferChain &buffers);
 };
 using WriterPtr = shared_ptr<Writer>;
 using ExpectedWriterPtr = expected::expected<WriterPtr, Error>;
@@ -122,6 +179,13 @@ public:
 		vector<uint8_t>::const_iterator start,
 		vector<uint8_t>::const_iterator end,
 		AsyncIoHandler handler) = 0;
+
+	// Gather version of `AsyncWrite()`. The handler receives the number of bytes written, which,
+	// like for `AsyncWrite()`, may be less than the size of the chain. The chain itself is
+	// copied, only the memory it points to needs to remain valid. The default implementation
+	// issues one `AsyncWrite()` per buffer, and stops at the first short write. Writers on top of
+	// file descriptors and sockets override this to write the whole chain with one system call.
+	virtual error::Error AsyncWriteV(const ConstBufferChain &buffers, AsyncIoHandler handler);
 };
 using AsyncWriterPtr = shared_ptr<AsyncWriter>;
 
@@ -187,6 +251,26 @@ void AsyncCopy(
 	function<void(Error)> finished_handler,
 	int64_t stop_after = numeric_limits<int64_t>::max());
 
+/**
+ * Same as above, but cycles through `buffer_count` buffers, so that the next read can be in
+ * progress while previous blocks are still being written. This keeps both ends busy, which helps
+ * when both of them have high latency, for example when copying from network to flash. There is
+ * never more than one read and one write in progress at the same time, and with a `buffer_count`
+ * of 1 the behavior is the same as `AsyncCopy`, except that short writes are retried.
+ */
+void AsyncCopyMultiBuffer(
+	AsyncWriter &dst,
+	AsyncReader &src,
+	size_t buffer_count,
+	function<void(Error)> finished_handler,
+	int64_t stop_after = numeric_limits<int64_t>::max());
+void AsyncCopyMultiBuffer(
+	AsyncWriterPtr dst,
+	AsyncReaderPtr src,
+	size_t buffer_count,
+	function<void(Error)> finished_handler,
+	int64_t stop_after = numeric_limits<int64_t>::max());
+
 class StreamReader : virtual public Reader {
 protected:
 	shared_ptr<std::istream> is_;
@@ -239,6 +323,73 @@ private:
 	string path_;
 };
 
+/**
+ * A reader which already has its data in memory, and can hand out views of it instead of copying
+ * it into the caller's buffer. Consumers which can make use of this discover it with
+ * `dynamic_cast`, and fall back to `Read()` otherwise.
+ */
+class ZeroCopyReader : virtual public Reader {
+public:
+	struct View {
+		const uint8_t *data;
+		size_t size;
+	};
+	using ExpectedView = expected::expected<View, error::Error>;
+
+	// Returns a view of the next `max_size` bytes at most, and moves past them. The view is
+	// valid until the next call to either `ReadView()` or `Read()`. A size of zero means EOF.
+	virtual ExpectedView ReadView(size_t max_size) = 0;
+};
+
+/**
+ * Reads a regular file through a read-only memory mapping. The kernel is told that access is
+ * sequential, so it can read ahead aggressively, and pages which have been read are given back
+ * as we go, so a large file doesn't push everything else out of the page cache.
+ *
+ * The file must not be modified while it is read. Touching a page of the mapping which is past
+ * the end of the file kills the process with SIGBUS. To avoid one system call per read, the file
+ * size is only checked when a read goes past the range covered by the previous check, which looks
+ * a few MiB ahead. So truncation is only detected at those points, and a file which is truncated
+ * in between will crash the process.
+ */
+class MappedFileReader : virtual public ZeroCopyReader {
+public:
+	~MappedFileReader();
+
+	MappedFileReader(const MappedFileReader &) = delete;
+	MappedFileReader &operator=(const MappedFileReader &) = delete;
+
+	ExpectedSize Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
+	ExpectedView ReadView(size_t max_size) override;
+
+	uint64_t Size() const {
+		return size_;
+	}
+
+private:
+	MappedFileReader() {
+	}
+
+	void ReleaseConsumed();
+
+	int fd_ {-1};
+	uint8_t *map_ {nullptr};
+	size_t size_ {0};
+	size_t offset_ {0};
+	size_t released_ {0};
+	// Everything up to here was inside the file the last time its size was checked.
+	size_t checked_ {0};
+
+	friend expected::expected<shared_ptr<MappedFileReader>, error::Error> OpenMappedFile(
+		const string &path);
+};
+using MappedFileReaderPtr = shared_ptr<MappedFileReader>;
+using ExpectedMappedFileReaderPtr = expected::expected<MappedFileReaderPtr, error::Error>;
+
+// Fails if the file can't be mapped, for example if it is not a regular file, in which case the
+// caller should fall back to a stream based reader.
+ExpectedMappedFileReaderPtr OpenMappedFile(const string &path);
+
 /* Discards all data written to it */
 class Discard : virtual public Writer {
 	ExpectedSize Write(
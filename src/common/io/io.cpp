@@ -19,6 +19,7 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <istream>
 #include <memory>
 #include <streambuf>
@@ -61,6 +62,106 @@ void AsyncReader::RepeatedAsyncRead(
 	func.ScheduleNextRead(Repeat::Yes);
 }
 
+size_t BufferChainSize(const MutableBufferChain &chain) {
+	size_t total = 0;
+	for (const auto &buf : chain) {
+		total += buf.size();
+	}
+	return total;
+}
+
+size_t BufferChainSize(const ConstBufferChain &chain) {
+	size_t total = 0;
+	for (const auto &buf : chain) {
+		total += buf.size();
+	}
+	return total;
+}
+
+ExpectedSize Reader::ReadV(const MutableBufferChain &buffers) {
+	size_t total = 0;
+	for (const auto &buf : buffers) {
+		if (buf.size() == 0) {
+			continue;
+		}
+		auto result = Read(buf.start, buf.end);
+		if (!result) {
+			return result;
+		}
+		total += result.value();
+		if (result.value() < buf.size()) {
+			break;
+		}
+	}
+	return total;
+}
+
+ExpectedSize Writer::WriteV(const ConstBufferChain &buffers) {
+	size_t total = 0;
+	for (const auto &buf : buffers) {
+		if (buf.size() == 0) {
+			continue;
+		}
+		auto result = Write(buf.start, buf.end);
+		if (!result) {
+			return result;
+		}
+		total += result.value();
+		if (result.value() < buf.size()) {
+			break;
+		}
+	}
+	return total;
+}
+
+error::Error AsyncWriter::AsyncWriteV(const ConstBufferChain &buffers, AsyncIoHandler handler) {
+	if (buffers.empty()) {
+		return error::Error(
+			make_error_condition(errc::invalid_argument), "AsyncWriteV: Empty buffer chain");
+	}
+
+	class Functor {
+	public:
+		AsyncWriter &writer;
+		shared_ptr<ConstBufferChain> buffers;
+		size_t index;
+		size_t written;
+		AsyncIoHandler handler;
+
+		error::Error WriteNext() {
+			// Skip empty buffers, but always do at least one write, so that a chain with only
+			// empty buffers still completes asynchronously, like an empty `AsyncWrite()` does.
+			while (index + 1 < buffers->size() && (*buffers)[index].size() == 0) {
+				index++;
+			}
+			const auto &buf = (*buffers)[index];
+			return writer.AsyncWrite(buf.start, buf.end, *this);
+		}
+
+		void operator()(ExpectedSize result) {
+			if (!result) {
+				handler(result);
+				return;
+			}
+
+			written += result.value();
+			if (result.value() < (*buffers)[index].size() || index + 1 >= buffers->size()) {
+				handler(written);
+				return;
+			}
+
+			index++;
+			auto err = WriteNext();
+			if (err != error::NoError) {
+				handler(expected::unexpected(err));
+			}
+		}
+	};
+
+	Functor func {*this, make_shared<ConstBufferChain>(buffers), 0, 0, handler};
+	return func.WriteNext();
+}
+
 Error Copy(Writer &dst, Reader &src) {
 	vector<uint8_t> buffer(MENDER_BUFSIZE);
 	return Copy(dst, src, buffer);
@@ -370,6 +471,213 @@ void AsyncCopy(
 	}
 }
 
+class AsyncMultiBufferCopier : public enable_shared_from_this<AsyncMultiBufferCopier> {
+public:
+	AsyncMultiBufferCopier(
+		AsyncWriterPtr writer,
+		AsyncReaderPtr reader,
+		size_t buffer_count,
+		function<void(Error)> finished_handler,
+		int64_t limit) :
+		writer_ {writer},
+		reader_ {reader},
+		buffers_(buffer_count, vector<uint8_t>(MENDER_BUFSIZE)),
+		finished_handler_ {finished_handler},
+		limit_ {limit} {
+		for (size_t i = 0; i < buffer_count; i++) {
+			free_.push_back(i);
+		}
+	}
+
+	void Start() {
+		Continue();
+	}
+
+private:
+	struct Block {
+		size_t index;
+		size_t offset;
+		size_t size;
+	};
+
+	void Continue() {
+		if (finished_) {
+			return;
+		}
+
+		if (!writing_ && !filled_.empty()) {
+			StartWrite();
+		}
+
+		if (!reading_ && !eof_ && !free_.empty() && !finished_) {
+			StartRead();
+		}
+
+		if (eof_ && !reading_ && !writing_ && filled_.empty()) {
+			Finish(error::NoError);
+		}
+	}
+
+	void StartRead() {
+		size_t to_copy = static_cast<size_t>(
+			min(limit_ - read_total_, static_cast<int64_t>(MENDER_BUFSIZE)));
+		if (to_copy == 0) {
+			eof_ = true;
+			return;
+		}
+
+		auto index = free_.front();
+		free_.pop_front();
+		auto &buf = buffers_[index];
+
+		reading_ = true;
+		auto self = shared_from_this();
+		auto err = reader_->AsyncRead(
+			buf.begin(), buf.begin() + to_copy, [self, index](ExpectedSize exp_size) {
+				self->ReadHandler(index, exp_size);
+			});
+		if (err != error::NoError) {
+			reading_ = false;
+			Finish(err);
+		}
+	}
+
+	void ReadHandler(size_t index, ExpectedSize exp_size) {
+		reading_ = false;
+		if (finished_) {
+			return;
+		}
+		if (!exp_size) {
+			Finish(exp_size.error());
+			return;
+		}
+
+		if (exp_size.value() == 0) {
+			eof_ = true;
+			free_.push_back(index);
+		} else {
+			read_total_ += exp_size.value();
+			filled_.push_back(Block {index, 0, exp_size.value()});
+		}
+		Continue();
+	}
+
+	void StartWrite() {
+		auto &block = filled_.front();
+		auto &buf = buffers_[block.index];
+
+		writing_ = true;
+		auto self = shared_from_this();
+		auto err = writer_->AsyncWrite(
+			buf.cbegin() + block.offset,
+			buf.cbegin() + block.offset + block.size,
+			[self](ExpectedSize exp_size) { self->WriteHandler(exp_size); });
+		if (err != error::NoError) {
+			writing_ = false;
+			Finish(err);
+		}
+	}
+
+	void WriteHandler(ExpectedSize exp_size) {
+		writing_ = false;
+		if (finished_) {
+			return;
+		}
+		if (!exp_size) {
+			Finish(exp_size.error());
+			return;
+		}
+
+		auto &block = filled_.front();
+		if (exp_size.value() == 0 || exp_size.value() > block.size) {
+			Finish(error::Error(
+				make_error_condition(errc::io_error),
+				"Unexpected number of written bytes in AsyncCopyMultiBuffer"));
+			return;
+		}
+
+		block.offset += exp_size.value();
+		block.size -= exp_size.value();
+		if (block.size == 0) {
+			// Whole block written, the buffer can be reused for reading.
+			free_.push_back(block.index);
+			filled_.pop_front();
+		}
+		Continue();
+	}
+
+	void Finish(const error::Error &err) {
+		if (finished_) {
+			return;
+		}
+		finished_ = true;
+
+		// The other direction may still have an operation in flight. The buffers stay alive
+		// until its handler has been called, since it holds a reference to us.
+		if (reading_) {
+			reader_->Cancel();
+		}
+		if (writing_) {
+			writer_->Cancel();
+		}
+
+		// Don't keep references to the reader and writer after we're done, like the
+		// functors above.
+		auto handler = finished_handler_;
+		finished_handler_ = nullptr;
+		writer_.reset();
+		reader_.reset();
+		handler(err);
+	}
+
+	AsyncWriterPtr writer_;
+	AsyncReaderPtr reader_;
+	vector<vector<uint8_t>> buffers_;
+	function<void(Error)> finished_handler_;
+
+	deque<size_t> free_;
+	deque<Block> filled_;
+
+	int64_t read_total_ {0};
+	int64_t limit_;
+
+	bool reading_ {false};
+	bool writing_ {false};
+	bool eof_ {false};
+	bool finished_ {false};
+};
+
+void AsyncCopyMultiBuffer(
+	AsyncWriter &dst,
+	AsyncReader &src,
+	size_t buffer_count,
+	function<void(Error)> finished_handler,
+	int64_t stop_after) {
+	AsyncCopyMultiBuffer(
+		AsyncWriterPtr(&dst, [](AsyncWriter *) {}),
+		AsyncReaderPtr(&src, [](AsyncReader *) {}),
+		buffer_count,
+		finished_handler,
+		stop_after);
+}
+
+void AsyncCopyMultiBuffer(
+	AsyncWriterPtr dst,
+	AsyncReaderPtr src,
+	size_t buffer_count,
+	function<void(Error)> finished_handler,
+	int64_t stop_after) {
+	if (buffer_count == 0) {
+		finished_handler(error::MakeError(
+			error::ProgrammingError, "AsyncCopyMultiBuffer needs at least one buffer"));
+		return;
+	}
+
+	auto copier = make_shared<AsyncMultiBufferCopier>(
+		dst, src, buffer_count, finished_handler, stop_after);
+	copier->Start();
+}
+
 ExpectedSize ByteReader::Read(vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
 	assert(end > start);
 	Vsize max_read {emitter_->size() - bytes_read_};
@@ -14,6 +14,13 @@
 
 #include <common/io.hpp>
 
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace mender {
 namespace common {
 namespace io {
@@ -22,6 +29,131 @@ namespace paths {
 const string Stdin = "/dev/stdin";
 
 } // namespace paths
+
+// Pages behind the read position are given back in chunks of at least this size, so that we
+// don't make two system calls for every small read.
+const size_t kMappedReleaseThreshold = 1024 * 1024;
+
+// The file size is checked again only when a read goes past the range covered by the last check,
+// which is extended by this much each time.
+const size_t kMappedCheckWindow = 4 * 1024 * 1024;
+
+static error::Error ErrnoError(int err, const string &msg) {
+	return error::Error(generic_category().default_error_condition(err), msg);
+}
+
+ExpectedMappedFileReaderPtr OpenMappedFile(const string &path) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot open " + path));
+	}
+
+	// From here on the reader owns the descriptor and closes it on the error paths.
+	MappedFileReaderPtr reader(new MappedFileReader);
+	reader->fd_ = fd;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot stat " + path));
+	}
+	if (!S_ISREG(st.st_mode)) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::not_supported),
+			"Cannot map " + path + ": Not a regular file"));
+	}
+	if (static_cast<uint64_t>(st.st_size) > numeric_limits<size_t>::max()) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::value_too_large),
+			"Cannot map " + path + ": Too large for the address space"));
+	}
+	reader->size_ = static_cast<size_t>(st.st_size);
+
+	if (reader->size_ == 0) {
+		// mmap doesn't accept empty mappings, but there is nothing to read anyway.
+		return reader;
+	}
+
+	void *map = mmap(nullptr, reader->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot map " + path));
+	}
+	reader->map_ = static_cast<uint8_t *>(map);
+
+	// Both are only hints, so errors don't matter.
+	madvise(map, reader->size_, MADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	return reader;
+}
+
+MappedFileReader::~MappedFileReader() {
+	if (map_ != nullptr) {
+		munmap(map_, size_);
+	}
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+}
+
+ExpectedSize MappedFileReader::Read(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
+	auto view = ReadView(end - start);
+	if (!view) {
+		return expected::unexpected(view.error());
+	}
+	copy_n(view.value().data, view.value().size, start);
+	return view.value().size;
+}
+
+MappedFileReader::ExpectedView MappedFileReader::ReadView(size_t max_size) {
+	// The previous view is no longer in use, so everything up to here can go.
+	ReleaseConsumed();
+
+	size_t to_read = min(max_size, size_ - offset_);
+	size_t end = offset_ + to_read;
+	if (end > checked_) {
+		// Touching the mapping past the end of the file raises SIGBUS, so make sure that it
+		// hasn't been truncated. This is only done once per window, not for every view, so a
+		// truncation which happens after the check is not caught, which is why the file must
+		// not be modified while it is read.
+		struct stat st;
+		if (fstat(fd_, &st) != 0) {
+			int err = errno;
+			return expected::unexpected(ErrnoError(err, "Cannot stat mapped file"));
+		}
+		auto file_size = static_cast<uint64_t>(st.st_size);
+		if (file_size < end) {
+			return expected::unexpected(error::Error(
+				make_error_condition(errc::io_error), "Mapped file was truncated while reading"));
+		}
+		checked_ = static_cast<size_t>(
+			min<uint64_t>(min<uint64_t>(size_, file_size), end + kMappedCheckWindow));
+	}
+
+	View view {map_ + offset_, to_read};
+	offset_ += to_read;
+	return view;
+}
+
+void MappedFileReader::ReleaseConsumed() {
+	auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t release_end = offset_ - offset_ % page_size;
+	if (release_end - released_ < kMappedReleaseThreshold) {
+		return;
+	}
+
+	size_t length = release_end - released_;
+	// Drop them from our mapping, and then from the page cache, since we are never going to read
+	// them again. Again these are only hints.
+	madvise(map_ + released_, length, MADV_DONTNEED);
+	posix_fadvise(
+		fd_, static_cast<off_t>(released_), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+	released_ = release_end;
+}
+
 } // namespace io
 } // namespace common
 } // namespace mender
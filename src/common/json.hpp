@@ -17,6 +17,8 @@
 
 #include <common/config.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <unordered_map>
@@ -177,6 +179,7 @@ public:
 
 	friend ExpectedJson LoadFromFile(string file_path);
 	friend ExpectedJson Load(string json_str);
+	friend ExpectedJson Load(const uint8_t *data, size_t size);
 	friend ExpectedJson Load(istream &str);
 	friend ExpectedJson Load(io::Reader &reader);
 
@@ -194,6 +197,8 @@ using ExpectedChildrenMap = expected::expected<ChildrenMap, error::Error>;
 
 ExpectedJson LoadFromFile(string file_path);
 ExpectedJson Load(string json_str);
+// Parses the JSON in place, without copying it into a string first.
+ExpectedJson Load(const uint8_t *data, size_t size);
 ExpectedJson Load(istream &str);
 ExpectedJson Load(io::Reader &reader);
 
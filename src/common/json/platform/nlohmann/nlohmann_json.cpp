@@ -91,6 +91,17 @@ ExpectedJson Load(string json_str) {
 	}
 }
 
+ExpectedJson Load(const uint8_t *data, size_t size) {
+	try {
+		insensitive_json parsed = insensitive_json::parse(data, data + size);
+		Json j = Json(parsed);
+		return ExpectedJson(j);
+	} catch (exception &e) {
+		return expected::unexpected(GetErrorFromException(
+			e, "Failed to parse '" + string(reinterpret_cast<const char *>(data), size) + "'"));
+	}
+}
+
 ExpectedJson Load(istream &str) {
 	try {
 		insensitive_json parsed = insensitive_json::parse(str);
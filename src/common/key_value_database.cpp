@@ -48,14 +48,25 @@ Error MakeError(ErrorCode code, const string &msg) {
 	return Error(error_condition(code, KeyValueDatabaseErrorCategory), msg);
 }
 
-Error ReadString(Transaction &txn, const string &key, string &value_str, bool missing_ok) {
-	auto ex_bytes = txn.Read(key);
+Error Transaction::ReadView(
+	const string &key, function<Error(const uint8_t *data, size_t size)> func) {
+	auto ex_bytes = Read(key);
 	if (!ex_bytes) {
-		if (!missing_ok || (ex_bytes.error().code != MakeError(KeyError, "").code)) {
-			return ex_bytes.error();
+		return ex_bytes.error();
+	}
+	auto &bytes = ex_bytes.value();
+	return func(bytes.data(), bytes.size());
+}
+
+Error ReadString(Transaction &txn, const string &key, string &value_str, bool missing_ok) {
+	auto err = txn.ReadView(key, [&value_str](const uint8_t *data, size_t size) {
+		value_str.assign(reinterpret_cast<const char *>(data), size);
+		return error::NoError;
+	});
+	if (err != error::NoError) {
+		if (!missing_ok || (err.code != MakeError(KeyError, "").code)) {
+			return err;
 		}
-	} else {
-		value_str = common::StringFromByteVector(ex_bytes.value());
 	}
 	return error::NoError;
 }
@@ -18,6 +18,8 @@
 #include <common/config.h>
 
 #include <functional>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -60,6 +62,10 @@ public:
 	virtual ~Transaction() {};
 
 	virtual ExpectedBytes Read(const string &key) = 0;
+	// Calls `func` with the bytes of the value, which must not be used after `func` returns.
+	// Unlike `Read()`, this lets the backend hand out the value without copying it.
+	virtual Error ReadView(
+		const string &key, function<Error(const uint8_t *data, size_t size)> func);
 	virtual Error Write(const string &key, const vector<uint8_t> &value) = 0;
 	virtual Error Remove(const string &key) = 0;
 };
@@ -36,6 +36,10 @@ public:
 	LmdbTransaction(lmdb::txn &txn, lmdb::dbi &dbi);
 
 	expected::ExpectedBytes Read(const string &key) override;
+	// The data points straight into the memory map, and is valid for as long as the transaction
+	// is, unless the key is written or removed in the meantime.
+	error::Error ReadView(
+		const string &key, function<error::Error(const uint8_t *data, size_t size)> func) override;
 	error::Error Write(const string &key, const vector<uint8_t> &value) override;
 	error::Error Remove(const string &key) override;
 
@@ -64,6 +68,21 @@ expected::ExpectedBytes LmdbTransaction::Read(const string &key) {
 	}
 }
 
+error::Error LmdbTransaction::ReadView(
+	const string &key, function<error::Error(const uint8_t *data, size_t size)> func) {
+	std::string_view value;
+	try {
+		bool exists = dbi_.get(txn_, key, value);
+		if (!exists) {
+			return MakeError(KeyError, "Key " + key + " not found in database");
+		}
+	} catch (std::runtime_error &e) {
+		return MakeError(LmdbError, e.what());
+	}
+
+	return func(reinterpret_cast<const uint8_t *>(value.data()), value.size());
+}
+
 error::Error LmdbTransaction::Write(const string &key, const vector<uint8_t> &value) {
 	try {
 		string_view data(reinterpret_cast<const char *>(value.data()), value.size());
@@ -96,28 +115,42 @@ KeyValueDatabaseLmdb::~KeyValueDatabaseLmdb() {
 	Close();
 }
 
-error::Error KeyValueDatabaseLmdb::Open(const string &path) {
-	return OpenInternal(path, true);
+error::Error KeyValueDatabaseLmdb::Open(const string &path, Durability durability) {
+	return OpenInternal(path, durability, true);
 }
 
-error::Error KeyValueDatabaseLmdb::OpenInternal(const string &path, bool try_recovery) {
+error::Error KeyValueDatabaseLmdb::OpenInternal(
+	const string &path, Durability durability, bool try_recovery) {
 	Close();
 
 	env_ = make_unique<lmdb::env>(lmdb::env::create());
+	durability_ = durability;
+
+	unsigned int flags = MDB_NOSUBDIR;
+	switch (durability) {
+	case Durability::Full:
+		break;
+	case Durability::NoMetaSync:
+		flags |= MDB_NOMETASYNC;
+		break;
+	case Durability::NoSync:
+		flags |= MDB_NOSYNC;
+		break;
+	}
 
 	try {
-		env_->open(path.c_str(), MDB_NOSUBDIR, 0600);
+		env_->open(path.c_str(), flags, 0600);
 	} catch (std::runtime_error &e) {
 		auto err {MakeError(LmdbError, e.what()).WithContext("Opening LMDB database failed")};
+		// Never opened, so there is nothing to close.
+		env_.reset();
 
 		if (not try_recovery) {
-			env_.reset();
 			return err;
 		}
 
 		try {
 			if (not fs::exists(path)) {
-				env_.reset();
 				return err;
 			}
 
@@ -127,17 +160,15 @@ error::Error KeyValueDatabaseLmdb::OpenInternal(const string &path, bool try_rec
 
 			fs::rename(path, path + kBrokenSuffix);
 
-			auto err2 = OpenInternal(path, false);
+			auto err2 = OpenInternal(path, durability, false);
 			if (err2 != error::NoError) {
 				return err.FollowedBy(err2);
 			}
 			return error::NoError;
 		} catch (fs::filesystem_error &e) {
-			env_.reset();
 			return err.FollowedBy(error::Error(e.code().default_error_condition(), e.what())
 									  .WithContext("Opening LMDB database failed"));
 		} catch (std::runtime_error &e) {
-			env_.reset();
 			return err.FollowedBy(error::MakeError(error::GenericError, e.what())
 									  .WithContext("Opening LMDB database failed"));
 		}
@@ -146,7 +177,30 @@ error::Error KeyValueDatabaseLmdb::OpenInternal(const string &path, bool try_rec
 	return error::NoError;
 }
 
+error::Error KeyValueDatabaseLmdb::Sync() {
+	AssertOrReturnError(env_);
+
+	if (durability_ == Durability::Full) {
+		// Everything was flushed on commit already.
+		return error::NoError;
+	}
+
+	try {
+		env_->sync(true);
+		return error::NoError;
+	} catch (std::runtime_error &e) {
+		return MakeError(LmdbError, e.what()).WithContext("Could not sync LMDB database");
+	}
+}
+
 void KeyValueDatabaseLmdb::Close() {
+	if (env_ && durability_ != Durability::Full) {
+		// LMDB doesn't flush on close by itself.
+		auto err = Sync();
+		if (err != error::NoError) {
+			log::Error(err.String());
+		}
+	}
 	env_.reset();
 }
 
@@ -168,6 +222,12 @@ expected::ExpectedBytes KeyValueDatabaseLmdb::Read(const string &key) {
 	}
 }
 
+error::Error KeyValueDatabaseLmdb::ReadView(
+	const string &key, function<error::Error(const uint8_t *data, size_t size)> func) {
+	return ReadTransaction(
+		[&key, &func](Transaction &txn) -> error::Error { return txn.ReadView(key, func); });
+}
+
 error::Error KeyValueDatabaseLmdb::Write(const string &key, const vector<uint8_t> &value) {
 	return WriteTransaction(
 		[&key, &value](Transaction &txn) -> error::Error { return txn.Write(key, value); });
@@ -33,6 +33,21 @@ namespace key_value_database {
 namespace error = mender::common::error;
 namespace expected = mender::common::expected;
 
+// How much of the durability of each committed write transaction LMDB guarantees. Anything less
+// than `Full` means that the most recent transactions may be lost after a power failure, until
+// `Sync()` is called or the database is closed, but the database is never corrupted (except with
+// `NoSync` on filesystems which don't preserve write order). This makes it possible to group
+// several commits under one flush.
+enum class Durability {
+	// Flush data and metadata on every commit (the LMDB default).
+	Full,
+	// Flush data on every commit, but metadata only on the next commit or `Sync()`. A crash may
+	// lose the last transaction.
+	NoMetaSync,
+	// Don't flush at all on commit; leave it to `Sync()` and `Close()`.
+	NoSync,
+};
+
 // Note: Using one instance of KeyValueDatabaseLmdb in multiple threads is not
 // safe, but using separate instances to access the same database is safe.
 class KeyValueDatabaseLmdb : public KeyValueDatabase {
@@ -40,19 +55,25 @@ public:
 	KeyValueDatabaseLmdb();
 	~KeyValueDatabaseLmdb();
 
-	error::Error Open(const string &path);
+	error::Error Open(const string &path, Durability durability = Durability::Full);
+	// Flushes all committed transactions to disk. Only needed when the database was opened with
+	// a durability other than `Full`.
+	error::Error Sync();
 	void Close();
 
 	expected::ExpectedBytes Read(const string &key) override;
+	error::Error ReadView(
+		const string &key, function<error::Error(const uint8_t *data, size_t size)> func) override;
 	error::Error Write(const string &key, const vector<uint8_t> &value) override;
 	error::Error Remove(const string &key) override;
 	error::Error WriteTransaction(function<error::Error(Transaction &)> txnFunc) override;
 	error::Error ReadTransaction(function<error::Error(Transaction &)> txnFunc) override;
 
 private:
-	error::Error OpenInternal(const string &path, bool try_recovery);
+	error::Error OpenInternal(const string &path, Durability durability, bool try_recovery);
 
 	unique_ptr<lmdb::env> env_;
+	Durability durability_ {Durability::Full};
 };
 
 } // namespace key_value_database
@@ -87,6 +87,9 @@ error::Error CreateDirectory(const string &path);
 error::Error CreateDirectories(const string &dir);
 
 error::Error DataSyncRecursively(const string &dir);
+// Syncs a single file or directory. Sync the directory as well after creating or renaming a file
+// in it, to make sure that the change itself survives a crash.
+error::Error DataSync(const string &path);
 
 error::Error Rename(const string &oldname, const string &newname);
 error::Error FileCopy(const string &what, const string &where);
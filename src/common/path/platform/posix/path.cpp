@@ -15,6 +15,7 @@
 #include <common/path.hpp>
 
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <cerrno>
 #include <filesystem>
@@ -95,6 +96,30 @@ error::Error DataSyncRecursively(const string &dir) {
 	return error::NoError;
 }
 
+error::Error DataSync(const string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return error::Error(
+			generic_category().default_error_condition(errno),
+			"Could not open path to sync: " + path);
+	}
+
+	unique_ptr<int, void (*)(int *)> fd_closer(&fd, [](int *fd) {
+		if (*fd >= 0) {
+			close(*fd);
+		}
+	});
+
+	// Full `fsync()`, for directories the entries are what we are after.
+	int result = fsync(fd);
+	if (result != 0) {
+		return error::Error(
+			generic_category().default_error_condition(errno), "Could not sync path: " + path);
+	}
+
+	return error::NoError;
+}
+
 } // namespace path
 } // namespace common
 } // namespace mender
@@ -15,7 +15,9 @@
 #ifndef MENDER_AUTH_API_AUTH_HPP
 #define MENDER_AUTH_API_AUTH_HPP
 
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -62,13 +64,53 @@ error::Error MakeError(AuthClientErrorCode code, const string &msg);
 using APIResponse = mender::api::auth::ExpectedAuthData;
 using APIResponseHandler = function<void(APIResponse)>;
 
+// Identity data from the script is reused for up to `identity_data_max_age`, see
+// `identity_parser::GetCachedIdentityData()`.
 error::Error FetchJWTToken(
 	mender::common::http::Client &client,
 	const vector<string> &servers,
 	const crypto::Args &args,
 	const string &device_identity_script_path,
 	APIResponseHandler api_handler,
-	const string &tenant_token = "");
+	const string &tenant_token = "",
+	chrono::seconds identity_data_max_age = chrono::seconds {0});
+
+struct ParallelAuth;
+using ParallelAuthPtr = shared_ptr<ParallelAuth>;
+
+// Like `FetchJWTToken()`, but instead of waiting for each server to fail before trying the next
+// one, the next server is tried after `stagger` even if the previous ones haven't answered yet. A
+// failure starts the next server immediately. The first successful response wins, and the
+// remaining requests are cancelled. Every server gets its own HTTP client, since a client can
+// only handle one request at a time.
+class ParallelAuthClient {
+public:
+	ParallelAuthClient(
+		events::EventLoop &loop,
+		const http::ClientConfig &client_config,
+		chrono::milliseconds stagger);
+	~ParallelAuthClient();
+
+	ParallelAuthClient(const ParallelAuthClient &) = delete;
+	ParallelAuthClient &operator=(const ParallelAuthClient &) = delete;
+
+	error::Error FetchJWTToken(
+		const vector<string> &servers,
+		const crypto::Args &args,
+		const string &device_identity_script_path,
+		APIResponseHandler api_handler,
+		const string &tenant_token = "",
+		chrono::seconds identity_data_max_age = chrono::seconds {0});
+
+	// Cancels all outstanding requests. The handler is not called.
+	void Cancel();
+
+private:
+	events::EventLoop &loop_;
+	http::ClientConfig client_config_;
+	chrono::milliseconds stagger_;
+	ParallelAuthPtr auth_;
+};
 
 #ifdef MENDER_EMBED_MENDER_AUTH
 class AuthenticatorHttp : public mender::api::auth::Authenticator {
@@ -79,13 +121,24 @@ public:
 		chrono::seconds auth_timeout = chrono::minutes {1}) :
 		Authenticator {loop, auth_timeout},
 		config_ {config},
-		client_ {config.GetHttpClientConfig(), loop} {
+		client_ {config.GetHttpClientConfig(), loop},
+		parallel_client_ {
+			loop,
+			config.GetHttpClientConfig(),
+			chrono::milliseconds {config.parallel_authentication_stagger_milliseconds}},
+		token_refresh_timer_ {loop} {
 	}
 
 	void SetCryptoArgs(const crypto::Args &args) {
 		crypto_args_ = args;
 	}
 
+	// The token is kept in this process, so when we have one, it is handed out directly instead
+	// of going through `GetJwtToken()` and `HandleReceivedToken()`. This also keeps handing out
+	// the current token while a new one is fetched ahead of its expiry.
+	error::Error WithToken(mender::api::auth::AuthenticatedAction action) override;
+	void ExpireToken() override;
+
 protected:
 	error::Error StartWatchingTokenSignal() override;
 	error::Error GetJwtToken() override;
@@ -94,12 +147,18 @@ protected:
 private:
 	void FetchJwtTokenHandler(APIResponse resp);
 
+	// Fetches a new token in the background shortly before the current one expires. The
+	// current token is handed out by `WithToken()` until the new one arrives.
+	void ScheduleTokenRefresh();
+
 	const conf::MenderConfig &config_;
 	http::Client client_;
+	ParallelAuthClient parallel_client_;
 	crypto::Args crypto_args_;
 
 	string token_;
 	string server_url_;
+	events::Timer token_refresh_timer_;
 };
 #endif
 
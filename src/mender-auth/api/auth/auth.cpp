@@ -77,25 +77,21 @@ error::Error MakeHTTPResponseError(
 			+ ")");
 }
 
-static void TryAuthenticate(
-	vector<string>::const_iterator server_it,
-	vector<string>::const_iterator end,
-	mender::common::http::Client &client,
-	const string request_body,
-	const string signature,
-	APIResponseHandler api_handler);
+struct AuthRequest {
+	string body;
+	string signature;
+};
+using ExpectedAuthRequest = expected::expected<AuthRequest, error::Error>;
 
-error::Error FetchJWTToken(
-	mender::common::http::Client &client,
-	const vector<string> &servers,
+static ExpectedAuthRequest MakeAuthRequest(
 	const crypto::Args &crypto_args,
 	const string &device_identity_script_path,
-	APIResponseHandler api_handler,
-	const string &tenant_token) {
+	const string &tenant_token,
+	chrono::seconds identity_data_max_age) {
 	key_value_parser::ExpectedKeyValuesMap expected_identity_data =
-		identity_parser::GetIdentityData(device_identity_script_path);
+		identity_parser::GetCachedIdentityData(device_identity_script_path, identity_data_max_age);
 	if (!expected_identity_data) {
-		return expected_identity_data.error();
+		return expected::unexpected(expected_identity_data.error());
 	}
 
 	auto identity_data_json = identity_parser::DumpIdentityData(expected_identity_data.value());
@@ -112,68 +108,54 @@ error::Error FetchJWTToken(
 
 	auto expected_public_key = crypto::ExtractPublicKey(crypto_args);
 	if (!expected_public_key) {
-		return expected_public_key.error();
+		return expected::unexpected(expected_public_key.error());
 	}
 	request_body_map.insert({"pubkey", expected_public_key.value()});
 
 	auto expected_request_body = json::Dump(request_body_map);
 	if (!expected_request_body) {
-		return expected_request_body.error();
+		return expected::unexpected(expected_request_body.error());
 	}
 	auto request_body = expected_request_body.value();
 
 	// Sign the body
 	auto expected_signature = crypto::Sign(crypto_args, common::ByteVectorFromString(request_body));
 	if (!expected_signature) {
-		return expected_signature.error();
+		return expected::unexpected(expected_signature.error());
 	}
-	auto signature = expected_signature.value();
 
-	// TryAuthenticate() calls the handler on any potential further errors, we
-	// are done here with no errors.
-	TryAuthenticate(servers.cbegin(), servers.cend(), client, request_body, signature, api_handler);
-	return error::NoError;
+	return AuthRequest {request_body, expected_signature.value()};
 }
 
-static void TryAuthenticate(
-	vector<string>::const_iterator server_it,
-	vector<string>::const_iterator end,
+// Sends the authentication request to one server. The handler gets either the token, or the
+// reason why this server didn't give us one.
+static error::Error AuthenticateWith(
 	mender::common::http::Client &client,
-	const string request_body,
-	const string signature,
-	APIResponseHandler api_handler) {
-	if (server_it == end) {
-		auto err = MakeError(AuthenticationError, "No more servers to try for authentication");
-		api_handler(expected::unexpected(err));
-		return;
-	}
-
-	auto whole_url = mender::common::http::JoinUrl(*server_it, request_uri);
+	const string &server,
+	const AuthRequest &auth_request,
+	APIResponseHandler handler) {
+	auto whole_url = mender::common::http::JoinUrl(server, request_uri);
 	auto req = make_shared<mender::common::http::OutgoingRequest>();
 	req->SetMethod(mender::common::http::Method::POST);
 	req->SetAddress(whole_url);
 	req->SetHeader("Content-Type", "application/json");
-	req->SetHeader("Content-Length", to_string(request_body.size()));
+	req->SetHeader("Content-Length", to_string(auth_request.body.size()));
 	req->SetHeader("Accept", "application/json");
-	req->SetHeader("X-MEN-Signature", signature);
+	req->SetHeader("X-MEN-Signature", auth_request.signature);
 	req->SetHeader("Authorization", "API_KEY");
 
+	auto request_body = auth_request.body;
 	req->SetBodyGenerator([request_body]() -> io::ExpectedReaderPtr {
 		return make_shared<io::StringReader>(request_body);
 	});
 
 	auto received_body = make_shared<vector<uint8_t>>();
 
-	auto err = client.AsyncCall(
+	return client.AsyncCall(
 		req,
-		[received_body, server_it, end, &client, request_body, signature, api_handler](
-			mender::common::http::ExpectedIncomingResponsePtr exp_resp) {
+		[received_body, handler](mender::common::http::ExpectedIncomingResponsePtr exp_resp) {
 			if (!exp_resp) {
-				mlog::Info(
-					"Authentication error trying server '" + *server_it
-					+ "': " + exp_resp.error().String());
-				TryAuthenticate(
-					std::next(server_it), end, client, request_body, signature, api_handler);
+				handler(expected::unexpected(exp_resp.error()));
 				return;
 			}
 			auto resp = exp_resp.value();
@@ -186,57 +168,248 @@ static void TryAuthenticate(
 			mlog::Debug("Status code:" + to_string(resp->GetStatusCode()));
 			mlog::Debug("Status message: " + resp->GetStatusMessage());
 		},
-		[received_body, server_it, end, &client, request_body, signature, api_handler](
+		[received_body, server, handler](
 			mender::common::http::ExpectedIncomingResponsePtr exp_resp) {
 			if (!exp_resp) {
-				mlog::Info(
-					"Authentication error trying server '" + *server_it
-					+ "': " + exp_resp.error().String());
-				TryAuthenticate(
-					std::next(server_it), end, client, request_body, signature, api_handler);
+				handler(expected::unexpected(exp_resp.error()));
 				return;
 			}
 			auto resp = exp_resp.value();
 
 			string response_body = common::StringFromByteVector(*received_body);
 
-			error::Error err;
 			switch (resp->GetStatusCode()) {
 			case mender::common::http::StatusOK:
-				api_handler(AuthData {*server_it, response_body});
+				handler(AuthData {server, response_body});
 				return;
 			case mender::common::http::StatusUnauthorized:
-				err = MakeHTTPResponseError(
-					UnauthorizedError, resp, response_body, "Failed to authorize with the server.");
-				mlog::Info(
-					"Authentication error trying server '" + *server_it + "': " + err.String());
-				TryAuthenticate(
-					std::next(server_it), end, client, request_body, signature, api_handler);
+				handler(expected::unexpected(MakeHTTPResponseError(
+					UnauthorizedError,
+					resp,
+					response_body,
+					"Failed to authorize with the server.")));
 				return;
 			case mender::common::http::StatusBadRequest:
 			case mender::common::http::StatusInternalServerError:
-				err = MakeHTTPResponseError(
-					APIError, resp, response_body, "Failed to authorize with the server.");
-				mlog::Info(
-					"Authentication error trying server '" + *server_it + "': " + err.String());
-				TryAuthenticate(
-					std::next(server_it), end, client, request_body, signature, api_handler);
+				handler(expected::unexpected(MakeHTTPResponseError(
+					APIError, resp, response_body, "Failed to authorize with the server.")));
 				return;
 			default:
-				err =
-					MakeError(ResponseError, "Unexpected error code: " + resp->GetStatusMessage());
-				mlog::Info(
-					"Authentication error trying server '" + *server_it + "': " + err.String());
-				TryAuthenticate(
-					std::next(server_it), end, client, request_body, signature, api_handler);
+				handler(expected::unexpected(MakeError(
+					ResponseError, "Unexpected error code: " + resp->GetStatusMessage())));
 				return;
 			}
 		});
+}
+
+static void TryAuthenticate(
+	vector<string>::const_iterator server_it,
+	vector<string>::const_iterator end,
+	mender::common::http::Client &client,
+	const AuthRequest auth_request,
+	APIResponseHandler api_handler) {
+	if (server_it == end) {
+		auto err = MakeError(AuthenticationError, "No more servers to try for authentication");
+		api_handler(expected::unexpected(err));
+		return;
+	}
+
+	auto err = AuthenticateWith(
+		client,
+		*server_it,
+		auth_request,
+		[server_it, end, &client, auth_request, api_handler](APIResponse resp) {
+			if (resp) {
+				api_handler(resp);
+				return;
+			}
+			mlog::Info(
+				"Authentication error trying server '" + *server_it
+				+ "': " + resp.error().String());
+			TryAuthenticate(std::next(server_it), end, client, auth_request, api_handler);
+		});
 	if (err != error::NoError) {
 		api_handler(expected::unexpected(err));
 	}
 }
 
+error::Error FetchJWTToken(
+	mender::common::http::Client &client,
+	const vector<string> &servers,
+	const crypto::Args &crypto_args,
+	const string &device_identity_script_path,
+	APIResponseHandler api_handler,
+	const string &tenant_token,
+	chrono::seconds identity_data_max_age) {
+	auto auth_request = MakeAuthRequest(
+		crypto_args, device_identity_script_path, tenant_token, identity_data_max_age);
+	if (!auth_request) {
+		return auth_request.error();
+	}
+
+	// TryAuthenticate() calls the handler on any potential further errors, we
+	// are done here with no errors.
+	TryAuthenticate(servers.cbegin(), servers.cend(), client, auth_request.value(), api_handler);
+	return error::NoError;
+}
+
+// Shared by all the requests of one parallel authentication, and by the handlers of those requests,
+// so that it survives the `ParallelAuthClient` if needed.
+struct ParallelAuth {
+	ParallelAuth(events::EventLoop &loop) :
+		loop {loop},
+		stagger_timer {loop} {
+	}
+
+	events::EventLoop &loop;
+	vector<string> servers;
+	chrono::milliseconds stagger;
+	AuthRequest auth_request;
+	APIResponseHandler api_handler;
+
+	// One per server, since a client can only handle one request at a time.
+	vector<unique_ptr<mender::common::http::Client>> clients;
+	events::Timer stagger_timer;
+
+	size_t started {0};
+	size_t failed {0};
+	bool finished {false};
+};
+
+// Stops all requests except `winner`, without calling the handler.
+static void StopParallelAuth(ParallelAuthPtr auth, size_t winner) {
+	auth->finished = true;
+	auth->stagger_timer.Cancel();
+	for (size_t i = 0; i < auth->clients.size(); i++) {
+		if (i != winner) {
+			auth->clients[i]->Cancel();
+		}
+	}
+
+	// The clients hold handlers which refer back to us, but we may be inside one of those
+	// handlers right now, so break the cycle once we are out of here.
+	auth->loop.Post([auth]() { auth->clients.clear(); });
+}
+
+static void FinishParallelAuth(ParallelAuthPtr auth, size_t winner, APIResponse resp) {
+	StopParallelAuth(auth, winner);
+	auth->api_handler(resp);
+}
+
+static void StartNextParallelAuth(ParallelAuthPtr auth);
+
+static void ParallelAuthHandler(ParallelAuthPtr auth, size_t index, APIResponse resp) {
+	if (auth->finished) {
+		// Cancelled, or lost the race.
+		return;
+	}
+	if (resp) {
+		FinishParallelAuth(auth, index, resp);
+		return;
+	}
+
+	mlog::Info(
+		"Authentication error trying server '" + auth->servers[index]
+		+ "': " + resp.error().String());
+	auth->failed++;
+	if (auth->started < auth->servers.size()) {
+		// No point in waiting for the stagger when we already know this one failed.
+		StartNextParallelAuth(auth);
+	} else if (auth->failed == auth->started) {
+		FinishParallelAuth(
+			auth,
+			auth->servers.size(),
+			expected::unexpected(
+				MakeError(AuthenticationError, "No more servers to try for authentication")));
+	}
+}
+
+static void StartNextParallelAuth(ParallelAuthPtr auth) {
+	auth->stagger_timer.Cancel();
+
+	while (auth->started < auth->servers.size()) {
+		auto index = auth->started++;
+		auto err = AuthenticateWith(
+			*auth->clients[index],
+			auth->servers[index],
+			auth->auth_request,
+			[auth, index](APIResponse resp) { ParallelAuthHandler(auth, index, resp); });
+		if (err == error::NoError) {
+			break;
+		}
+		mlog::Info(
+			"Authentication error trying server '" + auth->servers[index] + "': " + err.String());
+		auth->failed++;
+	}
+
+	if (auth->failed == auth->servers.size()) {
+		FinishParallelAuth(
+			auth,
+			auth->servers.size(),
+			expected::unexpected(
+				MakeError(AuthenticationError, "No more servers to try for authentication")));
+		return;
+	}
+
+	if (auth->started < auth->servers.size()) {
+		auth->stagger_timer.AsyncWait(auth->stagger, [auth](error::Error err) {
+			if (err != error::NoError || auth->finished) {
+				return;
+			}
+			StartNextParallelAuth(auth);
+		});
+	}
+}
+
+ParallelAuthClient::ParallelAuthClient(
+	events::EventLoop &loop,
+	const http::ClientConfig &client_config,
+	chrono::milliseconds stagger) :
+	loop_ {loop},
+	client_config_ {client_config},
+	stagger_ {stagger} {
+}
+
+ParallelAuthClient::~ParallelAuthClient() {
+	Cancel();
+}
+
+void ParallelAuthClient::Cancel() {
+	if (auth_ && !auth_->finished) {
+		StopParallelAuth(auth_, auth_->servers.size());
+	}
+	auth_.reset();
+}
+
+error::Error ParallelAuthClient::FetchJWTToken(
+	const vector<string> &servers,
+	const crypto::Args &crypto_args,
+	const string &device_identity_script_path,
+	APIResponseHandler api_handler,
+	const string &tenant_token,
+	chrono::seconds identity_data_max_age) {
+	auto auth_request = MakeAuthRequest(
+		crypto_args, device_identity_script_path, tenant_token, identity_data_max_age);
+	if (!auth_request) {
+		return auth_request.error();
+	}
+
+	Cancel();
+
+	auth_ = make_shared<ParallelAuth>(loop_);
+	auth_->servers = servers;
+	auth_->stagger = stagger_;
+	auth_->auth_request = auth_request.value();
+	auth_->api_handler = api_handler;
+	for (size_t i = 0; i < servers.size(); i++) {
+		auth_->clients.emplace_back(new mender::common::http::Client(client_config_, loop_));
+	}
+
+	// Calls the handler on any further errors, just like `TryAuthenticate()`.
+	StartNextParallelAuth(auth_);
+	return error::NoError;
+}
+
 } // namespace auth
 } // namespace api
 } // namespace auth
@@ -36,30 +36,93 @@ error::Error AuthenticatorHttp::GetJwtToken() {
 	return error::NoError;
 }
 
+error::Error AuthenticatorHttp::WithToken(mender::api::auth::AuthenticatedAction action) {
+	if (token_ != "" && server_url_ != "") {
+		mender::api::auth::ExpectedAuthData ex_auth_data =
+			mender::api::auth::AuthData {server_url_, token_};
+		loop_.Post([action, ex_auth_data]() { action(ex_auth_data); });
+		return error::NoError;
+	}
+
+	pending_actions_.push_back(action);
+	if (token_fetch_in_progress_) {
+		// Already waiting for a new token.
+		return error::NoError;
+	}
+	return RequestNewToken();
+}
+
+void AuthenticatorHttp::ExpireToken() {
+	token_.clear();
+	server_url_.clear();
+	token_refresh_timer_.Cancel();
+	Authenticator::ExpireToken();
+}
+
 void AuthenticatorHttp::FetchJwtTokenHandler(APIResponse resp) {
+	auth_timeout_timer_.Cancel();
+
 	if (resp) {
 		token_ = resp.value().token;
 		server_url_ = resp.value().server_url;
 
 		log::Info("Successfully received new authorization data");
+		ScheduleTokenRefresh();
+		PostPendingActions(mender::api::auth::AuthData {server_url_, token_});
+	} else if (token_ != "") {
+		// The token has not been expired, so this was an early refresh. Keep using the
+		// current token until the server rejects it.
+		log::Warning("Failed to refresh the token: " + resp.error().String());
+		PostPendingActions(resp);
 	} else {
-		token_.clear();
-		server_url_.clear();
-
 		log::Error("Failed to fetch new token: " + resp.error().String());
+		PostPendingActions(resp);
+	}
+}
+
+void AuthenticatorHttp::ScheduleTokenRefresh() {
+	token_refresh_timer_.Cancel();
+
+	auto exp_delay = mender::api::auth::TokenRefreshDelay(token_);
+	if (!exp_delay) {
+		// We will still get a new token when the old one is rejected.
+		log::Debug("Not refreshing the token ahead of time: " + exp_delay.error().String());
+		return;
 	}
 
-	PostPendingActions(mender::api::auth::AuthData {token_, server_url_});
+	log::Debug("Refreshing the token in " + to_string(exp_delay.value().count()) + " seconds");
+	token_refresh_timer_.AsyncWait(exp_delay.value(), [this](error::Error err) {
+		if (err != error::NoError) {
+			// Cancelled, a new token is handled elsewhere.
+			return;
+		}
+		if (!token_fetch_in_progress_) {
+			// Does not clear `token_`, so `WithToken()` keeps handing it out meanwhile.
+			log::Debug("Token is about to expire, requesting a new one");
+			RequestNewToken();
+		}
+	});
 }
 
 error::Error AuthenticatorHttp::FetchJwtToken() {
+	if (config_.parallel_authentication && config_.servers.size() > 1) {
+		return parallel_client_.FetchJWTToken(
+			config_.servers,
+			crypto_args_,
+			config_.paths.GetIdentityScript(),
+			[this](APIResponse resp) { FetchJwtTokenHandler(resp); },
+			config_.tenant_token,
+			chrono::seconds {config_.identity_data_cache_seconds});
+	}
+
 	return FetchJWTToken(
 		client_,
 		config_.servers,
 		crypto_args_,
 		config_.paths.GetIdentityScript(),
 		[this](APIResponse resp) { FetchJwtTokenHandler(resp); },
-		config_.tenant_token);
+		config_.tenant_token,
+		chrono::seconds {config_.identity_data_cache_seconds});
 }
 
 } // namespace auth
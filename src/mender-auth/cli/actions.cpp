@@ -95,23 +95,38 @@ error::Error DoAuthenticate(
 	}
 	mender::common::events::Timer timer {loop};
 	http::Client client {config.GetHttpClientConfig(), loop};
-	auto err = auth_client::FetchJWTToken(
-		client,
-		config.servers,
-		{keystore->KeyName(), keystore->PassPhrase(), keystore->SSLEngine()},
-		config.paths.GetIdentityScript(),
-		[&loop, &timer](auth_client::APIResponse resp) {
-			log::Info("Got Auth response");
-			if (resp) {
-				log::Info(
-					"Successfully authorized with the server '" + resp.value().server_url + "'");
-			} else {
-				log::Error(resp.error().String());
-			}
-			timer.Cancel();
-			loop.Stop();
-		},
-		config.tenant_token);
+	auth_client::ParallelAuthClient parallel_client {
+		loop,
+		config.GetHttpClientConfig(),
+		chrono::milliseconds {config.parallel_authentication_stagger_milliseconds}};
+	crypto::Args crypto_args {keystore->KeyName(), keystore->PassPhrase(), keystore->SSLEngine()};
+	auto handler = [&loop, &timer](auth_client::APIResponse resp) {
+		log::Info("Got Auth response");
+		if (resp) {
+			log::Info("Successfully authorized with the server '" + resp.value().server_url + "'");
+		} else {
+			log::Error(resp.error().String());
+		}
+		timer.Cancel();
+		loop.Stop();
+	};
+	error::Error err;
+	if (config.parallel_authentication && config.servers.size() > 1) {
+		err = parallel_client.FetchJWTToken(
+			config.servers,
+			crypto_args,
+			config.paths.GetIdentityScript(),
+			handler,
+			config.tenant_token);
+	} else {
+		err = auth_client::FetchJWTToken(
+			client,
+			config.servers,
+			crypto_args,
+			config.paths.GetIdentityScript(),
+			handler,
+			config.tenant_token);
+	}
 	if (err != error::NoError) {
 		return err;
 	}
@@ -162,6 +177,7 @@ error::Error DaemonAction::Execute(context::MenderContext &main_context) {
 	}
 
 	ipc::Server ipc_server {loop, config};
+	ipc_server.UsePersistentCache(config.paths.GetAuthTokenCacheFile());
 
 	err = ipc_server.Listen(
 		{keystore_->KeyName(), keystore_->PassPhrase(), keystore_->SSLEngine()},
@@ -15,6 +15,10 @@
 #ifndef MENDER_AUTH_HTTP_FORWARDER_HPP
 #define MENDER_AUTH_HTTP_FORWARDER_HPP
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include <common/error.hpp>
 #include <common/events.hpp>
 #include <common/expected.hpp>
@@ -37,9 +41,9 @@ using namespace std;
 
 class ForwardObject {
 private:
-	ForwardObject(const http::ClientConfig &config, events::EventLoop &event_loop);
+	ForwardObject(unique_ptr<http::Client> client);
 
-	http::Client client_;
+	unique_ptr<http::Client> client_;
 
 	log::Logger logger_;
 
@@ -65,6 +69,7 @@ public:
 
 	void Cancel() override;
 
+	// `listen_url` can also be a Unix domain socket, see `http::Server::AsyncServeUrl()`.
 	error::Error AsyncForward(const string &listen_url, const string &target_url);
 
 	uint16_t GetPort() const;
@@ -86,15 +91,22 @@ private:
 		http::IncomingResponsePtr resp_in,
 		http::OutgoingResponsePtr resp_out);
 
+	unique_ptr<http::Client> AcquireClient();
+	void FinishConnection(http::IncomingRequestPtr req_in);
+
 	log::Logger logger_;
 	events::EventLoop &event_loop_;
 	http::Server server_;
 	shared_ptr<bool> cancelled_;
-	const http::ClientConfig &client_config_;
+	http::ClientConfig client_config_;
 	string target_url_;
 
 	unordered_map<http::IncomingRequestPtr, ForwardObjectPtr> connections_;
 
+	// Clients whose upstream connection is still open after a finished request. They are
+	// handed out again for new requests, so that those don't need a new TCP and TLS handshake.
+	vector<unique_ptr<http::Client>> idle_clients_;
+
 	friend class ForwardObject;
 	friend class TestServer;
 };
@@ -18,20 +18,29 @@ namespace mender {
 namespace auth {
 namespace http_forwarder {
 
-ForwardObject::ForwardObject(const http::ClientConfig &config, events::EventLoop &event_loop) :
-	client_(config, event_loop),
+// How many idle upstream connections to keep around at most.
+const size_t MaxIdleClients = 4;
+
+ForwardObject::ForwardObject(unique_ptr<http::Client> client) :
+	client_(std::move(client)),
 	logger_("http_forwarder") {
 }
 
+static http::ServerConfig WithKeepAlive(http::ServerConfig config) {
+	config.keep_alive = true;
+	return config;
+}
+
 Server::Server(
 	const http::ServerConfig &server_config,
 	const http::ClientConfig &client_config,
 	events::EventLoop &loop) :
 	logger_("http_forwarder"),
 	event_loop_ {loop},
-	server_ {server_config, loop},
+	server_ {WithKeepAlive(server_config), loop},
 	cancelled_ {make_shared<bool>(true)},
 	client_config_ {client_config} {
+	client_config_.keep_alive = true;
 }
 
 Server::~Server() {
@@ -44,6 +53,7 @@ void Server::Cancel() {
 	*cancelled_ = true;
 	cancelled_ = make_shared<bool>(true);
 	connections_.clear();
+	idle_clients_.clear();
 	server_.Cancel();
 }
 
@@ -101,7 +111,7 @@ void Server::RequestHeaderHandler(http::ExpectedIncomingRequestPtr exp_req) {
 	}
 	auto &req_in = exp_req.value();
 
-	ForwardObjectPtr connection {new ForwardObject(client_config_, event_loop_)};
+	ForwardObjectPtr connection {new ForwardObject(AcquireClient())};
 	connections_[req_in] = connection;
 	connection->logger_ = logger_.WithFields(log::LogField {"request", req_in->GetPath()});
 	connection->req_in_ = req_in;
@@ -139,7 +149,7 @@ void Server::RequestHeaderHandler(http::ExpectedIncomingRequestPtr exp_req) {
 	} // else: if body is missing we don't need to do anything.
 
 	auto &cancelled = cancelled_;
-	auto err = connection->client_.AsyncCall(
+	auto err = connection->client_->AsyncCall(
 		req_out,
 		[this, cancelled, req_in](http::ExpectedIncomingResponsePtr exp_resp) {
 			if (!*cancelled) {
@@ -251,8 +261,7 @@ void Server::ResponseHeaderHandler(
 		auto &connection = connections_[req_in];
 		connection->incoming_request_finished_ = true;
 		if (connection->outgoing_request_finished_) {
-			// We are done, remove connection.
-			connections_.erase(req_in);
+			FinishConnection(req_in);
 		}
 	});
 	if (err != error::NoError) {
@@ -305,9 +314,10 @@ void Server::SwitchProtocol(
 				}
 			};
 
-		// Forward in both directions.
-		io::AsyncCopy(local_socket, remote_socket, finished_handler);
-		io::AsyncCopy(remote_socket, local_socket, finished_handler);
+		// Forward in both directions. Use two buffers each way, so that we can receive the
+		// next block while the previous one is still being sent.
+		io::AsyncCopyMultiBuffer(local_socket, remote_socket, 2, finished_handler);
+		io::AsyncCopyMultiBuffer(remote_socket, local_socket, 2, finished_handler);
 	});
 	if (err != error::NoError) {
 		connections_[req_in]->logger_.Error("Could not switch protocol: " + err.String());
@@ -329,9 +339,27 @@ void Server::ResponseBodyHandler(
 
 	connection->outgoing_request_finished_ = true;
 	if (connection->incoming_request_finished_) {
-		// We are done, remove connection.
-		connections_.erase(req_in);
+		FinishConnection(req_in);
+	}
+}
+
+unique_ptr<http::Client> Server::AcquireClient() {
+	if (idle_clients_.empty()) {
+		return unique_ptr<http::Client>(new http::Client(client_config_, event_loop_));
+	}
+	auto client = std::move(idle_clients_.back());
+	idle_clients_.pop_back();
+	return client;
+}
+
+void Server::FinishConnection(http::IncomingRequestPtr req_in) {
+	// We are done. Only clients which finished without errors end up here, so their upstream
+	// connection, if still open, can be used for the next request.
+	auto &connection = connections_[req_in];
+	if (idle_clients_.size() < MaxIdleClients) {
+		idle_clients_.push_back(std::move(connection->client_));
 	}
+	connections_.erase(req_in);
 }
 
 } // namespace http_forwarder
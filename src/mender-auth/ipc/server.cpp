@@ -14,6 +14,7 @@
 
 #include <mender-auth/ipc/server.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <string>
@@ -22,7 +23,10 @@
 #include <common/platform/dbus.hpp>
 #include <common/error.hpp>
 #include <common/expected.hpp>
+#include <common/io.hpp>
+#include <common/json.hpp>
 #include <common/log.hpp>
+#include <common/path.hpp>
 
 namespace mender {
 namespace auth {
@@ -32,6 +36,11 @@ namespace crypto = mender::common::crypto;
 namespace dbus = mender::common::dbus;
 namespace error = mender::common::error;
 namespace expected = mender::common::expected;
+namespace io = mender::common::io;
+namespace json = mender::common::json;
+namespace path = mender::common::path;
+
+namespace api_auth = mender::api::auth;
 
 
 using namespace std;
@@ -42,43 +51,89 @@ error::Error AuthenticatingForwarder::Listen(
 	// Cannot serve new tokens when not knowing where to fetch them from.
 	AssertOrReturnError(servers_.size() > 0);
 
+	args_ = args;
+	identity_script_path_ =
+		identity_script_path == "" ? default_identity_script_path_ : identity_script_path;
+
+	if (cache_file_ != "") {
+		LoadPersistentCache();
+	}
+
 	auto dbus_obj = make_shared<dbus::DBusObject>("/io/mender/AuthenticationManager");
 	dbus_obj->AddMethodHandler<dbus::ExpectedStringPair>(
 		"io.mender.Authentication1", "GetJwtToken", [this]() {
 			return dbus::StringPair {GetJWTToken(), GetServerURL()};
 		});
 	dbus_obj->AddMethodHandler<expected::ExpectedBool>(
-		"io.mender.Authentication1", "FetchJwtToken", [this, args, identity_script_path]() {
+		"io.mender.Authentication1", "FetchJwtToken", [this]() {
 			if (auth_in_progress_) {
 				// Already authenticating, nothing to do here.
+				refresh_in_progress_ = false;
 				return true;
 			}
-			auto err = auth_client::FetchJWTToken(
-				client_,
-				servers_,
-				args,
-				identity_script_path == "" ? default_identity_script_path_ : identity_script_path,
-				[this](auth_client::APIResponse resp) { FetchJwtTokenHandler(resp); },
-				tenant_token_);
+			auto err = FetchJwtToken();
 			if (err != error::NoError) {
 				log::Error("Failed to trigger token fetching: " + err.String());
 				return false;
 			}
-			auth_in_progress_ = true;
 			return true;
 		});
 
 	return dbus_server_.AdvertiseObject(dbus_obj);
 }
 
+error::Error AuthenticatingForwarder::FetchJwtToken() {
+	auto handler = [this](auth_client::APIResponse resp) { FetchJwtTokenHandler(resp); };
+	error::Error err;
+	if (parallel_authentication_) {
+		err = parallel_client_.FetchJWTToken(
+			servers_,
+			args_,
+			identity_script_path_,
+			handler,
+			tenant_token_,
+			identity_data_max_age_);
+	} else {
+		err = auth_client::FetchJWTToken(
+			client_,
+			servers_,
+			args_,
+			identity_script_path_,
+			handler,
+			tenant_token_,
+			identity_data_max_age_);
+	}
+	if (err != error::NoError) {
+		return err;
+	}
+	auth_in_progress_ = true;
+	return error::NoError;
+}
+
 void AuthenticatingForwarder::FetchJwtTokenHandler(auth_client::APIResponse &resp) {
 	auth_in_progress_ = false;
+	refresh_timer_.Cancel();
+
+	bool refreshing = refresh_in_progress_;
+	refresh_in_progress_ = false;
+	if (refreshing && !resp) {
+		// The cached token is still valid, keep using it. Once it expires, clients will ask
+		// for a new one anyway.
+		log::Warning("Failed to refresh the token: " + resp.error().String());
+		return;
+	}
 
-	forwarder_.Cancel();
+	if (refreshing && resp.value().server_url == forwarder_.GetTargetUrl()) {
+		// Same server, keep the proxy running so that requests in flight are not
+		// interrupted.
+		Cache(resp.value().token, cached_server_url_);
+		log::Info("Successfully refreshed authorization data");
+		ScheduleTokenRefresh();
+		SavePersistentCache(resp.value().server_url);
+	} else if (resp) {
+		forwarder_.Cancel();
 
-	if (resp) {
-		// ":0" port number means pick random port in user range.
-		auto err = forwarder_.AsyncForward("http://127.0.0.1:0", resp.value().server_url);
+		auto err = forwarder_.AsyncForward(forwarder_listen_url_, resp.value().server_url);
 		if (err == error::NoError) {
 			Cache(resp.value().token, forwarder_.GetUrl());
 		} else {
@@ -90,8 +145,12 @@ void AuthenticatingForwarder::FetchJwtTokenHandler(auth_client::APIResponse &res
 		}
 
 		log::Info("Successfully received new authorization data");
+		ScheduleTokenRefresh();
+		SavePersistentCache(resp.value().server_url);
 	} else {
+		forwarder_.Cancel();
 		ClearCache();
+		DeletePersistentCache();
 		log::Error("Failed to fetch new token: " + resp.error().String());
 	}
 	// Emit signal either with valid token and server url or with empty strings
@@ -102,6 +161,149 @@ void AuthenticatingForwarder::FetchJwtTokenHandler(auth_client::APIResponse &res
 		dbus::StringPair {cached_jwt_token_, cached_server_url_});
 }
 
+void AuthenticatingForwarder::ScheduleTokenRefresh() {
+	auto exp_delay = api_auth::TokenRefreshDelay(cached_jwt_token_);
+	if (!exp_delay) {
+		log::Debug("Not refreshing the token ahead of time: " + exp_delay.error().String());
+		return;
+	}
+
+	refresh_timer_.AsyncWait(exp_delay.value(), [this](error::Error err) {
+		if (err != error::NoError || auth_in_progress_) {
+			return;
+		}
+		log::Debug("Token is about to expire, requesting a new one");
+		refresh_in_progress_ = true;
+		auto fetch_err = FetchJwtToken();
+		if (fetch_err != error::NoError) {
+			refresh_in_progress_ = false;
+			log::Warning("Failed to trigger token refresh: " + fetch_err.String());
+		}
+	});
+}
+
+void AuthenticatingForwarder::LoadPersistentCache() {
+	if (!path::FileExists(cache_file_)) {
+		return;
+	}
+
+	auto exp_json = json::LoadFromFile(cache_file_);
+	if (!exp_json) {
+		log::Warning("Could not load the cached token: " + exp_json.error().String());
+		DeletePersistentCache();
+		return;
+	}
+	auto &cache = exp_json.value();
+	auto token = cache.Get("token").and_then(json::ToString);
+	auto server_url = cache.Get("server_url").and_then(json::ToString);
+	auto tenant_token = cache.Get("tenant_token").and_then(json::ToString);
+	auto pubkey = cache.Get("pubkey").and_then(json::ToString);
+	if (!token || !server_url || !tenant_token || !pubkey) {
+		log::Warning("Invalid token cache, ignoring it");
+		DeletePersistentCache();
+		return;
+	}
+
+	// Only check what we can check locally. If the server doesn't accept the token anymore,
+	// clients will ask for a new one as usual.
+	string reason;
+	if (find(servers_.cbegin(), servers_.cend(), server_url.value()) == servers_.cend()) {
+		reason = "server is not configured anymore";
+	} else if (tenant_token.value() != tenant_token_) {
+		reason = "tenant token has changed";
+	} else {
+		auto exp_pubkey = crypto::ExtractPublicKey(args_);
+		auto exp_expiry = api_auth::GetTokenExpiry(token.value());
+		if (!exp_pubkey || exp_pubkey.value() != pubkey.value()) {
+			reason = "device key has changed";
+		} else if (!exp_expiry) {
+			// Without it we cannot tell whether the token is still valid at all.
+			reason = "token has no usable expiry time: " + exp_expiry.error().String();
+		} else if (exp_expiry.value() <= chrono::system_clock::now()) {
+			reason = "token has expired";
+		}
+	}
+	if (reason != "") {
+		log::Info("Not using the cached token: " + reason);
+		DeletePersistentCache();
+		return;
+	}
+
+	auto err = forwarder_.AsyncForward(forwarder_listen_url_, server_url.value());
+	if (err != error::NoError) {
+		log::Error("Unable to start a local HTTP proxy: " + err.String());
+		return;
+	}
+	Cache(token.value(), forwarder_.GetUrl());
+	ScheduleTokenRefresh();
+	log::Info("Using the cached authorization data for server '" + server_url.value() + "'");
+}
+
+void AuthenticatingForwarder::SavePersistentCache(const string &server_url) {
+	if (cache_file_ == "") {
+		return;
+	}
+
+	auto exp_pubkey = crypto::ExtractPublicKey(args_);
+	if (!exp_pubkey) {
+		log::Warning("Not caching the token: " + exp_pubkey.error().String());
+		DeletePersistentCache();
+		return;
+	}
+
+	auto exp_data = json::Dump(json::KeyValueMap {
+		{"token", cached_jwt_token_},
+		{"server_url", server_url},
+		{"tenant_token", tenant_token_},
+		{"pubkey", exp_pubkey.value()},
+	});
+	if (!exp_data) {
+		log::Warning("Not caching the token: " + exp_data.error().String());
+		return;
+	}
+
+	// Write a new file, sync it and move it in place, so that a crash never leaves a half written
+	// one behind. It holds a credential, so only we may read it.
+	const string tmp_file = cache_file_ + ".tmp";
+	auto exp_os = io::OpenOfstream(tmp_file);
+	if (!exp_os) {
+		log::Warning("Not caching the token: " + exp_os.error().String());
+		return;
+	}
+	auto err = path::Permissions(tmp_file, {path::Perms::Owner_read, path::Perms::Owner_write});
+	if (err == error::NoError) {
+		err = io::WriteStringIntoOfstream(exp_os.value(), exp_data.value());
+	}
+	exp_os.value().close();
+	if (err == error::NoError) {
+		err = path::DataSync(tmp_file);
+	}
+	if (err == error::NoError) {
+		err = path::Rename(tmp_file, cache_file_);
+	}
+	if (err != error::NoError) {
+		log::Warning("Not caching the token: " + err.String());
+		path::FileDelete(tmp_file);
+		return;
+	}
+
+	// Make the rename itself durable. The new file is in place either way, so only warn.
+	err = path::DataSync(path::DirName(cache_file_));
+	if (err != error::NoError) {
+		log::Warning("Could not sync the token cache directory: " + err.String());
+	}
+}
+
+void AuthenticatingForwarder::DeletePersistentCache() {
+	if (cache_file_ == "" || !path::FileExists(cache_file_)) {
+		return;
+	}
+	auto err = path::FileDelete(cache_file_);
+	if (err != error::NoError) {
+		log::Warning("Could not delete the cached token: " + err.String());
+	}
+}
+
 } // namespace ipc
 } // namespace auth
 } // namespace mender
@@ -54,10 +54,27 @@ public:
 	AuthenticatingForwarder(events::EventLoop &loop, const conf::MenderConfig &config) :
 		servers_ {config.servers},
 		tenant_token_ {config.tenant_token},
+		identity_data_max_age_ {config.identity_data_cache_seconds},
 		client_ {config.GetHttpClientConfig(), loop},
-		forwarder_ {http::ServerConfig {}, config.GetHttpClientConfig(), loop},
+		parallel_authentication_ {config.parallel_authentication && config.servers.size() > 1},
+		parallel_client_ {
+			loop,
+			config.GetHttpClientConfig(),
+			chrono::milliseconds {config.parallel_authentication_stagger_milliseconds}},
+		forwarder_ {ForwarderServerConfig(config), config.GetHttpClientConfig(), loop},
+		// ":0" port number means pick random port in user range.
+		forwarder_listen_url_ {
+			config.forwarder_listen_url == "" ? "http://127.0.0.1:0" : config.forwarder_listen_url},
 		default_identity_script_path_ {config.paths.GetIdentityScript()},
-		dbus_server_ {loop, "io.mender.AuthenticationManager"} {};
+		dbus_server_ {loop, "io.mender.AuthenticationManager"},
+		refresh_timer_ {loop} {};
+
+	// Keep the token in the given file, so that it survives restarts. A token found there
+	// already is used by `Listen()` if it still fits the configuration and the key. Must be
+	// called before `Listen()`.
+	void UsePersistentCache(const string &cache_file) {
+		cache_file_ = cache_file;
+	}
 
 	error::Error Listen(const crypto::Args &args, const string &identity_script_path = "");
 
@@ -79,22 +96,45 @@ public:
 	}
 
 private:
+	static http::ServerConfig ForwarderServerConfig(const conf::MenderConfig &config) {
+		http::ServerConfig server_config;
+		server_config.unix_socket_allowed_uids.assign(
+			config.forwarder_allowed_uids.begin(), config.forwarder_allowed_uids.end());
+		return server_config;
+	}
+
 	void ClearCache() {
 		Cache("", "");
 	}
 
+	error::Error FetchJwtToken();
+	void LoadPersistentCache();
+	void SavePersistentCache(const string &server_url);
+	void DeletePersistentCache();
 	void FetchJwtTokenHandler(auth_client::APIResponse &resp);
+	void ScheduleTokenRefresh();
 
 	string cached_jwt_token_;
 	string cached_server_url_;
 	bool auth_in_progress_ = false;
+	// Fetching a new token before the cached one expires, which stays in use meanwhile.
+	bool refresh_in_progress_ = false;
+
+	crypto::Args args_;
+	string identity_script_path_;
+	string cache_file_;
 
 	const vector<string> &servers_;
 	const string tenant_token_;
+	const chrono::seconds identity_data_max_age_;
 	http::Client client_;
+	const bool parallel_authentication_;
+	auth_client::ParallelAuthClient parallel_client_;
 	http_forwarder::Server forwarder_;
+	const string forwarder_listen_url_;
 	string default_identity_script_path_;
 	dbus::DBusServer dbus_server_;
+	events::Timer refresh_timer_;
 };
 
 using Server = AuthenticatingForwarder;
@@ -0,0 +1,612 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <mender-update/block_writer/block_writer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <artifact/sha/sha.hpp>
+
+#include <common/log.hpp>
+
+namespace mender {
+namespace update {
+namespace block_writer {
+
+namespace log = mender::common::log;
+namespace sha = mender::sha;
+
+static error::Error ErrnoError(int err, const string &msg) {
+	return error::Error(generic_category().default_error_condition(err), msg);
+}
+
+static bool IsZero(const uint8_t *data, size_t size) {
+	// If the first byte is zero, and every byte equals the one before it, they are all zero.
+	return size == 0 || (data[0] == 0 && memcmp(data, data + 1, size - 1) == 0);
+}
+
+static error::Error AllocateBuffer(uint8_t *&buffer, size_t size) {
+	void *allocated;
+	int err = posix_memalign(&allocated, BlockSize, size);
+	if (err != 0) {
+		return ErrnoError(err, "Cannot allocate write buffer");
+	}
+	buffer = static_cast<uint8_t *>(allocated);
+	return error::NoError;
+}
+
+struct VerifyState {
+	mutex lock;
+	condition_variable changed;
+	// How much of the target has been flushed, and is ready to be read back.
+	uint64_t durable {0};
+	// Set when `durable` is the final size of the image.
+	bool finished {false};
+	bool aborted {false};
+	// Set by the verification thread when it is done, along with `result`.
+	bool done {false};
+	error::Error result;
+	// Called by the verification thread when it is done, if set.
+	function<void()> done_handler;
+};
+
+// Reads the target, but only the parts which have been flushed. Blocks until more is flushed, and
+// returns EOF once everything has been read after the writer is finished.
+class FlushedDataReader : virtual public io::Reader {
+public:
+	FlushedDataReader(int fd, VerifyState &state) :
+		fd_ {fd},
+		state_ {state} {
+	}
+
+	expected::ExpectedSize Read(
+		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override {
+		uint64_t available;
+		{
+			unique_lock<mutex> lock(state_.lock);
+			state_.changed.wait(lock, [this]() {
+				return state_.aborted || state_.finished || state_.durable > offset_;
+			});
+			if (state_.aborted) {
+				return expected::unexpected(error::Error(
+					make_error_condition(errc::operation_canceled), "Verification aborted"));
+			}
+			available = state_.durable - offset_;
+		}
+
+		size_t to_read = static_cast<size_t>(min<uint64_t>(end - start, available));
+		if (to_read == 0) {
+			return 0;
+		}
+		ssize_t result;
+		do {
+			result = pread(fd_, &*start, to_read, static_cast<off_t>(offset_));
+		} while (result < 0 && errno == EINTR);
+		if (result < 0) {
+			int err = errno;
+			return expected::unexpected(ErrnoError(err, "Cannot read back written data"));
+		} else if (result == 0) {
+			return expected::unexpected(error::Error(
+				make_error_condition(errc::io_error),
+				"Cannot read back written data: Target ended at " + to_string(offset_)));
+		}
+		offset_ += result;
+		return result;
+	}
+
+private:
+	int fd_;
+	uint64_t offset_ {0};
+	VerifyState &state_;
+};
+
+BlockWriter::~BlockWriter() {
+	*destroying_ = true;
+	StopVerification(true);
+	free(buffer_);
+	free(compare_buffer_);
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+}
+
+ExpectedBlockWriterPtr BlockWriter::Open(const string &path, const Options &options) {
+	if (options.buffer_size == 0 || options.buffer_size % BlockSize != 0) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::invalid_argument),
+			"Buffer size must be a multiple of " + to_string(BlockSize)));
+	}
+
+	BlockWriterPtr writer(new BlockWriter(path, options));
+
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISBLK(st.st_mode)) {
+		writer->is_block_device_ = true;
+	}
+
+	// Comparing requires reading from the target as well.
+	int access = options.skip_unchanged ? O_RDWR : O_WRONLY;
+	if (writer->is_block_device_) {
+		int flags = access | O_CLOEXEC;
+		if (options.direct_io) {
+			writer->fd_ = open(path.c_str(), flags | O_DIRECT);
+			if (writer->fd_ >= 0) {
+				writer->direct_io_ = true;
+			} else if (errno == EINVAL) {
+				log::Info("Direct I/O not supported by " + path + ", using buffered I/O");
+			}
+		}
+		if (writer->fd_ < 0) {
+			writer->fd_ = open(path.c_str(), flags);
+		}
+	} else if (options.skip_unchanged) {
+		writer->fd_ = open(path.c_str(), access | O_CREAT | O_CLOEXEC, 0600);
+	} else {
+		// Holes are left for zero blocks, so there must not be any old data in the file.
+		writer->fd_ = open(path.c_str(), access | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	}
+	if (writer->fd_ < 0) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot open " + path));
+	}
+
+	auto err = AllocateBuffer(writer->buffer_, options.buffer_size);
+	if (err == error::NoError && options.skip_unchanged) {
+		err = AllocateBuffer(writer->compare_buffer_, options.buffer_size);
+	}
+	if (err != error::NoError) {
+		return expected::unexpected(err);
+	}
+
+	if (options.verify_checksum != "") {
+		writer->StartVerification();
+	}
+
+	return writer;
+}
+
+expected::ExpectedSize BlockWriter::Write(
+	vector<uint8_t>::const_iterator start, vector<uint8_t>::const_iterator end) {
+	size_t size = end - start;
+	if (size == 0) {
+		return 0;
+	}
+	auto data = &*start;
+	size_t remaining = size;
+	while (remaining > 0) {
+		size_t to_copy = min(remaining, options_.buffer_size - buffered_);
+		memcpy(buffer_ + buffered_, data, to_copy);
+		buffered_ += to_copy;
+		data += to_copy;
+		remaining -= to_copy;
+
+		if (buffered_ == options_.buffer_size) {
+			auto err = WriteBuffer();
+			if (err != error::NoError) {
+				return expected::unexpected(err);
+			}
+		}
+	}
+	return size;
+}
+
+error::Error BlockWriter::FlushAll() {
+	auto err = WriteBuffer();
+	if (err != error::NoError) {
+		return err;
+	}
+
+	if (!is_block_device_) {
+		// Trailing holes don't count towards the file size, so set it explicitly.
+		if (ftruncate(fd_, static_cast<off_t>(offset_)) != 0) {
+			int errnum = errno;
+			return ErrnoError(errnum, "Cannot set size of " + path_);
+		}
+	}
+
+	return Sync();
+}
+
+error::Error BlockWriter::Finish() {
+	auto err = FlushAll();
+	if (err != error::NoError || !verify_) {
+		return err;
+	}
+
+	StopVerification(false);
+	if (verify_->result != error::NoError) {
+		return verify_->result.WithContext("Verification of data written to " + path_ + " failed");
+	}
+	log::Debug("Verified data written to " + path_);
+	return error::NoError;
+}
+
+void BlockWriter::AsyncFinish(events::EventLoop &loop, function<void(error::Error)> handler) {
+	auto destroying = destroying_;
+
+	auto err = FlushAll();
+	if (err != error::NoError || !verify_) {
+		loop.Post([destroying, handler, err]() {
+			if (!*destroying) {
+				handler(err);
+			}
+		});
+		return;
+	}
+
+	auto state = verify_;
+	auto path = path_;
+	auto deliver = [&loop, destroying, state, path, handler]() {
+		loop.Post([destroying, state, path, handler]() {
+			if (*destroying) {
+				return;
+			}
+			if (state->result != error::NoError) {
+				handler(state->result.WithContext(
+					"Verification of data written to " + path + " failed"));
+				return;
+			}
+			log::Debug("Verified data written to " + path);
+			handler(error::NoError);
+		});
+	};
+
+	{
+		unique_lock<mutex> lock(state->lock);
+		state->finished = true;
+		if (!state->done) {
+			// The thread itself is joined in the destructor.
+			state->done_handler = deliver;
+			lock.unlock();
+			state->changed.notify_all();
+			return;
+		}
+	}
+	deliver();
+}
+
+error::Error BlockWriter::WriteBuffer() {
+	if (buffered_ == 0) {
+		return error::NoError;
+	}
+
+	if (is_block_device_ && !options_.skip_unchanged) {
+		// We don't know what is on the device already, so everything must be written.
+		auto err = WriteRange(buffer_, buffered_, offset_);
+		if (err != error::NoError) {
+			return err;
+		}
+	} else {
+		size_t existing = 0;
+		if (options_.skip_unchanged) {
+			// Read whole blocks, since that is what `O_DIRECT` requires. It always fits, since the
+			// buffer size is a multiple of the block size.
+			size_t to_read = (buffered_ + BlockSize - 1) / BlockSize * BlockSize;
+			auto read = ReadRange(compare_buffer_, to_read, offset_);
+			if (!read) {
+				return read.error();
+			}
+			existing = read.value();
+		}
+
+		// Write runs of changed or non-zero blocks, and skip over the blocks in between.
+		size_t run_start = 0;
+		bool in_run = false;
+		for (size_t pos = 0; pos < buffered_; pos += BlockSize) {
+			size_t block_size = min(BlockSize, buffered_ - pos);
+			bool skip;
+			if (options_.skip_unchanged) {
+				skip = pos + block_size <= existing
+					   && memcmp(buffer_ + pos, compare_buffer_ + pos, block_size) == 0;
+			} else {
+				skip = IsZero(buffer_ + pos, block_size);
+			}
+			if (skip) {
+				skipped_ += block_size;
+				if (in_run) {
+					auto err =
+						WriteRange(buffer_ + run_start, pos - run_start, offset_ + run_start);
+					if (err != error::NoError) {
+						return err;
+					}
+					in_run = false;
+				}
+			} else if (!in_run) {
+				run_start = pos;
+				in_run = true;
+			}
+		}
+		if (in_run) {
+			auto err =
+				WriteRange(buffer_ + run_start, buffered_ - run_start, offset_ + run_start);
+			if (err != error::NoError) {
+				return err;
+			}
+		}
+	}
+
+	offset_ += buffered_;
+	unsynced_ += buffered_;
+	buffered_ = 0;
+
+	if (options_.sync_interval > 0 && unsynced_ >= options_.sync_interval) {
+		return Sync();
+	}
+	return error::NoError;
+}
+
+error::Error BlockWriter::WriteRange(const uint8_t *data, size_t size, uint64_t offset) {
+	if (direct_io_ && size % BlockSize != 0) {
+		// Only the very last write can be unaligned, and `O_DIRECT` doesn't accept that.
+		int flags = fcntl(fd_, F_GETFL);
+		if (flags < 0 || fcntl(fd_, F_SETFL, flags & ~O_DIRECT) < 0) {
+			int err = errno;
+			return ErrnoError(err, "Cannot disable direct I/O on " + path_);
+		}
+		direct_io_ = false;
+	}
+
+	while (size > 0) {
+		auto written = pwrite(fd_, data, size, static_cast<off_t>(offset));
+		if (written < 0) {
+			int err = errno;
+			if (err == EINTR) {
+				continue;
+			}
+			return ErrnoError(err, "Cannot write to " + path_);
+		} else if (written == 0) {
+			return error::Error(
+				make_error_condition(errc::no_space_on_device),
+				"Cannot write to " + path_ + ": No space left at offset " + to_string(offset));
+		}
+		data += written;
+		size -= written;
+		offset += written;
+	}
+	return error::NoError;
+}
+
+expected::ExpectedSize BlockWriter::ReadRange(uint8_t *data, size_t size, uint64_t offset) {
+	size_t total = 0;
+	while (total < size) {
+		auto read = pread(fd_, data + total, size - total, static_cast<off_t>(offset + total));
+		if (read < 0) {
+			int err = errno;
+			if (err == EINTR) {
+				continue;
+			}
+			return expected::unexpected(ErrnoError(err, "Cannot read from " + path_));
+		} else if (read == 0) {
+			// End of the target. Everything beyond this needs to be written.
+			break;
+		}
+		total += read;
+	}
+	return total;
+}
+
+error::Error BlockWriter::Sync() {
+	if (fdatasync(fd_) != 0) {
+		int err = errno;
+		return ErrnoError(err, "Cannot flush " + path_);
+	}
+	unsynced_ = 0;
+
+	if (verify_) {
+		// Make sure that the verification reads from the device, not from the cache. Not
+		// fatal, it just makes the verification less thorough.
+		uint64_t durable;
+		{
+			unique_lock<mutex> lock(verify_->lock);
+			durable = verify_->durable;
+		}
+		posix_fadvise(
+			fd_,
+			static_cast<off_t>(durable),
+			static_cast<off_t>(offset_ - durable),
+			POSIX_FADV_DONTNEED);
+
+		{
+			unique_lock<mutex> lock(verify_->lock);
+			verify_->durable = offset_;
+		}
+		verify_->changed.notify_all();
+	}
+
+	return error::NoError;
+}
+
+void BlockWriter::StartVerification() {
+	verify_ = make_shared<VerifyState>();
+	verify_thread_ = thread([this]() { Verify(); });
+}
+
+void BlockWriter::Verify() {
+	error::Error err;
+
+	int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		int errnum = errno;
+		err = ErrnoError(errnum, "Cannot open " + path_ + " for reading");
+	} else {
+		FlushedDataReader reader(fd, *verify_);
+		sha::Reader sha_reader(reader, options_.verify_checksum);
+		vector<uint8_t> buffer(options_.buffer_size);
+		while (true) {
+			auto result = sha_reader.Read(buffer.begin(), buffer.end());
+			if (!result) {
+				err = result.error();
+				break;
+			} else if (result.value() == 0) {
+				break;
+			}
+		}
+		close(fd);
+	}
+
+	function<void()> done_handler;
+	{
+		unique_lock<mutex> lock(verify_->lock);
+		verify_->result = err;
+		verify_->done = true;
+		done_handler = std::move(verify_->done_handler);
+	}
+	if (done_handler) {
+		done_handler();
+	}
+}
+
+void BlockWriter::StopVerification(bool aborted) {
+	if (!verify_thread_.joinable()) {
+		return;
+	}
+	{
+		unique_lock<mutex> lock(verify_->lock);
+		if (aborted) {
+			verify_->aborted = true;
+		} else {
+			verify_->finished = true;
+		}
+	}
+	verify_->changed.notify_all();
+	verify_thread_.join();
+}
+
+struct WriteThreadState {
+	mutex lock;
+	condition_variable changed;
+	// The next task for the thread, empty if there is none.
+	function<function<void()>()> task;
+	// Set while the thread is running a task.
+	bool running {false};
+	bool stopping {false};
+};
+
+AsyncBlockWriter::AsyncBlockWriter(events::EventLoop &loop, BlockWriterPtr writer) :
+	loop_ {loop},
+	writer_ {writer},
+	state_ {make_shared<WriteThreadState>()} {
+	thread_ = thread([this]() { Run(); });
+}
+
+AsyncBlockWriter::~AsyncBlockWriter() {
+	Cancel();
+	{
+		unique_lock<mutex> lock(state_->lock);
+		state_->stopping = true;
+	}
+	state_->changed.notify_all();
+	thread_.join();
+}
+
+error::Error AsyncBlockWriter::AsyncWrite(
+	vector<uint8_t>::const_iterator start,
+	vector<uint8_t>::const_iterator end,
+	io::AsyncIoHandler handler) {
+	auto cancelled = cancelled_;
+	return Submit([this, start, end, cancelled, handler]() -> function<void()> {
+		auto result = writer_->Write(start, end);
+		return [cancelled, handler, result]() {
+			if (!*cancelled) {
+				handler(result);
+			}
+		};
+	});
+}
+
+void AsyncBlockWriter::Cancel() {
+	*cancelled_ = true;
+	cancelled_ = make_shared<bool>(false);
+
+	unique_lock<mutex> lock(state_->lock);
+	state_->task = nullptr;
+	state_->changed.wait(lock, [this]() { return !state_->running; });
+}
+
+void AsyncBlockWriter::AsyncFinish(function<void(error::Error)> handler) {
+	auto cancelled = cancelled_;
+	auto err = Submit([this, cancelled, handler]() -> function<void()> {
+		// Delivers the result through the loop by itself.
+		writer_->AsyncFinish(loop_, [cancelled, handler](error::Error err) {
+			if (!*cancelled) {
+				handler(err);
+			}
+		});
+		return nullptr;
+	});
+	if (err != error::NoError) {
+		loop_.Post([cancelled, handler, err]() {
+			if (!*cancelled) {
+				handler(err);
+			}
+		});
+	}
+}
+
+error::Error AsyncBlockWriter::Submit(function<function<void()>()> task) {
+	{
+		unique_lock<mutex> lock(state_->lock);
+		if (state_->task || state_->running) {
+			return error::Error(
+				make_error_condition(errc::operation_in_progress),
+				"A write is already in progress");
+		}
+		state_->task = std::move(task);
+	}
+	state_->changed.notify_all();
+	return error::NoError;
+}
+
+void AsyncBlockWriter::Run() {
+	while (true) {
+		function<function<void()>()> task;
+		{
+			unique_lock<mutex> lock(state_->lock);
+			state_->changed.wait(lock, [this]() { return state_->stopping || state_->task; });
+			if (state_->stopping) {
+				return;
+			}
+			task = std::move(state_->task);
+			state_->task = nullptr;
+			state_->running = true;
+		}
+
+		auto completion = task();
+
+		// Not running anymore before the completion is posted, so that its handler can start
+		// the next write right away.
+		{
+			unique_lock<mutex> lock(state_->lock);
+			state_->running = false;
+		}
+		state_->changed.notify_all();
+
+		if (completion) {
+			loop_.Post(completion);
+		}
+	}
+}
+
+} // namespace block_writer
+} // namespace update
+} // namespace mender
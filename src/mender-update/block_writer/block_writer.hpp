@@ -0,0 +1,192 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef MENDER_UPDATE_BLOCK_WRITER_HPP
+#define MENDER_UPDATE_BLOCK_WRITER_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <common/error.hpp>
+#include <common/events.hpp>
+#include <common/expected.hpp>
+#include <common/io.hpp>
+
+namespace mender {
+namespace update {
+namespace block_writer {
+
+using namespace std;
+
+namespace error = mender::common::error;
+namespace events = mender::common::events;
+namespace expected = mender::common::expected;
+namespace io = mender::common::io;
+
+// Alignment and granularity of all writes, which is enough for `O_DIRECT` on any device we
+// support.
+const size_t BlockSize = 4096;
+
+struct Options {
+	// Bypass the page cache. Only used for block devices.
+	bool direct_io {false};
+	// Read what is already in the target, and only write the blocks that differ. This is slower
+	// than writing everything when most blocks have changed, but saves a lot of time and flash
+	// wear when most of them haven't, since reads are much cheaper than writes.
+	bool skip_unchanged {false};
+	// Flush to the device after this many bytes have been written, so that a big image doesn't
+	// fill the page cache with dirty pages. Zero means to only flush at the end.
+	uint64_t sync_interval {64 * 1024 * 1024};
+	// How much data is collected before it is written. Must be a multiple of `BlockSize`.
+	size_t buffer_size {1024 * 1024};
+	// SHA256 checksum of the complete image. If set, everything that has been flushed is read
+	// back from the target and checksummed in a separate thread while writing continues, and
+	// `Finish()` fails if the result doesn't match. The data is dropped from the page cache after
+	// flushing, so that it is really read back from the device.
+	string verify_checksum;
+};
+
+struct VerifyState;
+struct WriteThreadState;
+
+class BlockWriter;
+using BlockWriterPtr = shared_ptr<BlockWriter>;
+using ExpectedBlockWriterPtr = expected::expected<BlockWriterPtr, error::Error>;
+
+/**
+ * Writes a payload image to a block device or a regular file, such as an inactive partition.
+ * Data is collected into large, aligned blocks before being written. Blocks which contain only
+ * zeros are not written when the target is a regular file, leaving holes in it instead, unless
+ * `skip_unchanged` is used, in which case blocks that are already in the target are not written.
+ * Call `Finish()` after the last write, otherwise the data may not have reached the target.
+ */
+class BlockWriter : virtual public io::Writer {
+public:
+	~BlockWriter();
+
+	BlockWriter(const BlockWriter &) = delete;
+	BlockWriter &operator=(const BlockWriter &) = delete;
+
+	static ExpectedBlockWriterPtr Open(const string &path, const Options &options = Options {});
+
+	expected::ExpectedSize Write(
+		vector<uint8_t>::const_iterator start, vector<uint8_t>::const_iterator end) override;
+
+	// Writes what is left in the buffer and flushes everything to the device. If verifying, also
+	// waits for the verification to finish.
+	error::Error Finish();
+	// Same as `Finish()`, but the verification result is delivered through `loop` instead of
+	// waiting for it. The handler is not called if the writer is destroyed before that.
+	void AsyncFinish(events::EventLoop &loop, function<void(error::Error)> handler);
+
+	bool IsBlockDevice() const {
+		return is_block_device_;
+	}
+	uint64_t BytesWritten() const {
+		return offset_ + buffered_;
+	}
+	// How many of the bytes written so far didn't need to be written to the target.
+	uint64_t BytesSkipped() const {
+		return skipped_;
+	}
+
+private:
+	BlockWriter(const string &path, const Options &options) :
+		path_ {path},
+		options_ {options} {
+	}
+
+	error::Error FlushAll();
+	error::Error WriteBuffer();
+	error::Error WriteRange(const uint8_t *data, size_t size, uint64_t offset);
+	expected::ExpectedSize ReadRange(uint8_t *data, size_t size, uint64_t offset);
+	error::Error Sync();
+
+	void StartVerification();
+	void Verify();
+	void StopVerification(bool aborted);
+
+	string path_;
+	Options options_;
+	int fd_ {-1};
+	bool is_block_device_ {false};
+	bool direct_io_ {false};
+
+	// Aligned, so that it can be used with `O_DIRECT`.
+	uint8_t *buffer_ {nullptr};
+	size_t buffered_ {0};
+	// Existing content of the target, only used with `skip_unchanged`.
+	uint8_t *compare_buffer_ {nullptr};
+	// Where in the target `buffer_` starts.
+	uint64_t offset_ {0};
+	uint64_t unsynced_ {0};
+	uint64_t skipped_ {0};
+
+	shared_ptr<VerifyState> verify_;
+	thread verify_thread_;
+
+	shared_ptr<bool> destroying_ {make_shared<bool>(false)};
+};
+
+/**
+ * Runs the writes of a `BlockWriter` in a separate thread, and delivers the results through the
+ * event loop, so that the loop is not blocked while the target is written and flushed. Only one
+ * write can be in progress at a time.
+ */
+class AsyncBlockWriter : virtual public io::AsyncWriter {
+public:
+	AsyncBlockWriter(events::EventLoop &loop, BlockWriterPtr writer);
+	~AsyncBlockWriter();
+
+	AsyncBlockWriter(const AsyncBlockWriter &) = delete;
+	AsyncBlockWriter &operator=(const AsyncBlockWriter &) = delete;
+
+	error::Error AsyncWrite(
+		vector<uint8_t>::const_iterator start,
+		vector<uint8_t>::const_iterator end,
+		io::AsyncIoHandler handler) override;
+	// A write which has already started can't be interrupted, and uses the caller's buffer, so
+	// this waits for it to finish. Its handler is not called.
+	void Cancel() override;
+
+	// Same as `BlockWriter::AsyncFinish()`, except that the remaining data is also written and
+	// flushed in the thread.
+	void AsyncFinish(function<void(error::Error)> handler);
+
+	// Must not be used while a write is in progress.
+	BlockWriter &Writer() {
+		return *writer_;
+	}
+
+private:
+	// The task runs in the thread, and returns what to run in the event loop afterwards, if
+	// anything.
+	error::Error Submit(function<function<void()>()> task);
+	void Run();
+
+	events::EventLoop &loop_;
+	BlockWriterPtr writer_;
+	shared_ptr<bool> cancelled_ {make_shared<bool>(false)};
+	shared_ptr<WriteThreadState> state_;
+	thread thread_;
+};
+
+} // namespace block_writer
+} // namespace update
+} // namespace mender
+
+#endif // MENDER_UPDATE_BLOCK_WRITER_HPP
@@ -78,6 +78,9 @@ public:
 
 	error::Error Initialize();
 	virtual kv_db::KeyValueDatabase &GetMenderStoreDB();
+	// Makes sure everything written to the store so far survives a power failure. Must be called
+	// before any point the device may go down from, unless `StateDatabaseDurability` is `full`.
+	virtual error::Error SyncMenderStoreDB();
 	ExpectedProvidesData LoadProvides();
 	ExpectedProvidesData LoadProvides(kv_db::Transaction &txn);
 	expected::ExpectedString GetDeviceType();
@@ -133,6 +136,10 @@ public:
 	// original schema again.
 	static const string state_data_key_uncommitted;
 
+	// Deployment status updates which have not been delivered to the server yet. See
+	// deployments::StatusReporter.
+	static const string deployment_status_queue_key;
+
 	// ---------------------- NOT IN USE ANYMORE --------------------------
 	// Key used to store the auth token.
 	static const string auth_token_name;
@@ -52,6 +52,7 @@ const string MenderContext::artifact_provides_key {"artifact-provides"};
 const string MenderContext::standalone_state_key {"standalone-state"};
 const string MenderContext::state_data_key {"state"};
 const string MenderContext::state_data_key_uncommitted {"state-uncommitted"};
+const string MenderContext::deployment_status_queue_key {"deployment-status-queue"};
 const string MenderContext::update_control_maps {"update-control-maps"};
 const string MenderContext::auth_token_name {"authtoken"};
 const string MenderContext::auth_token_cache_invalidator_name {"auth-token-cache-invalidator"};
@@ -95,25 +96,38 @@ error::Error MakeError(MenderContextErrorCode code, const string &msg) {
 	return error::Error(error_condition(code, MenderContextErrorCategory), msg);
 }
 
+#ifdef MENDER_USE_LMDB
+static kv_db::Durability StoreDurability(const string &setting) {
+	if (setting == "" || setting == "full") {
+		return kv_db::Durability::Full;
+	} else if (setting == "no-meta-sync") {
+		return kv_db::Durability::NoMetaSync;
+	} else if (setting == "no-sync") {
+		return kv_db::Durability::NoSync;
+	}
+	log::Warning(
+		"Unknown StateDatabaseDurability setting `" + setting + "`, using `full` instead");
+	return kv_db::Durability::Full;
+}
+#endif // MENDER_USE_LMDB
+
 error::Error MenderContext::Initialize() {
 #ifdef MENDER_USE_LMDB
-	auto err = mender_store_.Open(path::Join(config_.paths.GetDataStore(), "mender-store"));
-	if (error::NoError != err) {
-		return err;
-	}
-	err = mender_store_.Remove(auth_token_name);
+	auto err = mender_store_.Open(
+		path::Join(config_.paths.GetDataStore(), "mender-store"),
+		StoreDurability(config_.state_database_durability));
 	if (error::NoError != err) {
-		// key not existing in the DB is not treated as an error so this must be
-		// a real error
 		return err;
 	}
-	err = mender_store_.Remove(auth_token_cache_invalidator_name);
-	if (error::NoError != err) {
-		// same as above -- a real error
-		return err;
-	}
-
-	return error::NoError;
+	// key not existing in the DB is not treated as an error so any error here must be a real
+	// error
+	return mender_store_.WriteTransaction([](kv_db::Transaction &txn) {
+		auto err = txn.Remove(auth_token_name);
+		if (error::NoError != err) {
+			return err;
+		}
+		return txn.Remove(auth_token_cache_invalidator_name);
+	});
 #else
 	return error::NoError;
 #endif
@@ -123,6 +137,10 @@ kv_db::KeyValueDatabase &MenderContext::GetMenderStoreDB() {
 	return mender_store_;
 }
 
+error::Error MenderContext::SyncMenderStoreDB() {
+	return mender_store_.Sync();
+}
+
 ExpectedProvidesData MenderContext::LoadProvides() {
 	ExpectedProvidesData data;
 	auto err = mender_store_.ReadTransaction([this, &data](kv_db::Transaction &txn) {
@@ -141,7 +159,6 @@ ExpectedProvidesData MenderContext::LoadProvides() {
 ExpectedProvidesData MenderContext::LoadProvides(kv_db::Transaction &txn) {
 	string artifact_name;
 	string artifact_group;
-	string artifact_provides_str;
 
 	auto err = kv_db::ReadString(txn, artifact_name_key, artifact_name, true);
 	if (err != error::NoError) {
@@ -151,24 +168,34 @@ ExpectedProvidesData MenderContext::LoadProvides(kv_db::Transaction &txn) {
 	if (err != error::NoError) {
 		return expected::unexpected(err);
 	}
-	err = kv_db::ReadString(txn, artifact_provides_key, artifact_provides_str, true);
-	if (err != error::NoError) {
+
+	// The provides can be large, so parse them straight from the database.
+	json::ExpectedJson ex_j;
+	bool have_provides = false;
+	err = txn.ReadView(
+		artifact_provides_key, [&ex_j, &have_provides](const uint8_t *data, size_t size) {
+			if (size > 0) {
+				ex_j = json::Load(data, size);
+				have_provides = true;
+			}
+			return error::NoError;
+		});
+	if (err != error::NoError && err.code != kv_db::MakeError(kv_db::KeyError, "").code) {
 		return expected::unexpected(err);
 	}
 
 	ProvidesData ret {};
 	if (artifact_name != "") {
-		ret["artifact_name"] = artifact_name;
+		ret["artifact_name"] = std::move(artifact_name);
 	}
 	if (artifact_group != "") {
-		ret["artifact_group"] = artifact_group;
+		ret["artifact_group"] = std::move(artifact_group);
 	}
-	if (artifact_provides_str == "") {
+	if (!have_provides) {
 		// nothing more to do
 		return ret;
 	}
 
-	auto ex_j = json::Load(artifact_provides_str);
 	if (!ex_j) {
 		return expected::unexpected(ex_j.error());
 	}
@@ -184,7 +211,7 @@ ExpectedProvidesData MenderContext::LoadProvides(kv_db::Transaction &txn) {
 		auto err = json::MakeError(json::TypeError, "Unexpected non-string data in provides");
 		return expected::unexpected(err);
 	}
-	for (const auto &it : ex_children.value()) {
+	for (const auto &it : children) {
 		ret[it.first] = it.second.GetString().value();
 	}
 
@@ -14,6 +14,8 @@
 
 #include <mender-update/daemon/context.hpp>
 
+#include <algorithm>
+
 #include <common/common.hpp>
 #include <client_shared/conf.hpp>
 #include <common/log.hpp>
@@ -30,7 +32,8 @@ namespace http_resumer = mender::common::http::resumer;
 
 namespace main_context = mender::update::context;
 
-const int kStateDataVersion = 2;
+const int kStateDataVersion = 3;
+const int kStateDataJsonVersion = 2;
 
 // The maximum times we are allowed to move through update states. If this is exceeded then the
 // update will be forcefully aborted. This can happen if we are in a reboot loop, for example.
@@ -147,6 +150,11 @@ void StateData::FillUpdateDataFromArtifact(artifact::PayloadHeaderView &view) {
 	}
 }
 
+static http::ClientConfig WithKeepAlive(http::ClientConfig config) {
+	config.keep_alive = true;
+	return config;
+}
+
 Context::Context(
 	mender::update::context::MenderContext &mender_context, events::EventLoop &event_loop) :
 	mender_context(mender_context),
@@ -156,10 +164,12 @@ Context::Context(
 #elif defined(MENDER_EMBED_MENDER_AUTH)
 	authenticator(event_loop, mender_context.GetConfig()),
 #endif
-	http_client(mender_context.GetConfig().GetHttpClientConfig(), event_loop, authenticator),
+	http_client(
+		WithKeepAlive(mender_context.GetConfig().GetHttpClientConfig()), event_loop, authenticator),
 	download_client(make_shared<http_resumer::DownloadResumerClient>(
 		mender_context.GetConfig().GetHttpClientConfig(), event_loop)),
 	deployment_client(make_shared<deployments::DeploymentClient>()),
+	status_reporter(mender_context),
 	inventory_client(make_shared<inventory::InventoryClient>()) {
 }
 
@@ -318,6 +328,177 @@ static string GenerateStateDataJson(const StateData &state_data) {
 	return std::move(*content.rdbuf()).str();
 }
 
+// The binary encoding of the state data starts with these bytes, which can't start a JSON
+// document, followed by the version as a 32-bit little endian number. The fields follow in a fixed
+// order; numbers and lengths are LEB128 encoded, and strings are not terminated.
+static const string kStateDataMagic {"\0MSD", 4};
+
+class StateDataEncoder {
+public:
+	void Version(uint32_t version) {
+		data_.insert(data_.end(), kStateDataMagic.begin(), kStateDataMagic.end());
+		for (int i = 0; i < 4; i++) {
+			data_.push_back(static_cast<uint8_t>(version >> (i * 8)));
+		}
+	}
+
+	void Uint(uint64_t value) {
+		while (value >= 0x80) {
+			data_.push_back(static_cast<uint8_t>(value) | 0x80);
+			value >>= 7;
+		}
+		data_.push_back(static_cast<uint8_t>(value));
+	}
+
+	void String(const string &str) {
+		Uint(str.size());
+		data_.insert(data_.end(), str.begin(), str.end());
+	}
+
+	void StringVector(const vector<string> &vec) {
+		Uint(vec.size());
+		for (const auto &str : vec) {
+			String(str);
+		}
+	}
+
+	void StringMap(const unordered_map<string, string> &map) {
+		Uint(map.size());
+		for (const auto &entry : map) {
+			String(entry.first);
+			String(entry.second);
+		}
+	}
+
+	vector<uint8_t> &Data() {
+		return data_;
+	}
+
+private:
+	vector<uint8_t> data_;
+};
+
+// Reads the fields written by StateDataEncoder. Running past the end of the data doesn't fail
+// straight away, but makes `Truncated()` return true.
+class StateDataDecoder {
+public:
+	StateDataDecoder(const uint8_t *data, size_t size) :
+		data_ {data},
+		size_ {size} {
+	}
+
+	static bool IsBinary(const uint8_t *data, size_t size) {
+		return size >= kStateDataMagic.size()
+			   && equal(kStateDataMagic.begin(), kStateDataMagic.end(), data);
+	}
+
+	uint32_t Version() {
+		if (size_ < kStateDataMagic.size() + 4) {
+			truncated_ = true;
+			return 0;
+		}
+		uint32_t version = 0;
+		const uint8_t *version_data = data_ + pos_ + kStateDataMagic.size();
+		for (int i = 0; i < 4; i++) {
+			version |= static_cast<uint32_t>(version_data[i]) << (i * 8);
+		}
+		pos_ += kStateDataMagic.size() + 4;
+		return version;
+	}
+
+	uint64_t Uint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (pos_ >= size_) {
+				truncated_ = true;
+				return 0;
+			}
+			uint8_t byte = data_[pos_++];
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		truncated_ = true;
+		return 0;
+	}
+
+	string String() {
+		auto size = Uint();
+		if (truncated_ || size > size_ - pos_) {
+			truncated_ = true;
+			return "";
+		}
+		string str {reinterpret_cast<const char *>(data_ + pos_), static_cast<size_t>(size)};
+		pos_ += size;
+		return str;
+	}
+
+	vector<string> StringVector() {
+		vector<string> vec;
+		auto size = Uint();
+		// Each entry takes at least one byte, so don't trust a size larger than that.
+		for (uint64_t i = 0; i < size && !truncated_ && pos_ < size_; i++) {
+			vec.push_back(String());
+		}
+		if (vec.size() != size) {
+			truncated_ = true;
+		}
+		return vec;
+	}
+
+	unordered_map<string, string> StringMap() {
+		unordered_map<string, string> map;
+		auto size = Uint();
+		for (uint64_t i = 0; i < size && !truncated_ && pos_ < size_; i++) {
+			auto key = String();
+			map[key] = String();
+		}
+		if (map.size() != size) {
+			truncated_ = true;
+		}
+		return map;
+	}
+
+	bool Truncated() const {
+		return truncated_;
+	}
+
+private:
+	const uint8_t *data_;
+	size_t size_;
+	size_t pos_ {0};
+	bool truncated_ {false};
+};
+
+static vector<uint8_t> EncodeStateData(const StateData &state_data) {
+	StateDataEncoder enc;
+	enc.Version(kStateDataVersion);
+	enc.String(state_data.state);
+
+	auto &update_info = state_data.update_info;
+	enc.String(update_info.id);
+
+	auto &artifact = update_info.artifact;
+	enc.String(artifact.source.uri);
+	enc.String(artifact.source.expire);
+	enc.StringVector(artifact.compatible_devices);
+	enc.StringVector(artifact.payload_types);
+	enc.String(artifact.artifact_name);
+	enc.String(artifact.artifact_group);
+	enc.StringMap(artifact.type_info_provides);
+	enc.StringVector(artifact.clears_artifact_provides);
+
+	enc.StringVector(update_info.reboot_requested);
+	enc.String(update_info.supports_rollback);
+	enc.Uint(static_cast<uint64_t>(update_info.state_data_store_count));
+	enc.Uint(
+		(update_info.has_db_schema_update ? 1 : 0)
+		| (update_info.all_rollbacks_successful ? 2 : 0));
+
+	return std::move(enc.Data());
+}
+
 error::Error Context::SaveDeploymentStateData(kv_db::Transaction &txn, StateData &state_data) {
 	if (state_data.update_info.state_data_store_count++ >= kMaxStateDataStoreCount) {
 		return main_context::MakeError(
@@ -325,7 +506,13 @@ error::Error Context::SaveDeploymentStateData(kv_db::Transaction &txn, StateData
 			"State looping detected, breaking out of loop");
 	}
 
-	string content = GenerateStateDataJson(state_data);
+	// Until the update is committed, a rollback may bring back a client which only reads JSON.
+	vector<uint8_t> content;
+	if (state_data.version >= kStateDataVersion) {
+		content = EncodeStateData(state_data);
+	} else {
+		content = common::ByteVectorFromString(GenerateStateDataJson(state_data));
+	}
 
 	string store_key;
 	if (state_data.update_info.has_db_schema_update) {
@@ -341,7 +528,7 @@ error::Error Context::SaveDeploymentStateData(kv_db::Transaction &txn, StateData
 		}
 	}
 
-	auto err = txn.Write(store_key, common::ByteVectorFromString(content));
+	auto err = txn.Write(store_key, content);
 	if (err != error::NoError) {
 		return err.WithContext("Could not write state data");
 	}
@@ -373,6 +560,27 @@ error::Error Context::SaveDeploymentStateData(StateData &state_data) {
 		dst = expr.value();                                                  \
 	}
 
+// Checks the values which have a fixed set of valid strings.
+static error::Error CheckUpdateInfoValues(const UpdateInfo &update_info) {
+	for (const auto &reboot_requested : update_info.reboot_requested) {
+		if (reboot_requested != "") {
+			auto exp_needs_reboot = DbStringToNeedsReboot(reboot_requested);
+			if (!exp_needs_reboot) {
+				return exp_needs_reboot.error();
+			}
+		}
+	}
+
+	if (update_info.supports_rollback != "") {
+		auto exp_supports_rollback = DbStringToSupportsRollback(update_info.supports_rollback);
+		if (!exp_supports_rollback) {
+			return exp_supports_rollback.error();
+		}
+	}
+
+	return error::NoError;
+}
+
 static error::Error UnmarshalJsonStateDataVersion1(const json::Json &json, StateData &state_data) {
 	auto exp_int = json.Get("Version").and_then(json::To<int>);
 	SetOrReturnIfError(state_data.version, exp_int);
@@ -419,11 +627,12 @@ static error::Error UnmarshalJsonStateDataVersion1(const json::Json &json, State
 	return error::NoError;
 }
 
+// Only versions 1 and 2 were stored as JSON.
 static error::Error UnmarshalJsonStateData(const json::Json &json, StateData &state_data) {
 	auto exp_int = json.Get("Version").and_then(json::To<int>);
 	SetOrReturnIfError(state_data.version, exp_int);
 
-	if (state_data.version != kStateDataVersion && state_data.version != 1) {
+	if (state_data.version != 2 && state_data.version != 1) {
 		return error::Error(
 			make_error_condition(errc::not_supported),
 			"State Data version not supported by this client (" + to_string(state_data.version)
@@ -494,25 +703,9 @@ static error::Error UnmarshalJsonStateData(const json::Json &json, StateData &st
 
 	exp_string_vector = json_update_info.Get("RebootRequested").and_then(json::ToStringVector);
 	SetOrReturnIfError(update_info.reboot_requested, exp_string_vector);
-	// Check that it's valid strings.
-	for (const auto &reboot_requested : update_info.reboot_requested) {
-		if (reboot_requested != "") {
-			auto exp_needs_reboot = DbStringToNeedsReboot(reboot_requested);
-			if (!exp_needs_reboot) {
-				return exp_needs_reboot.error();
-			}
-		}
-	}
 
 	exp_string = json_update_info.Get("SupportsRollback").and_then(json::ToString);
 	SetOrReturnIfError(update_info.supports_rollback, exp_string);
-	// Check that it's a valid string.
-	if (update_info.supports_rollback != "") {
-		auto exp_supports_rollback = DbStringToSupportsRollback(update_info.supports_rollback);
-		if (!exp_supports_rollback) {
-			return exp_supports_rollback.error();
-		}
-	}
 
 	auto exp_int64 = json_update_info.Get("StateDataStoreCount").and_then(json::ToInt64);
 	SetOrReturnIfError(update_info.state_data_store_count, exp_int64);
@@ -523,31 +716,113 @@ static error::Error UnmarshalJsonStateData(const json::Json &json, StateData &st
 	exp_bool = json_update_info.Get("AllRollbacksSuccessful").and_then(json::ToBool);
 	DefaultOrSetOrReturnIfError(update_info.all_rollbacks_successful, exp_bool, false);
 
-	return error::NoError;
+	return CheckUpdateInfoValues(update_info);
 }
 
 #undef SetOrReturnIfError
-#undef EmptyOrSetOrReturnIfError
+#undef DefaultOrSetOrReturnIfError
 
-expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
-	log::Trace("Loading the deployment state data");
+static error::Error DecodeStateData(const uint8_t *data, size_t size, StateData &state_data) {
+	StateDataDecoder dec {data, size};
 
-	auto &db = mender_context.GetMenderStoreDB();
-	auto err = db.WriteTransaction([this, &state_data](kv_db::Transaction &txn) {
-		auto exp_content = txn.Read(mender_context.state_data_key);
-		if (!exp_content) {
-			return exp_content.error().WithContext("Could not load state data");
+	auto version = dec.Version();
+	if (!dec.Truncated() && version != static_cast<uint32_t>(kStateDataVersion)) {
+		return error::Error(
+			make_error_condition(errc::not_supported),
+			"State Data version not supported by this client (" + to_string(version) + ")");
+	}
+	state_data.version = kStateDataVersion;
+
+	state_data.state = dec.String();
+
+	auto &update_info = state_data.update_info;
+	update_info.id = dec.String();
+
+	auto &artifact = update_info.artifact;
+	artifact.source.uri = dec.String();
+	artifact.source.expire = dec.String();
+	artifact.compatible_devices = dec.StringVector();
+	artifact.payload_types = dec.StringVector();
+	artifact.artifact_name = dec.String();
+	artifact.artifact_group = dec.String();
+	artifact.type_info_provides = dec.StringMap();
+	artifact.clears_artifact_provides = dec.StringVector();
+
+	update_info.reboot_requested = dec.StringVector();
+	update_info.supports_rollback = dec.String();
+	update_info.state_data_store_count = static_cast<int64_t>(dec.Uint());
+	auto flags = dec.Uint();
+	update_info.has_db_schema_update = (flags & 1) != 0;
+	update_info.all_rollbacks_successful = (flags & 2) != 0;
+
+	if (dec.Truncated()) {
+		return main_context::MakeError(main_context::DatabaseValueError, "Truncated state data");
+	}
+
+	// It's possible for there not to be an initialized update,
+	// if the deployment failed before we could successfully parse the artifact.
+	if (artifact.payload_types.size() != 1
+		and not(artifact.payload_types.size() == 0 and artifact.artifact_name == "")) {
+		return error::Error(
+			make_error_condition(errc::not_supported),
+			"Only exactly one payload type is supported. Got: "
+				+ to_string(artifact.payload_types.size()));
+	}
+
+	return CheckUpdateInfoValues(update_info);
+}
+
+// Loads the state data stored under `key`, in either encoding, straight from the database without
+// copying it out first. Fails with `KeyError` if there is no such key.
+static error::Error LoadStateData(
+	kv_db::Transaction &txn, const string &key, StateData &state_data) {
+	return txn.ReadView(key, [&key, &state_data](const uint8_t *data, size_t size) {
+		if (StateDataDecoder::IsBinary(data, size)) {
+			log::Trace("Got binary database state data content from `" + key + "`");
+			return DecodeStateData(data, size, state_data);
 		}
-		auto content = common::StringFromByteVector(exp_content.value());
 
-		auto exp_json = json::Load(content);
+		if (log::Level() >= log::LogLevel::Trace) {
+			log::Trace(
+				"Got database state data content from `" + key
+				+ "`: " + string(reinterpret_cast<const char *>(data), size));
+		}
+		auto exp_json = json::Load(data, size);
 		if (!exp_json) {
-			return exp_json.error().WithContext("Could not load state data");
+			return exp_json.error();
 		}
+		return UnmarshalJsonStateData(exp_json.value(), state_data);
+	});
+}
 
-		log::Trace("Got database state data content: " + content);
+// Loads the uncommitted state data, if there is any for the same update as `state_data`, and
+// replaces `state_data` with it.
+static error::Error LoadMatchingUncommittedStateData(
+	kv_db::Transaction &txn, StateData &state_data) {
+	StateData state_data_uncommitted {};
+	auto err = LoadStateData(
+		txn, main_context::MenderContext::state_data_key_uncommitted, state_data_uncommitted);
+	if (err != error::NoError) {
+		if (err.code != kv_db::MakeError(kv_db::KeyError, "").code) {
+			return err.WithContext("Could not load the uncommited state data");
+		}
+		log::Debug("Got read error reading the uncommitted state data: " + err.String());
+		return error::NoError;
+	}
+
+	// Verify that the update IDs are equal
+	if (state_data.update_info.id == state_data_uncommitted.update_info.id) {
+		state_data = state_data_uncommitted;
+	}
+	return error::NoError;
+}
 
-		auto err = UnmarshalJsonStateData(exp_json.value(), state_data);
+expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
+	log::Trace("Loading the deployment state data");
+
+	auto &db = mender_context.GetMenderStoreDB();
+	auto err = db.WriteTransaction([this, &state_data](kv_db::Transaction &txn) {
+		auto err = LoadStateData(txn, mender_context.state_data_key, state_data);
 		if (err != error::NoError) {
 			if (err.code == make_error_condition(errc::not_supported)) {
 				//
@@ -555,30 +830,17 @@ expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
 				//
 				// Try and load the uncommitted data, in case we are rolling back from an
 				// unsupported version
-				exp_content = txn.Read(mender_context.state_data_key_uncommitted);
-				if (!exp_content) {
-					if (exp_content.error().code != kv_db::MakeError(kv_db::KeyError, "").code) {
-						return exp_content.error().WithContext("Could not load state data");
-					}
-					return exp_content.error().WithContext("Could not load state data");
-				}
-
-				auto content = common::StringFromByteVector(exp_content.value());
-				log::Trace("Got database state data content from the uncommitted key: " + content);
-				auto exp_json = json::Load(content);
-				if (!exp_json) {
-					return exp_json.error().WithContext("Could not load state data");
-				}
 				StateData state_data_uncommitted {};
 
-				err = UnmarshalJsonStateData(exp_json.value(), state_data_uncommitted);
+				err = LoadStateData(
+					txn, mender_context.state_data_key_uncommitted, state_data_uncommitted);
 				if (err != error::NoError) {
 					return err.WithContext(
 						"Could not unmarshal the uncommited state data. This means we failed to roll back the state data");
 				}
 				state_data = state_data_uncommitted;
 			} else {
-				return err.WithContext("Failed to unmarshal the state data");
+				return err.WithContext("Could not load state data");
 			}
 		}
 
@@ -587,38 +849,15 @@ expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
 			//
 			// Roll forwards
 			//
-			log::Debug("Got old state data version 1. Migrating it to version 2");
+			log::Debug(
+				"Got old state data version 1. Migrating it to version "
+				+ to_string(kStateDataJsonVersion));
 
 			// We need to upgrade the schema. Check if we have
 			// already written an updated one.
-			exp_content = txn.Read(mender_context.state_data_key_uncommitted);
-			if (!exp_content) {
-				if (exp_content.error().code != kv_db::MakeError(kv_db::KeyError, "").code) {
-					return exp_content.error().WithContext("Could not load state data");
-				}
-				log::Debug(
-					"Got read error reading the uncommitted state data: "
-					+ exp_content.error().String());
-			} else {
-				auto content = common::StringFromByteVector(exp_content.value());
-				log::Trace("Loaded the uncommitted state data: " + content);
-
-				exp_json = json::Load(content);
-				if (!exp_json) {
-					return exp_json.error().WithContext("Could not load state data");
-				}
-
-				StateData state_data_uncommitted {};
-
-				auto inner_err = UnmarshalJsonStateData(exp_json.value(), state_data_uncommitted);
-				if (inner_err != error::NoError) {
-					return inner_err.WithContext("Could not load the uncommited state data");
-				}
-
-				// Verify that the update IDs are equal
-				if (state_data.update_info.id == state_data_uncommitted.update_info.id) {
-					state_data = state_data_uncommitted;
-				}
+			err = LoadMatchingUncommittedStateData(txn, state_data);
+			if (err != error::NoError) {
+				return err;
 			}
 
 			// If we are upgrading the schema, we know for a fact
@@ -634,10 +873,17 @@ expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
 
 			// Since we loaded from the uncommitted key, set this.
 			state_data.update_info.has_db_schema_update = true;
+			state_data.version = kStateDataJsonVersion;
 
 			break;
 		}
 		case 2:
+			// Version 2 has the same content as version 3, but is stored as JSON. Keep it that
+			// way until the update is committed, in case we roll back to a client which can't
+			// read the binary encoding.
+			state_data.update_info.has_db_schema_update = false;
+			break;
+		case 3:
 			state_data.update_info.has_db_schema_update = false;
 			break;
 		default:
@@ -646,7 +892,6 @@ expected::ExpectedBool Context::LoadDeploymentStateData(StateData &state_data) {
 				+ to_string(state_data.version));
 		}
 
-		state_data.version = 2;
 		log::Trace("Finished loading the state data");
 
 		// Every load also saves, which increments the state_data_store_count.
@@ -685,6 +930,77 @@ void Context::FinishDeploymentLogging() {
 	}
 }
 
+static progress::TrackerOptions ProgressOptions(const conf::MenderConfig &config) {
+	progress::TrackerOptions options;
+	options.interval = chrono::milliseconds(config.progress_interval_milliseconds);
+	return options;
+}
+
+progress::TrackerPtr Context::MakeProgressTracker(
+	const string &stage, int64_t total_bytes, deployments::DeploymentStatus status) {
+	const auto &config = mender_context.GetConfig();
+	if (config.progress_interval_milliseconds <= 0) {
+		return nullptr;
+	}
+
+	return make_shared<progress::Tracker>(
+		stage, total_bytes, ProgressOptions(config), [this, status](const progress::Event &event) {
+			PublishProgress(event, status);
+		});
+}
+
+void Context::TrackDownloadProgress(update_module::UpdateModule &update_module) {
+	const auto &config = mender_context.GetConfig();
+	if (config.progress_interval_milliseconds <= 0) {
+		return;
+	}
+
+	update_module.SetProgressHandler(
+		[this](const progress::Event &event) {
+			PublishProgress(event, deployments::DeploymentStatus::Downloading);
+		},
+		ProgressOptions(config));
+}
+
+void Context::PublishProgress(const progress::Event &event, deployments::DeploymentStatus status) {
+	log::Debug("Progress: " + progress::EventToString(event));
+
+#ifdef MENDER_USE_DBUS
+	if (!progress_dbus_failed_) {
+		auto err = progress_dbus_server_.EmitSignal<string>(
+			"/io/mender/UpdateManager",
+			"io.mender.UpdateProgress1",
+			"Progress",
+			progress::EventToJson(event));
+		if (err != error::NoError) {
+			log::Warning("Not sending progress signals on DBus: " + err.String());
+			progress_dbus_failed_ = true;
+		}
+	}
+#endif
+
+	auto interval = chrono::seconds(mender_context.GetConfig().progress_substate_interval_seconds);
+	if (interval.count() <= 0 || !deployment.state_data) {
+		return;
+	}
+	auto now = chrono::steady_clock::now();
+	if (!event.finished && last_progress_substate_
+		&& now - last_progress_substate_.value() < interval) {
+		return;
+	}
+	last_progress_substate_ = now;
+
+	auto err = status_reporter.Report(
+		*deployment_client,
+		http_client,
+		deployment.state_data->update_info.id,
+		status,
+		progress::EventToString(event));
+	if (err != error::NoError) {
+		log::Warning("Could not report progress substate: " + err.String());
+	}
+}
+
 } // namespace daemon
 } // namespace update
 } // namespace mender
@@ -15,6 +15,7 @@
 #ifndef MENDER_UPDATE_DAEMON_CONTEXT_HPP
 #define MENDER_UPDATE_DAEMON_CONTEXT_HPP
 
+#include <chrono>
 #include <memory>
 
 #include <common/error.hpp>
@@ -24,6 +25,10 @@
 #include <common/io.hpp>
 #include <common/json.hpp>
 #include <common/key_value_database.hpp>
+#include <common/optional.hpp>
+#ifdef MENDER_USE_DBUS
+#include <common/platform/dbus.hpp>
+#endif
 
 #include <artifact/artifact.hpp>
 
@@ -33,6 +38,7 @@
 #include <mender-update/context.hpp>
 #include <mender-update/deployments.hpp>
 #include <mender-update/inventory.hpp>
+#include <mender-update/progress_reader/progress_reader.hpp>
 #include <mender-update/update_module/v3/update_module.hpp>
 
 #ifdef MENDER_EMBED_MENDER_AUTH
@@ -60,13 +66,23 @@ namespace auth = mender::api::auth;
 
 namespace deployments = mender::update::deployments;
 namespace inventory = mender::update::inventory;
+namespace progress = mender::update::progress;
+
+#ifdef MENDER_USE_DBUS
+namespace dbus = mender::common::dbus;
+#endif
 
 namespace update_module = mender::update::update_module::v3;
 
 // current version of the format of StateData;
 // increase the version number once the format of StateData is changed
 // StateDataVersion = 2 was introduced in Mender 2.0.0.
+// StateDataVersion = 3 has the same content as 2, but is stored in a compact binary encoding
+// instead of JSON. Versions 1 and 2 can still be read.
 extern const int kStateDataVersion;
+// Newest version stored as JSON. New deployments are stored in this version until they are
+// committed, so that a rollback to an older client can still read them.
+extern const int kStateDataJsonVersion;
 
 struct ArtifactSource {
 	string uri;
@@ -129,7 +145,7 @@ struct UpdateInfo {
 
 struct StateData {
 	// version is providing information about the format of the data
-	int version {kStateDataVersion};
+	int version {kStateDataJsonVersion};
 	// number representing the id of the last state to execute
 	string state;
 	// update info and response data for the update that was in progress
@@ -157,6 +173,15 @@ public:
 	void BeginDeploymentLogging();
 	void FinishDeploymentLogging();
 
+	// Returns nullptr if progress tracking is disabled. Substates are sent with `status`.
+	progress::TrackerPtr MakeProgressTracker(
+		const string &stage, int64_t total_bytes, deployments::DeploymentStatus status);
+	// Makes `update_module` report its download progress, unless progress tracking is disabled.
+	void TrackDownloadProgress(update_module::UpdateModule &update_module);
+	// Emits the event as a DBus signal, and, if `ProgressSubstateIntervalSeconds` is set, reports
+	// it to the server as a substate of `status`, at most that often.
+	void PublishProgress(const progress::Event &event, deployments::DeploymentStatus status);
+
 	mender::update::context::MenderContext &mender_context;
 	events::EventLoop &event_loop;
 
@@ -167,12 +192,16 @@ public:
 #endif
 
 public:
-	// For polling, and for making status updates.
+	// For polling, and for making status updates. Keeps the connection open between requests,
+	// so that a series of status updates doesn't reconnect for every one of them.
 	api::HTTPClient http_client;
 	// For the artifact download.
 	shared_ptr<http::ClientInterface> download_client;
 
 	shared_ptr<deployments::DeploymentAPI> deployment_client;
+	// All deployment status updates go through this, using `deployment_client` and
+	// `http_client`.
+	deployments::StatusReporter status_reporter;
 	shared_ptr<inventory::InventoryAPI> inventory_client;
 
 	bool has_submitted_inventory {false};
@@ -180,6 +209,8 @@ public:
 	struct {
 		unique_ptr<StateData> state_data;
 		io::ReaderPtr artifact_reader;
+		// The source `artifact_reader` reads from. Payload data is read from it directly.
+		io::AsyncReaderPtr artifact_async_reader;
 		unique_ptr<artifact::Artifact> artifact_parser;
 		unique_ptr<artifact::Payload> artifact_payload;
 		unique_ptr<update_module::UpdateModule> update_module;
@@ -219,6 +250,14 @@ public:
 	static const string kRebootTypeNone;
 	static const string kRebootTypeCustom;
 	static const string kRebootTypeAutomatic;
+
+private:
+#ifdef MENDER_USE_DBUS
+	dbus::DBusServer progress_dbus_server_ {event_loop, "io.mender.UpdateManager"};
+	// Set after the first failure, so that a missing bus doesn't cost anything per event.
+	bool progress_dbus_failed_ {false};
+#endif
+	optional<chrono::steady_clock::time_point> last_progress_substate_;
 };
 
 } // namespace daemon
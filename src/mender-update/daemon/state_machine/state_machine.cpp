@@ -36,9 +36,13 @@ StateMachine::StateMachine(Context &ctx, events::EventLoop &event_loop) :
 	termination_handler_(event_loop),
 	submit_inventory_state_(event_loop),
 	poll_for_deployment_state_(event_loop),
-	send_download_status_state_(deployments::DeploymentStatus::Downloading),
-	send_install_status_state_(deployments::DeploymentStatus::Installing),
-	send_reboot_status_state_(deployments::DeploymentStatus::Rebooting),
+	send_download_status_state_(
+		deployments::DeploymentStatus::Downloading, SendStatusUpdateState::Delivery::Background),
+	send_install_status_state_(
+		deployments::DeploymentStatus::Installing, SendStatusUpdateState::Delivery::Background),
+	// The device may go down after this, so make sure the server knows first.
+	send_reboot_status_state_(
+		deployments::DeploymentStatus::Rebooting, SendStatusUpdateState::Delivery::Wait),
 	send_commit_status_state_(
 		deployments::DeploymentStatus::Installing,
 		event_loop,
@@ -170,6 +170,29 @@ void PollForDeploymentState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &
 			}
 		});
 
+	// Statuses which could not be delivered during an earlier deployment go first.
+	auto exp_pending = ctx.status_reporter.HasPending();
+	if (!exp_pending) {
+		log::Error(
+			"Could not check for undelivered deployment statuses: "
+			+ exp_pending.error().String());
+	} else if (exp_pending.value()) {
+		log::Info("Sending undelivered deployment status updates");
+		ctx.status_reporter.Flush(
+			*ctx.deployment_client, ctx.http_client, [&ctx, &poster](error::Error err) {
+				if (err != error::NoError) {
+					log::Error("Could not send deployment status: " + err.String());
+				}
+				CheckForDeployment(ctx, poster);
+			});
+		return;
+	}
+
+	CheckForDeployment(ctx, poster);
+}
+
+void PollForDeploymentState::CheckForDeployment(
+	Context &ctx, sm::EventPoster<StateEvent> &poster) {
 	auto err = ctx.deployment_client->CheckNewDeployments(
 		ctx.mender_context,
 		ctx.http_client,
@@ -292,6 +315,7 @@ void UpdateDownloadState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &pos
 				poster.PostEvent(StateEvent::Failure);
 				return;
 			}
+			ctx.deployment.artifact_async_reader = http_reader.value();
 			ctx.deployment.artifact_reader =
 				make_shared<events::io::ReaderFromAsyncReader>(ctx.event_loop, http_reader.value());
 			ParseArtifact(ctx, poster);
@@ -330,7 +354,11 @@ void UpdateDownloadState::ParseArtifact(Context &ctx, sm::EventPoster<StateEvent
 		.artifact_scripts_version = 3,
 		.artifact_verify_keys = ctx.mender_context.GetConfig().artifact_verify_keys,
 	};
-	auto exp_parser = artifact::Parse(*ctx.deployment.artifact_reader, config);
+	auto exp_parser = artifact::Parse(
+		*ctx.deployment.artifact_reader,
+		*ctx.deployment.artifact_async_reader,
+		ctx.event_loop,
+		config);
 	if (!exp_parser) {
 		log::Error(exp_parser.error().String());
 		poster.PostEvent(StateEvent::Failure);
@@ -387,6 +415,7 @@ void UpdateDownloadState::ParseArtifact(Context &ctx, sm::EventPoster<StateEvent
 
 	ctx.deployment.update_module.reset(
 		new update_module::UpdateModule(ctx.mender_context, header.header.payload_type));
+	ctx.TrackDownloadProgress(*ctx.deployment.update_module);
 
 	err = ctx.deployment.update_module->CleanAndPrepareFileTree(
 		ctx.deployment.update_module->GetUpdateModuleWorkDir(), header);
@@ -455,8 +484,10 @@ void UpdateDownloadState::DoDownload(Context &ctx, sm::EventPoster<StateEvent> &
 	}
 }
 
-SendStatusUpdateState::SendStatusUpdateState(optional<deployments::DeploymentStatus> status) :
+SendStatusUpdateState::SendStatusUpdateState(
+	optional<deployments::DeploymentStatus> status, Delivery delivery) :
 	status_(status),
+	delivery_(delivery),
 	mode_(FailureMode::Ignore) {
 }
 
@@ -466,6 +497,7 @@ SendStatusUpdateState::SendStatusUpdateState(
 	int retry_interval_seconds,
 	int retry_count) :
 	status_(status),
+	delivery_(Delivery::Wait),
 	mode_(FailureMode::RetryThenFail),
 	retry_(Retry {
 		http::ExponentialBackoff(chrono::seconds(retry_interval_seconds), retry_count),
@@ -559,14 +591,23 @@ void SendStatusUpdateState::DoStatusUpdate(Context &ctx, sm::EventPoster<StateEv
 		}
 	}
 
-	// Push status.
-	log::Debug("Pushing deployment status: " + DeploymentStatusString(status));
-	auto err = ctx.deployment_client->PushStatus(
-		ctx.deployment.state_data->update_info.id,
-		status,
-		"",
+	auto err = ctx.status_reporter.Report(
+		*ctx.deployment_client,
 		ctx.http_client,
-		[result_handler, &ctx](error::Error err) {
+		ctx.deployment.state_data->update_info.id,
+		status);
+	if (err != error::NoError) {
+		result_handler(err);
+		return;
+	}
+
+	if (delivery_ == Delivery::Background) {
+		poster.PostEvent(StateEvent::Success);
+		return;
+	}
+
+	ctx.status_reporter.Flush(
+		*ctx.deployment_client, ctx.http_client, [result_handler, &ctx](error::Error err) {
 			// If there is an error, we don't submit logs now, but call the handler,
 			// which may schedule a retry later. If there is no error, and the
 			// deployment as a whole was successful, then also call the handler here,
@@ -588,20 +629,25 @@ void SendStatusUpdateState::DoStatusUpdate(Context &ctx, sm::EventPoster<StateEv
 			}
 		});
 
-	if (err != error::NoError) {
-		result_handler(err);
-	}
-
 	// No action, wait for reply from status endpoint.
 }
 
 void UpdateInstallState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
 	log::Debug("Entering ArtifactInstall state");
 
+	// There are no bytes to count here, but the final event still tells how long it took.
+	auto tracker =
+		ctx.MakeProgressTracker("install", -1, deployments::DeploymentStatus::Installing);
+
 	DefaultAsyncErrorHandler(
 		poster,
 		ctx.deployment.update_module->AsyncArtifactInstall(
-			ctx.event_loop, DefaultStateHandler {poster}));
+			ctx.event_loop, [&poster, tracker](error::Error err) {
+				if (tracker) {
+					tracker->Finish();
+				}
+				DefaultStateHandler {poster}(err);
+			}));
 }
 
 void UpdateCheckRebootState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
@@ -630,9 +676,25 @@ void UpdateCheckRebootState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &
 			}));
 }
 
+// Flushes the state data saved so far, so that it survives what comes next. Returns false, and
+// posts a failure, if it can't be done.
+static bool SyncStateData(Context &ctx, sm::EventPoster<StateEvent> &poster) {
+	auto err = ctx.mender_context.SyncMenderStoreDB();
+	if (err != error::NoError) {
+		log::Error("Could not flush state data to disk: " + err.String());
+		poster.PostEvent(StateEvent::Failure);
+		return false;
+	}
+	return true;
+}
+
 void UpdateRebootState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
 	log::Debug("Entering ArtifactReboot state");
 
+	if (!SyncStateData(ctx, poster)) {
+		return;
+	}
+
 	assert(ctx.deployment.state_data->update_info.reboot_requested.size() == 1);
 	auto exp_reboot_mode =
 		DbStringToNeedsReboot(ctx.deployment.state_data->update_info.reboot_requested[0]);
@@ -692,6 +754,10 @@ void UpdateCommitState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poste
 		return;
 	}
 
+	if (!SyncStateData(ctx, poster)) {
+		return;
+	}
+
 	DefaultAsyncErrorHandler(
 		poster,
 		ctx.deployment.update_module->AsyncArtifactCommit(
@@ -699,11 +765,13 @@ void UpdateCommitState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poste
 }
 
 void UpdateAfterCommitState::OnEnterSaveState(Context &ctx, sm::EventPoster<StateEvent> &poster) {
-	// Now we have committed. If we had a schema update, re-save state data with the new schema.
+	// Now we have committed. If we had a schema update, or the state data is still stored in the
+	// JSON format, re-save state data with the new schema.
 	assert(ctx.deployment.state_data);
 	auto &state_data = *ctx.deployment.state_data;
-	if (state_data.update_info.has_db_schema_update) {
+	if (state_data.update_info.has_db_schema_update || state_data.version < kStateDataVersion) {
 		state_data.update_info.has_db_schema_update = false;
+		state_data.version = kStateDataVersion;
 		auto err = ctx.SaveDeploymentStateData(state_data);
 		if (err != error::NoError) {
 			log::Error("Not able to commit schema update: " + err.String());
@@ -763,7 +831,11 @@ void UpdateRollbackRebootState::OnEnter(Context &ctx, sm::EventPoster<StateEvent
 		poster.PostEvent(StateEvent::Success);
 	};
 
-	error::Error err;
+	auto err = ctx.mender_context.SyncMenderStoreDB();
+	if (err != error::NoError) {
+		log::Error("Could not flush state data to disk: " + err.String());
+	}
+
 	switch (exp_reboot_mode.value()) {
 	case update_module::RebootAction::No:
 		// Should not happen because then we don't enter this state.
@@ -884,6 +956,11 @@ void UpdateSaveProvidesState::OnEnter(Context &ctx, sm::EventPoster<StateEvent>
 		return;
 	}
 
+	// The new artifact name must not get lost, now that the update is permanent.
+	if (!SyncStateData(ctx, poster)) {
+		return;
+	}
+
 	poster.PostEvent(StateEvent::Success);
 }
 
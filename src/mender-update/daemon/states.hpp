@@ -64,6 +64,8 @@ public:
 	void OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) override;
 
 private:
+	static void CheckForDeployment(Context &ctx, sm::EventPoster<StateEvent> &poster);
+
 	events::Timer poll_timer_;
 };
 
@@ -105,8 +107,16 @@ private:
 
 class SendStatusUpdateState : virtual public StateType {
 public:
+	enum class Delivery {
+		// Continue as soon as the status is queued. If a later status is queued before this
+		// one is sent, only the later one is sent.
+		Background,
+		// Wait until the status has been sent, or failed to be sent.
+		Wait,
+	};
+
 	// Ignore-failure version.
-	SendStatusUpdateState(optional<deployments::DeploymentStatus> status);
+	SendStatusUpdateState(optional<deployments::DeploymentStatus> status, Delivery delivery);
 	// Retry-then-fail version.
 	SendStatusUpdateState(
 		optional<deployments::DeploymentStatus> status,
@@ -127,6 +137,7 @@ private:
 	};
 
 	optional<deployments::DeploymentStatus> status_;
+	Delivery delivery_;
 	FailureMode mode_;
 	struct Retry {
 		http::ExponentialBackoff backoff;
@@ -138,6 +138,71 @@ public:
 		LogsAPIResponseHandler api_handler) override;
 };
 
+// How many times a queued status update is attempted before it is given up on.
+const int MaxStatusDeliveryAttempts = 20;
+
+/**
+ * Sends deployment status updates to the server, one at a time, in the order they were reported.
+ *
+ * A status which is reported while an earlier one is still being sent replaces any status which
+ * is waiting to be sent, so on a slow link the intermediate states are skipped, and only the most
+ * recent status reaches the server. Once a status fails to be delivered, the queue is kept in the
+ * database until it has been sent, so that it is retried after a restart. Statuses which are
+ * delivered on the first attempt never touch the database.
+ *
+ * Reporting doesn't wait for the delivery. Use `Flush()` at the points where the server needs to
+ * know about the status before the deployment can continue.
+ */
+class StatusReporter {
+public:
+	StatusReporter(context::MenderContext &ctx) :
+		ctx_ {ctx} {
+	}
+
+	// Queues the status, and starts sending the queue if it isn't being sent already. The
+	// `api` and `client` must stay valid until the queue has been sent.
+	error::Error Report(
+		DeploymentAPI &api,
+		api::Client &client,
+		const string &deployment_id,
+		DeploymentStatus status,
+		const string &substate = "");
+
+	// Sends everything in the queue, and then calls `handler`. If a status can't be delivered,
+	// `handler` is called with the error straight away, and the status stays in the queue until
+	// the next `Flush()`, unless a later `Report()` replaces it. The exception is
+	// `DeploymentAbortedError`, after which all statuses of that deployment are dropped.
+	void Flush(DeploymentAPI &api, api::Client &client, StatusAPIResponseHandler handler);
+
+	// Whether there are statuses which have not been delivered yet.
+	expected::ExpectedBool HasPending();
+
+private:
+	struct QueuedStatus {
+		string deployment_id;
+		DeploymentStatus status;
+		string substate;
+		int attempts;
+	};
+
+	static expected::expected<QueuedStatus, error::Error> ParseQueuedStatus(
+		const json::Json &entry);
+	error::Error LoadQueue();
+	error::Error StoreQueue();
+	void SendNext(DeploymentAPI &api, api::Client &client);
+	void HandleResult(DeploymentAPI &api, api::Client &client, error::Error err);
+	void CallFlushHandlers(error::Error err);
+
+	context::MenderContext &ctx_;
+	bool loaded_ {false};
+	// Whether the queue is in the database.
+	bool stored_ {false};
+	// The front element is the one being sent, if `sending_` is true.
+	vector<QueuedStatus> queue_;
+	bool sending_ {false};
+	vector<StatusAPIResponseHandler> flush_handlers_;
+};
+
 /**
  * A helper class only declared here because of testing. Not to be used
  * separately outside of PushLogs().
@@ -154,6 +219,7 @@ public:
 
 	expected::ExpectedSize Read(
 		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
+	expected::ExpectedSize ReadV(const io::MutableBufferChain &buffers) override;
 
 	error::Error Rewind() {
 		header_rem_ = header_.size();
@@ -167,6 +233,10 @@ public:
 	}
 
 private:
+	// Reads from whichever of header, log data and closing is current, never across them.
+	expected::ExpectedSize ReadPiece(
+		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end);
+
 	shared_ptr<io::FileReader> reader_;
 	int64_t raw_data_size_;
 	int64_t rem_raw_data_size_;
@@ -27,6 +27,7 @@
 #include <common/http.hpp>
 #include <common/io.hpp>
 #include <common/json.hpp>
+#include <common/key_value_database.hpp>
 #include <common/log.hpp>
 #include <common/optional.hpp>
 #include <mender-update/context.hpp>
@@ -46,6 +47,7 @@ namespace expected = mender::common::expected;
 namespace http = mender::common::http;
 namespace io = mender::common::io;
 namespace json = mender::common::json;
+namespace kv_db = mender::common::key_value_database;
 namespace log = mender::common::log;
 
 const DeploymentsErrorCategoryClass DeploymentsErrorCategory;
@@ -335,6 +337,264 @@ error::Error DeploymentClient::PushStatus(
 		});
 }
 
+static expected::expected<DeploymentStatus, error::Error> DeploymentStatusFromString(
+	const string &str) {
+	for (int i = 0; i < static_cast<int>(DeploymentStatus::End_); i++) {
+		if (deployment_status_strings[i] == str) {
+			return static_cast<DeploymentStatus>(i);
+		}
+	}
+	return expected::unexpected(
+		MakeError(InvalidDataError, "Unknown deployment status: \"" + str + "\""));
+}
+
+expected::expected<StatusReporter::QueuedStatus, error::Error> StatusReporter::ParseQueuedStatus(
+	const json::Json &entry) {
+	auto id = json::Get<string>(entry, "id", json::MissingOk::No);
+	if (!id) {
+		return expected::unexpected(id.error());
+	}
+	auto status_str = json::Get<string>(entry, "status", json::MissingOk::No);
+	if (!status_str) {
+		return expected::unexpected(status_str.error());
+	}
+	auto status = DeploymentStatusFromString(status_str.value());
+	if (!status) {
+		return expected::unexpected(status.error());
+	}
+	auto substate = json::Get<string>(entry, "substate", json::MissingOk::No);
+	if (!substate) {
+		return expected::unexpected(substate.error());
+	}
+	auto attempts = json::Get<int>(entry, "attempts", json::MissingOk::No);
+	if (!attempts) {
+		return expected::unexpected(attempts.error());
+	}
+	return QueuedStatus {id.value(), status.value(), substate.value(), attempts.value()};
+}
+
+error::Error StatusReporter::LoadQueue() {
+	if (loaded_) {
+		return error::NoError;
+	}
+
+	// Only try once, so that statuses from the database never end up behind newer ones.
+	loaded_ = true;
+
+	auto &db = ctx_.GetMenderStoreDB();
+	string queue_str;
+	auto err =
+		kv_db::ReadString(db, context::MenderContext::deployment_status_queue_key, queue_str);
+	if (err != error::NoError) {
+		return err;
+	}
+	if (queue_str == "") {
+		return error::NoError;
+	}
+	stored_ = true;
+
+	auto exp_json = json::Load(queue_str);
+	if (!exp_json) {
+		log::Error("Discarding undelivered deployment statuses: " + exp_json.error().String());
+		return StoreQueue();
+	}
+	auto exp_size = exp_json.value().GetArraySize();
+	if (!exp_size) {
+		log::Error("Discarding undelivered deployment statuses: " + exp_size.error().String());
+		return StoreQueue();
+	}
+	for (size_t i = 0; i < exp_size.value(); i++) {
+		auto exp_entry = exp_json.value().Get(i);
+		auto exp_status = exp_entry ? ParseQueuedStatus(exp_entry.value())
+									: expected::unexpected(exp_entry.error());
+		if (!exp_status) {
+			log::Error(
+				"Discarding undelivered deployment status: " + exp_status.error().String());
+			continue;
+		}
+		queue_.push_back(exp_status.value());
+	}
+
+	return error::NoError;
+}
+
+error::Error StatusReporter::StoreQueue() {
+	auto &db = ctx_.GetMenderStoreDB();
+	if (queue_.empty()) {
+		if (!stored_) {
+			return error::NoError;
+		}
+		auto err = db.Remove(context::MenderContext::deployment_status_queue_key);
+		if (err != error::NoError && err.code != kv_db::MakeError(kv_db::KeyError, "").code) {
+			return err;
+		}
+		stored_ = false;
+		return error::NoError;
+	}
+
+	stringstream queue_str;
+	queue_str << "[";
+	for (auto it = queue_.begin(); it != queue_.end(); it++) {
+		if (it != queue_.begin()) {
+			queue_str << ",";
+		}
+		queue_str << R"({"id":")" << json::EscapeString(it->deployment_id) << R"(","status":")"
+				  << DeploymentStatusString(it->status) << R"(","substate":")"
+				  << json::EscapeString(it->substate) << R"(","attempts":)" << it->attempts
+				  << "}";
+	}
+	queue_str << "]";
+	auto err = db.Write(
+		context::MenderContext::deployment_status_queue_key,
+		common::ByteVectorFromString(queue_str.str()));
+	if (err != error::NoError) {
+		return err;
+	}
+	stored_ = true;
+	return error::NoError;
+}
+
+error::Error StatusReporter::Report(
+	DeploymentAPI &api,
+	api::Client &client,
+	const string &deployment_id,
+	DeploymentStatus status,
+	const string &substate) {
+	AssertOrReturnError(deployment_id != "");
+
+	auto err = LoadQueue();
+	if (err != error::NoError) {
+		log::Error("Could not load undelivered deployment statuses: " + err.String());
+	}
+
+	// Everything which isn't being sent yet is superseded by the new status: Older statuses of
+	// the same deployment are not interesting anymore, and the server doesn't hand out a new
+	// deployment before it considers the previous one finished.
+	auto first = queue_.begin() + (sending_ ? 1 : 0);
+	for (auto it = first; it != queue_.end(); it++) {
+		log::Debug(
+			"Dropping unsent deployment status " + DeploymentStatusString(it->status)
+			+ " for deployment " + it->deployment_id);
+	}
+	queue_.erase(first, queue_.end());
+	queue_.push_back(QueuedStatus {deployment_id, status, substate, 0});
+
+	// Only keep the queue up to date once it's in the database. Statuses which are delivered
+	// on the first attempt don't need to be stored.
+	if (stored_) {
+		err = StoreQueue();
+		if (err != error::NoError) {
+			log::Error("Could not store the deployment status queue: " + err.String());
+		}
+	}
+
+	if (!sending_) {
+		SendNext(api, client);
+	}
+	return error::NoError;
+}
+
+void StatusReporter::Flush(
+	DeploymentAPI &api, api::Client &client, StatusAPIResponseHandler handler) {
+	auto err = LoadQueue();
+	if (err != error::NoError) {
+		log::Error("Could not load undelivered deployment statuses: " + err.String());
+	}
+
+	if (queue_.empty()) {
+		handler(error::NoError);
+		return;
+	}
+
+	flush_handlers_.push_back(handler);
+	if (!sending_) {
+		SendNext(api, client);
+	}
+}
+
+expected::ExpectedBool StatusReporter::HasPending() {
+	auto err = LoadQueue();
+	if (err != error::NoError) {
+		return expected::unexpected(err);
+	}
+	return !queue_.empty();
+}
+
+void StatusReporter::SendNext(DeploymentAPI &api, api::Client &client) {
+	if (queue_.empty()) {
+		CallFlushHandlers(error::NoError);
+		return;
+	}
+
+	auto &next = queue_.front();
+	log::Debug(
+		"Pushing deployment status: " + DeploymentStatusString(next.status) + " ("
+		+ to_string(queue_.size() - 1) + " more queued)");
+	sending_ = true;
+	auto err = api.PushStatus(
+		next.deployment_id,
+		next.status,
+		next.substate,
+		client,
+		[this, &api, &client](error::Error err) { HandleResult(api, client, err); });
+	if (err != error::NoError) {
+		HandleResult(api, client, err);
+	}
+}
+
+void StatusReporter::HandleResult(DeploymentAPI &api, api::Client &client, error::Error err) {
+	sending_ = false;
+	auto sent = queue_.front();
+	bool superseded = false;
+
+	if (err == error::NoError) {
+		queue_.erase(queue_.begin());
+	} else if (err.code == MakeError(DeploymentAbortedError, "").code) {
+		log::Info("Deployment " + sent.deployment_id + " was aborted, dropping its statuses");
+		queue_.erase(
+			remove_if(
+				queue_.begin(),
+				queue_.end(),
+				[&sent](const QueuedStatus &queued) {
+					return queued.deployment_id == sent.deployment_id;
+				}),
+			queue_.end());
+	} else if (queue_.size() > 1) {
+		// A newer status was reported while this one was being sent, so try that one instead.
+		superseded = true;
+		queue_.erase(queue_.begin());
+	} else if (++queue_.front().attempts >= MaxStatusDeliveryAttempts) {
+		log::Error(
+			"Giving up on delivering deployment status " + DeploymentStatusString(sent.status)
+			+ " for deployment " + sent.deployment_id);
+		queue_.erase(queue_.begin());
+	}
+
+	// Keep failed statuses in the database, so that they are retried after a restart.
+	if (err != error::NoError || stored_) {
+		auto store_err = StoreQueue();
+		if (store_err != error::NoError) {
+			log::Error("Could not store the deployment status queue: " + store_err.String());
+		}
+	}
+
+	if (err != error::NoError && !superseded) {
+		CallFlushHandlers(err);
+		return;
+	}
+
+	SendNext(api, client);
+}
+
+void StatusReporter::CallFlushHandlers(error::Error err) {
+	// Handlers may flush again, so don't iterate over the member.
+	vector<StatusAPIResponseHandler> handlers;
+	handlers.swap(flush_handlers_);
+	for (auto &handler : handlers) {
+		handler(err);
+	}
+}
+
 using mender::common::expected::ExpectedSize;
 
 static ExpectedSize GetLogFileDataSize(const string &path) {
@@ -361,6 +621,31 @@ const vector<uint8_t> JsonLogMessagesReader::header_ = {
 const vector<uint8_t> JsonLogMessagesReader::closing_ = {']', '}'};
 
 ExpectedSize JsonLogMessagesReader::Read(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
+	return ReadV({io::MutableBuffer(start, end)});
+}
+
+ExpectedSize JsonLogMessagesReader::ReadV(const io::MutableBufferChain &buffers) {
+	// Header, log data and closing are produced straight into the caller's buffers, one piece
+	// after the other, so one call can deliver all of them.
+	size_t total = 0;
+	for (const auto &buf : buffers) {
+		auto start = buf.start;
+		while (start != buf.end) {
+			auto ex_sz = ReadPiece(start, buf.end);
+			if (!ex_sz) {
+				return ex_sz;
+			} else if (ex_sz.value() == 0) {
+				return total;
+			}
+			start += ex_sz.value();
+			total += ex_sz.value();
+		}
+	}
+	return total;
+}
+
+ExpectedSize JsonLogMessagesReader::ReadPiece(
 	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
 	if (header_rem_ > 0) {
 		io::Vsize target_size = end - start;
@@ -0,0 +1,600 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <mender-update/native_installer/native_installer.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <common/common.hpp>
+#include <common/log.hpp>
+#include <common/path.hpp>
+
+namespace mender {
+namespace update {
+namespace native_installer {
+
+namespace common = mender::common;
+namespace log = mender::common::log;
+namespace path = mender::common::path;
+
+// Marks that there was nothing at the destination before the update, so that rolling back means
+// removing it.
+const string CreatedMarker = "native-installer-created";
+// Marks that the destination is being replaced, and holds the `ContentId()` of the new content.
+const string InstallingMarker = "native-installer-installing";
+
+static error::Error ErrnoError(int err, const string &msg) {
+	return error::Error(generic_category().default_error_condition(err), msg);
+}
+
+// Reads the whole file, without trailing newlines, like `$(cat file)` would.
+static expected::ExpectedString ReadFile(const string &file) {
+	ifstream stream(file);
+	if (!stream) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot open " + file));
+	}
+	string content {istreambuf_iterator<char>(stream), istreambuf_iterator<char>()};
+	while (content.size() > 0 && content.back() == '\n') {
+		content.pop_back();
+	}
+	return content;
+}
+
+// Reads one of the meta data files from the file tree.
+static expected::ExpectedString ReadTreeFile(const string &work_dir, const string &name) {
+	return ReadFile(path::Join(work_dir, string("files"), name));
+}
+
+static expected::ExpectedString ReadDestDir(const string &work_dir) {
+	auto dest_dir = ReadTreeFile(work_dir, "dest_dir");
+	if (!dest_dir) {
+		return dest_dir;
+	}
+	auto dir = dest_dir.value();
+	while (dir.size() > 1 && dir.back() == '/') {
+		dir.pop_back();
+	}
+	if (dir == "" || !path::IsAbsolute(dir)) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::invalid_argument),
+			"Destination directory must be an absolute path, got: '" + dest_dir.value() + "'"));
+	}
+	return dir;
+}
+
+static error::Error SyncPath(const string &file) {
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		int err = errno;
+		return ErrnoError(err, "Cannot open " + file);
+	}
+	int result = fsync(fd);
+	int err = errno;
+	close(fd);
+	if (result != 0) {
+		return ErrnoError(err, "Cannot sync " + file);
+	}
+	return error::NoError;
+}
+
+// Writes a marker file, and makes sure that it survives a crash before anything which relies on
+// it is done.
+static error::Error WriteMarker(const string &file, const string &content) {
+	ofstream stream(file);
+	if (!stream) {
+		int err = errno;
+		return ErrnoError(err, "Cannot create " + file);
+	}
+	stream << content;
+	stream.close();
+	if (!stream) {
+		int err = errno;
+		return ErrnoError(err, "Cannot write " + file);
+	}
+	auto err = SyncPath(file);
+	if (err != error::NoError) {
+		return err;
+	}
+	return SyncPath(path::DirName(file));
+}
+
+static bool ExchangeNotSupported(const error::Error &err) {
+	return err.code == make_error_condition(errc::invalid_argument)
+		   || err.code == make_error_condition(errc::function_not_supported);
+}
+
+// Atomically swaps the two paths, which must both exist.
+static error::Error Exchange(const string &from, const string &to) {
+	if (renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_EXCHANGE) != 0) {
+		int err = errno;
+		return ErrnoError(err, "Cannot exchange " + from + " and " + to);
+	}
+	return error::NoError;
+}
+
+// Identifies the content at `file`, even after it is renamed or exchanged with something else.
+static expected::ExpectedString ContentId(const string &file) {
+	struct stat st;
+	if (lstat(file.c_str(), &st) != 0) {
+		int err = errno;
+		return expected::unexpected(ErrnoError(err, "Cannot stat " + file));
+	}
+	return to_string(st.st_dev) + ":" + to_string(st.st_ino);
+}
+
+static bool SameContent(const string &file, const string &id) {
+	auto file_id = ContentId(file);
+	return file_id && file_id.value() == id;
+}
+
+static bool IsDirectory(const string &file) {
+	struct stat st;
+	return lstat(file.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Replaces `dest` with `staging`, keeping the old content at `backup`, for filesystems which
+// can't exchange the two atomically.
+static error::Error ReplaceWithoutExchange(
+	const string &staging, const string &dest, const string &backup) {
+	if (!IsDirectory(dest)) {
+		// Keep a hard link to the old file, and then replace it in one rename, so that the
+		// destination exists all along.
+		if (link(dest.c_str(), backup.c_str()) != 0) {
+			int err = errno;
+			return ErrnoError(err, "Cannot link " + dest + " to " + backup);
+		}
+		return path::Rename(staging, dest);
+	}
+
+	// A non-empty directory can't be replaced in one rename. If this is interrupted,
+	// `RestoreOldContent()` moves the backup back to the missing destination.
+	log::Warning(
+		"Filesystem doesn't support exchanging " + dest
+		+ " atomically, it will be missing for a moment");
+	auto err = path::Rename(dest, backup);
+	if (err != error::NoError) {
+		return err;
+	}
+	return path::Rename(staging, dest);
+}
+
+// Puts the old content back at `dest`, from whatever state `Installer::Install()` left it in,
+// also if it was interrupted. `new_id` is the `ContentId()` of the new content.
+static error::Error RestoreOldContent(
+	const string &dest, const string &staging, const string &backup, const string &new_id) {
+	bool dest_exists = path::FileExists(dest);
+	if (!dest_exists || SameContent(dest, new_id)) {
+		// The old content is at the backup path, or still at the staging path if the
+		// exchange was done, but not the rename after it.
+		string old_content;
+		if (path::FileExists(backup) && !SameContent(backup, new_id)) {
+			old_content = backup;
+		} else if (path::FileExists(staging) && !SameContent(staging, new_id)) {
+			old_content = staging;
+		} else {
+			return error::Error(
+				make_error_condition(errc::no_such_file_or_directory),
+				"Cannot find the old content of " + dest);
+		}
+
+		error::Error err;
+		if (dest_exists) {
+			err = Exchange(old_content, dest);
+		}
+		if (!dest_exists || ExchangeNotSupported(err)) {
+			err = error::NoError;
+			if (IsDirectory(dest)) {
+				err = path::DeleteRecursively(dest);
+			}
+			if (err == error::NoError) {
+				// Replaces a file atomically.
+				err = path::Rename(old_content, dest);
+			}
+		}
+		if (err != error::NoError) {
+			return err;
+		}
+	}
+
+	// What is left is either the new content, or a hard link to the old one.
+	auto dest_id = ContentId(dest);
+	for (const auto &leftover : {staging, backup}) {
+		auto leftover_id = ContentId(leftover);
+		if (leftover_id
+			&& (leftover_id.value() == new_id
+				|| (dest_id && leftover_id.value() == dest_id.value()))) {
+			auto err = path::DeleteRecursively(leftover);
+			if (err != error::NoError) {
+				return err;
+			}
+		}
+	}
+	return error::NoError;
+}
+
+static error::Error ArchiveError(struct archive *archive, const string &msg) {
+	const char *archive_msg = archive_error_string(archive);
+	return error::Error(
+		make_error_condition(errc::io_error),
+		msg + ": " + (archive_msg != nullptr ? archive_msg : "Unknown error"));
+}
+
+static error::Error CheckDeadline(
+	chrono::steady_clock::time_point deadline, const string &tar_file) {
+	if (chrono::steady_clock::now() >= deadline) {
+		return error::Error(
+			make_error_condition(errc::timed_out), "Timed out extracting " + tar_file);
+	}
+	return error::NoError;
+}
+
+static error::Error Extract(
+	const string &tar_file, const string &dir, chrono::steady_clock::time_point deadline) {
+	unique_ptr<struct archive, decltype(&archive_read_free)> reader(
+		archive_read_new(), archive_read_free);
+	unique_ptr<struct archive, decltype(&archive_write_free)> writer(
+		archive_write_disk_new(), archive_write_free);
+	if (!reader || !writer) {
+		return error::Error(
+			make_error_condition(errc::not_enough_memory), "Cannot allocate archive handles");
+	}
+
+	archive_read_support_format_tar(reader.get());
+	archive_read_support_filter_all(reader.get());
+	if (archive_read_open_filename(reader.get(), tar_file.c_str(), 1024 * 1024) != ARCHIVE_OK) {
+		return ArchiveError(reader.get(), "Cannot open " + tar_file);
+	}
+
+	// Same as what `tar -xf` does, but without following anything out of `dir`.
+	int flags = ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL
+				| ARCHIVE_EXTRACT_XATTR | ARCHIVE_EXTRACT_FFLAGS | ARCHIVE_EXTRACT_SECURE_NODOTDOT
+				| ARCHIVE_EXTRACT_SECURE_SYMLINKS;
+	if (geteuid() == 0) {
+		flags |= ARCHIVE_EXTRACT_OWNER;
+	}
+	archive_write_disk_set_options(writer.get(), flags);
+	archive_write_disk_set_standard_lookup(writer.get());
+
+	while (true) {
+		auto err = CheckDeadline(deadline, tar_file);
+		if (err != error::NoError) {
+			return err;
+		}
+
+		struct archive_entry *entry;
+		int result = archive_read_next_header(reader.get(), &entry);
+		if (result == ARCHIVE_EOF) {
+			break;
+		} else if (result < ARCHIVE_WARN) {
+			return ArchiveError(reader.get(), "Cannot read " + tar_file);
+		}
+
+		archive_entry_set_pathname(entry, (dir + "/" + archive_entry_pathname(entry)).c_str());
+		const char *hardlink = archive_entry_hardlink(entry);
+		if (hardlink != nullptr) {
+			archive_entry_set_hardlink(entry, (dir + "/" + hardlink).c_str());
+		}
+
+		result = archive_write_header(writer.get(), entry);
+		if (result < ARCHIVE_WARN) {
+			return ArchiveError(
+				writer.get(), "Cannot extract " + string(archive_entry_pathname(entry)));
+		}
+		if (archive_entry_size(entry) > 0) {
+			const void *block;
+			size_t size;
+			la_int64_t offset;
+			while ((result = archive_read_data_block(reader.get(), &block, &size, &offset))
+				   == ARCHIVE_OK) {
+				// A single large file can take a long time on its own.
+				err = CheckDeadline(deadline, tar_file);
+				if (err != error::NoError) {
+					return err;
+				}
+				if (archive_write_data_block(writer.get(), block, size, offset) < ARCHIVE_WARN) {
+					return ArchiveError(
+						writer.get(), "Cannot write " + string(archive_entry_pathname(entry)));
+				}
+			}
+			if (result < ARCHIVE_WARN) {
+				return ArchiveError(reader.get(), "Cannot read " + tar_file);
+			}
+		}
+		if (archive_write_finish_entry(writer.get()) < ARCHIVE_WARN) {
+			return ArchiveError(
+				writer.get(), "Cannot finish " + string(archive_entry_pathname(entry)));
+		}
+	}
+
+	if (archive_write_close(writer.get()) != ARCHIVE_OK) {
+		return ArchiveError(writer.get(), "Cannot finish extracting " + tar_file);
+	}
+	return error::NoError;
+}
+
+InstallerPtr Installer::Create(const string &payload_type) {
+	if (payload_type == "directory") {
+		return InstallerPtr(new DirectoryInstaller);
+	} else if (payload_type == "single-file") {
+		return InstallerPtr(new SingleFileInstaller);
+	}
+	return nullptr;
+}
+
+expected::ExpectedString Installer::Call(
+	const string &state, const string &work_dir, chrono::seconds timeout) {
+	if (timeout == chrono::seconds {0}) {
+		deadline_ = chrono::steady_clock::time_point::max();
+	} else {
+		deadline_ = chrono::steady_clock::now() + timeout;
+	}
+
+	error::Error err;
+	if (state == "NeedsArtifactReboot") {
+		return "No";
+	} else if (state == "SupportsRollback") {
+		return "Yes";
+	} else if (state == "ArtifactInstall") {
+		err = Install(work_dir);
+	} else if (state == "ArtifactCommit") {
+		err = Commit(work_dir);
+	} else if (state == "ArtifactRollback") {
+		err = Rollback(work_dir);
+	} else if (state == "Cleanup") {
+		err = Cleanup(work_dir);
+	}
+	if (err != error::NoError) {
+		return expected::unexpected(err.WithContext(state));
+	}
+	return "";
+}
+
+error::Error Installer::Install(const string &work_dir) {
+	auto dest = Destination(work_dir);
+	if (!dest) {
+		return dest.error();
+	}
+	auto staging = dest.value() + StagingSuffix;
+	auto backup = dest.value() + BackupSuffix;
+	auto created_marker = path::Join(work_dir, string("tmp"), CreatedMarker);
+	auto installing_marker = path::Join(work_dir, string("tmp"), InstallingMarker);
+
+	error::Error err;
+	if (path::FileExists(installing_marker) || path::FileExists(created_marker)) {
+		// An earlier attempt was interrupted half way, put the old content back first.
+		err = Rollback(work_dir);
+		if (err != error::NoError) {
+			return err;
+		}
+	}
+
+	// Leftovers from an earlier attempt which was interrupted.
+	err = path::DeleteRecursively(staging);
+	if (err == error::NoError) {
+		err = path::DeleteRecursively(backup);
+	}
+	if (err == error::NoError) {
+		err = path::CreateDirectories(path::DirName(dest.value()));
+	}
+	if (err != error::NoError) {
+		return err;
+	}
+
+	err = Stage(work_dir, staging);
+	if (err != error::NoError) {
+		path::DeleteRecursively(staging);
+		return err;
+	}
+
+	if (!path::FileExists(dest.value())) {
+		err = WriteMarker(created_marker, "");
+		if (err == error::NoError) {
+			err = path::Rename(staging, dest.value());
+		}
+	} else {
+		// Record which content is the new one before touching the destination, so that
+		// `Rollback()` can find the old content whichever step below is interrupted.
+		auto new_id = ContentId(staging);
+		if (!new_id) {
+			return new_id.error();
+		}
+		err = WriteMarker(installing_marker, new_id.value());
+		if (err == error::NoError) {
+			err = Exchange(staging, dest.value());
+			if (err == error::NoError) {
+				err = path::Rename(staging, backup);
+			} else if (ExchangeNotSupported(err)) {
+				err = ReplaceWithoutExchange(staging, dest.value(), backup);
+			}
+		}
+	}
+	if (err != error::NoError) {
+		return err;
+	}
+
+	log::Info("Installed " + dest.value());
+	return SyncPath(path::DirName(dest.value()));
+}
+
+error::Error Installer::Commit(const string &work_dir) {
+	auto dest = Destination(work_dir);
+	if (!dest) {
+		return dest.error();
+	}
+
+	auto err = path::DeleteRecursively(dest.value() + BackupSuffix);
+	if (err == error::NoError) {
+		err = path::DeleteRecursively(dest.value() + StagingSuffix);
+	}
+	if (err == error::NoError) {
+		err = path::DeleteRecursively(path::Join(work_dir, string("tmp"), InstallingMarker));
+	}
+	if (err != error::NoError) {
+		return err;
+	}
+	return path::DeleteRecursively(path::Join(work_dir, string("tmp"), CreatedMarker));
+}
+
+error::Error Installer::Rollback(const string &work_dir) {
+	auto dest = Destination(work_dir);
+	if (!dest) {
+		return dest.error();
+	}
+	auto staging = dest.value() + StagingSuffix;
+	auto backup = dest.value() + BackupSuffix;
+	auto created_marker = path::Join(work_dir, string("tmp"), CreatedMarker);
+	auto installing_marker = path::Join(work_dir, string("tmp"), InstallingMarker);
+
+	error::Error err;
+	if (path::FileExists(installing_marker)) {
+		auto new_id = ReadFile(installing_marker);
+		if (!new_id) {
+			return new_id.error();
+		}
+		err = RestoreOldContent(dest.value(), staging, backup, new_id.value());
+		if (err == error::NoError) {
+			err = path::FileDelete(installing_marker);
+		}
+	} else if (path::FileExists(created_marker)) {
+		err = path::DeleteRecursively(dest.value());
+		if (err == error::NoError) {
+			err = path::DeleteRecursively(staging);
+		}
+		if (err == error::NoError) {
+			err = path::FileDelete(created_marker);
+		}
+	} else {
+		// Never got as far as installing anything.
+		return error::NoError;
+	}
+	if (err != error::NoError) {
+		return err;
+	}
+
+	log::Info("Rolled back " + dest.value());
+	return SyncPath(path::DirName(dest.value()));
+}
+
+error::Error Installer::Cleanup(const string &work_dir) {
+	auto dest = Destination(work_dir);
+	if (!dest) {
+		// Nothing was downloaded, so nothing can have been staged either.
+		return error::NoError;
+	}
+	auto staging = dest.value() + StagingSuffix;
+
+	auto installing_marker = path::Join(work_dir, string("tmp"), InstallingMarker);
+	if (path::FileExists(installing_marker)) {
+		// Neither committed nor rolled back, so the staging path may have the old content.
+		auto new_id = ReadFile(installing_marker);
+		auto staging_id = ContentId(staging);
+		if (staging_id && (!new_id || staging_id.value() != new_id.value())) {
+			log::Warning("Keeping " + staging + ", it may be the only copy of the old content");
+			return error::NoError;
+		}
+	}
+	return path::DeleteRecursively(staging);
+}
+
+expected::ExpectedString DirectoryInstaller::Destination(const string &work_dir) {
+	auto dest_dir = ReadDestDir(work_dir);
+	if (dest_dir && dest_dir.value() == "/") {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::invalid_argument),
+			"Destination directory is '/', install not supported"));
+	}
+	return dest_dir;
+}
+
+error::Error DirectoryInstaller::Stage(const string &work_dir, const string &staging) {
+	auto err = path::CreateDirectory(staging);
+	if (err != error::NoError) {
+		return err;
+	}
+	err = Extract(path::Join(work_dir, "files", "update.tar"), staging, deadline_);
+	if (err != error::NoError) {
+		return err;
+	}
+	return path::DataSyncRecursively(staging);
+}
+
+expected::ExpectedString SingleFileInstaller::Destination(const string &work_dir) {
+	auto dest_dir = ReadDestDir(work_dir);
+	if (!dest_dir) {
+		return dest_dir;
+	}
+	auto filename = ReadTreeFile(work_dir, "filename");
+	if (!filename) {
+		return filename;
+	}
+	if (filename.value() == "" || filename.value().find('/') != string::npos) {
+		return expected::unexpected(error::Error(
+			make_error_condition(errc::invalid_argument),
+			"Invalid file name: '" + filename.value() + "'"));
+	}
+	return path::Join(dest_dir.value(), filename.value());
+}
+
+error::Error SingleFileInstaller::Stage(const string &work_dir, const string &staging) {
+	auto filename = ReadTreeFile(work_dir, "filename");
+	if (!filename) {
+		return filename.error();
+	}
+	auto source = path::Join(work_dir, string("files"), filename.value());
+
+	// Link rather than copy the file, if it is on the same filesystem. Unlike moving it, this
+	// leaves the source in place, so that `Install()` can stage it again after rolling back an
+	// interrupted attempt.
+	if (link(source.c_str(), staging.c_str()) != 0) {
+		int errnum = errno;
+		if (errnum != EXDEV && errnum != EPERM) {
+			return ErrnoError(errnum, "Cannot link " + source + " to " + staging);
+		}
+		// Another filesystem, or one without hard links.
+		auto err = path::FileCopy(source, staging);
+		if (err != error::NoError) {
+			return err;
+		}
+	}
+
+	// Previous revisions of the Update Module did not have this file, so it might not exist.
+	auto permissions = ReadTreeFile(work_dir, "permissions");
+	if (permissions) {
+		auto mode = common::StringToLongLong(permissions.value(), 8);
+		if (!mode) {
+			return mode.error().WithContext("Invalid permissions");
+		}
+		if (chmod(staging.c_str(), static_cast<mode_t>(mode.value())) != 0) {
+			int errnum = errno;
+			return ErrnoError(errnum, "Cannot set permissions of " + staging);
+		}
+	}
+
+	return SyncPath(staging);
+}
+
+} // namespace native_installer
+} // namespace update
+} // namespace mender
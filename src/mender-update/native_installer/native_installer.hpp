@@ -0,0 +1,100 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef MENDER_UPDATE_NATIVE_INSTALLER_HPP
+#define MENDER_UPDATE_NATIVE_INSTALLER_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <common/error.hpp>
+#include <common/expected.hpp>
+
+namespace mender {
+namespace update {
+namespace native_installer {
+
+using namespace std;
+
+namespace error = mender::common::error;
+namespace expected = mender::common::expected;
+
+// Suffixes of the paths next to the destination where the new content is prepared, and where the
+// old content is kept until the update is committed or rolled back.
+const string StagingSuffix = ".mender-new";
+const string BackupSuffix = ".mender-backup";
+
+class Installer;
+using InstallerPtr = unique_ptr<Installer>;
+
+/**
+ * Built-in replacement for one of the Update Modules in `support/modules`, which installs the
+ * payload without spawning any processes. The new content is prepared next to the destination,
+ * and then swapped with the old content in one atomic rename. The old content is kept next to
+ * the destination until the update is committed, so rolling back is also just a rename.
+ *
+ * The payload files are expected in the `files` directory of the file tree, where they are put
+ * when the module doesn't consume the streams in the `Download` state.
+ */
+class Installer {
+public:
+	virtual ~Installer() {
+	}
+
+	// Returns nullptr if there is no built-in installer for the payload type.
+	static InstallerPtr Create(const string &payload_type);
+
+	// Handles the state or query with the given name, the same way as the Update Module of the
+	// same name, and returns what it would have printed. Extracting the payload gives up after
+	// `timeout`, unless it is zero. The other steps are renames, which are not interrupted.
+	expected::ExpectedString Call(
+		const string &state, const string &work_dir, chrono::seconds timeout = chrono::seconds {0});
+
+protected:
+	// Where the payload is installed.
+	virtual expected::ExpectedString Destination(const string &work_dir) = 0;
+	// Puts the new content at `staging`, which is on the same filesystem as the destination.
+	virtual error::Error Stage(const string &work_dir, const string &staging) = 0;
+
+	// When the current call should give up, see `Call()`.
+	chrono::steady_clock::time_point deadline_;
+
+private:
+	error::Error Install(const string &work_dir);
+	error::Error Commit(const string &work_dir);
+	error::Error Rollback(const string &work_dir);
+	error::Error Cleanup(const string &work_dir);
+};
+
+// Installs the `update.tar` payload file into the directory named in `dest_dir`.
+class DirectoryInstaller : public Installer {
+protected:
+	expected::ExpectedString Destination(const string &work_dir) override;
+	error::Error Stage(const string &work_dir, const string &staging) override;
+};
+
+// Installs the payload file named in `filename` into the directory named in `dest_dir`, with the
+// mode in `permissions`, if present.
+class SingleFileInstaller : public Installer {
+protected:
+	expected::ExpectedString Destination(const string &work_dir) override;
+	error::Error Stage(const string &work_dir, const string &staging) override;
+};
+
+} // namespace native_installer
+} // namespace update
+} // namespace mender
+
+#endif // MENDER_UPDATE_NATIVE_INSTALLER_HPP
@@ -14,18 +14,146 @@
 
 #include <mender-update/progress_reader/progress_reader.hpp>
 
-#include <vector>
 #include <cmath>
 #include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <common/json.hpp>
 
 namespace mender {
 namespace update {
 namespace progress {
 
+namespace json = mender::common::json;
+
+Tracker::Tracker(
+	const string &stage,
+	int64_t total_bytes,
+	const TrackerOptions &options,
+	EventHandler handler) :
+	options_ {options},
+	handler_ {handler},
+	start_ {chrono::steady_clock::now()} {
+	event_.stage = stage;
+	event_.total_bytes = total_bytes;
+	last_event_ = start_;
+}
+
+void Tracker::Finish() {
+	if (finished_) {
+		return;
+	}
+	Emit(chrono::steady_clock::now(), true);
+}
+
+void Tracker::Check() {
+	if (finished_) {
+		// Should not happen, but don't look at the clock for every read if it does.
+		next_check_ = numeric_limits<int64_t>::max();
+		return;
+	}
+
+	auto now = chrono::steady_clock::now();
+	if (event_.total_bytes >= 0 && bytes_ >= event_.total_bytes) {
+		Emit(now, true);
+		return;
+	}
+
+	next_check_ = bytes_ + options_.check_bytes;
+	if (!has_sent_ || now - last_event_ >= options_.interval) {
+		Emit(now, false);
+	}
+}
+
+void Tracker::Emit(chrono::steady_clock::time_point now, bool finished) {
+	auto since_start = chrono::duration<double>(now - start_).count();
+
+	event_.bytes = bytes_;
+	event_.elapsed = chrono::duration_cast<chrono::milliseconds>(now - start_);
+	event_.finished = finished;
+	if (finished) {
+		event_.bytes_per_second = since_start > 0 ? static_cast<double>(bytes_) / since_start : 0;
+		event_.eta_seconds = 0;
+	} else {
+		auto since_last = chrono::duration<double>(now - last_event_).count();
+		event_.bytes_per_second =
+			since_last > 0 ? static_cast<double>(bytes_ - last_event_bytes_) / since_last : 0;
+		if (event_.total_bytes >= 0 && bytes_ > 0 && since_start > 0) {
+			event_.eta_seconds = static_cast<int64_t>(
+				round(static_cast<double>(event_.total_bytes - bytes_) * since_start
+					  / static_cast<double>(bytes_)));
+		} else {
+			event_.eta_seconds = -1;
+		}
+	}
+
+	has_sent_ = true;
+	last_event_ = now;
+	last_event_bytes_ = bytes_;
+	if (finished) {
+		finished_ = true;
+		next_check_ = numeric_limits<int64_t>::max();
+	}
+
+	handler_(event_);
+}
+
+string EventToJson(const Event &event) {
+	stringstream ss;
+	ss << R"({"stage":")" << json::EscapeString(event.stage) << R"(",)";
+	ss << R"("bytes":)" << event.bytes << ",";
+	ss << R"("total_bytes":)" << event.total_bytes << ",";
+	ss << R"("elapsed_ms":)" << event.elapsed.count() << ",";
+	ss << R"("bytes_per_second":)" << static_cast<int64_t>(event.bytes_per_second) << ",";
+	ss << R"("eta_seconds":)" << event.eta_seconds << ",";
+	ss << R"("finished":)" << (event.finished ? "true" : "false") << "}";
+	return ss.str();
+}
+
+static string MiB(double bytes) {
+	stringstream ss;
+	ss << fixed << setprecision(1) << bytes / (1024 * 1024) << " MiB";
+	return ss.str();
+}
+
+string EventToString(const Event &event) {
+	vector<string> parts;
+	if (event.total_bytes > 0) {
+		parts.push_back(
+			to_string(event.bytes * 100 / event.total_bytes) + "% of "
+			+ MiB(static_cast<double>(event.total_bytes)));
+	} else if (event.bytes > 0) {
+		parts.push_back(MiB(static_cast<double>(event.bytes)));
+	}
+	if (event.bytes > 0) {
+		parts.push_back(MiB(event.bytes_per_second) + "/s");
+	}
+	if (event.finished) {
+		parts.push_back("done in " + to_string(event.elapsed.count() / 1000) + " s");
+	} else if (event.eta_seconds >= 0) {
+		parts.push_back(to_string(event.eta_seconds) + " s left");
+	}
+
+	string str = event.stage + ":";
+	for (size_t i = 0; i < parts.size(); i++) {
+		str += (i == 0 ? " " : ", ") + parts[i];
+	}
+	return str;
+}
+
 expected::ExpectedSize Reader::Read(
 	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) {
 	expected::ExpectedSize exp_read = reader_->Read(start, end);
-	if (exp_read) {
+	if (exp_read && tracker_) {
+		if (exp_read.value() == 0) {
+			tracker_->Finish();
+		} else {
+			tracker_->Add(exp_read.value());
+		}
+	} else if (exp_read) {
 		bytes_read_ += exp_read.value();
 		int percentage = static_cast<int>(bytes_read_ * 100 / tot_size_);
 		if (percentage > last_percentage_) {
@@ -36,6 +164,43 @@ expected::ExpectedSize Reader::Read(
 	return exp_read;
 }
 
+AsyncReader::~AsyncReader() {
+	*destroying_ = true;
+}
+
+error::Error AsyncReader::AsyncRead(
+	vector<uint8_t>::iterator start, vector<uint8_t>::iterator end, io::AsyncIoHandler handler) {
+	auto destroying = destroying_;
+	return reader_->AsyncRead(start, end, [this, destroying, handler](io::ExpectedSize result) {
+		if (*destroying) {
+			return;
+		}
+		if (result && tracker_) {
+			if (result.value() == 0) {
+				tracker_->Finish();
+			} else {
+				tracker_->Add(result.value());
+			}
+		} else if (result && result.value() > 0) {
+			Report(result.value());
+		}
+		handler(result);
+	});
+}
+
+void AsyncReader::Cancel() {
+	reader_->Cancel();
+}
+
+void AsyncReader::Report(size_t n) {
+	bytes_read_ += n;
+	int percentage = static_cast<int>(bytes_read_ * 100 / tot_size_);
+	if (percentage > last_percentage_) {
+		cerr << "\r" << percentage << "%";
+		last_percentage_ = percentage;
+	}
+}
+
 } // namespace progress
 } // namespace update
 } // namespace mender
@@ -12,9 +12,17 @@
 //    See the License for the specific language governing permissions and
 //    limitations under the License.
 
+#ifndef MENDER_UPDATE_PROGRESS_READER_HPP
+#define MENDER_UPDATE_PROGRESS_READER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <common/error.hpp>
 #include <common/expected.hpp>
 #include <common/io.hpp>
 
@@ -25,13 +33,90 @@ namespace progress {
 using namespace std;
 
 namespace io = mender::common::io;
+namespace error = mender::common::error;
 namespace expected = mender::common::expected;
 
+struct Event {
+	// For example "download rootfs.ext4" or "install".
+	string stage;
+	int64_t bytes {0};
+	// -1 if unknown.
+	int64_t total_bytes {-1};
+	chrono::milliseconds elapsed {0};
+	// Since the previous event, or the average for the whole stage in the final event.
+	double bytes_per_second {0};
+	// Based on the average rate so far. -1 if unknown.
+	int64_t eta_seconds {-1};
+	bool finished {false};
+};
+
+using EventHandler = function<void(const Event &event)>;
+
+struct TrackerOptions {
+	// Minimum time between two events. The final event is sent regardless.
+	chrono::milliseconds interval {1000};
+	// How many bytes to count before looking at the clock again. This keeps `Add()` down to an
+	// addition and a comparison for most reads.
+	int64_t check_bytes {64 * 1024};
+};
+
+// Turns a stream of byte counts into rate limited progress events. The first `Add()` sends an
+// event straight away, so that the start of the stage is visible too.
+class Tracker {
+public:
+	Tracker(
+		const string &stage,
+		int64_t total_bytes,
+		const TrackerOptions &options,
+		EventHandler handler);
+
+	void Add(int64_t n) {
+		bytes_ += n;
+		if (bytes_ >= next_check_) {
+			Check();
+		}
+	}
+
+	// Sends the final event, unless it has been sent already because all of `total_bytes`
+	// were added.
+	void Finish();
+
+private:
+	void Check();
+	void Emit(chrono::steady_clock::time_point now, bool finished);
+
+	TrackerOptions options_;
+	EventHandler handler_;
+	Event event_;
+	int64_t bytes_ {0};
+	int64_t next_check_ {0};
+	chrono::steady_clock::time_point start_;
+	chrono::steady_clock::time_point last_event_;
+	int64_t last_event_bytes_ {0};
+	bool has_sent_ {false};
+	bool finished_ {false};
+};
+
+using TrackerPtr = shared_ptr<Tracker>;
+
+// One line JSON object, with the same field names as the `Event` members.
+string EventToJson(const Event &event);
+
+// Short, human readable summary, suitable as a deployment substate.
+string EventToString(const Event &event);
+
+// Without a tracker, the readers print the percentage read so far to stderr. With one, they feed
+// it instead, and finish it at the end of the stream.
+
 class Reader : virtual public io::Reader {
 public:
 	Reader(const shared_ptr<io::Reader> &reader, int64_t size) :
 		reader_ {reader},
 		tot_size_ {size} {};
+	Reader(const shared_ptr<io::Reader> &reader, int64_t size, TrackerPtr tracker) :
+		reader_ {reader},
+		tot_size_ {size},
+		tracker_ {tracker} {};
 
 	expected::ExpectedSize Read(
 		vector<uint8_t>::iterator start, vector<uint8_t>::iterator end) override;
@@ -39,10 +124,41 @@ public:
 private:
 	shared_ptr<io::Reader> reader_;
 	int64_t tot_size_;
+	TrackerPtr tracker_;
+	int64_t bytes_read_ {0};
+	int last_percentage_ {-1};
+};
+
+class AsyncReader : virtual public io::AsyncReader {
+public:
+	AsyncReader(const shared_ptr<io::AsyncReader> &reader, int64_t size) :
+		reader_ {reader},
+		tot_size_ {size} {};
+	AsyncReader(const shared_ptr<io::AsyncReader> &reader, int64_t size, TrackerPtr tracker) :
+		reader_ {reader},
+		tot_size_ {size},
+		tracker_ {tracker} {};
+	~AsyncReader();
+
+	error::Error AsyncRead(
+		vector<uint8_t>::iterator start,
+		vector<uint8_t>::iterator end,
+		io::AsyncIoHandler handler) override;
+	void Cancel() override;
+
+private:
+	void Report(size_t n);
+
+	shared_ptr<io::AsyncReader> reader_;
+	int64_t tot_size_;
+	TrackerPtr tracker_;
 	int64_t bytes_read_ {0};
 	int last_percentage_ {-1};
+	shared_ptr<bool> destroying_ {make_shared<bool>(false)};
 };
 
 } // namespace progress
 } // namespace update
 } // namespace mender
+
+#endif // MENDER_UPDATE_PROGRESS_READER_HPP
@@ -151,6 +151,8 @@ struct Context {
 	events::EventLoop &loop;
 
 	StateData state_data;
+	// `state_data` has changed, but a deferred save has not written it yet.
+	bool state_data_pending {false};
 
 	vector<string> stop_before;
 
@@ -240,7 +240,8 @@ StateMachine::StateMachine(Context &ctx) :
 		executor::Action::Error,
 		executor::OnError::Ignore,
 		Result::NoResult},
-	save_before_artifact_install_state_ {StateData::kBeforeStateArtifactInstall_Enter},
+	save_before_artifact_install_state_ {
+		StateData::kBeforeStateArtifactInstall_Enter, JustSaveState::Write::Deferred},
 	save_artifact_install_state_ {StateData::kInStateArtifactInstall_Enter},
 	artifact_install_enter_state_ {
 		executor::State::ArtifactInstall,
@@ -257,14 +258,16 @@ StateMachine::StateMachine(Context &ctx) :
 		executor::Action::Error,
 		executor::OnError::Ignore,
 		Result::NoResult},
-	save_before_artifact_commit_state_ {StateData::kBeforeStateArtifactCommit_Enter},
+	save_before_artifact_commit_state_ {
+		StateData::kBeforeStateArtifactCommit_Enter, JustSaveState::Write::Deferred},
 	save_artifact_commit_state_ {StateData::kInStateArtifactCommit_Enter},
 	artifact_commit_enter_state_ {
 		executor::State::ArtifactCommit,
 		executor::Action::Enter,
 		executor::OnError::Fail,
 		Result::CommitFailed | Result::Failed},
-	save_before_artifact_commit_leave_state_ {StateData::kBeforeStateArtifactCommit_Leave},
+	save_before_artifact_commit_leave_state_ {
+		StateData::kBeforeStateArtifactCommit_Leave, JustSaveState::Write::Deferred},
 	save_artifact_commit_leave_state_ {StateData::kInStateArtifactCommit_Leave},
 	artifact_commit_leave_state_ {
 		executor::State::ArtifactCommit,
@@ -335,6 +338,10 @@ StateMachine::StateMachine(Context &ctx) :
 	//    already. This is done by saving a different value in the "save" state, and is thus
 	//    preserved even after a spontaneous reboot. Once we have gone there, there is no going
 	//    back.
+
+	// Unless we stop, the "save_before" value is overwritten right away, so its write is
+	// deferred, and goes into the same transaction as the one in the "save" state. A crash in
+	// between then leaves the previous state in the database, which is just as valid.
 	s.AddTransition(save_before_artifact_install_state_,      se::Success,              save_artifact_install_state_,             tf::Immediate);
 	s.AddTransition(save_before_artifact_install_state_,      se::Failure,              save_cleanup_state_,                      tf::Immediate);
 
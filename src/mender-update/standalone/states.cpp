@@ -62,12 +62,19 @@ void SaveState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
 		ctx.state_data.rolled_back = false;
 	}
 
+	if (write_ == Write::Deferred) {
+		ctx.state_data_pending = true;
+		OnEnterSaveState(ctx, poster);
+		return;
+	}
+
 	auto err = SaveStateData(ctx.main_context.GetMenderStoreDB(), ctx.state_data);
 	if (err != error::NoError) {
 		UpdateResult(ctx.result_and_error, {Result::Failed, err});
 		poster.PostEvent(StateEvent::Failure);
 		return;
 	}
+	ctx.state_data_pending = false;
 
 	OnEnterSaveState(ctx, poster);
 }
@@ -187,7 +194,12 @@ void PrepareDownloadState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &po
 			return;
 		}
 		ctx.artifact_reader = reader.value();
+	} else if (auto mapped = io::OpenMappedFile(ctx.artifact_src)) {
+		// Saves a copy through the stream and one into libarchive's buffer. Only works for
+		// regular files though, so pipes and devices take the stream path below.
+		ctx.artifact_reader = mapped.value();
 	} else {
+		log::Debug("Not using a memory mapping for the Artifact: " + mapped.error().String());
 		auto stream = io::OpenIfstream(ctx.artifact_src);
 		if (!stream) {
 			UpdateResult(
@@ -404,7 +416,15 @@ void RebootAndRollbackQueryState::OnEnterSaveState(
 }
 
 void ArtifactCommitState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
-	auto err = ctx.update_module->ArtifactCommit();
+	// The saved state must be on disk before the commit makes the update permanent.
+	auto err = ctx.main_context.SyncMenderStoreDB();
+	if (err != error::NoError) {
+		UpdateResult(ctx.result_and_error, {Result::CommitFailed | Result::Failed, err});
+		poster.PostEvent(StateEvent::Failure);
+		return;
+	}
+
+	err = ctx.update_module->ArtifactCommit();
 	if (err != error::NoError) {
 		log::Error("Commit failed: " + err.String());
 		UpdateResult(ctx.result_and_error, {Result::CommitFailed | Result::Failed, err});
@@ -532,6 +552,14 @@ void ScriptRunnerState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poste
 void ExitState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
 	auto err =
 		ctx.main_context.GetMenderStoreDB().WriteTransaction([&ctx](database::Transaction &txn) {
+			if (ctx.state_data_pending) {
+				// We are stopping right after a deferred save, so it has to happen here.
+				auto err = SaveStateData(txn, ctx.state_data);
+				if (err != error::NoError) {
+					return err;
+				}
+			}
+
 			auto exp_bytes = txn.Read(context::MenderContext::standalone_state_key);
 			if (!exp_bytes) {
 				if (exp_bytes.error().code == database::MakeError(database::KeyError, "").code) {
@@ -556,6 +584,11 @@ void ExitState::OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) {
 				return error::NoError;
 			}
 		});
+	if (err == error::NoError) {
+		ctx.state_data_pending = false;
+		// The device is likely to be rebooted right after we exit.
+		err = ctx.main_context.SyncMenderStoreDB();
+	}
 	if (err != error::NoError) {
 		UpdateResult(ctx.result_and_error, {Result::Failed, err});
 		poster.PostEvent(StateEvent::Failure);
@@ -32,20 +32,30 @@ using StateType = sm::State<Context, StateEvent>;
 
 class SaveState : virtual public StateType {
 public:
-	SaveState(const string &state) :
-		state_ {state} {
+	enum class Write {
+		Immediate,
+		// Leave the write to the next state, which must be another `SaveState` or the
+		// `ExitState`. For saves which are followed straight by another one, so that both end
+		// up in the same transaction.
+		Deferred,
+	};
+
+	SaveState(const string &state, Write write = Write::Immediate) :
+		state_ {state},
+		write_ {write} {
 	}
 	void OnEnter(Context &ctx, sm::EventPoster<StateEvent> &poster) override final;
 	virtual void OnEnterSaveState(Context &ctx, sm::EventPoster<StateEvent> &poster) = 0;
 
 private:
 	string state_;
+	Write write_;
 };
 
 class JustSaveState : public SaveState {
 public:
-	JustSaveState(const string &state) :
-		SaveState {state} {
+	JustSaveState(const string &state, Write write = Write::Immediate) :
+		SaveState {state, write} {
 	}
 	void OnEnterSaveState(Context &ctx, sm::EventPoster<StateEvent> &poster) override;
 };
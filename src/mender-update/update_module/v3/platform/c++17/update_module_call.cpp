@@ -40,13 +40,22 @@ UpdateModule::StateRunner::StateRunner(
 	events::EventLoop &loop,
 	State state,
 	const string &module_path,
-	const string &module_work_path) :
+	const string &module_work_path,
+	native_installer::Installer *native_installer) :
 	loop(loop),
 	module_work_path(module_work_path),
-	proc({module_path, StateToString(state), module_work_path}) {
+	proc({module_path, StateToString(state), module_work_path}),
+	native_installer(native_installer) {
 	proc.SetWorkDir(module_work_path);
 }
 
+UpdateModule::StateRunner::~StateRunner() {
+	*destroying = true;
+	if (native_thread.joinable()) {
+		native_thread.join();
+	}
+}
+
 error::Error UpdateModule::StateRunner::AsyncCallState(
 	State state, bool procOut, chrono::seconds timeout_seconds, HandlerFunction handler) {
 	this->handler = handler;
@@ -68,6 +77,11 @@ error::Error UpdateModule::StateRunner::AsyncCallState(
 		}
 	}
 
+	if (native_installer != nullptr) {
+		RunNativeInstaller(state, procOut, timeout_seconds);
+		return error::NoError;
+	}
+
 	processes::OutputHandler stderr_handler {"Update Module output (stderr): "};
 
 	error::Error processStart;
@@ -118,6 +132,33 @@ error::Error UpdateModule::StateRunner::AsyncCallState(
 	return err;
 }
 
+void UpdateModule::StateRunner::RunNativeInstaller(
+	State state, bool procOut, chrono::seconds timeout_seconds) {
+	if (procOut) {
+		output.emplace(string());
+	}
+
+	// Installing can take a while, so do it in a thread to keep the event loop going.
+	auto &destroying = this->destroying;
+	native_thread = thread([this, state, procOut, timeout_seconds, destroying]() {
+		auto result =
+			native_installer->Call(StateToString(state), module_work_path, timeout_seconds);
+		loop.Post([this, state, procOut, result, destroying]() {
+			if (*destroying) {
+				return;
+			}
+
+			error::Error err;
+			if (!result) {
+				err = result.error();
+			} else if (procOut) {
+				*output = result.value();
+			}
+			ProcessFinishedHandler(state, err);
+		});
+	});
+}
+
 void UpdateModule::StateRunner::ProcessFinishedHandler(State state, error::Error err) {
 	if (state == State::Cleanup) {
 		std::error_code ec;
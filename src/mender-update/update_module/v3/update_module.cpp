@@ -30,6 +30,7 @@ namespace path = mender::common::path;
 
 static std::string StateString[] = {
 	"ProvidePayloadFileSizes",
+	"ProvidePayloadWriteTarget",
 	"Download",
 	"DownloadWithFileSizes",
 	"ArtifactInstall",
@@ -52,7 +53,8 @@ std::string StateToString(State state) {
 }
 
 UpdateModule::UpdateModule(MenderContext &ctx, const string &payload_type) :
-	ctx_ {ctx} {
+	ctx_ {ctx},
+	payload_type_ {payload_type} {
 	update_module_path_ = path::Join(ctx.GetConfig().paths.GetModulesPath(), payload_type);
 	update_module_workdir_ =
 		path::Join(ctx.GetConfig().paths.GetModulesWorkPath(), "payloads", "0000", "tree");
@@ -62,7 +64,17 @@ UpdateModule::DownloadData::DownloadData(
 	events::EventLoop &event_loop, artifact::Payload &payload) :
 	payload_ {payload},
 	event_loop_ {event_loop} {
-	buffer_.resize(MENDER_BUFSIZE);
+}
+
+UpdateModule::DownloadData::~DownloadData() {
+	*destroying_ = true;
+	// Stop a payload copy which is still in progress, otherwise it would carry on by itself.
+	if (current_payload_reader_) {
+		current_payload_reader_->Cancel();
+	}
+	if (current_stream_writer_) {
+		current_stream_writer_->Cancel();
+	}
 }
 
 static expected::ExpectedBool HandleProvidePayloadFileSizesOutput(
@@ -93,6 +105,36 @@ error::Error UpdateModule::AsyncProvidePayloadFileSizes(
 		});
 }
 
+static expected::ExpectedString HandleProvidePayloadWriteTargetOutput(
+	const expected::ExpectedString &exp_output) {
+	if (!exp_output) {
+		return expected::unexpected(error::Error(exp_output.error()));
+	}
+	auto &processStdOut = exp_output.value();
+	if (processStdOut == "" || path::IsAbsolute(processStdOut)) {
+		return processStdOut;
+	}
+	return expected::unexpected(error::Error(
+		make_error_condition(errc::protocol_error),
+		"Unexpected output from the process for ProvidePayloadWriteTarget state: "
+			+ processStdOut));
+}
+
+expected::ExpectedString UpdateModule::ProvidePayloadWriteTarget() {
+	return HandleProvidePayloadWriteTargetOutput(
+		CallStateCapture(State::ProvidePayloadWriteTarget));
+}
+
+error::Error UpdateModule::AsyncProvidePayloadWriteTarget(
+	events::EventLoop &event_loop, ProvidePayloadWriteTargetFinishedHandler handler) {
+	return AsyncCallStateCapture(
+		event_loop,
+		State::ProvidePayloadWriteTarget,
+		[handler](expected::ExpectedString exp_output) {
+			handler(HandleProvidePayloadWriteTargetOutput(exp_output));
+		});
+}
+
 error::Error UpdateModule::Download(artifact::Payload &payload) {
 	events::EventLoop event_loop;
 	error::Error err;
@@ -115,7 +157,7 @@ void UpdateModule::AsyncDownload(
 		download_.reset();
 	};
 
-	download_->event_loop_.Post([this]() { StartDownloadProcess(); });
+	download_->event_loop_.Post([this]() { StartDownload(); });
 }
 
 error::Error UpdateModule::DownloadWithFileSizes(artifact::Payload &payload) {
@@ -141,7 +183,7 @@ void UpdateModule::AsyncDownloadWithFileSizes(
 		download_.reset();
 	};
 
-	download_->event_loop_.Post([this]() { StartDownloadProcess(); });
+	download_->event_loop_.Post([this]() { StartDownload(); });
 }
 
 error::Error UpdateModule::ArtifactInstall() {
@@ -282,6 +324,16 @@ error::Error UpdateModule::AsyncCleanup(
 	return AsyncCallStateNoCapture(event_loop, State::Cleanup, handler);
 }
 
+native_installer::Installer *UpdateModule::GetNativeInstaller() {
+	if (!ctx_.GetConfig().native_installers) {
+		return nullptr;
+	}
+	if (!native_installer_) {
+		native_installer_ = native_installer::Installer::Create(payload_type_);
+	}
+	return native_installer_.get();
+}
+
 string UpdateModule::GetModulePath() const {
 	return update_module_path_;
 }
@@ -299,7 +351,8 @@ error::Error UpdateModule::GetProcessError(const error::Error &err) {
 
 error::Error UpdateModule::AsyncCallStateCapture(
 	events::EventLoop &loop, State state, function<void(expected::ExpectedString)> handler) {
-	state_runner_.reset(new StateRunner(loop, state, GetModulePath(), GetModulesWorkPath()));
+	state_runner_.reset(new StateRunner(
+		loop, state, GetModulePath(), GetModulesWorkPath(), GetNativeInstaller()));
 
 	return state_runner_->AsyncCallState(
 		state,
@@ -336,7 +389,8 @@ expected::ExpectedString UpdateModule::CallStateCapture(State state) {
 
 error::Error UpdateModule::AsyncCallStateNoCapture(
 	events::EventLoop &loop, State state, function<void(error::Error)> handler) {
-	state_runner_.reset(new StateRunner(loop, state, GetModulePath(), GetModulesWorkPath()));
+	state_runner_.reset(new StateRunner(
+		loop, state, GetModulePath(), GetModulesWorkPath(), GetNativeInstaller()));
 
 	return state_runner_->AsyncCallState(
 		state,
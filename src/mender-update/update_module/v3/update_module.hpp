@@ -24,7 +24,10 @@
 #include <common/optional.hpp>
 #include <common/processes.hpp>
 
+#include <mender-update/block_writer/block_writer.hpp>
 #include <mender-update/context.hpp>
+#include <mender-update/native_installer/native_installer.hpp>
+#include <mender-update/progress_reader/progress_reader.hpp>
 
 #include <artifact/artifact.hpp>
 
@@ -44,6 +47,7 @@ namespace events = mender::common::events;
 namespace expected = mender::common::expected;
 namespace io = mender::common::io;
 namespace procs = mender::common::processes;
+namespace progress = mender::update::progress;
 
 using context::MenderContext;
 using expected::ExpectedBool;
@@ -53,6 +57,7 @@ using mender::artifact::Artifact;
 enum class RebootAction { No, Automatic, Yes };
 enum class State {
 	ProvidePayloadFileSizes,
+	ProvidePayloadWriteTarget,
 	Download,
 	DownloadWithFileSizes,
 	ArtifactInstall,
@@ -98,6 +103,13 @@ public:
 		update_module_workdir_ = path;
 	}
 
+	// Without a handler, download progress is printed to stderr.
+	void SetProgressHandler(
+		progress::EventHandler handler, const progress::TrackerOptions &options) {
+		progress_handler_ = handler;
+		progress_options_ = options;
+	}
+
 	error::Error PrepareFileTreeDeviceParts(const string &path);
 	error::Error CleanAndPrepareFileTree(
 		const string &path, artifact::PayloadHeaderView &payload_meta_data);
@@ -105,6 +117,7 @@ public:
 	error::Error DeleteFileTree(const string &path);
 
 	using ProvidePayloadFileSizesFinishedHandler = function<void(ExpectedBool)>;
+	using ProvidePayloadWriteTargetFinishedHandler = function<void(expected::ExpectedString)>;
 	using StateFinishedHandler = function<void(error::Error)>;
 	using NeedsRebootFinishedHandler = function<void(ExpectedRebootAction)>;
 	using SupportsRollbackFinishedHandler = function<void(ExpectedBool)>;
@@ -113,6 +126,10 @@ public:
 	ExpectedBool ProvidePayloadFileSizes();
 	error::Error AsyncProvidePayloadFileSizes(
 		events::EventLoop &event_loop, ProvidePayloadFileSizesFinishedHandler handler);
+	// Only called by the download states, and only if `NativePayloadWriter` is enabled.
+	expected::ExpectedString ProvidePayloadWriteTarget();
+	error::Error AsyncProvidePayloadWriteTarget(
+		events::EventLoop &event_loop, ProvidePayloadWriteTargetFinishedHandler handler);
 	error::Error Download(artifact::Payload &payload);
 	void AsyncDownload(
 		events::EventLoop &event_loop, artifact::Payload &payload, StateFinishedHandler handler);
@@ -171,14 +188,18 @@ private:
 	error::Error PrepareDownloadDirectory(const string &path);
 	error::Error DeleteStreamsFiles();
 
+	void StartDownload();
 	void StartDownloadProcess();
+	void StartNativeWrite(const string &target);
+	void FinishNativeWrite();
+	void NativeWriteFinishedHandler(error::Error err);
 
 	void StreamNextOpenHandler(io::ExpectedAsyncWriterPtr writer);
 	void StreamOpenHandler(io::ExpectedAsyncWriterPtr writer);
 
 	void StreamNextWriteHandler(size_t expected_n, io::ExpectedSize result);
-	void PayloadReadHandler(io::ExpectedSize result);
-	void StreamWriteHandler(size_t offset, size_t expected_n, io::ExpectedSize result);
+	void CopyPayload();
+	void PayloadCopiedHandler(error::Error err);
 
 	void EndStreamNext();
 
@@ -190,35 +211,54 @@ private:
 
 	void StartDownloadToFile();
 
+	io::AsyncReaderPtr MakeProgressReader(const shared_ptr<artifact::Reader> &payload_reader);
+
+	// Returns the built-in installer which is used instead of the Update Module, or nullptr if
+	// there is none for this payload type, or they are disabled.
+	native_installer::Installer *GetNativeInstaller();
+
 	context::MenderContext &ctx_;
+	string payload_type_;
 	string update_module_path_;
 	string update_module_workdir_;
+	native_installer::InstallerPtr native_installer_;
+	progress::EventHandler progress_handler_;
+	progress::TrackerOptions progress_options_;
 
 	struct DownloadData {
 		DownloadData(events::EventLoop &event_loop, artifact::Payload &payload);
+		~DownloadData();
 
 		artifact::Payload &payload_;
 		events::EventLoop &event_loop_;
 		StateFinishedHandler download_finished_handler_;
-		vector<uint8_t> buffer_;
 
 		shared_ptr<procs::Process> proc_;
 
 		string stream_next_path_;
 		shared_ptr<io::Canceller> stream_next_opener_;
 		io::AsyncWriterPtr stream_next_writer_;
+		// The entry currently being written to `stream-next`, without the newline.
+		vector<uint8_t> stream_next_entry_;
 
 		string current_payload_name_;
 		int64_t current_payload_size_;
 		io::AsyncReaderPtr current_payload_reader_;
 		shared_ptr<io::Canceller> current_stream_opener_;
 		io::AsyncWriterPtr current_stream_writer_;
-		int64_t written_ {0};
+		// The payload copy keeps the reader and the writer alive by itself, so it must be told
+		// when we're gone.
+		shared_ptr<bool> destroying_ {make_shared<bool>(false)};
 
 		bool module_has_started_download_ {false};
 		bool module_has_finished_download_ {false};
 		bool downloading_to_files_ {false};
 		bool downloading_with_sizes_ {false};
+
+		// Set when the payload is written by us, to the target named by the module, instead
+		// of being streamed to the module.
+		bool writing_natively_ {false};
+		shared_ptr<block_writer::AsyncBlockWriter> native_writer_;
 	};
 	unique_ptr<DownloadData> download_;
 
@@ -229,7 +269,9 @@ private:
 			events::EventLoop &loop,
 			State state,
 			const string &module_path,
-			const string &module_work_path);
+			const string &module_work_path,
+			native_installer::Installer *native_installer);
+		~StateRunner();
 
 		using HandlerFunction = function<void(expected::expected<optional<string>, error::Error>)>;
 
@@ -238,6 +280,7 @@ private:
 
 	private:
 		void ProcessFinishedHandler(State state, error::Error err);
+		void RunNativeInstaller(State state, bool procOut, chrono::seconds timeout_seconds);
 
 		events::EventLoop &loop;
 		bool first_line_captured {false};
@@ -246,6 +289,11 @@ private:
 		procs::Process proc;
 		optional<string> output;
 		HandlerFunction handler;
+
+		// Runs in `native_thread` instead of `proc`, if set.
+		native_installer::Installer *native_installer;
+		thread native_thread;
+		shared_ptr<bool> destroying {make_shared<bool>(false)};
 	};
 	unique_ptr<StateRunner> state_runner_;
 
@@ -32,6 +32,32 @@ namespace path = mender::common::path;
 namespace processes = mender::common::processes;
 namespace progress = mender::update::progress;
 
+static const vector<uint8_t> stream_next_newline {'\n'};
+
+void UpdateModule::StartDownload() {
+	if (GetNativeInstaller() != nullptr) {
+		// The built-in installers work on the files in the file tree.
+		download_->downloading_to_files_ = true;
+		StartDownloadToFile();
+		return;
+	}
+
+	if (!ctx_.GetConfig().native_payload_writer) {
+		StartDownloadProcess();
+		return;
+	}
+
+	DownloadErrorHandler(AsyncProvidePayloadWriteTarget(
+		download_->event_loop_, [this](expected::ExpectedString target) {
+			if (!target) {
+				DownloadErrorHandler(target.error());
+			} else if (target.value() == "") {
+				StartDownloadProcess();
+			} else {
+				StartNativeWrite(target.value());
+			}
+		}));
+}
 
 void UpdateModule::StartDownloadProcess() {
 	string download_command = "Download";
@@ -105,10 +131,7 @@ void UpdateModule::StreamNextOpenHandler(io::ExpectedAsyncWriterPtr writer) {
 	}
 	auto payload_reader = make_shared<artifact::Reader>(std::move(reader.value()));
 
-	auto progress_reader = make_shared<progress::Reader>(payload_reader, payload_reader->Size());
-
-	download_->current_payload_reader_ =
-		make_shared<events::io::AsyncReaderFromReader>(download_->event_loop_, progress_reader);
+	download_->current_payload_reader_ = MakeProgressReader(payload_reader);
 	download_->current_payload_name_ = payload_reader->Name();
 	download_->current_payload_size_ = payload_reader->Size();
 
@@ -121,25 +144,20 @@ void UpdateModule::StreamNextOpenHandler(io::ExpectedAsyncWriterPtr writer) {
 		return;
 	}
 
-	string stream_next_string;
+	// The entry is put together right where it is written from, instead of in a string which is
+	// then copied over.
+	auto &entry = download_->stream_next_entry_;
+	auto entry_path = path::Join("streams", download_->current_payload_name_);
+	entry.assign(entry_path.begin(), entry_path.end());
 	if (download_->downloading_with_sizes_) {
-		stream_next_string = path::Join("streams", download_->current_payload_name_) + " "
-							 + to_string(download_->current_payload_size_);
-	} else {
-		stream_next_string = path::Join("streams", download_->current_payload_name_);
-	}
-	size_t entry_size = stream_next_string.size() + 1;
-	if (entry_size > download_->buffer_.size()) {
-		DownloadErrorHandler(error::Error(
-			make_error_condition(errc::no_buffer_space), "Payload name is too large for buffer"));
-		return;
+		auto entry_size_field = " " + to_string(download_->current_payload_size_);
+		entry.insert(entry.end(), entry_size_field.begin(), entry_size_field.end());
 	}
-	copy(stream_next_string.begin(), stream_next_string.end(), download_->buffer_.begin());
-	download_->buffer_[entry_size - 1] = '\n';
-	DownloadErrorHandler(download_->stream_next_writer_->AsyncWrite(
-		download_->buffer_.begin(),
-		download_->buffer_.begin() + entry_size,
-		[this, entry_size](io::ExpectedSize result) {
+	// Entry and newline go out in one write, so the module never sees a partial line.
+	io::ConstBufferChain chain {entry, stream_next_newline};
+	size_t entry_size = io::BufferChainSize(chain);
+	DownloadErrorHandler(download_->stream_next_writer_->AsyncWriteV(
+		chain, [this, entry_size](io::ExpectedSize result) {
 			StreamNextWriteHandler(entry_size, result);
 		}));
 }
@@ -151,10 +169,7 @@ void UpdateModule::StreamOpenHandler(io::ExpectedAsyncWriterPtr writer) {
 	}
 	download_->current_stream_writer_ = writer.value();
 
-	DownloadErrorHandler(download_->current_payload_reader_->AsyncRead(
-		download_->buffer_.begin(), download_->buffer_.end(), [this](io::ExpectedSize result) {
-			PayloadReadHandler(result);
-		}));
+	CopyPayload();
 }
 
 void UpdateModule::StreamNextWriteHandler(size_t expected_n, io::ExpectedSize result) {
@@ -169,63 +184,44 @@ void UpdateModule::StreamNextWriteHandler(size_t expected_n, io::ExpectedSize re
 	}
 }
 
-void UpdateModule::PayloadReadHandler(io::ExpectedSize result) {
-	if (!result) {
-		// Close streams.
-		download_->current_stream_writer_.reset();
-		download_->current_payload_reader_.reset();
-		DownloadErrorHandler(result.error());
-	} else if (result.value() > 0) {
-		DownloadErrorHandler(download_->current_stream_writer_->AsyncWrite(
-			download_->buffer_.begin(),
-			download_->buffer_.begin() + result.value(),
-			[this, result](io::ExpectedSize write_result) {
-				StreamWriteHandler(0, result.value(), write_result);
-			}));
-	} else {
-		// Close streams.
-		download_->current_stream_writer_.reset();
-		download_->current_payload_reader_.reset();
-
-		if (download_->downloading_to_files_) {
-			StartDownloadToFile();
-		} else {
-			DownloadErrorHandler(OpenStreamNextPipe(
-				[this](io::ExpectedAsyncWriterPtr writer) { StreamNextOpenHandler(writer); }));
-		}
-	}
+void UpdateModule::CopyPayload() {
+	// Two buffers, so that the next chunk can be downloaded while the previous one is still being
+	// written.
+	auto destroying = download_->destroying_;
+	io::AsyncCopyMultiBuffer(
+		download_->current_stream_writer_,
+		download_->current_payload_reader_,
+		2,
+		[this, destroying](error::Error err) {
+			if (!*destroying) {
+				PayloadCopiedHandler(err);
+			}
+		});
 }
 
-void UpdateModule::StreamWriteHandler(size_t offset, size_t expected_n, io::ExpectedSize result) {
-	if (!result) {
-		DownloadErrorHandler(result.error());
-	} else if (result.value() == 0 || result.value() > expected_n) {
-		DownloadErrorHandler(error::Error(
-			make_error_condition(errc::io_error),
-			"Unexpected number of written bytes to download stream"));
-	} else if (result.value() < expected_n) {
-		auto new_offset = offset + result.value();
-		auto new_expected = expected_n - result.value();
-		DownloadErrorHandler(download_->current_stream_writer_->AsyncWrite(
-			download_->buffer_.begin() + new_offset,
-			download_->buffer_.begin() + new_offset + new_expected,
-			[this, new_offset, new_expected](io::ExpectedSize write_result) {
-				StreamWriteHandler(new_offset, new_expected, write_result);
-			}));
+void UpdateModule::PayloadCopiedHandler(error::Error err) {
+	// Close streams.
+	download_->current_stream_writer_.reset();
+	download_->current_payload_reader_.reset();
+
+	if (err != error::NoError) {
+		DownloadErrorHandler(err);
+	} else if (download_->writing_natively_) {
+		FinishNativeWrite();
+	} else if (download_->downloading_to_files_) {
+		StartDownloadToFile();
 	} else {
-		download_->written_ += result.value();
-		log::Trace("Wrote " + to_string(download_->written_) + " bytes to Update Module");
-		DownloadErrorHandler(download_->current_payload_reader_->AsyncRead(
-			download_->buffer_.begin(), download_->buffer_.end(), [this](io::ExpectedSize result) {
-				PayloadReadHandler(result);
-			}));
+		DownloadErrorHandler(OpenStreamNextPipe(
+			[this](io::ExpectedAsyncWriterPtr writer) { StreamNextOpenHandler(writer); }));
 	}
 }
 
 void UpdateModule::EndStreamNext() {
 	// Empty write.
 	DownloadErrorHandler(download_->stream_next_writer_->AsyncWrite(
-		download_->buffer_.begin(), download_->buffer_.begin(), [this](io::ExpectedSize result) {
+		stream_next_newline.cbegin(),
+		stream_next_newline.cbegin(),
+		[this](io::ExpectedSize result) {
 			if (!result) {
 				DownloadErrorHandler(result.error());
 			} else {
@@ -292,8 +288,15 @@ void UpdateModule::StartDownloadToFile() {
 		return;
 	}
 	auto payload_reader = make_shared<artifact::Reader>(std::move(reader.value()));
-	download_->current_payload_reader_ =
-		make_shared<events::io::AsyncReaderFromReader>(download_->event_loop_, payload_reader);
+	if (progress_handler_) {
+		// This path never printed progress to stderr, so only track it for a handler.
+		download_->current_payload_reader_ = MakeProgressReader(payload_reader);
+	} else if (payload_reader->CanReadAsync()) {
+		download_->current_payload_reader_ = payload_reader;
+	} else {
+		download_->current_payload_reader_ =
+			make_shared<events::io::AsyncReaderFromReader>(download_->event_loop_, payload_reader);
+	}
 	download_->current_payload_name_ = payload_reader->Name();
 
 	auto stream_path = path::Join(update_module_workdir_, string("files"));
@@ -314,10 +317,120 @@ void UpdateModule::StartDownloadToFile() {
 	}
 	download_->current_stream_writer_ = current_stream_writer;
 
-	DownloadErrorHandler(download_->current_payload_reader_->AsyncRead(
-		download_->buffer_.begin(), download_->buffer_.end(), [this](io::ExpectedSize result) {
-			PayloadReadHandler(result);
-		}));
+	CopyPayload();
+}
+
+io::AsyncReaderPtr UpdateModule::MakeProgressReader(
+	const shared_ptr<artifact::Reader> &payload_reader) {
+	progress::TrackerPtr tracker;
+	if (progress_handler_) {
+		tracker = make_shared<progress::Tracker>(
+			"download " + payload_reader->Name(),
+			payload_reader->Size(),
+			progress_options_,
+			progress_handler_);
+	}
+
+	if (payload_reader->CanReadAsync()) {
+		if (tracker) {
+			return make_shared<progress::AsyncReader>(
+				payload_reader, payload_reader->Size(), tracker);
+		}
+		return make_shared<progress::AsyncReader>(payload_reader, payload_reader->Size());
+	}
+
+	shared_ptr<io::Reader> progress_reader;
+	if (tracker) {
+		progress_reader =
+			make_shared<progress::Reader>(payload_reader, payload_reader->Size(), tracker);
+	} else {
+		progress_reader = make_shared<progress::Reader>(payload_reader, payload_reader->Size());
+	}
+	return make_shared<events::io::AsyncReaderFromReader>(download_->event_loop_, progress_reader);
+}
+
+void UpdateModule::StartNativeWrite(const string &target) {
+	auto reader = download_->payload_.Next();
+	if (!reader) {
+		if (reader.error().code
+			== artifact::parser_error::MakeError(
+				   artifact::parser_error::NoMorePayloadFilesError, "")
+				   .code) {
+			DownloadErrorHandler(error::Error(
+				make_error_condition(errc::invalid_argument),
+				"Cannot write payload to " + target + ": Payload contains no files"));
+		} else {
+			DownloadErrorHandler(reader.error());
+		}
+		return;
+	}
+	auto payload_reader = make_shared<artifact::Reader>(std::move(reader.value()));
+
+	download_->current_payload_reader_ = MakeProgressReader(payload_reader);
+	download_->current_payload_name_ = payload_reader->Name();
+	download_->current_payload_size_ = payload_reader->Size();
+
+	block_writer::Options options;
+	options.direct_io = ctx_.GetConfig().native_payload_writer_direct_io;
+	options.skip_unchanged = ctx_.GetConfig().native_payload_writer_skip_unchanged;
+	if (ctx_.GetConfig().native_payload_writer_verify) {
+		options.verify_checksum = payload_reader->Checksum();
+	}
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	if (!writer) {
+		DownloadErrorHandler(writer.error());
+		return;
+	}
+	// Writing and flushing can block for a long time, so do it outside of the event loop.
+	download_->native_writer_ =
+		make_shared<block_writer::AsyncBlockWriter>(download_->event_loop_, writer.value());
+	download_->current_stream_writer_ = download_->native_writer_;
+	download_->writing_natively_ = true;
+
+	log::Info(
+		"Writing payload " + download_->current_payload_name_ + " ("
+		+ to_string(download_->current_payload_size_) + " bytes) directly to " + target);
+
+	CopyPayload();
+}
+
+void UpdateModule::FinishNativeWrite() {
+	// Flushing and verifying may take a while after the last write, so don't block the loop
+	// waiting for it.
+	download_->native_writer_->AsyncFinish(
+		[this](error::Error err) { NativeWriteFinishedHandler(err); });
+}
+
+void UpdateModule::NativeWriteFinishedHandler(error::Error err) {
+	if (err != error::NoError) {
+		download_->native_writer_.reset();
+		DownloadErrorHandler(err);
+		return;
+	}
+	auto &writer = download_->native_writer_->Writer();
+	log::Info(
+		"Wrote " + to_string(writer.BytesWritten() - writer.BytesSkipped()) + " of "
+		+ to_string(writer.BytesWritten())
+		+ " bytes, the rest was already in place or left as holes");
+	download_->native_writer_.reset();
+
+	// The target can only hold one file, same as when the module does the writing.
+	auto reader = download_->payload_.Next();
+	if (reader) {
+		DownloadErrorHandler(error::Error(
+			make_error_condition(errc::invalid_argument),
+			"Cannot write payload natively: More than one file in payload"));
+		return;
+	} else if (
+		reader.error().code
+		!= artifact::parser_error::MakeError(artifact::parser_error::NoMorePayloadFilesError, "")
+			   .code) {
+		DownloadErrorHandler(reader.error());
+		return;
+	}
+
+	log::Debug("Finished writing payload natively");
+	EndDownloadLoop(error::NoError);
 }
 
 } // namespace v3
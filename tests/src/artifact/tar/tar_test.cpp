@@ -27,6 +27,8 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <common/events.hpp>
+#include <common/events_io.hpp>
 #include <common/processes.hpp>
 
 #include <common/testing.hpp>
@@ -37,6 +39,7 @@ namespace io = mender::common::io;
 namespace error = mender::common::error;
 namespace tar = mender::tar;
 namespace processes = mender::common::processes;
+namespace events = mender::common::events;
 namespace mendertesting = mender::common::testing;
 
 class TarTestEnv : public testing::Test {
@@ -63,6 +66,19 @@ protected:
     cp ${DIRNAME}/test-large.tar ${DIRNAME}/test-large-with-zeroes.tar
     dd if=/dev/zero bs=1K count=3 >> ${DIRNAME}/test-large.tar
 
+    # Create uncompressed tar files with names which don't fit in the ustar header
+    LONGNAME=${DIRNAME}/this-is-a-very-long-file-name-which-does-not-fit-in-the-one-hundred-bytes-of-a-ustar-header
+    printf "long name data" > ${LONGNAME}
+    tar cf ${DIRNAME}/test-pax.tar --format=pax ${LONGNAME} ${DIRNAME}/testdata
+    tar cf ${DIRNAME}/test-gnu.tar --format=gnu ${LONGNAME} ${DIRNAME}/testdata
+
+    # Create GNU tar files with a long link target, and with a sparse file
+    ln -s this-is-a-very-long-link-target-which-does-not-fit-in-the-one-hundred-bytes-of-the-ustar-linkname-field ${DIRNAME}/long-link
+    tar cf ${DIRNAME}/test-gnu-long-link.tar --format=gnu ${DIRNAME}/long-link ${DIRNAME}/testdata
+    truncate -s 1M ${DIRNAME}/sparse
+    printf "sparse data" >> ${DIRNAME}/sparse
+    tar cSf ${DIRNAME}/test-gnu-sparse.tar --format=gnu ${DIRNAME}/sparse
+
 		exit 0
 		)";
 
@@ -233,6 +249,119 @@ TEST_F(TarTestEnv, TestTarReaderExtraZeroesAtEOF) {
 	EXPECT_EQ(next_tar_entry.error().message, "Reached the end of the archive");
 }
 
+TEST_F(TarTestEnv, TestTarReaderLongNames) {
+	for (auto file : {"test-pax.tar", "test-gnu.tar"}) {
+		SCOPED_TRACE(file);
+
+		std::ifstream fs {tmpdir->Path() + "/" + file};
+		mender::common::io::StreamReader sr {fs};
+		mender::tar::Reader tar_reader {sr};
+
+		auto tar_entry = tar_reader.Next();
+		ASSERT_TRUE(tar_entry) << tar_entry.error().String();
+		EXPECT_THAT(
+			tar_entry.value().Name(),
+			testing::EndsWith(
+				"/this-is-a-very-long-file-name-which-does-not-fit-in-the-one-hundred-bytes-of-a-ustar-header"));
+		EXPECT_EQ(tar_entry.value().Size(), 14);
+
+		vector<uint8_t> data(100);
+		auto bytes_read = tar_entry.value().Read(data.begin(), data.end());
+		ASSERT_TRUE(bytes_read);
+		data.resize(bytes_read.value());
+		EXPECT_EQ(string(data.begin(), data.end()), "long name data");
+
+		// Second entry.
+		auto second_entry = tar_reader.Next();
+		ASSERT_TRUE(second_entry) << second_entry.error().String();
+		EXPECT_THAT(second_entry.value().Name(), testing::EndsWith("testdata"));
+
+		// Skip it without reading.
+		auto no_entry = tar_reader.Next();
+		ASSERT_FALSE(no_entry);
+		EXPECT_EQ(no_entry.error().code, tar::MakeError(tar::TarEOFError, "").code);
+	}
+}
+
+TEST_F(TarTestEnv, TestTarReaderAsyncEntries) {
+	events::EventLoop loop;
+
+	auto async_reader = make_shared<events::io::AsyncFileDescriptorReader>(loop);
+	auto err = async_reader->Open(tmpdir->Path() + "/test-pax.tar");
+	ASSERT_EQ(err, error::NoError) << err.String();
+	events::io::ReaderFromAsyncReader sync_reader {loop, async_reader};
+
+	mender::tar::Reader tar_reader {sync_reader};
+	tar_reader.SetAsyncSource(*async_reader, loop);
+
+	auto read_all = [&loop](mender::tar::Entry &entry) {
+		EXPECT_TRUE(entry.CanReadAsync());
+
+		string data;
+		vector<uint8_t> buf(4);
+		entry.RepeatedAsyncRead(
+			buf.begin(), buf.end(), [&loop, &data, &buf](io::ExpectedSize result) {
+				if (!result) {
+					ADD_FAILURE() << result.error().String();
+					loop.Stop();
+					return io::Repeat::No;
+				} else if (result.value() == 0) {
+					loop.Stop();
+					return io::Repeat::No;
+				}
+				data.append(buf.begin(), buf.begin() + result.value());
+				return io::Repeat::Yes;
+			});
+		loop.Run();
+		return data;
+	};
+
+	auto tar_entry = tar_reader.Next();
+	ASSERT_TRUE(tar_entry) << tar_entry.error().String();
+	EXPECT_EQ(read_all(tar_entry.value()), "long name data");
+
+	// Headers are still read synchronously, and pick up where the asynchronous reads stopped.
+	auto second_entry = tar_reader.Next();
+	ASSERT_TRUE(second_entry) << second_entry.error().String();
+	EXPECT_THAT(second_entry.value().Name(), testing::EndsWith("testdata"));
+	EXPECT_EQ(read_all(second_entry.value()), "foobar\n");
+
+	auto no_entry = tar_reader.Next();
+	ASSERT_FALSE(no_entry);
+	EXPECT_EQ(no_entry.error().code, tar::MakeError(tar::TarEOFError, "").code);
+}
+
+TEST_F(TarTestEnv, TestTarReaderGnuLongLink) {
+	std::ifstream fs {tmpdir->Path() + "/test-gnu-long-link.tar"};
+	mender::common::io::StreamReader sr {fs};
+	mender::tar::Reader tar_reader {sr};
+
+	// The long link name belongs to the link entry, it is not an entry of its own.
+	auto tar_entry = tar_reader.Next();
+	ASSERT_TRUE(tar_entry) << tar_entry.error().String();
+	EXPECT_THAT(tar_entry.value().Name(), testing::EndsWith("/long-link"));
+	EXPECT_EQ(tar_entry.value().Size(), 0);
+
+	auto second_entry = tar_reader.Next();
+	ASSERT_TRUE(second_entry) << second_entry.error().String();
+	EXPECT_THAT(second_entry.value().Name(), testing::EndsWith("testdata"));
+
+	auto no_entry = tar_reader.Next();
+	ASSERT_FALSE(no_entry);
+	EXPECT_EQ(no_entry.error().code, tar::MakeError(tar::TarEOFError, "").code);
+}
+
+TEST_F(TarTestEnv, TestTarReaderGnuSparseFile) {
+	std::ifstream fs {tmpdir->Path() + "/test-gnu-sparse.tar"};
+	mender::common::io::StreamReader sr {fs};
+	mender::tar::Reader tar_reader {sr};
+
+	auto tar_entry = tar_reader.Next();
+	ASSERT_FALSE(tar_entry);
+	EXPECT_EQ(tar_entry.error().code, tar::MakeError(tar::TarReaderError, "").code);
+	EXPECT_THAT(tar_entry.error().message, testing::HasSubstr("Unsupported tar entry type 'S'"));
+}
+
 TEST_F(TarTestEnv, TestCorruptTar) {
 	std::fstream fs {tmpdir->Path() + "/test-corrupt.tar"};
 
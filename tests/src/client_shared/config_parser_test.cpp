@@ -35,6 +35,7 @@ const string complete_config = R"({
   "UpdateLogPath": "UpdateLogPath_value",
   "TenantToken": "TenantToken_value",
   "DaemonLogLevel": "DaemonLogLevel_value",
+  "StateDatabaseDurability": "no-sync",
 
   "SkipVerify": true,
   "DBus": { "Enabled": true },
@@ -45,10 +46,22 @@ const string complete_config = R"({
   "InventoryPollIntervalSeconds": 4,
   "RetryPollIntervalSeconds": 5,
   "RetryPollCount": 6,
+  "ParallelAuthentication": true,
+  "ParallelAuthenticationStaggerMilliseconds": 250,
+  "IdentityDataCacheSeconds": 60,
+  "ForwarderListenURL": "unix:///run/mender/auth.sock",
+  "ForwarderAllowedUIDs": [1000, 1001],
   "StateScriptTimeoutSeconds": 7,
   "StateScriptRetryTimeoutSeconds": 8,
   "StateScriptRetryIntervalSeconds": 9,
   "ModuleTimeoutSeconds": 10,
+  "ProgressIntervalMilliseconds": 250,
+  "ProgressSubstateIntervalSeconds": 30,
+  "NativePayloadWriter": true,
+  "NativePayloadWriterDirectIO": true,
+  "NativePayloadWriterSkipUnchanged": true,
+  "NativePayloadWriterVerify": true,
+  "NativeInstallers": true,
 
   "ArtifactVerifyKeys": [
     "key1",
@@ -97,6 +110,7 @@ TEST(ConfigParserDefaultsTests, ConfigParserDefaults) {
 	EXPECT_EQ(mc.update_log_path, "");
 	EXPECT_EQ(mc.tenant_token, "");
 	EXPECT_EQ(mc.daemon_log_level, "");
+	EXPECT_EQ(mc.state_database_durability, "");
 
 	EXPECT_FALSE(mc.skip_verify);
 
@@ -104,10 +118,22 @@ TEST(ConfigParserDefaultsTests, ConfigParserDefaults) {
 	EXPECT_EQ(mc.inventory_poll_interval_seconds, 28800);
 	EXPECT_EQ(mc.retry_poll_interval_seconds, 0);
 	EXPECT_EQ(mc.retry_poll_count, 0);
+	EXPECT_FALSE(mc.parallel_authentication);
+	EXPECT_EQ(mc.parallel_authentication_stagger_milliseconds, 500);
+	EXPECT_EQ(mc.identity_data_cache_seconds, 3600);
+	EXPECT_EQ(mc.forwarder_listen_url, "");
+	EXPECT_EQ(mc.forwarder_allowed_uids.size(), 0);
 	EXPECT_EQ(mc.state_script_timeout_seconds, 3600);
 	EXPECT_EQ(mc.state_script_retry_timeout_seconds, 1800);
 	EXPECT_EQ(mc.state_script_retry_interval_seconds, 60);
 	EXPECT_EQ(mc.module_timeout_seconds, 14400);
+	EXPECT_EQ(mc.progress_interval_milliseconds, 1000);
+	EXPECT_EQ(mc.progress_substate_interval_seconds, 0);
+	EXPECT_FALSE(mc.native_payload_writer);
+	EXPECT_FALSE(mc.native_payload_writer_direct_io);
+	EXPECT_FALSE(mc.native_payload_writer_skip_unchanged);
+	EXPECT_FALSE(mc.native_payload_writer_verify);
+	EXPECT_FALSE(mc.native_installers);
 
 	EXPECT_EQ(mc.artifact_verify_keys.size(), 0);
 
@@ -136,6 +162,7 @@ TEST_F(ConfigParserTests, LoadComplete) {
 	EXPECT_EQ(mc.update_log_path, "UpdateLogPath_value");
 	EXPECT_EQ(mc.tenant_token, "TenantToken_value");
 	EXPECT_EQ(mc.daemon_log_level, "DaemonLogLevel_value");
+	EXPECT_EQ(mc.state_database_durability, "no-sync");
 
 	EXPECT_TRUE(mc.skip_verify);
 
@@ -143,10 +170,22 @@ TEST_F(ConfigParserTests, LoadComplete) {
 	EXPECT_EQ(mc.inventory_poll_interval_seconds, 4);
 	EXPECT_EQ(mc.retry_poll_interval_seconds, 5);
 	EXPECT_EQ(mc.retry_poll_count, 6);
+	EXPECT_TRUE(mc.parallel_authentication);
+	EXPECT_EQ(mc.parallel_authentication_stagger_milliseconds, 250);
+	EXPECT_EQ(mc.identity_data_cache_seconds, 60);
+	EXPECT_EQ(mc.forwarder_listen_url, "unix:///run/mender/auth.sock");
+	EXPECT_EQ(mc.forwarder_allowed_uids, vector<int>({1000, 1001}));
 	EXPECT_EQ(mc.state_script_timeout_seconds, 7);
 	EXPECT_EQ(mc.state_script_retry_timeout_seconds, 8);
 	EXPECT_EQ(mc.state_script_retry_interval_seconds, 9);
 	EXPECT_EQ(mc.module_timeout_seconds, 10);
+	EXPECT_EQ(mc.progress_interval_milliseconds, 250);
+	EXPECT_EQ(mc.progress_substate_interval_seconds, 30);
+	EXPECT_TRUE(mc.native_payload_writer);
+	EXPECT_TRUE(mc.native_payload_writer_direct_io);
+	EXPECT_TRUE(mc.native_payload_writer_skip_unchanged);
+	EXPECT_TRUE(mc.native_payload_writer_verify);
+	EXPECT_TRUE(mc.native_installers);
 
 	EXPECT_EQ(mc.artifact_verify_keys.size(), 3);
 	EXPECT_EQ(mc.artifact_verify_keys[0], "key1");
@@ -582,6 +621,27 @@ TEST_F(ConfigParserTests, ValidateServerConfig) {
 	EXPECT_THAT(ret.error().String(), testing::HasSubstr("Servers"));
 }
 
+TEST_F(ConfigParserTests, ValidateParallelAuthenticationStagger) {
+	for (auto value : {"-1", "60001"}) {
+		SCOPED_TRACE(value);
+
+		ofstream os(test_config_fname);
+		os << R"({
+  "ParallelAuthenticationStaggerMilliseconds": )"
+		   << value << R"(
+})";
+		os.close();
+
+		config_parser::MenderConfigFromFile mc;
+		config_parser::ExpectedBool ret = mc.LoadFile(test_config_fname);
+		ASSERT_FALSE(ret);
+		EXPECT_EQ(
+			ret.error().code, config_parser::MakeError(config_parser::ValidationError, "").code);
+		EXPECT_THAT(
+			ret.error().String(), testing::HasSubstr("ParallelAuthenticationStaggerMilliseconds"));
+	}
+}
+
 TEST_F(ConfigParserTests, CaseInsensitiveParsing) {
 	ofstream os(test_config_fname);
 	os << R"({
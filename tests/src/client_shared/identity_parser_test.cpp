@@ -15,6 +15,7 @@
 #include <client_shared/identity_parser.hpp>
 
 #include <sys/stat.h>
+#include <utime.h>
 #include <gtest/gtest.h>
 #include <fstream>
 
@@ -208,3 +209,32 @@ exit 0
 		R"({"foo":["baz","bar"],"key":"value=23","mac":"de:ad:be:ef:00:01","some value":"bar"})",
 		json_str);
 }
+
+TEST_F(IdentityParserTests, GetCachedIdentityData) {
+	auto prepare_script = [this](const string &mac, time_t mtime) {
+		ASSERT_TRUE(PrepareTestScript("#!/bin/sh\necho \"mac=" + mac + "\"\nexit 0\n"));
+		// Make sure the modification time differs, regardless of the clock resolution.
+		struct utimbuf times {mtime, mtime};
+		ASSERT_EQ(utime(test_script_fname, &times), 0);
+	};
+
+	prepare_script("de:ad:be:ef:00:01", 1000);
+	auto ex_data = id_p::GetCachedIdentityData(test_script_fname, chrono::minutes {1});
+	ASSERT_TRUE(ex_data);
+	EXPECT_EQ(ex_data.value()["mac"][0], "de:ad:be:ef:00:01");
+
+	// Remove the script's executable bit, so that it fails if it is run again.
+	ASSERT_EQ(chmod(test_script_fname, S_IRUSR | S_IWUSR), 0);
+	ex_data = id_p::GetCachedIdentityData(test_script_fname, chrono::minutes {1});
+	ASSERT_TRUE(ex_data);
+	EXPECT_EQ(ex_data.value()["mac"][0], "de:ad:be:ef:00:01");
+
+	// Not cached when asking for fresh data.
+	EXPECT_FALSE(id_p::GetCachedIdentityData(test_script_fname, chrono::seconds {0}));
+
+	// A modified script is run again.
+	prepare_script("de:ad:be:ef:00:02", 2000);
+	ex_data = id_p::GetCachedIdentityData(test_script_fname, chrono::minutes {1});
+	ASSERT_TRUE(ex_data);
+	EXPECT_EQ(ex_data.value()["mac"][0], "de:ad:be:ef:00:02");
+}
@@ -235,6 +235,34 @@ TEST(CryptoTest, TestPrivateKeyLoadFromPEMCorrectPassphrase) {
 	ASSERT_TRUE(expected_private_key) << "Unexpected: " << expected_private_key.error();
 }
 
+TEST(CryptoTest, TestPrivateKeyCache) {
+	mtesting::TemporaryDirectory tmpdir;
+	string private_key_file = path::Join(tmpdir.Path(), "private.key");
+	fs::copy_file("./private-key.rsa.pem", private_key_file);
+
+	auto expected_public_key = ExtractPublicKey({private_key_file});
+	ASSERT_TRUE(expected_public_key) << "Unexpected: " << expected_public_key.error();
+	// Second time the parsed key comes from the cache.
+	auto expected_cached_key = ExtractPublicKey({private_key_file});
+	ASSERT_TRUE(expected_cached_key) << "Unexpected: " << expected_cached_key.error();
+	EXPECT_EQ(expected_public_key.value(), expected_cached_key.value());
+
+	// Replacing the file must not give us the old key.
+	fs::copy_file(
+		"./private-key.ecdsa.pem", private_key_file, fs::copy_options::overwrite_existing);
+	auto expected_new_key = ExtractPublicKey({private_key_file});
+	ASSERT_TRUE(expected_new_key) << "Unexpected: " << expected_new_key.error();
+	EXPECT_NE(expected_public_key.value(), expected_new_key.value());
+
+	// Neither must a cached encrypted key be handed out without the right passphrase.
+	auto expected_private_key = PrivateKey::Load({"./private-encrypted.pem", "secret"});
+	ASSERT_TRUE(expected_private_key) << "Unexpected: " << expected_private_key.error();
+	expected_private_key = PrivateKey::Load({"./private-encrypted.pem", "dunno"});
+	EXPECT_FALSE(expected_private_key);
+	expected_private_key = PrivateKey::Load({"./private-encrypted.pem", "secret"});
+	ASSERT_TRUE(expected_private_key) << "Unexpected: " << expected_private_key.error();
+}
+
 TEST(CryptoTest, TestPrivateKeyGenerate) {
 	auto expected_private_key = PrivateKey::Generate();
 	EXPECT_TRUE(expected_private_key) << "Unexpected: " << expected_private_key.error();
@@ -68,6 +68,58 @@ TEST(EventsIo, ReadAndWriteWithPipes) {
 	EXPECT_EQ(to_receive, to_send);
 }
 
+TEST(EventsIo, GatherWriteWithPipes) {
+	TestEventLoop loop;
+
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	events::io::AsyncFileDescriptorReader reader(loop, fds[0]);
+	events::io::AsyncFileDescriptorWriter writer(loop, fds[1]);
+
+	const vector<uint8_t> header {'<', '<'};
+	const vector<uint8_t> body {'a', 'b', 'c', 'd'};
+	const vector<uint8_t> empty {};
+	const vector<uint8_t> closing {'>', '>'};
+
+	vector<uint8_t> to_receive(100);
+
+	auto err =
+		reader.AsyncRead(to_receive.begin(), to_receive.end(), [&loop](io::ExpectedSize result) {
+			EXPECT_TRUE(result);
+			EXPECT_EQ(result.value(), 8);
+
+			loop.Stop();
+		});
+	ASSERT_EQ(err, error::NoError);
+	err = writer.AsyncWriteV({header, body, empty, closing}, [](io::ExpectedSize result) {
+		EXPECT_TRUE(result);
+		EXPECT_EQ(result.value(), 8);
+	});
+	ASSERT_EQ(err, error::NoError);
+
+	loop.Run();
+
+	to_receive.resize(8);
+	EXPECT_EQ(to_receive, (vector<uint8_t> {'<', '<', 'a', 'b', 'c', 'd', '>', '>'}));
+
+	// The generic implementation, one write per buffer.
+	auto sync_writer = make_shared<io::ByteWriter>(to_receive);
+	events::io::AsyncWriterFromWriter wrapped_writer(loop, sync_writer);
+	to_receive.assign(8, 0);
+	err = wrapped_writer.io::AsyncWriter::AsyncWriteV(
+		{closing, body, header}, [&loop](io::ExpectedSize result) {
+			EXPECT_TRUE(result);
+			EXPECT_EQ(result.value(), 8);
+			loop.Stop();
+		});
+	ASSERT_EQ(err, error::NoError);
+
+	loop.Run();
+
+	EXPECT_EQ(to_receive, (vector<uint8_t> {'>', '>', 'a', 'b', 'c', 'd', '<', '<'}));
+}
+
 TEST(IO, AsyncBufferedReader) {
 	TestEventLoop loop;
 
@@ -181,6 +233,82 @@ TEST(EventsIo, PartialRead) {
 	EXPECT_EQ(to_receive, to_send);
 }
 
+// The rest of the tests use io_uring too when it's available, but only this checks that it
+// really is in use. Skipped when built without MENDER_USE_IO_URING, or if the kernel doesn't
+// support it.
+TEST(EventsIo, ReadAndWriteWithIoUring) {
+	TestEventLoop loop;
+
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	events::io::AsyncFileDescriptorReader reader(loop, fds[0]);
+	events::io::AsyncFileDescriptorWriter writer(loop, fds[1]);
+	if (!reader.UsesIoUring() || !writer.UsesIoUring()) {
+		GTEST_SKIP() << "io_uring is not in use";
+	}
+
+	const uint8_t data[] = "abcd";
+
+	vector<uint8_t> to_send(data, data + sizeof(data));
+	vector<uint8_t> to_receive;
+	to_receive.resize(to_send.size());
+
+	auto err = reader.AsyncRead(
+		to_receive.begin() + 1, to_receive.end(), [&loop](io::ExpectedSize result) {
+			EXPECT_TRUE(result);
+			EXPECT_EQ(result.value(), 4);
+
+			loop.Stop();
+		});
+	ASSERT_EQ(err, error::NoError);
+	err = writer.AsyncWrite(to_send.begin() + 1, to_send.end(), [](io::ExpectedSize result) {
+		EXPECT_TRUE(result);
+		EXPECT_EQ(result.value(), 4);
+	});
+	ASSERT_EQ(err, error::NoError);
+
+	// Nothing has been submitted yet, and the kernel should never see this.
+	const vector<uint8_t> sent {to_send.begin() + 1, to_send.end()};
+	fill(to_send.begin(), to_send.end(), 'X');
+
+	loop.Run();
+
+	EXPECT_EQ(sent, (vector<uint8_t> {to_receive.begin() + 1, to_receive.end()}));
+}
+
+TEST(EventsIo, CancelledReadWithIoUring) {
+	TestEventLoop loop;
+
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	events::io::AsyncFileDescriptorReader reader(loop, fds[0]);
+	if (!reader.UsesIoUring()) {
+		close(fds[1]);
+		GTEST_SKIP() << "io_uring is not in use";
+	}
+
+	vector<uint8_t> to_receive(4, 'X');
+	auto err =
+		reader.AsyncRead(to_receive.begin(), to_receive.end(), [&loop](io::ExpectedSize result) {
+			ASSERT_FALSE(result);
+			EXPECT_EQ(result.error().code, make_error_condition(errc::operation_canceled));
+			loop.Stop();
+		});
+	ASSERT_EQ(err, error::NoError);
+	reader.Cancel();
+
+	loop.Run();
+
+	// Whatever arrives now should stay in the pipe.
+	ASSERT_EQ(write(fds[1], "abcd", 4), 4);
+	close(fds[1]);
+	char left[4];
+	EXPECT_EQ(read(fds[0], left, sizeof(left)), 4);
+	EXPECT_EQ(to_receive, vector<uint8_t>(4, 'X'));
+}
+
 TEST(EventsIo, PartialWrite) {
 	TestEventLoop loop;
 
@@ -552,6 +680,54 @@ TEST(EventsIo, AsyncIoFromSyncIo) {
 	EXPECT_EQ(string(output.begin(), output.begin() + input.size()), input);
 }
 
+TEST(EventsIo, AsyncCopyMultiBuffer) {
+	TestEventLoop loop;
+
+	// Several blocks, and not a multiple of the block size.
+	string input;
+	for (int i = 0; input.size() < 100000; i++) {
+		input += to_string(i) + ",";
+	}
+
+	struct TestCase {
+		size_t buffer_count;
+		int64_t stop_after;
+		size_t expected_size;
+	};
+	vector<TestCase> cases {
+		{1, numeric_limits<int64_t>::max(), input.size()},
+		{2, numeric_limits<int64_t>::max(), input.size()},
+		{4, numeric_limits<int64_t>::max(), input.size()},
+		{3, 50000, 50000},
+	};
+
+	for (auto &c : cases) {
+		io::ReaderPtr reader = make_shared<io::StringReader>(input);
+
+		vector<uint8_t> output;
+		auto byte_writer = make_shared<io::ByteWriter>(output);
+		byte_writer->SetUnlimited(true);
+
+		auto areader = make_shared<events::io::AsyncReaderFromReader>(loop, reader);
+		auto awriter = make_shared<events::io::AsyncWriterFromWriter>(loop, byte_writer);
+
+		bool finished = false;
+		io::AsyncCopyMultiBuffer(
+			awriter, areader, c.buffer_count, [&finished, &loop](error::Error err) {
+				EXPECT_EQ(err, error::NoError) << err.String();
+				finished = true;
+				loop.Stop();
+			},
+			c.stop_after);
+
+		loop.Run();
+
+		EXPECT_TRUE(finished) << "buffer_count: " << c.buffer_count;
+		EXPECT_EQ(string(output.begin(), output.end()), input.substr(0, c.expected_size))
+			<< "buffer_count: " << c.buffer_count;
+	}
+}
+
 // Dummy reader that detects the number of '1' in a stream. It is meant to verify that it
 // actually reads the stream together with the main reader, and can fail the EOF Read if necessary
 class CountOnesReader : virtual public io::AsyncReader {
@@ -15,8 +15,12 @@
 #include <common/http.hpp>
 
 #include <chrono>
+#include <fstream>
 #include <thread>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -1552,6 +1556,245 @@ TEST(HttpTest, SerialRequestsWithSameObjectAfterCancel) {
 	EXPECT_TRUE(client_hit2_body);
 }
 
+TEST(HttpTest, SerialRequestsWithKeepAlive) {
+	TestEventLoop loop;
+
+	const size_t request_count = 3;
+	vector<unordered_set<shared_ptr<http::Stream>>> server_streams;
+
+	http::ServerConfig server_config;
+	server_config.keep_alive = true;
+	http::TestServer server(server_config, loop);
+	auto err = server.AsyncServeUrl(
+		"http://127.0.0.1:" TEST_PORT,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+		},
+		[&server, &server_streams](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			server_streams.push_back(http::TestInspector::GetStreams(server));
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetHeader("Content-Length", to_string(BodyOfXes::TARGET_BODY_SIZE));
+			resp->SetBodyReader(make_shared<BodyOfXes>());
+			resp->SetStatusCodeAndMessage(200, "Success");
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	http::ClientConfig client_config;
+	client_config.keep_alive = true;
+	http::Client client(client_config, loop);
+
+	size_t responses = 0;
+	vector<uint8_t> received_body;
+	function<void()> make_request = [&]() {
+		received_body.clear();
+		auto req = make_shared<http::OutgoingRequest>();
+		req->SetMethod(http::Method::GET);
+		req->SetAddress("http://127.0.0.1:" TEST_PORT "/endpoint");
+		auto err = client.AsyncCall(
+			req,
+			[&received_body](http::ExpectedIncomingResponsePtr exp_resp) {
+				ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+				auto body_writer = make_shared<io::ByteWriter>(received_body);
+				body_writer->SetUnlimited(true);
+				exp_resp.value()->SetBodyWriter(body_writer);
+			},
+			[&](http::ExpectedIncomingResponsePtr exp_resp) {
+				ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+				EXPECT_EQ(received_body.size(), size_t {BodyOfXes::TARGET_BODY_SIZE});
+				if (++responses < request_count) {
+					make_request();
+				} else {
+					loop.Stop();
+				}
+			});
+		ASSERT_EQ(error::NoError, err);
+	};
+	make_request();
+
+	loop.Run();
+
+	EXPECT_EQ(responses, request_count);
+	ASSERT_EQ(server_streams.size(), request_count);
+	// All requests should have been served on the first connection, so no new streams should
+	// have been accepted in between.
+	EXPECT_EQ(server_streams[0], server_streams[1]);
+	EXPECT_EQ(server_streams[0], server_streams[2]);
+
+	// Closing the connection on the client side should make the server drop the stream.
+	client.Cancel();
+}
+
+TEST(HttpTest, IdleKeepAliveConnectionIsClosed) {
+	TestEventLoop loop;
+
+	http::ServerConfig server_config;
+	server_config.keep_alive = true;
+	server_config.keep_alive_idle_timeout = chrono::seconds {1};
+	http::TestServer server(server_config, loop);
+	auto err = server.AsyncServeUrl(
+		"http://127.0.0.1:" TEST_PORT,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+		},
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetHeader("Content-Length", "0");
+			resp->SetStatusCodeAndMessage(200, "Success");
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	http::ClientConfig client_config;
+	client_config.keep_alive = true;
+	http::Client client(client_config, loop);
+
+	events::Timer timer(loop);
+	bool responded = false;
+	size_t streams_while_idle = 0;
+	auto req = make_shared<http::OutgoingRequest>();
+	req->SetMethod(http::Method::GET);
+	req->SetAddress("http://127.0.0.1:" TEST_PORT "/endpoint");
+	err = client.AsyncCall(
+		req,
+		[](http::ExpectedIncomingResponsePtr exp_resp) {
+			ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+		},
+		[&](http::ExpectedIncomingResponsePtr exp_resp) {
+			ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+			responded = true;
+			streams_while_idle = http::TestInspector::GetStreams(server).size();
+
+			// The client keeps the connection open, but the server should give up on it
+			// after the idle timeout.
+			timer.AsyncWait(chrono::seconds {2}, [&loop](error::Error err) { loop.Stop(); });
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	loop.Run();
+
+	EXPECT_TRUE(responded);
+	// One for the kept-alive connection, and one waiting for new connections.
+	EXPECT_EQ(streams_while_idle, 2);
+	EXPECT_EQ(http::TestInspector::GetStreams(server).size(), 1);
+}
+
+TEST(HttpTest, ServeOnUnixSocket) {
+	TestEventLoop loop;
+
+	mendertesting::TemporaryDirectory tmpdir;
+	const string socket_path = tmpdir.Path() + "/http.sock";
+	{
+		// Pretend a previous instance left its socket behind.
+		boost::asio::io_context io_context;
+		boost::asio::local::stream_protocol::acceptor stale(
+			io_context, boost::asio::local::stream_protocol::endpoint(socket_path));
+	}
+
+	// Not a `TestServer`, since there is no listening stream left at the end.
+	http::Server server(http::ServerConfig {}, loop);
+	auto err = server.AsyncServeUrl(
+		"unix://" + socket_path,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			EXPECT_EQ(exp_req.value()->GetPath(), "/endpoint");
+		},
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetHeader("Content-Length", "0");
+			resp->SetStatusCodeAndMessage(200, "Success");
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	EXPECT_EQ(server.GetUrl(), "unix://" + socket_path);
+	EXPECT_EQ(server.GetPort(), 0);
+
+	struct stat socket_stat;
+	ASSERT_EQ(stat(socket_path.c_str(), &socket_stat), 0);
+	EXPECT_EQ(socket_stat.st_mode & 0777, 0600);
+
+	// The request path is appended to the server URL, like for TCP.
+	bool client_hit_body = false;
+	http::Client client(http::ClientConfig {}, loop);
+	auto req = make_shared<http::OutgoingRequest>();
+	req->SetMethod(http::Method::GET);
+	req->SetAddress(server.GetUrl() + "/endpoint");
+	err = client.AsyncCall(
+		req,
+		[](http::ExpectedIncomingResponsePtr exp_resp) {
+			ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+			EXPECT_EQ(exp_resp.value()->GetStatusCode(), 200);
+		},
+		[&client_hit_body, &loop](http::ExpectedIncomingResponsePtr exp_resp) {
+			ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+			client_hit_body = true;
+			loop.Stop();
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	loop.Run();
+
+	EXPECT_TRUE(client_hit_body);
+
+	server.Cancel();
+	EXPECT_NE(access(socket_path.c_str(), F_OK), 0);
+}
+
+TEST(HttpTest, ServeOnUnixSocketKeepsOtherFiles) {
+	TestEventLoop loop;
+
+	mendertesting::TemporaryDirectory tmpdir;
+	const string socket_path = tmpdir.Path() + "/http.sock";
+	{
+		ofstream file(socket_path);
+		file << "not a socket";
+	}
+
+	http::Server server(http::ServerConfig {}, loop);
+	auto err = server.AsyncServeUrl(
+		"unix://" + socket_path,
+		[](http::ExpectedIncomingRequestPtr exp_req) {},
+		[](http::ExpectedIncomingRequestPtr exp_req) {});
+	EXPECT_NE(error::NoError, err);
+
+	ifstream file(socket_path);
+	string content;
+	getline(file, content);
+	EXPECT_EQ(content, "not a socket");
+}
+
+TEST(HttpTest, ClientWithoutUnixSocket) {
+	TestEventLoop loop;
+
+	mendertesting::TemporaryDirectory tmpdir;
+
+	http::Client client(http::ClientConfig {}, loop);
+	auto req = make_shared<http::OutgoingRequest>();
+	req->SetMethod(http::Method::GET);
+	req->SetAddress("unix://" + tmpdir.Path() + "/http.sock/endpoint");
+	auto err = client.AsyncCall(
+		req,
+		[](http::ExpectedIncomingResponsePtr exp_resp) {},
+		[](http::ExpectedIncomingResponsePtr exp_resp) {});
+	EXPECT_EQ(err.code, make_error_condition(errc::no_such_file_or_directory));
+}
+
 TEST(HttpTest, DestroyClientBeforeRequestComplete) {
 	TestEventLoop loop;
 
@@ -17,6 +17,8 @@
 #include <cerrno>
 #include <functional>
 
+#include <unistd.h>
+
 #include <common/testing.hpp>
 
 #include <gtest/gtest.h>
@@ -329,6 +331,61 @@ TEST(IO, TestByteReader) {
 	EXPECT_EQ(vec_write2, (vector<uint8_t> {1, 2, 3, 4, 5, 6, 7, 14}));
 }
 
+TEST(IO, TestBufferChains) {
+	vector<uint8_t> vec_read {1, 2, 3, 4, 5, 6, 7, 14};
+	auto byte_reader = io::ByteReader(vec_read);
+
+	vector<uint8_t> first(3);
+	vector<uint8_t> second(3);
+	vector<uint8_t> third(3);
+	io::MutableBufferChain read_chain {first, second, third};
+	EXPECT_EQ(io::BufferChainSize(read_chain), 9);
+
+	auto ex_bytes_read = byte_reader.ReadV(read_chain);
+	ASSERT_TRUE(ex_bytes_read.has_value()) << ex_bytes_read.error().String();
+	ASSERT_EQ(8, ex_bytes_read.value());
+	EXPECT_EQ(first, (vector<uint8_t> {1, 2, 3}));
+	EXPECT_EQ(second, (vector<uint8_t> {4, 5, 6}));
+	EXPECT_EQ(third, (vector<uint8_t> {7, 14, 0}));
+
+	ex_bytes_read = byte_reader.ReadV(read_chain);
+	ASSERT_TRUE(ex_bytes_read.has_value()) << ex_bytes_read.error().String();
+	EXPECT_EQ(0, ex_bytes_read.value());
+
+	vector<uint8_t> vec_write {};
+	auto byte_writer = io::ByteWriter(vec_write);
+	byte_writer.SetUnlimited(true);
+
+	const vector<uint8_t> empty {};
+	io::ConstBufferChain write_chain {first, empty, second, third};
+	EXPECT_EQ(io::BufferChainSize(write_chain), 9);
+
+	auto ex_bytes_written = byte_writer.WriteV(write_chain);
+	ASSERT_TRUE(ex_bytes_written.has_value()) << ex_bytes_written.error().String();
+	ASSERT_EQ(9, ex_bytes_written.value());
+	EXPECT_EQ(vec_write, (vector<uint8_t> {1, 2, 3, 4, 5, 6, 7, 14, 0}));
+
+	// An error is not hidden behind the buffers which were written before it.
+	class FailingWriter : public io::Writer {
+	public:
+		expected::ExpectedSize Write(
+			vector<uint8_t>::const_iterator start, vector<uint8_t>::const_iterator end) override {
+			if (writes_++ > 0) {
+				return expected::unexpected(
+					error::Error(make_error_condition(errc::io_error), "Write failed"));
+			}
+			return end - start;
+		}
+
+	private:
+		int writes_ {0};
+	};
+	FailingWriter failing_writer;
+	ex_bytes_written = failing_writer.WriteV(write_chain);
+	ASSERT_FALSE(ex_bytes_written.has_value());
+	EXPECT_EQ(ex_bytes_written.error().code, make_error_condition(errc::io_error));
+}
+
 class StreamIOTests : public testing::Test {
 protected:
 	TemporaryDirectory tmp_dir;
@@ -369,6 +426,74 @@ TEST_F(StreamIOTests, OpenIfstreamOfstreamNoexist) {
 	EXPECT_TRUE(ex_os.error().IsErrno(ENOENT));
 }
 
+TEST_F(StreamIOTests, MappedFileReader) {
+	string test_file_path = tmp_dir.Path() + "/test_file";
+
+	// Big enough that pages get released behind the read position.
+	vector<uint8_t> content(3 * 1024 * 1024 + 123);
+	for (size_t i = 0; i < content.size(); i++) {
+		content[i] = static_cast<uint8_t>(i % 251);
+	}
+	{
+		auto ex_os = io::OpenOfstream(test_file_path);
+		ASSERT_TRUE(ex_os);
+		io::StreamWriter writer(ex_os.value());
+		auto ex_written = writer.Write(content.cbegin(), content.cend());
+		ASSERT_TRUE(ex_written);
+	}
+
+	auto ex_reader = io::OpenMappedFile(test_file_path);
+	ASSERT_TRUE(ex_reader) << ex_reader.error().String();
+	auto reader = ex_reader.value();
+	EXPECT_EQ(reader->Size(), content.size());
+
+	vector<uint8_t> received;
+	vector<uint8_t> buf(1000);
+	auto ex_read = reader->Read(buf.begin(), buf.end());
+	ASSERT_TRUE(ex_read);
+	ASSERT_EQ(ex_read.value(), 1000);
+	received.insert(received.end(), buf.begin(), buf.end());
+	while (true) {
+		auto view = reader->ReadView(100000);
+		ASSERT_TRUE(view);
+		if (view.value().size == 0) {
+			break;
+		}
+		received.insert(received.end(), view.value().data, view.value().data + view.value().size);
+	}
+	EXPECT_EQ(received, content);
+
+	ex_read = reader->Read(buf.begin(), buf.end());
+	ASSERT_TRUE(ex_read);
+	EXPECT_EQ(ex_read.value(), 0);
+
+	// Empty files cannot be mapped, but should still work.
+	string empty_file_path = tmp_dir.Path() + "/empty_file";
+	ASSERT_TRUE(io::OpenOfstream(empty_file_path));
+	ex_reader = io::OpenMappedFile(empty_file_path);
+	ASSERT_TRUE(ex_reader) << ex_reader.error().String();
+	ex_read = ex_reader.value()->Read(buf.begin(), buf.end());
+	ASSERT_TRUE(ex_read);
+	EXPECT_EQ(ex_read.value(), 0);
+
+	ex_reader = io::OpenMappedFile(tmp_dir.Path());
+	EXPECT_FALSE(ex_reader);
+
+	// Reading past the end of a truncated file would raise SIGBUS.
+	ex_reader = io::OpenMappedFile(test_file_path);
+	ASSERT_TRUE(ex_reader) << ex_reader.error().String();
+	ASSERT_EQ(truncate(test_file_path.c_str(), 1000), 0);
+	ex_read = ex_reader.value()->Read(buf.begin(), buf.end());
+	ASSERT_TRUE(ex_read);
+	EXPECT_EQ(ex_read.value(), 1000);
+	auto view = ex_reader.value()->ReadView(100000);
+	EXPECT_FALSE(view);
+
+	ex_reader = io::OpenMappedFile(tmp_dir.Path() + "/noexist");
+	ASSERT_FALSE(ex_reader);
+	EXPECT_TRUE(ex_reader.error().IsErrno(ENOENT));
+}
+
 TEST_F(StreamIOTests, WriteStringIntoOfstreamOK) {
 	string test_file_path = tmp_dir.Path() + "/test_file";
 
@@ -72,6 +72,14 @@ TEST(JsonStringTests, LoadFromValidString) {
 	ASSERT_TRUE(ej);
 	json::Json j = ej.value();
 	EXPECT_FALSE(j.IsNull());
+
+	// Only the given part should be parsed.
+	string data {R"({"key": "value"}trailing garbage)"};
+	ej = json::Load(reinterpret_cast<const uint8_t *>(data.data()), 16);
+	ASSERT_TRUE(ej) << ej.error().String();
+	auto value = ej.value().Get("key").and_then(json::ToString);
+	ASSERT_TRUE(value);
+	EXPECT_EQ(value.value(), "value");
 }
 
 TEST(JsonStringTests, LoadFromInvalidString) {
@@ -0,0 +1,149 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <common/key_value_database_lmdb.hpp>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <common/error.hpp>
+#include <common/path.hpp>
+#include <common/testing.hpp>
+
+using namespace std;
+
+namespace error = mender::common::error;
+namespace kvdb = mender::common::key_value_database;
+namespace mtesting = mender::common::testing;
+namespace path = mender::common::path;
+
+using BenchmarkParams = tuple<kvdb::Durability, mtesting::BenchmarkLocation>;
+
+static string DurabilityName(kvdb::Durability durability) {
+	switch (durability) {
+	case kvdb::Durability::Full:
+		return "Full";
+	case kvdb::Durability::NoMetaSync:
+		return "NoMetaSync";
+	case kvdb::Durability::NoSync:
+		return "NoSync";
+	}
+	return "Unknown";
+}
+
+class KeyValueDatabaseBenchmark : public testing::TestWithParam<BenchmarkParams> {
+protected:
+	void SetUp() override {
+		tmpdir_.reset(new mtesting::TemporaryDirectory(get<1>(GetParam()).path));
+		auto err = db_.Open(path::Join(tmpdir_->Path(), "mender-store"), get<0>(GetParam()));
+		ASSERT_EQ(err, error::NoError) << err.String();
+	}
+
+	void TearDown() override {
+		db_.Close();
+		tmpdir_.reset();
+	}
+
+	unique_ptr<mtesting::TemporaryDirectory> tmpdir_;
+	kvdb::KeyValueDatabaseLmdb db_;
+};
+
+INSTANTIATE_TEST_SUITE_P(
+	,
+	KeyValueDatabaseBenchmark,
+	testing::Combine(
+		testing::Values(
+			kvdb::Durability::Full, kvdb::Durability::NoMetaSync, kvdb::Durability::NoSync),
+		testing::ValuesIn(mtesting::BenchmarkLocations())),
+	[](const testing::TestParamInfo<BenchmarkParams> &info) {
+		return DurabilityName(get<0>(info.param)) + "_" + get<1>(info.param).name;
+	});
+
+static const vector<size_t> kValueSizes {64, 4096, 256 * 1024};
+
+TEST_P(KeyValueDatabaseBenchmark, Write) {
+	for (auto size : kValueSizes) {
+		vector<uint8_t> value(size, 'x');
+		mtesting::Benchmark bench("write_" + to_string(size));
+		for (int i = 0; i < 200; i++) {
+			value[0] = static_cast<uint8_t>(i);
+			bench.Measure([&]() { EXPECT_EQ(db_.Write("key", value), error::NoError); });
+		}
+	}
+}
+
+TEST_P(KeyValueDatabaseBenchmark, Read) {
+	for (auto size : kValueSizes) {
+		ASSERT_EQ(db_.Write("key", vector<uint8_t>(size, 'x')), error::NoError);
+
+		{
+			mtesting::Benchmark bench("read_" + to_string(size));
+			for (int i = 0; i < 2000; i++) {
+				bench.Measure([&]() { EXPECT_TRUE(db_.Read("key")); });
+			}
+		}
+
+		{
+			mtesting::Benchmark bench("read_view_" + to_string(size));
+			for (int i = 0; i < 2000; i++) {
+				bench.Measure([&]() {
+					auto err = db_.ReadView("key", [size](const uint8_t *data, size_t value_size) {
+						EXPECT_EQ(value_size, size);
+						return error::NoError;
+					});
+					EXPECT_EQ(err, error::NoError);
+				});
+			}
+		}
+	}
+}
+
+TEST_P(KeyValueDatabaseBenchmark, Transactions) {
+	// The same number of writes, either in separate transactions, or grouped.
+	const vector<uint8_t> value(4096, 'x');
+	for (int writes_per_txn : {1, 10, 100}) {
+		mtesting::Benchmark bench("txn_" + to_string(writes_per_txn) + "_writes_of_4096");
+		for (int i = 0; i < 1000 / writes_per_txn; i++) {
+			bench.Measure([&]() {
+				auto err = db_.WriteTransaction([&](kvdb::Transaction &txn) {
+					for (int j = 0; j < writes_per_txn; j++) {
+						auto err = txn.Write("key" + to_string(j), value);
+						if (err != error::NoError) {
+							return err;
+						}
+					}
+					return error::NoError;
+				});
+				EXPECT_EQ(err, error::NoError);
+			});
+		}
+	}
+}
+
+TEST_P(KeyValueDatabaseBenchmark, WritesWithSync) {
+	// What the relaxed durability settings cost when they are checkpointed regularly.
+	const vector<uint8_t> value(4096, 'x');
+	mtesting::Benchmark bench("10_writes_then_sync");
+	for (int i = 0; i < 50; i++) {
+		bench.Measure([&]() {
+			for (int j = 0; j < 10; j++) {
+				EXPECT_EQ(db_.Write("key" + to_string(j), value), error::NoError);
+			}
+			EXPECT_EQ(db_.Sync(), error::NoError);
+		});
+	}
+}
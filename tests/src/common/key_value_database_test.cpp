@@ -59,6 +59,22 @@ static vector<KeyValueDatabaseSetup> GenerateDatabaseSetups() {
 	assert(err == error::NoError);
 	elem.db = lmdb_db;
 	ret.push_back(elem);
+
+	elem.name = "LMDB_NoMetaSync";
+	elem.tmpdir = std::make_shared<mender::common::testing::TemporaryDirectory>();
+	lmdb_db = std::make_shared<kvdb::KeyValueDatabaseLmdb>();
+	err = lmdb_db->Open(elem.tmpdir->Path() + "mender-store", kvdb::Durability::NoMetaSync);
+	assert(err == error::NoError);
+	elem.db = lmdb_db;
+	ret.push_back(elem);
+
+	elem.name = "LMDB_NoSync";
+	elem.tmpdir = std::make_shared<mender::common::testing::TemporaryDirectory>();
+	lmdb_db = std::make_shared<kvdb::KeyValueDatabaseLmdb>();
+	err = lmdb_db->Open(elem.tmpdir->Path() + "mender-store", kvdb::Durability::NoSync);
+	assert(err == error::NoError);
+	elem.db = lmdb_db;
+	ret.push_back(elem);
 #endif
 
 	return ret;
@@ -193,6 +209,52 @@ TEST_P(KeyValueDatabaseTest, TestReadTransactionFailure) {
 	EXPECT_EQ(db_error, err);
 }
 
+TEST_P(KeyValueDatabaseTest, TestReadView) {
+	kvdb::KeyValueDatabase &db = *GetParam().db;
+
+	db.Write("foo", common::ByteVectorFromString("bar"));
+
+	string value;
+	auto err = db.ReadView("foo", [&value](const uint8_t *data, size_t size) {
+		value.assign(reinterpret_cast<const char *>(data), size);
+		return error::NoError;
+	});
+	ASSERT_EQ(error::NoError, err);
+	EXPECT_EQ(value, "bar");
+
+	err = db.ReadTransaction([](kvdb::Transaction &txn) -> error::Error {
+		auto err = txn.ReadView("foo", [](const uint8_t *data, size_t size) {
+			EXPECT_EQ(string(reinterpret_cast<const char *>(data), size), "bar");
+			return error::NoError;
+		});
+		EXPECT_EQ(error::NoError, err);
+
+		bool called = false;
+		err = txn.ReadView("bogus", [&called](const uint8_t *data, size_t size) {
+			called = true;
+			return error::NoError;
+		});
+		EXPECT_EQ(err.code, kvdb::MakeError(kvdb::KeyError, "Key Not found").code);
+		EXPECT_FALSE(called);
+		return error::NoError;
+	});
+	ASSERT_EQ(error::NoError, err);
+
+	// Errors from the callback are passed through.
+	auto cb_err = kvdb::MakeError(kvdb::LmdbError, "Some error");
+	err = db.ReadView("foo", [&cb_err](const uint8_t *data, size_t size) { return cb_err; });
+	EXPECT_EQ(err, cb_err);
+
+	string str;
+	err = kvdb::ReadString(db, "foo", str);
+	ASSERT_EQ(error::NoError, err);
+	EXPECT_EQ(str, "bar");
+	err = kvdb::ReadString(db, "bogus", str, true);
+	EXPECT_EQ(error::NoError, err);
+	err = kvdb::ReadString(db, "bogus", str, false);
+	EXPECT_EQ(err.code, kvdb::MakeError(kvdb::KeyError, "Key Not found").code);
+}
+
 #ifdef MENDER_USE_LMDB
 TEST(KeyValueDatabaseLmdbTest, TestSomeLmdbExceptionPaths) {
 	kvdb::KeyValueDatabaseLmdb db;
@@ -251,4 +313,30 @@ TEST(KeyValueDatabaseLmdbTest, CorruptedDatabaseRecovery) {
 	EXPECT_THAT(err.String(), testing::HasSubstr("MDB_INVALID"));
 	EXPECT_THAT(err.String(), testing::HasSubstr("Is a directory"));
 }
+
+TEST(KeyValueDatabaseLmdbTest, SyncAndReopen) {
+	mtesting::TemporaryDirectory tmpdir;
+	string db_path = path::Join(tmpdir.Path(), "db");
+
+	for (auto durability :
+		 {kvdb::Durability::Full, kvdb::Durability::NoMetaSync, kvdb::Durability::NoSync}) {
+		kvdb::KeyValueDatabaseLmdb db;
+		ASSERT_EQ(error::NoError, db.Open(db_path, durability));
+
+		auto data = common::ByteVectorFromString("value" + to_string(int(durability)));
+		EXPECT_EQ(error::NoError, db.Write("key", data));
+		EXPECT_EQ(error::NoError, db.Sync());
+		EXPECT_EQ(error::NoError, db.Write("key2", data));
+		// Closing must flush whatever hasn't been synced yet.
+		db.Close();
+
+		ASSERT_EQ(error::NoError, db.Open(db_path));
+		auto result = db.Read("key");
+		ASSERT_TRUE(result) << result.error().String();
+		EXPECT_EQ(result.value(), data);
+		result = db.Read("key2");
+		ASSERT_TRUE(result) << result.error().String();
+		EXPECT_EQ(result.value(), data);
+	}
+}
 #endif // MENDER_USE_LMDB
@@ -40,8 +40,12 @@ shared_ptr<ostream> AssertInDeathTestHelper(const char *func, const char *file,
 	return shared_ptr<ostream>(new ostream(cerr.rdbuf()), [](ostream *) { std::abort(); });
 }
 
-TemporaryDirectory::TemporaryDirectory() {
-	fs::path path = fs::temp_directory_path();
+TemporaryDirectory::TemporaryDirectory() :
+	TemporaryDirectory(fs::temp_directory_path()) {
+}
+
+TemporaryDirectory::TemporaryDirectory(const string &parent) {
+	fs::path path = parent;
 	path.append("mender-test-" + std::to_string(std::random_device()()));
 	if (!fs::create_directories(path)) {
 		throw runtime_error("Failed to create the temporary directory: " + string(path));
@@ -135,6 +139,31 @@ void TemporaryDirectory::CreateSubDirectory(const string &dirname) {
 	return ::testing::AssertionFailure() << filename1 << " and " << filename2 << " are equal";
 }
 
+vector<BenchmarkLocation> BenchmarkLocations() {
+	vector<BenchmarkLocation> locations;
+	if (fs::is_directory("/dev/shm")) {
+		locations.push_back({"tmpfs", "/dev/shm"});
+	}
+	auto dir = getenv("MENDER_BENCHMARK_DIR");
+	locations.push_back({"disk", dir != nullptr ? dir : fs::current_path().string()});
+	return locations;
+}
+
+Benchmark::Benchmark(const string &name) :
+	name_ {name} {
+}
+
+Benchmark::~Benchmark() {
+	if (iterations_ == 0) {
+		return;
+	}
+	auto per_iteration =
+		chrono::duration_cast<chrono::nanoseconds>(total_).count() / iterations_;
+	cout << "[ BENCH    ] " << name_ << ": " << static_cast<double>(per_iteration) / 1000.0
+		 << " us/op over " << iterations_ << " ops" << endl;
+	::testing::Test::RecordProperty(name_ + "_ns", to_string(per_iteration));
+}
+
 const string HttpFileServer::serve_address_ {"http://127.0.0.1:53272"};
 
 HttpFileServer::HttpFileServer(const string &dir) :
@@ -15,8 +15,10 @@
 #ifndef MENDER_COMMON_TESTING
 #define MENDER_COMMON_TESTING
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -54,6 +56,8 @@ shared_ptr<ostream> AssertInDeathTestHelper(const char *func, const char *file,
 class TemporaryDirectory {
 public:
 	TemporaryDirectory();
+	// Creates the directory inside `parent`, instead of the system's temporary directory.
+	explicit TemporaryDirectory(const string &parent);
 	~TemporaryDirectory();
 
 	std::string Path() const;
@@ -114,6 +118,39 @@ private:
 	stringstream cerr_string_;
 };
 
+// A place to keep the data of a benchmark, so that the numbers can be compared between file
+// systems.
+struct BenchmarkLocation {
+	string name;
+	string path;
+};
+
+// Returns `/dev/shm` as "tmpfs", if it exists, and the directory in the `MENDER_BENCHMARK_DIR`
+// environment variable, or else the current directory, as "disk".
+vector<BenchmarkLocation> BenchmarkLocations();
+
+// Adds up the time spent in `Measure()`, and reports the average when destroyed, on stdout and as
+// a property in the test report. `name` should only contain characters which are valid in an XML
+// attribute name.
+class Benchmark {
+public:
+	Benchmark(const string &name);
+	~Benchmark();
+
+	template <typename Func>
+	void Measure(Func func) {
+		auto start = chrono::steady_clock::now();
+		func();
+		total_ += chrono::steady_clock::now() - start;
+		iterations_++;
+	}
+
+private:
+	string name_;
+	chrono::steady_clock::duration total_ {0};
+	int iterations_ {0};
+};
+
 class HttpFileServer {
 public:
 	HttpFileServer(const string &dir);
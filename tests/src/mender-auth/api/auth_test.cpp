@@ -255,3 +255,124 @@ TEST_F(AuthTests, FetchJWTTokenFailTest) {
 
 	ASSERT_EQ(err, error::NoError) << "Unexpected error: " << err.message;
 }
+
+TEST_F(AuthTests, FetchJWTTokenParallelTest) {
+	const string JWT_TOKEN = "FOOBARJWTTOKEN";
+
+	TestEventLoop loop;
+
+	// Setup test servers (a working one and one which never answers)
+	const string working_server_url {"http://127.0.0.1:" + TEST_PORT};
+	http::ServerConfig server_config;
+	http::Server working_server(server_config, loop);
+	working_server.AsyncServeUrl(
+		working_server_url,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			exp_req.value()->SetBodyWriter(make_shared<io::Discard>());
+		},
+		[JWT_TOKEN](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetStatusCodeAndMessage(200, "OK");
+			resp->SetBodyReader(make_shared<io::StringReader>(JWT_TOKEN));
+			resp->SetHeader("Content-Length", to_string(JWT_TOKEN.size()));
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+
+	const string hanging_server_url {"http://127.0.0.1:" + TEST_PORT3};
+	http::Server hanging_server(server_config, loop);
+	vector<http::OutgoingResponsePtr> hanging_responses;
+	hanging_server.AsyncServeUrl(
+		hanging_server_url,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			exp_req.value()->SetBodyWriter(make_shared<io::Discard>());
+		},
+		[&hanging_responses](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			// Keep the response, but never reply.
+			hanging_responses.push_back(result.value());
+		});
+
+	string private_key_path = "./private_key.pem";
+
+	string server_certificate_path {};
+	http::ClientConfig client_config {server_certificate_path};
+	auth::ParallelAuthClient client {loop, client_config, chrono::milliseconds {100}};
+
+	vector<string> servers {hanging_server_url, working_server_url};
+	auth::APIResponseHandler handle_jwt_token_callback =
+		[&loop, JWT_TOKEN, working_server_url](auth::APIResponse resp) {
+			ASSERT_TRUE(resp);
+			EXPECT_EQ(resp.value().token, JWT_TOKEN);
+			EXPECT_EQ(resp.value().server_url, working_server_url);
+			loop.Stop();
+		};
+	auto err = client.FetchJWTToken(
+		servers, {private_key_path}, test_device_identity_script, handle_jwt_token_callback);
+
+	loop.Run();
+
+	ASSERT_EQ(err, error::NoError) << "Unexpected error: " << err.message;
+}
+
+TEST_F(AuthTests, FetchJWTTokenParallelFailTest) {
+	TestEventLoop loop;
+
+	http::ServerConfig server_config;
+	const string failing_server_url {"http://127.0.0.1:" + TEST_PORT3};
+	http::Server failing_server(server_config, loop);
+	const string err_response_data =
+		R"({"error": "Bad weather in the clouds", "response-id": "some id here"})";
+	failing_server.AsyncServeUrl(
+		failing_server_url,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			exp_req.value()->SetBodyWriter(make_shared<io::Discard>());
+		},
+		[err_response_data](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetStatusCodeAndMessage(500, "Internal server error");
+			resp->SetBodyReader(make_shared<io::StringReader>(err_response_data));
+			resp->SetHeader("Content-Length", to_string(err_response_data.size()));
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+
+	string private_key_path = "./private_key.pem";
+
+	string server_certificate_path {};
+	http::ClientConfig client_config {server_certificate_path};
+	// Long stagger, so that the second server is only tried because the first one failed.
+	auth::ParallelAuthClient client {loop, client_config, chrono::seconds {60}};
+
+	const string no_server_url {"http://127.0.0.1:" + TEST_PORT2};
+	vector<string> servers {no_server_url, failing_server_url};
+	int calls = 0;
+	auth::APIResponseHandler handle_jwt_token_callback = [&loop, &calls](auth::APIResponse resp) {
+		calls++;
+		loop.Stop();
+		ASSERT_FALSE(resp);
+		EXPECT_THAT(resp.error().String(), ::testing::HasSubstr("Authentication error"));
+		EXPECT_THAT(resp.error().String(), ::testing::HasSubstr("No more servers"));
+	};
+	auto err = client.FetchJWTToken(
+		servers, {private_key_path}, test_device_identity_script, handle_jwt_token_callback);
+
+	loop.Run();
+
+	ASSERT_EQ(err, error::NoError) << "Unexpected error: " << err.message;
+	EXPECT_EQ(calls, 1);
+}
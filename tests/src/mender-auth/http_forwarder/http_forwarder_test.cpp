@@ -70,6 +70,10 @@ public:
 		EXPECT_EQ(connections_.size(), 0);
 	}
 
+	size_t IdleClientCount() const {
+		return idle_clients_.size();
+	}
+
 private:
 	events::EventLoop &event_loop_;
 };
@@ -168,6 +172,77 @@ TEST(HttpForwarderTests, BasicRequest) {
 	EXPECT_TRUE(hit_endpoint_correctly);
 }
 
+TEST(HttpForwarderTests, SerialRequestsReuseUpstreamClient) {
+	mtesting::TestEventLoop loop;
+
+	int hit_endpoint = 0;
+
+	http::ServerConfig server_config;
+	server_config.keep_alive = true;
+	http::Server server(server_config, loop);
+	server.AsyncServeUrl(
+		"http://127.0.0.1:" TEST_PORT,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+		},
+		[&hit_endpoint](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			hit_endpoint++;
+
+			auto exp_resp = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+			auto resp = exp_resp.value();
+
+			resp->SetStatusCodeAndMessage(200, "OK");
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(err, error::NoError); });
+		});
+
+	http::ClientConfig client_config;
+
+	hf::TestServer forwarder(server_config, client_config, loop);
+	auto err = forwarder.AsyncForward("http://127.0.0.1:0", "http://127.0.0.1:" TEST_PORT "/");
+	ASSERT_EQ(err, error::NoError);
+
+	http::ClientConfig local_client_config;
+	local_client_config.keep_alive = true;
+	http::Client client(local_client_config, loop);
+
+	int responses = 0;
+	function<void()> make_request = [&]() {
+		auto req = make_shared<http::OutgoingRequest>();
+		req->SetMethod(http::Method::GET);
+		req->SetAddress(http::JoinUrl(forwarder.GetUrl(), "/test-endpoint"));
+		auto err = client.AsyncCall(
+			req,
+			[](http::ExpectedIncomingResponsePtr exp_resp) {
+				ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+			},
+			[&](http::ExpectedIncomingResponsePtr exp_resp) {
+				ASSERT_TRUE(exp_resp) << exp_resp.error().String();
+				EXPECT_EQ(exp_resp.value()->GetStatusCode(), 200);
+				if (++responses < 3) {
+					make_request();
+				} else {
+					loop.Stop();
+				}
+			});
+		ASSERT_EQ(err, error::NoError);
+	};
+	make_request();
+
+	loop.Run();
+
+	// The forwarder may finish its side of the last request slightly after the client.
+	events::Timer timer(loop);
+	timer.AsyncWait(chrono::milliseconds(100), [&loop](error::Error) { loop.Stop(); });
+	loop.Run();
+
+	EXPECT_EQ(hit_endpoint, 3);
+	EXPECT_EQ(responses, 3);
+	// Every request should have borrowed the same upstream client, and given it back.
+	EXPECT_EQ(forwarder.IdleClientCount(), 1);
+}
+
 TEST(HttpForwarderTests, RequestAndResponseWithBody) {
 	mtesting::TestEventLoop loop;
 
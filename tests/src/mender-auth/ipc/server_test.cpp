@@ -284,3 +284,114 @@ TEST_F(ListenClientTests, TestUseForwarder) {
 	EXPECT_EQ(server.GetServerURL(), server.GetForwarder().GetUrl());
 	EXPECT_NE(expected_hosted_url, server.GetServerURL());
 }
+
+TEST_F(ListenClientTests, TestPersistentCache) {
+	TestEventLoop loop;
+
+	// {"alg":"RS256","typ":"JWT"}.{"sub":"device-01","exp":4102444800}.signature
+	string expected_jwt_token {
+		"eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.eyJzdWIiOiJkZXZpY2UtMDEiLCJleHAiOjQxMDI0NDQ4MDB9."
+		"c2lnbmF0dXJl"};
+	string expected_hosted_url {"http://127.0.0.1:" TEST_PORT};
+	string cache_file {path::Join(tmp_dir_.Path(), "auth-token-cache.json")};
+
+	// Set up the test server (Emulating hosted mender)
+	http::ServerConfig test_server_config {};
+	http::Server http_server(test_server_config, loop);
+	auto err = http_server.AsyncServeUrl(
+		"http://127.0.0.1:" TEST_PORT,
+		[](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+			exp_req.value()->SetBodyWriter(make_shared<io::Discard>());
+		},
+		[&expected_jwt_token](http::ExpectedIncomingRequestPtr exp_req) {
+			ASSERT_TRUE(exp_req) << exp_req.error().String();
+
+			auto result = exp_req.value()->MakeResponse();
+			ASSERT_TRUE(result);
+			auto resp = result.value();
+
+			resp->SetStatusCodeAndMessage(200, "Success");
+			resp->SetBodyReader(make_shared<io::StringReader>(expected_jwt_token));
+			resp->SetHeader("Content-Length", to_string(expected_jwt_token.size()));
+			resp->AsyncReply([](error::Error err) { ASSERT_EQ(error::NoError, err); });
+		});
+	ASSERT_EQ(error::NoError, err);
+
+	conf::MenderConfig config {};
+	config.servers.push_back(expected_hosted_url);
+	config.tenant_token = "dummytenanttoken";
+
+	auto fetch_and_cache_token = [&]() {
+		ipc::Server server {loop, config};
+		server.UsePersistentCache(cache_file);
+		err = server.Listen({"./private-key.rsa.pem"}, test_device_identity_script);
+		ASSERT_EQ(err, error::NoError);
+		EXPECT_EQ(server.GetJWTToken(), "");
+
+		dbus::DBusClient client {loop};
+		err = client.RegisterSignalHandler<dbus::ExpectedStringPair>(
+			"io.mender.Authentication1",
+			"JwtTokenStateChange",
+			[&loop](dbus::ExpectedStringPair ex_value) {
+				ASSERT_TRUE(ex_value);
+				loop.Stop();
+			});
+		ASSERT_EQ(err, error::NoError);
+
+		err = client.CallMethod<expected::ExpectedBool>(
+			"io.mender.AuthenticationManager",
+			"/io/mender/AuthenticationManager",
+			"io.mender.Authentication1",
+			"FetchJwtToken",
+			[](expected::ExpectedBool ex_value) {
+				ASSERT_TRUE(ex_value) << ex_value.error().message;
+				EXPECT_TRUE(ex_value.value());
+			});
+		ASSERT_EQ(err, error::NoError);
+
+		loop.Run();
+
+		EXPECT_EQ(expected_jwt_token, server.GetJWTToken());
+		EXPECT_TRUE(path::FileExists(cache_file));
+	};
+
+	fetch_and_cache_token();
+
+	// A restarted server uses the cached token straight away.
+	{
+		ipc::Server server {loop, config};
+		server.UsePersistentCache(cache_file);
+		err = server.Listen({"./private-key.rsa.pem"}, test_device_identity_script);
+		ASSERT_EQ(err, error::NoError);
+
+		EXPECT_EQ(expected_jwt_token, server.GetJWTToken());
+		EXPECT_EQ(expected_hosted_url, server.GetForwarder().GetTargetUrl());
+		EXPECT_EQ(server.GetServerURL(), server.GetForwarder().GetUrl());
+	}
+
+	// But not with another tenant token.
+	config.tenant_token = "othertenanttoken";
+	{
+		ipc::Server server {loop, config};
+		server.UsePersistentCache(cache_file);
+		err = server.Listen({"./private-key.rsa.pem"}, test_device_identity_script);
+		ASSERT_EQ(err, error::NoError);
+
+		EXPECT_EQ(server.GetJWTToken(), "");
+		EXPECT_FALSE(path::FileExists(cache_file));
+	}
+
+	// Nor if the token doesn't say when it expires.
+	expected_jwt_token = "foobarbazbatz";
+	fetch_and_cache_token();
+	{
+		ipc::Server server {loop, config};
+		server.UsePersistentCache(cache_file);
+		err = server.Listen({"./private-key.rsa.pem"}, test_device_identity_script);
+		ASSERT_EQ(err, error::NoError);
+
+		EXPECT_EQ(server.GetJWTToken(), "");
+		EXPECT_FALSE(path::FileExists(cache_file));
+	}
+}
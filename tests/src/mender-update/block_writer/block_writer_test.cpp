@@ -0,0 +1,387 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <mender-update/block_writer/block_writer.hpp>
+
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <artifact/sha/sha.hpp>
+
+#include <common/path.hpp>
+#include <common/testing.hpp>
+
+using namespace std;
+
+namespace block_writer = mender::update::block_writer;
+namespace events = mender::common::events;
+namespace io = mender::common::io;
+namespace sha = mender::sha;
+namespace mtesting = mender::common::testing;
+namespace path = mender::common::path;
+
+static vector<uint8_t> ReadFile(const string &file) {
+	ifstream f(file, ios::binary);
+	return vector<uint8_t>(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+}
+
+TEST(BlockWriterTests, WriteRegularFile) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	// Data, then a large run of zeros, then some more data which doesn't end on a block boundary.
+	vector<uint8_t> data(10000, 'a');
+	data.resize(data.size() + 2 * 1024 * 1024, 0);
+	data.resize(data.size() + 5000, 'b');
+
+	block_writer::Options options;
+	options.buffer_size = 64 * 1024;
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	EXPECT_FALSE(writer.value()->IsBlockDevice());
+
+	// Odd sized chunks, so that writes straddle the buffer boundaries.
+	const size_t chunk = 12345;
+	for (size_t pos = 0; pos < data.size(); pos += chunk) {
+		auto end = data.begin() + min(pos + chunk, data.size());
+		auto result = writer.value()->Write(data.begin() + pos, end);
+		ASSERT_TRUE(result) << result.error().String();
+		EXPECT_EQ(result.value(), end - (data.begin() + pos));
+	}
+	EXPECT_EQ(writer.value()->BytesWritten(), data.size());
+
+	auto err = writer.value()->Finish();
+	ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+
+	// The zeros should have been left as a hole. Not all filesystems support that, so only check
+	// that we didn't use more space than the file size.
+	struct stat st;
+	ASSERT_EQ(stat(target.c_str(), &st), 0);
+	EXPECT_EQ(st.st_size, data.size());
+	EXPECT_LE(st.st_blocks * 512, data.size() + block_writer::BlockSize);
+}
+
+TEST(BlockWriterTests, TrailingZeros) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	vector<uint8_t> data(100, 'a');
+	data.resize(3 * block_writer::BlockSize + 7, 0);
+
+	auto writer = block_writer::BlockWriter::Open(target);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	auto err = writer.value()->Finish();
+	ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+}
+
+TEST(BlockWriterTests, ReplacesExistingContent) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+	{
+		ofstream f(target, ios::binary);
+		f << string(3 * block_writer::BlockSize, 'x');
+	}
+
+	// Zeros are not written, so the old content must not shine through.
+	vector<uint8_t> data(2 * block_writer::BlockSize, 0);
+	data[0] = 'a';
+
+	auto writer = block_writer::BlockWriter::Open(target);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	auto err = writer.value()->Finish();
+	ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+}
+
+TEST(BlockWriterTests, SkipUnchanged) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	vector<uint8_t> old_data(10 * block_writer::BlockSize, 'x');
+	{
+		ofstream f(target, ios::binary);
+		f.write(reinterpret_cast<const char *>(old_data.data()), old_data.size());
+	}
+
+	// Change one block in the middle, and make the new data longer than the old.
+	auto data = old_data;
+	data[4 * block_writer::BlockSize + 10] = 'y';
+	data.resize(data.size() + 100, 'z');
+
+	block_writer::Options options;
+	options.skip_unchanged = true;
+	options.buffer_size = 4 * block_writer::BlockSize;
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	auto err = writer.value()->Finish();
+	ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+	EXPECT_EQ(writer.value()->BytesSkipped(), 9 * block_writer::BlockSize);
+}
+
+TEST(BlockWriterTests, SkipUnchangedShrinksFile) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+	{
+		ofstream f(target, ios::binary);
+		f << string(3 * block_writer::BlockSize, 'x');
+	}
+
+	vector<uint8_t> data(block_writer::BlockSize + 1, 'x');
+
+	block_writer::Options options;
+	options.skip_unchanged = true;
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	auto err = writer.value()->Finish();
+	ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+	EXPECT_EQ(writer.value()->BytesSkipped(), data.size());
+}
+
+static vector<uint8_t> VerifyTestData() {
+	vector<uint8_t> data;
+	for (size_t i = 0; i < 1024 * 1024 + 123; i++) {
+		data.push_back(static_cast<uint8_t>(i * 7 + i / 4096));
+	}
+	return data;
+}
+
+TEST(BlockWriterTests, Verify) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+	auto checksum = sha::Shasum(data);
+	ASSERT_TRUE(checksum) << checksum.error().String();
+
+	// Flush often, so that the verification runs alongside the writing.
+	block_writer::Options options;
+	options.buffer_size = 16 * block_writer::BlockSize;
+	options.sync_interval = 64 * block_writer::BlockSize;
+	options.verify_checksum = checksum.value().String();
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	for (size_t pos = 0; pos < data.size(); pos += 10000) {
+		auto end = data.begin() + min(pos + 10000, data.size());
+		auto result = writer.value()->Write(data.begin() + pos, end);
+		ASSERT_TRUE(result) << result.error().String();
+	}
+	auto err = writer.value()->Finish();
+	EXPECT_EQ(err, mender::common::error::NoError) << err.String();
+
+	EXPECT_EQ(ReadFile(target), data);
+}
+
+TEST(BlockWriterTests, VerifyMismatch) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+	auto checksum = sha::Shasum(data);
+	ASSERT_TRUE(checksum) << checksum.error().String();
+	data[5000]++;
+
+	block_writer::Options options;
+	options.buffer_size = 16 * block_writer::BlockSize;
+	options.sync_interval = 64 * block_writer::BlockSize;
+	options.verify_checksum = checksum.value().String();
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	auto err = writer.value()->Finish();
+	EXPECT_EQ(err.code, sha::MakeError(sha::ShasumMismatchError, "").code) << err.String();
+}
+
+TEST(BlockWriterTests, VerifyAsync) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+	auto checksum = sha::Shasum(data);
+	ASSERT_TRUE(checksum) << checksum.error().String();
+
+	for (auto corrupt : {false, true}) {
+		SCOPED_TRACE(corrupt);
+
+		auto written = data;
+		if (corrupt) {
+			written[5000]++;
+		}
+
+		block_writer::Options options;
+		options.buffer_size = 16 * block_writer::BlockSize;
+		options.sync_interval = 64 * block_writer::BlockSize;
+		options.verify_checksum = checksum.value().String();
+		auto writer = block_writer::BlockWriter::Open(target, options);
+		ASSERT_TRUE(writer) << writer.error().String();
+		auto result = writer.value()->Write(written.begin(), written.end());
+		ASSERT_TRUE(result) << result.error().String();
+
+		mtesting::TestEventLoop loop;
+		bool called = false;
+		mender::common::error::Error err;
+		writer.value()->AsyncFinish(loop, [&](mender::common::error::Error finish_err) {
+			called = true;
+			err = finish_err;
+			loop.Stop();
+		});
+		loop.Run();
+
+		EXPECT_TRUE(called);
+		if (corrupt) {
+			EXPECT_EQ(err.code, sha::MakeError(sha::ShasumMismatchError, "").code)
+				<< err.String();
+		} else {
+			EXPECT_EQ(err, mender::common::error::NoError) << err.String();
+		}
+	}
+}
+
+TEST(BlockWriterTests, AsyncBlockWriter) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+	auto checksum = sha::Shasum(data);
+	ASSERT_TRUE(checksum) << checksum.error().String();
+
+	block_writer::Options options;
+	options.buffer_size = 16 * block_writer::BlockSize;
+	options.verify_checksum = checksum.value().String();
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+
+	mtesting::TestEventLoop loop;
+	block_writer::AsyncBlockWriter async_writer(loop, writer.value());
+
+	const size_t chunk = 12345;
+	size_t pos = 0;
+	mender::common::error::Error err;
+	bool finished = false;
+	function<void()> write_next;
+	write_next = [&]() {
+		if (pos >= data.size()) {
+			async_writer.AsyncFinish([&](mender::common::error::Error finish_err) {
+				finished = true;
+				err = finish_err;
+				loop.Stop();
+			});
+			return;
+		}
+		auto end = data.cbegin() + min(pos + chunk, data.size());
+		auto start_err = async_writer.AsyncWrite(
+			data.cbegin() + pos, end, [&, end](io::ExpectedSize result) {
+				ASSERT_TRUE(result) << result.error().String();
+				EXPECT_EQ(result.value(), end - (data.cbegin() + pos));
+				pos += result.value();
+				write_next();
+			});
+		ASSERT_EQ(start_err, mender::common::error::NoError) << start_err.String();
+	};
+	write_next();
+	loop.Run();
+
+	EXPECT_TRUE(finished);
+	EXPECT_EQ(err, mender::common::error::NoError) << err.String();
+	EXPECT_EQ(async_writer.Writer().BytesWritten(), data.size());
+	EXPECT_EQ(ReadFile(target), data);
+}
+
+TEST(BlockWriterTests, AsyncBlockWriterCancel) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+
+	auto writer = block_writer::BlockWriter::Open(target);
+	ASSERT_TRUE(writer) << writer.error().String();
+
+	mtesting::TestEventLoop loop;
+	bool called = false;
+	{
+		block_writer::AsyncBlockWriter async_writer(loop, writer.value());
+		auto err = async_writer.AsyncWrite(
+			data.cbegin(), data.cend(), [&](io::ExpectedSize) { called = true; });
+		ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+		async_writer.Cancel();
+
+		// A new write can start right away.
+		err = async_writer.AsyncWrite(
+			data.cbegin(), data.cend(), [&](io::ExpectedSize) { called = true; });
+		ASSERT_EQ(err, mender::common::error::NoError) << err.String();
+	}
+
+	// Let anything which was posted run. Nothing should call the handlers.
+	events::Timer timer(loop);
+	timer.AsyncWait(chrono::milliseconds(100), [&](mender::common::error::Error) { loop.Stop(); });
+	loop.Run();
+	EXPECT_FALSE(called);
+}
+
+TEST(BlockWriterTests, VerifyAbortedOnDestruction) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	auto data = VerifyTestData();
+
+	block_writer::Options options;
+	options.verify_checksum = string(64, '0');
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_TRUE(writer) << writer.error().String();
+	auto result = writer.value()->Write(data.begin(), data.end());
+	ASSERT_TRUE(result) << result.error().String();
+	// Should not hang waiting for the verification.
+	writer.value().reset();
+}
+
+TEST(BlockWriterTests, InvalidBufferSize) {
+	mtesting::TemporaryDirectory tmpdir;
+	auto target = path::Join(tmpdir.Path(), "target");
+
+	block_writer::Options options;
+	options.buffer_size = block_writer::BlockSize + 1;
+	auto writer = block_writer::BlockWriter::Open(target, options);
+	ASSERT_FALSE(writer);
+	EXPECT_EQ(writer.error().code, make_error_condition(errc::invalid_argument));
+}
+
+TEST(BlockWriterTests, CannotOpen) {
+	auto writer = block_writer::BlockWriter::Open("/non-existing-directory/target");
+	ASSERT_FALSE(writer);
+	EXPECT_EQ(writer.error().code, make_error_condition(errc::no_such_file_or_directory));
+}
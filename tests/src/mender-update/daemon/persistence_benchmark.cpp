@@ -0,0 +1,169 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+#include <gtest/gtest.h>
+
+#include <client_shared/conf.hpp>
+#include <common/error.hpp>
+#include <common/key_value_database.hpp>
+#include <common/testing.hpp>
+
+#include <mender-update/context.hpp>
+#include <mender-update/daemon/context.hpp>
+
+namespace mender {
+namespace update {
+namespace daemon {
+
+namespace conf = mender::client_shared::conf;
+namespace error = mender::common::error;
+namespace kvdb = mender::common::key_value_database;
+namespace mtesting = mender::common::testing;
+
+namespace context = mender::update::context;
+
+using namespace std;
+
+// The value of `StateDatabaseDurability`, and where the database is.
+using BenchmarkParams = tuple<string, mtesting::BenchmarkLocation>;
+
+class PersistenceBenchmark : public testing::TestWithParam<BenchmarkParams> {
+protected:
+	void SetUp() override {
+		tmpdir_.reset(new mtesting::TemporaryDirectory(get<1>(GetParam()).path));
+		config_.state_database_durability = get<0>(GetParam());
+		config_.paths.SetDataStore(tmpdir_->Path());
+
+		main_context_.reset(new context::MenderContext(config_));
+		auto err = main_context_->Initialize();
+		ASSERT_EQ(err, error::NoError) << err.String();
+		ctx_.reset(new Context(*main_context_, event_loop_));
+	}
+
+	void TearDown() override {
+		ctx_.reset();
+		main_context_.reset();
+		tmpdir_.reset();
+	}
+
+	// State data for an update with a realistic amount of provides in it.
+	static StateData MakeStateData() {
+		StateData data;
+		data.state = "update-store";
+		data.update_info.id = "b35b0750-e2b7-4e24-91c6-6a162242aefc";
+		auto &artifact = data.update_info.artifact;
+		artifact.source.uri = "https://example.com/artifact-" + string(200, 'x');
+		artifact.source.expire = "2023-08-01T00:00:00Z";
+		artifact.compatible_devices = {"raspberrypi4", "raspberrypi4-64"};
+		artifact.payload_types = {"rootfs-image"};
+		artifact.artifact_name = "artifact-name";
+		artifact.artifact_group = "artifact-group";
+		for (int i = 0; i < 20; i++) {
+			artifact.type_info_provides["rootfs-image.provide-" + to_string(i)] = string(64, 'a');
+		}
+		artifact.clears_artifact_provides = {"rootfs-image.*"};
+		data.update_info.reboot_requested = {"reboot-type-automatic"};
+		data.update_info.supports_rollback = "rollback-supported";
+		return data;
+	}
+
+	static context::ProvidesData MakeProvides() {
+		context::ProvidesData provides;
+		for (int i = 0; i < 100; i++) {
+			provides["module-" + to_string(i) + ".checksum"] = string(64, 'a');
+		}
+		return provides;
+	}
+
+	unique_ptr<mtesting::TemporaryDirectory> tmpdir_;
+	conf::MenderConfig config_;
+	mtesting::TestEventLoop event_loop_;
+	unique_ptr<context::MenderContext> main_context_;
+	unique_ptr<Context> ctx_;
+};
+
+INSTANTIATE_TEST_SUITE_P(
+	,
+	PersistenceBenchmark,
+	testing::Combine(
+		testing::Values("full", "no-meta-sync", "no-sync"),
+		testing::ValuesIn(mtesting::BenchmarkLocations())),
+	[](const testing::TestParamInfo<BenchmarkParams> &info) {
+		string name = get<0>(info.param);
+		replace(name.begin(), name.end(), '-', '_');
+		return name + "_" + get<1>(info.param).name;
+	});
+
+TEST_P(PersistenceBenchmark, SaveDeploymentStateData) {
+	auto data = MakeStateData();
+	mtesting::Benchmark bench("save_state_data");
+	for (int i = 0; i < 500; i++) {
+		// Stay below the limit for state loops.
+		data.update_info.state_data_store_count = 0;
+		bench.Measure([&]() { EXPECT_EQ(ctx_->SaveDeploymentStateData(data), error::NoError); });
+	}
+}
+
+TEST_P(PersistenceBenchmark, LoadDeploymentStateData) {
+	// Loading also stores the data again, to bump the store count.
+	mtesting::Benchmark bench("load_state_data");
+	for (int i = 0; i < 500; i++) {
+		auto data = MakeStateData();
+		ASSERT_EQ(ctx_->SaveDeploymentStateData(data), error::NoError);
+
+		StateData loaded;
+		bench.Measure([&]() {
+			auto exp_bool = ctx_->LoadDeploymentStateData(loaded);
+			ASSERT_TRUE(exp_bool) << exp_bool.error().String();
+			EXPECT_TRUE(exp_bool.value());
+		});
+	}
+}
+
+TEST_P(PersistenceBenchmark, CommitArtifactDataAndLoadProvides) {
+	auto provides = MakeProvides();
+	{
+		mtesting::Benchmark bench("commit_artifact_data");
+		for (int i = 0; i < 500; i++) {
+			bench.Measure([&]() {
+				auto err = main_context_->CommitArtifactData(
+					"artifact-" + to_string(i),
+					"artifact-group",
+					provides,
+					context::ClearsProvidesData {"module-*"},
+					[](kvdb::Transaction &txn) { return error::NoError; });
+				EXPECT_EQ(err, error::NoError);
+			});
+		}
+	}
+
+	{
+		mtesting::Benchmark bench("load_provides");
+		for (int i = 0; i < 2000; i++) {
+			bench.Measure([&]() {
+				auto exp_provides = main_context_->LoadProvides();
+				ASSERT_TRUE(exp_provides) << exp_provides.error().String();
+				EXPECT_EQ(exp_provides.value().size(), provides.size() + 2);
+			});
+		}
+	}
+}
+
+} // namespace daemon
+} // namespace update
+} // namespace mender
@@ -3736,8 +3736,13 @@ void DoSchemaUpdate(kv_db::KeyValueDatabase &db) {
 		common::ByteVectorFromString(state_data));
 	ASSERT_EQ(err, error::NoError);
 
-	regex version_matcher {R"("Version": *[0-9]+)"};
-	state_data = regex_replace(state_data, version_matcher, R"("Version":9876)");
+	if (state_data.compare(0, 4, string("\0MSD", 4)) == 0) {
+		// Binary encoding, where the version follows as a 32-bit little endian number.
+		state_data.replace(4, 4, string("\x94\x26\0\0", 4));
+	} else {
+		regex version_matcher {R"("Version": *[0-9]+)"};
+		state_data = regex_replace(state_data, version_matcher, R"("Version":9876)");
+	}
 
 	// Store the incompatible version under the original key, pretending that this is an upgrade
 	// from a version we don't support.
@@ -4099,7 +4104,7 @@ TEST(DBSchemaMigrationTest, TestFromVersion1To2) {
 	ASSERT_TRUE(exp_bool.value());
 
 	// Check the loaded migrated data
-	EXPECT_EQ(migrated_data.version, kStateDataVersion);
+	EXPECT_EQ(migrated_data.version, kStateDataJsonVersion);
 	EXPECT_EQ(migrated_data.state, "update-status-report");
 	ASSERT_EQ(migrated_data.update_info.artifact.payload_types.size(), 1);
 	EXPECT_EQ(migrated_data.update_info.artifact.payload_types[0], "rootfs-image");
@@ -4112,6 +4117,138 @@ TEST(DBSchemaMigrationTest, TestFromVersion1To2) {
 	EXPECT_EQ(migrated_data.update_info.artifact.artifact_name, "mender-98415760");
 }
 
+TEST(DBSchemaMigrationTest, TestFromVersion2To3) {
+	// Setup
+	mtesting::TemporaryDirectory tmpdir;
+	conf::MenderConfig config {};
+	config.paths.SetDataStore(tmpdir.Path());
+
+	context::MenderContext main_context {config};
+	auto err = main_context.Initialize();
+	ASSERT_EQ(err, error::NoError);
+
+	mtesting::TestEventLoop event_loop;
+	Context ctx {main_context, event_loop};
+
+	auto &db = main_context.GetMenderStoreDB();
+
+	const string version_2_data = R"({
+  "Version": 2,
+  "Name": "update-store",
+  "UpdateInfo": {
+    "Artifact": {
+      "Source": {
+        "URI": "https://example.com/artifact",
+        "Expire": "2023-11-07T08:58:37.023637656Z"
+      },
+      "device_types_compatible": ["qemux86-64"],
+      "PayloadTypes": ["rootfs-image"],
+      "artifact_name": "artifact-name",
+      "artifact_group": "",
+      "artifact_provides": {"rootfs-image.checksum": "abc"},
+      "clears_artifact_provides": ["rootfs-image.*"]
+    },
+    "ID": "b35b0750-e2b7-4e24-91c6-6a162242aefc",
+    "RebootRequested": ["reboot-type-automatic"],
+    "SupportsRollback": "rollback-supported",
+    "StateDataStoreCount": 3,
+    "HasDBSchemaUpdate": false,
+    "AllRollbacksSuccessful": false
+  }
+})";
+	err = db.Write(main_context.state_data_key, common::ByteVectorFromString(version_2_data));
+	ASSERT_EQ(err, error::NoError);
+
+	// END Setup
+
+	StateData migrated_data {};
+	auto exp_bool = ctx.LoadDeploymentStateData(migrated_data);
+	ASSERT_TRUE(exp_bool) << exp_bool.error().String();
+	ASSERT_TRUE(exp_bool.value());
+
+	EXPECT_EQ(migrated_data.version, kStateDataJsonVersion);
+	EXPECT_FALSE(migrated_data.update_info.has_db_schema_update);
+	EXPECT_EQ(migrated_data.state, "update-store");
+	EXPECT_EQ(migrated_data.update_info.artifact.source.uri, "https://example.com/artifact");
+	EXPECT_EQ(migrated_data.update_info.artifact.artifact_name, "artifact-name");
+	EXPECT_EQ(
+		migrated_data.update_info.artifact.type_info_provides["rootfs-image.checksum"], "abc");
+	ASSERT_EQ(migrated_data.update_info.artifact.clears_artifact_provides.size(), 1);
+	EXPECT_EQ(migrated_data.update_info.artifact.clears_artifact_provides[0], "rootfs-image.*");
+	ASSERT_EQ(migrated_data.update_info.reboot_requested.size(), 1);
+	EXPECT_EQ(migrated_data.update_info.reboot_requested[0], "reboot-type-automatic");
+	EXPECT_EQ(migrated_data.update_info.state_data_store_count, 4);
+
+	// The data must stay in JSON until the update is committed, so that a client which can't
+	// read the new version can still pick it up after a rollback.
+	auto exp_bytes = db.Read(main_context.state_data_key);
+	ASSERT_TRUE(exp_bytes);
+	auto exp_json = json::Load(common::StringFromByteVector(exp_bytes.value()));
+	ASSERT_TRUE(exp_json) << exp_json.error().String();
+	auto exp_version = exp_json.value().Get("Version").and_then(json::To<int>);
+	ASSERT_TRUE(exp_version);
+	EXPECT_EQ(exp_version.value(), 2);
+	exp_bytes = db.Read(main_context.state_data_key_uncommitted);
+	EXPECT_FALSE(exp_bytes);
+
+	// After committing, the new version is stored.
+	migrated_data.state = "update-after-commit";
+	migrated_data.version = kStateDataVersion;
+	err = ctx.SaveDeploymentStateData(migrated_data);
+	ASSERT_EQ(err, error::NoError);
+	exp_bytes = db.Read(main_context.state_data_key);
+	ASSERT_TRUE(exp_bytes);
+	EXPECT_EQ(exp_bytes.value()[0], 0);
+
+	StateData committed_data {};
+	exp_bool = ctx.LoadDeploymentStateData(committed_data);
+	ASSERT_TRUE(exp_bool) << exp_bool.error().String();
+	ASSERT_TRUE(exp_bool.value());
+	EXPECT_EQ(committed_data.version, kStateDataVersion);
+	EXPECT_FALSE(committed_data.update_info.has_db_schema_update);
+	EXPECT_EQ(committed_data.state, "update-after-commit");
+	EXPECT_EQ(
+		committed_data.update_info.artifact.type_info_provides,
+		migrated_data.update_info.artifact.type_info_provides);
+	EXPECT_EQ(
+		committed_data.update_info.reboot_requested, migrated_data.update_info.reboot_requested);
+	EXPECT_EQ(committed_data.update_info.supports_rollback, "rollback-supported");
+	EXPECT_EQ(committed_data.update_info.state_data_store_count, 6);
+}
+
+TEST(DBSchemaMigrationTest, TruncatedBinaryStateData) {
+	mtesting::TemporaryDirectory tmpdir;
+	conf::MenderConfig config {};
+	config.paths.SetDataStore(tmpdir.Path());
+
+	context::MenderContext main_context {config};
+	auto err = main_context.Initialize();
+	ASSERT_EQ(err, error::NoError);
+
+	mtesting::TestEventLoop event_loop;
+	Context ctx {main_context, event_loop};
+
+	StateData state_data {};
+	state_data.version = kStateDataVersion;
+	state_data.state = "update-store";
+	state_data.update_info.id = "id";
+	err = ctx.SaveDeploymentStateData(state_data);
+	ASSERT_EQ(err, error::NoError);
+
+	auto &db = main_context.GetMenderStoreDB();
+	auto exp_bytes = db.Read(main_context.state_data_key);
+	ASSERT_TRUE(exp_bytes);
+	auto bytes = exp_bytes.value();
+	bytes.pop_back();
+	err = db.Write(main_context.state_data_key, bytes);
+	ASSERT_EQ(err, error::NoError);
+
+	StateData loaded_data {};
+	auto exp_bool = ctx.LoadDeploymentStateData(loaded_data);
+	ASSERT_FALSE(exp_bool);
+	EXPECT_EQ(exp_bool.error().code, context::MakeError(context::DatabaseValueError, "").code);
+}
+
 } // namespace daemon
 } // namespace update
 } // namespace mender
@@ -910,6 +910,182 @@ TEST_F(DeploymentsTests, PushStatusFailureTest) {
 	EXPECT_TRUE(handler_called);
 }
 
+// Records the pushed statuses, and lets the test decide when, and how, each push finishes.
+class ManualStatusDeploymentAPI : virtual public deps::DeploymentAPI {
+public:
+	error::Error CheckNewDeployments(
+		context::MenderContext &ctx,
+		api::Client &client,
+		deps::CheckUpdatesAPIResponseHandler api_handler) override {
+		return error::NoError;
+	}
+	error::Error PushStatus(
+		const string &deployment_id,
+		deps::DeploymentStatus status,
+		const string &substate,
+		api::Client &client,
+		deps::StatusAPIResponseHandler api_handler) override {
+		pushed.push_back(deployment_id + ":" + deps::DeploymentStatusString(status));
+		handlers.push_back(api_handler);
+		return error::NoError;
+	}
+	error::Error PushLogs(
+		const string &deployment_id,
+		const string &log_file_path,
+		api::Client &client,
+		deps::LogsAPIResponseHandler api_handler) override {
+		return error::NoError;
+	}
+
+	void Finish(error::Error err) {
+		ASSERT_FALSE(handlers.empty());
+		auto handler = handlers.front();
+		handlers.erase(handlers.begin());
+		handler(err);
+	}
+
+	vector<string> pushed;
+	vector<deps::StatusAPIResponseHandler> handlers;
+};
+
+class StatusReporterTests : public DeploymentsTests {
+protected:
+	void SetUp() override {
+		cfg_.paths.SetDataStore(test_state_dir.Path());
+		ctx_.reset(new context::MenderContext(cfg_));
+		auto err = ctx_->Initialize();
+		ASSERT_EQ(err, error::NoError);
+	}
+
+	bool QueueStored() {
+		auto exp_bytes = ctx_->GetMenderStoreDB().Read(
+			context::MenderContext::deployment_status_queue_key);
+		return bool(exp_bytes);
+	}
+
+	conf::MenderConfig cfg_;
+	unique_ptr<context::MenderContext> ctx_;
+	TestEventLoop loop_;
+	NoAuthHTTPClient client_ {http::ClientConfig {}, loop_};
+	ManualStatusDeploymentAPI api_;
+};
+
+TEST_F(StatusReporterTests, CoalescesStatuses) {
+	deps::StatusReporter reporter(*ctx_);
+
+	auto err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Downloading);
+	ASSERT_EQ(err, error::NoError);
+	// These arrive while "downloading" is being sent, so only the last one is sent.
+	err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Installing);
+	ASSERT_EQ(err, error::NoError);
+	err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Rebooting);
+	ASSERT_EQ(err, error::NoError);
+
+	bool flushed = false;
+	reporter.Flush(api_, client_, [&flushed](error::Error err) {
+		EXPECT_EQ(err, error::NoError);
+		flushed = true;
+	});
+	EXPECT_EQ(api_.pushed, vector<string>({"1:downloading"}));
+
+	api_.Finish(error::NoError);
+	EXPECT_EQ(api_.pushed, vector<string>({"1:downloading", "1:rebooting"}));
+	EXPECT_FALSE(flushed);
+
+	api_.Finish(error::NoError);
+	EXPECT_TRUE(flushed);
+	EXPECT_TRUE(api_.handlers.empty());
+
+	auto exp_pending = reporter.HasPending();
+	ASSERT_TRUE(exp_pending);
+	EXPECT_FALSE(exp_pending.value());
+	// Nothing failed, so nothing should have been stored.
+	EXPECT_FALSE(QueueStored());
+}
+
+TEST_F(StatusReporterTests, KeepsFailedStatusesAcrossRestarts) {
+	{
+		deps::StatusReporter reporter(*ctx_);
+		auto err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Success);
+		ASSERT_EQ(err, error::NoError);
+
+		error::Error flush_err;
+		reporter.Flush(api_, client_, [&flush_err](error::Error err) { flush_err = err; });
+		api_.Finish(error::Error(make_error_condition(errc::host_unreachable), "No network"));
+		EXPECT_EQ(flush_err.code, make_error_condition(errc::host_unreachable));
+		EXPECT_TRUE(QueueStored());
+	}
+
+	deps::StatusReporter reporter(*ctx_);
+	auto exp_pending = reporter.HasPending();
+	ASSERT_TRUE(exp_pending);
+	EXPECT_TRUE(exp_pending.value());
+
+	bool flushed = false;
+	reporter.Flush(api_, client_, [&flushed](error::Error err) {
+		EXPECT_EQ(err, error::NoError);
+		flushed = true;
+	});
+	EXPECT_EQ(api_.pushed, vector<string>({"1:success", "1:success"}));
+	api_.Finish(error::NoError);
+	EXPECT_TRUE(flushed);
+	EXPECT_FALSE(QueueStored());
+}
+
+TEST_F(StatusReporterTests, FailedStatusIsReplacedByNewerOne) {
+	deps::StatusReporter reporter(*ctx_);
+	auto err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Installing);
+	ASSERT_EQ(err, error::NoError);
+	api_.Finish(error::Error(make_error_condition(errc::host_unreachable), "No network"));
+
+	// A new deployment supersedes everything of the old one.
+	err = reporter.Report(api_, client_, "2", deps::DeploymentStatus::Downloading);
+	ASSERT_EQ(err, error::NoError);
+	api_.Finish(error::NoError);
+
+	EXPECT_EQ(api_.pushed, vector<string>({"1:installing", "2:downloading"}));
+	auto exp_pending = reporter.HasPending();
+	ASSERT_TRUE(exp_pending);
+	EXPECT_FALSE(exp_pending.value());
+	EXPECT_FALSE(QueueStored());
+}
+
+TEST_F(StatusReporterTests, FailureOfSupersededStatusContinues) {
+	deps::StatusReporter reporter(*ctx_);
+	auto err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Downloading);
+	ASSERT_EQ(err, error::NoError);
+	err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Installing);
+	ASSERT_EQ(err, error::NoError);
+
+	// "installing" is sent right away, without waiting for the next report.
+	api_.Finish(error::Error(make_error_condition(errc::host_unreachable), "No network"));
+	EXPECT_EQ(api_.pushed, vector<string>({"1:downloading", "1:installing"}));
+	api_.Finish(error::NoError);
+
+	auto exp_pending = reporter.HasPending();
+	ASSERT_TRUE(exp_pending);
+	EXPECT_FALSE(exp_pending.value());
+	EXPECT_FALSE(QueueStored());
+}
+
+TEST_F(StatusReporterTests, AbortedDeploymentDropsStatuses) {
+	deps::StatusReporter reporter(*ctx_);
+	auto err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Installing);
+	ASSERT_EQ(err, error::NoError);
+	err = reporter.Report(api_, client_, "1", deps::DeploymentStatus::Rebooting);
+	ASSERT_EQ(err, error::NoError);
+
+	error::Error flush_err;
+	reporter.Flush(api_, client_, [&flush_err](error::Error err) { flush_err = err; });
+	api_.Finish(deps::MakeError(deps::DeploymentAbortedError, "Aborted"));
+	EXPECT_EQ(flush_err.code, deps::MakeError(deps::DeploymentAbortedError, "").code);
+
+	EXPECT_EQ(api_.pushed, vector<string>({"1:installing"}));
+	auto exp_pending = reporter.HasPending();
+	ASSERT_TRUE(exp_pending);
+	EXPECT_FALSE(exp_pending.value());
+}
+
 TEST_F(DeploymentsTests, JsonLogMessageReaderTest) {
 	const string messages =
 		R"({"timestamp": "2016-03-11T13:03:17.063493443Z", "level": "INFO", "message": "OK"}
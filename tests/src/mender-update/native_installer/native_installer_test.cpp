@@ -0,0 +1,300 @@
+// Copyright 2023 Northern.tech AS
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <mender-update/native_installer/native_installer.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <common/error.hpp>
+#include <common/path.hpp>
+#include <common/processes.hpp>
+#include <common/testing.hpp>
+
+using namespace std;
+
+namespace error = mender::common::error;
+namespace mtesting = mender::common::testing;
+namespace native_installer = mender::update::native_installer;
+namespace path = mender::common::path;
+namespace processes = mender::common::processes;
+
+class NativeInstallerTests : public testing::Test {
+protected:
+	mtesting::TemporaryDirectory tmpdir_;
+	string work_dir_;
+	string dest_;
+
+	void SetUp() override {
+		work_dir_ = path::Join(tmpdir_.Path(), "tree");
+		ASSERT_EQ(path::CreateDirectories(path::Join(work_dir_, "files")), error::NoError);
+		ASSERT_EQ(path::CreateDirectories(path::Join(work_dir_, "tmp")), error::NoError);
+		dest_ = path::Join(tmpdir_.Path(), "dest");
+	}
+
+	void WriteFile(const string &file, const string &content) {
+		ofstream stream(file);
+		stream << content;
+		ASSERT_TRUE(stream.good());
+	}
+
+	string ReadFile(const string &file) {
+		ifstream stream(file);
+		return string {istreambuf_iterator<char>(stream), istreambuf_iterator<char>()};
+	}
+
+	// Creates a `directory` payload with `file.txt` and `sub/file.txt` in it.
+	void PrepareDirectoryPayload(const string &content) {
+		auto src = path::Join(tmpdir_.Path(), "src");
+		ASSERT_EQ(path::CreateDirectories(path::Join(src, "sub")), error::NoError);
+		WriteFile(path::Join(src, "file.txt"), content);
+		WriteFile(path::Join(src, "sub", "file.txt"), content);
+
+		processes::Process proc(
+			{"tar", "-cf", path::Join(work_dir_, "files", "update.tar"), "-C", src, "."});
+		ASSERT_EQ(proc.Run(), error::NoError);
+		ASSERT_EQ(path::DeleteRecursively(src), error::NoError);
+
+		WriteFile(path::Join(work_dir_, "files", "dest_dir"), dest_ + "\n");
+	}
+};
+
+TEST_F(NativeInstallerTests, Create) {
+	EXPECT_NE(native_installer::Installer::Create("directory"), nullptr);
+	EXPECT_NE(native_installer::Installer::Create("single-file"), nullptr);
+	EXPECT_EQ(native_installer::Installer::Create("rootfs-image"), nullptr);
+}
+
+TEST_F(NativeInstallerTests, Queries) {
+	auto installer = native_installer::Installer::Create("directory");
+
+	auto result = installer->Call("NeedsArtifactReboot", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(result.value(), "No");
+
+	result = installer->Call("SupportsRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(result.value(), "Yes");
+
+	result = installer->Call("ProvidePayloadFileSizes", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(result.value(), "");
+}
+
+TEST_F(NativeInstallerTests, DirectoryInstallAndCommit) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+
+	EXPECT_EQ(ReadFile(path::Join(dest_, "file.txt")), "new");
+	EXPECT_EQ(ReadFile(path::Join(dest_, "sub", "file.txt")), "new");
+	EXPECT_FALSE(path::FileExists(path::Join(dest_, "old.txt")));
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::StagingSuffix));
+	EXPECT_EQ(ReadFile(path::Join(dest_ + native_installer::BackupSuffix, "old.txt")), "old");
+
+	result = installer->Call("ArtifactCommit", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "file.txt")), "new");
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::BackupSuffix));
+}
+
+TEST_F(NativeInstallerTests, DirectoryInstallAndRollback) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "file.txt")), "new");
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "old.txt")), "old");
+	EXPECT_FALSE(path::FileExists(path::Join(dest_, "file.txt")));
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::BackupSuffix));
+}
+
+TEST_F(NativeInstallerTests, DirectoryRollbackAfterInterruptedInstall) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+
+	// Pretend we crashed after the exchange, but before the old content was moved from the
+	// staging path to the backup path.
+	auto staging = dest_ + native_installer::StagingSuffix;
+	ASSERT_EQ(path::Rename(dest_ + native_installer::BackupSuffix, staging), error::NoError);
+
+	// The old content must survive a cleanup, in case rolling back fails.
+	result = installer->Call("Cleanup", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(staging, "old.txt")), "old");
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "old.txt")), "old");
+	EXPECT_FALSE(path::FileExists(path::Join(dest_, "file.txt")));
+	EXPECT_FALSE(path::FileExists(staging));
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::BackupSuffix));
+}
+
+TEST_F(NativeInstallerTests, DirectoryRollbackWithMissingDestination) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+
+	// Pretend we crashed between the two renames used when the filesystem can't exchange.
+	auto staging = dest_ + native_installer::StagingSuffix;
+	ASSERT_EQ(path::Rename(dest_, staging), error::NoError);
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "old.txt")), "old");
+	EXPECT_FALSE(path::FileExists(staging));
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::BackupSuffix));
+}
+
+TEST_F(NativeInstallerTests, DirectoryInstallNewAndRollback) {
+	dest_ = path::Join(tmpdir_.Path(), "parent", "dest");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "file.txt")), "new");
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_FALSE(path::FileExists(dest_));
+}
+
+TEST_F(NativeInstallerTests, DirectoryRollbackWithoutInstall) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	PrepareDirectoryPayload("new");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(path::Join(dest_, "old.txt")), "old");
+}
+
+TEST_F(NativeInstallerTests, DirectoryInstallFailureLeavesDestination) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	WriteFile(path::Join(dest_, "old.txt"), "old");
+	WriteFile(path::Join(work_dir_, "files", "update.tar"), "not a tar file");
+	WriteFile(path::Join(work_dir_, "files", "dest_dir"), dest_);
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	EXPECT_FALSE(result);
+	EXPECT_EQ(ReadFile(path::Join(dest_, "old.txt")), "old");
+	EXPECT_FALSE(path::FileExists(dest_ + native_installer::StagingSuffix));
+}
+
+TEST_F(NativeInstallerTests, DirectoryRootNotSupported) {
+	PrepareDirectoryPayload("new");
+	WriteFile(path::Join(work_dir_, "files", "dest_dir"), "/");
+
+	auto installer = native_installer::Installer::Create("directory");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_FALSE(result);
+	EXPECT_EQ(result.error().code, make_error_condition(errc::invalid_argument));
+}
+
+TEST_F(NativeInstallerTests, SingleFileInstallAndRollback) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	auto target = path::Join(dest_, "config.txt");
+	WriteFile(target, "old");
+
+	WriteFile(path::Join(work_dir_, "files", "config.txt"), "new");
+	WriteFile(path::Join(work_dir_, "files", "dest_dir"), dest_);
+	WriteFile(path::Join(work_dir_, "files", "filename"), "config.txt");
+	WriteFile(path::Join(work_dir_, "files", "permissions"), "640\n");
+
+	auto installer = native_installer::Installer::Create("single-file");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "new");
+	struct stat st;
+	ASSERT_EQ(stat(target.c_str(), &st), 0);
+	EXPECT_EQ(st.st_mode & 0777, 0640);
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "old");
+	EXPECT_FALSE(path::FileExists(target + native_installer::BackupSuffix));
+}
+
+TEST_F(NativeInstallerTests, SingleFileInstallAgain) {
+	ASSERT_EQ(path::CreateDirectories(dest_), error::NoError);
+	auto target = path::Join(dest_, "config.txt");
+	WriteFile(target, "old");
+
+	WriteFile(path::Join(work_dir_, "files", "config.txt"), "new");
+	WriteFile(path::Join(work_dir_, "files", "dest_dir"), dest_);
+	WriteFile(path::Join(work_dir_, "files", "filename"), "config.txt");
+
+	auto installer = native_installer::Installer::Create("single-file");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+
+	// Like after being interrupted, the first attempt is rolled back and the file is staged
+	// again.
+	result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "new");
+
+	result = installer->Call("ArtifactRollback", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "old");
+}
+
+TEST_F(NativeInstallerTests, SingleFileInstallAndCommit) {
+	auto target = path::Join(dest_, "config.txt");
+
+	WriteFile(path::Join(work_dir_, "files", "config.txt"), "new");
+	WriteFile(path::Join(work_dir_, "files", "dest_dir"), dest_);
+	WriteFile(path::Join(work_dir_, "files", "filename"), "config.txt");
+
+	auto installer = native_installer::Installer::Create("single-file");
+	auto result = installer->Call("ArtifactInstall", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "new");
+
+	result = installer->Call("ArtifactCommit", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "new");
+
+	result = installer->Call("Cleanup", work_dir_);
+	ASSERT_TRUE(result) << result.error().String();
+	EXPECT_EQ(ReadFile(target), "new");
+}
@@ -14,9 +14,12 @@
 
 #include <mender-update/progress_reader/progress_reader.hpp>
 
+#include <chrono>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <common/io.hpp>
@@ -65,3 +68,112 @@ TEST(ProgressReaderTests, RegularRead) {
 
 	EXPECT_EQ(output, "\r0%\r5%\r25%\r90%\r100%");
 }
+
+TEST(ProgressTrackerTests, RateLimited) {
+	std::vector<progress::Event> events;
+	progress::TrackerOptions options;
+	options.interval = std::chrono::hours(1);
+	options.check_bytes = 0;
+	progress::Tracker tracker("download", 1000, options, [&events](const progress::Event &event) {
+		events.push_back(event);
+	});
+
+	for (int i = 0; i < 100; i++) {
+		tracker.Add(10);
+	}
+	// Finishing again after all the bytes have been added does nothing.
+	tracker.Finish();
+
+	// The first one, and the final one.
+	ASSERT_EQ(events.size(), 2);
+	EXPECT_EQ(events[0].stage, "download");
+	EXPECT_EQ(events[0].bytes, 10);
+	EXPECT_EQ(events[0].total_bytes, 1000);
+	EXPECT_FALSE(events[0].finished);
+	EXPECT_EQ(events[1].bytes, 1000);
+	EXPECT_EQ(events[1].eta_seconds, 0);
+	EXPECT_TRUE(events[1].finished);
+}
+
+TEST(ProgressTrackerTests, ChecksClockOnlyEveryCheckBytes) {
+	std::vector<progress::Event> events;
+	progress::TrackerOptions options;
+	options.interval = std::chrono::milliseconds(0);
+	options.check_bytes = 100;
+	progress::Tracker tracker("download", -1, options, [&events](const progress::Event &event) {
+		events.push_back(event);
+	});
+
+	for (int i = 0; i < 100; i++) {
+		tracker.Add(10);
+	}
+
+	// With no interval, every check sends an event, but the checks are 100 bytes apart.
+	ASSERT_EQ(events.size(), 10);
+	for (size_t i = 0; i < events.size(); i++) {
+		EXPECT_EQ(events[i].bytes, static_cast<int64_t>(10 + i * 100));
+		EXPECT_EQ(events[i].eta_seconds, -1);
+		EXPECT_FALSE(events[i].finished);
+	}
+
+	tracker.Finish();
+	tracker.Finish();
+	ASSERT_EQ(events.size(), 11);
+	EXPECT_EQ(events[10].bytes, 1000);
+	EXPECT_TRUE(events[10].finished);
+}
+
+TEST(ProgressTrackerTests, ReaderFeedsTracker) {
+	std::string d(1024 * 100, 'x');
+	auto rdr = std::make_shared<io::StringReader>(d);
+
+	std::vector<progress::Event> events;
+	progress::TrackerOptions options;
+	options.interval = std::chrono::hours(1);
+	auto tracker = std::make_shared<progress::Tracker>(
+		"download", -1, options, [&events](const progress::Event &event) {
+			events.push_back(event);
+		});
+	auto reader = progress::Reader(rdr, d.size(), tracker);
+
+	testing::internal::CaptureStderr();
+
+	std::vector<uint8_t> tmp(1024);
+	while (true) {
+		auto result = reader.Read(tmp.begin(), tmp.end());
+		ASSERT_TRUE(result) << result.error().String();
+		if (result.value() == 0) {
+			break;
+		}
+	}
+
+	EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+
+	ASSERT_EQ(events.size(), 2);
+	EXPECT_EQ(events[1].bytes, 1024 * 100);
+	EXPECT_TRUE(events[1].finished);
+}
+
+TEST(ProgressTrackerTests, EventFormats) {
+	progress::Event event;
+	event.stage = "download \"rootfs\"";
+	event.bytes = 50 * 1024 * 1024;
+	event.total_bytes = 100 * 1024 * 1024;
+	event.elapsed = std::chrono::milliseconds(25000);
+	event.bytes_per_second = 2 * 1024 * 1024;
+	event.eta_seconds = 25;
+
+	EXPECT_EQ(
+		progress::EventToJson(event),
+		R"({"stage":"download \"rootfs\"","bytes":52428800,"total_bytes":104857600,)"
+		R"("elapsed_ms":25000,"bytes_per_second":2097152,"eta_seconds":25,"finished":false})");
+	EXPECT_EQ(
+		progress::EventToString(event),
+		"download \"rootfs\": 50% of 100.0 MiB, 2.0 MiB/s, 25 s left");
+
+	event.stage = "install";
+	event.bytes = 0;
+	event.total_bytes = -1;
+	event.finished = true;
+	EXPECT_EQ(progress::EventToString(event), "install: done in 25 s");
+}
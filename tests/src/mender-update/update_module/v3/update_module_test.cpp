@@ -864,6 +864,128 @@ test "$line" = ""
 		FilesEqual(path::Join(work_dir_, "payload"), path::Join(temp_dir_.Path(), "rootfs")));
 }
 
+TEST_F(UpdateModuleTests, DownloadNativeWrite) {
+	UpdateModuleTestWithDefaultArtifact art(*this);
+
+	auto maybe_script = PrepareUpdateModuleScript(*art.update_module);
+	ASSERT_TRUE(maybe_script) << maybe_script.error();
+	auto script_path = maybe_script.value();
+	{
+		ofstream um_script(script_path);
+		um_script << R"delim(#!/bin/bash
+set -e
+echo "Update Module called" 1>&2
+test "$1" = "ProvidePayloadWriteTarget"
+echo "$PWD/target"
+)delim";
+	}
+
+	art.config.native_payload_writer = true;
+
+	auto err = art.update_module->Download(*art.payload);
+	EXPECT_EQ(err, error::NoError) << err.String();
+	EXPECT_TRUE(
+		FilesEqual(path::Join(work_dir_, "target"), path::Join(temp_dir_.Path(), "rootfs")));
+}
+
+TEST_F(UpdateModuleTests, DownloadNativeWriteNotSupportedByModule) {
+	UpdateModuleTestWithDefaultArtifact art(*this);
+
+	auto maybe_script = PrepareUpdateModuleScript(*art.update_module);
+	ASSERT_TRUE(maybe_script) << maybe_script.error();
+	auto script_path = maybe_script.value();
+	{
+		ofstream um_script(script_path);
+		um_script << R"delim(#!/bin/bash
+set -e
+if [ "$1" = "ProvidePayloadWriteTarget" ]; then
+    exit 0
+fi
+test "$1" = "Download"
+file="$(cat stream-next)"
+test "$file" = "streams/rootfs"
+cat "$file" > payload
+file="$(cat stream-next)"
+test "$file" = ""
+)delim";
+	}
+
+	art.config.native_payload_writer = true;
+
+	auto err = art.update_module->Download(*art.payload);
+	EXPECT_EQ(err, error::NoError) << err.String();
+	EXPECT_TRUE(
+		FilesEqual(path::Join(work_dir_, "payload"), path::Join(temp_dir_.Path(), "rootfs")));
+	EXPECT_FALSE(path::FileExists(path::Join(work_dir_, "target")));
+}
+
+TEST_F(UpdateModuleTests, DownloadNativeWriteBogusTarget) {
+	UpdateModuleTestWithDefaultArtifact art(*this);
+
+	auto maybe_script = PrepareUpdateModuleScript(*art.update_module);
+	ASSERT_TRUE(maybe_script) << maybe_script.error();
+	auto script_path = maybe_script.value();
+	{
+		ofstream um_script(script_path);
+		um_script << R"delim(#!/bin/bash
+echo "relative/target"
+)delim";
+	}
+
+	art.config.native_payload_writer = true;
+
+	auto err = art.update_module->Download(*art.payload);
+	EXPECT_NE(err, error::NoError);
+	EXPECT_EQ(err.code, make_error_condition(errc::protocol_error)) << err.String();
+}
+
+TEST_F(UpdateModuleTests, NativeInstaller) {
+	conf::MenderConfig config;
+	config.native_installers = true;
+	context::MenderContext ctx(config);
+	update_module::UpdateModule update_module(ctx, "directory");
+	// There is no script, everything is handled by the built-in installer.
+	update_module.SetUpdateModulePath(GetUpdateModulePath());
+	update_module.SetUpdateModuleWorkDir(work_dir_);
+
+	auto src = path::Join(temp_dir_.Path(), "src");
+	ASSERT_EQ(path::CreateDirectory(src), error::NoError);
+	{
+		ofstream f(path::Join(src, "file.txt"));
+		f << "new";
+	}
+	auto files = path::Join(work_dir_, "files");
+	ASSERT_EQ(path::CreateDirectory(files), error::NoError);
+	ASSERT_EQ(path::CreateDirectory(path::Join(work_dir_, "tmp")), error::NoError);
+	processes::Process proc({"tar", "-cf", path::Join(files, "update.tar"), "-C", src, "."});
+	ASSERT_EQ(proc.Run(), error::NoError);
+	auto dest = path::Join(temp_dir_.Path(), "dest");
+	{
+		ofstream f(path::Join(files, "dest_dir"));
+		f << dest;
+	}
+
+	auto supports_rollback = update_module.SupportsRollback();
+	ASSERT_TRUE(supports_rollback) << supports_rollback.error().String();
+	EXPECT_TRUE(supports_rollback.value());
+
+	auto needs_reboot = update_module.NeedsReboot();
+	ASSERT_TRUE(needs_reboot) << needs_reboot.error().String();
+	EXPECT_EQ(needs_reboot.value(), update_module::RebootAction::No);
+
+	auto err = update_module.ArtifactInstall();
+	ASSERT_EQ(err, error::NoError) << err.String();
+	EXPECT_TRUE(path::FileExists(path::Join(dest, "file.txt")));
+
+	err = update_module.ArtifactRollback();
+	ASSERT_EQ(err, error::NoError) << err.String();
+	EXPECT_FALSE(path::FileExists(dest));
+
+	err = update_module.Cleanup();
+	ASSERT_EQ(err, error::NoError) << err.String();
+	EXPECT_FALSE(path::FileExists(work_dir_));
+}
+
 TEST_F(UpdateModuleTests, CallArtifactReboot) {
 	UpdateModuleTestWithDefaultArtifact update_module_test(*this);
 	ASSERT_FALSE(HasFailure());